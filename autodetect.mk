@@ -4,6 +4,8 @@ SRC := $(wildcard src/*.cc)
 PROG_SRC := $(wildcard progs/*.cc)
 TEST_SRC := $(wildcard tests/*.cc)
 TEST_RUNNER := $(BUILDDIR)/debug/test.cc
+TABLES_SRC := $(BUILDDIR)/generated/isf_tables.cc
+GEN_TABLES := $(BUILDDIR)/gen_tables
 
 # Lists of files to produce
 OBJ := $(SRC:%.cc=$(BUILDDIR)/%.o)
@@ -12,6 +14,8 @@ DEBUG_OBJ := $(SRC:%.cc=$(BUILDDIR)/debug/%.o)
 PROFILE_OBJ := $(SRC:%.cc=$(BUILDDIR)/prof/%.o)
 TEST_OBJ := $(TEST_SRC:%.cc=$(BUILDDIR)/debug/%.o)
 TEST_RUNNER_OBJ := $(BUILDDIR)/debug/test.o
+TABLES_OBJ := $(BUILDDIR)/generated/isf_tables.o
+DEBUG_TABLES_OBJ := $(BUILDDIR)/debug/generated/isf_tables.o
 
 DEP := $(SRC:%.cc=$(BUILDDIR)/%.d)
 PROG_DEP := $(PROG_SRC:%.cc=$(BUILDDIR)/%.d)
@@ -19,9 +23,13 @@ DEBUG_DEP := $(SRC:%.cc=$(BUILDDIR)/debug/%.d)
 PROFILE_DEP := $(SRC:%.cc=$(BUILDDIR)/prof/%.d)
 TEST_DEP := $(TEST_SRC:%.cc=$(BUILDDIR)/debug/%.d)
 TEST_RUNNER_DEP := $(BUILDDIR)/debug/test.d
+TABLES_DEP := $(BUILDDIR)/generated/isf_tables.d
+DEBUG_TABLES_DEP := $(BUILDDIR)/debug/generated/isf_tables.d
 
-ALL_OBJ := $(OBJ) $(PROG_OBJ) $(DEBUG_OBJ) $(PROFILE_OBJ) $(TEST_OBJ) $(TEST_RUNNER_OBJ)
+ALL_OBJ := $(OBJ) $(PROG_OBJ) $(DEBUG_OBJ) $(PROFILE_OBJ) $(TEST_OBJ) $(TEST_RUNNER_OBJ) \
+	$(TABLES_OBJ) $(DEBUG_TABLES_OBJ)
 
-ALL_DEP := $(DEP) $(PROG_DEP) $(DEBUG_DEP) $(PROFILE_DEP) $(TEST_DEP) $(TEST_RUNNER_DEP)
+ALL_DEP := $(DEP) $(PROG_DEP) $(DEBUG_DEP) $(PROFILE_DEP) $(TEST_DEP) $(TEST_RUNNER_DEP) \
+	$(TABLES_DEP) $(DEBUG_TABLES_DEP)
 
 DIRS := $(sort $(dir $(ALL_OBJ) $(ALL_DEP)))
@@ -10,16 +10,40 @@ LD := g++
 # Include lists for library code and for the tests
 INCLUDE := -I include/
 LIB_INCLUDE := $(INCLUDE) -I src/
-TEST_INCLUDE := $(INCLUDE) -I tests/
+TEST_INCLUDE := $(INCLUDE) -I src/ -I tests/
 
 # External libraries to link against
 LIBRARIES := -lgmpxx -lgmp
 
+# Couplings (p1,q1) x (p2,q2) -> (p,q) with p1+q1 and p2+q2 at most this
+# are calculated at build time and compiled into the library
+BUILTIN_MAX_PQ := 3
+
+# Table of CGCs written by 'make table', and the largest p+q of any rep in it
+TABLE_FILE := SU3.table
+TABLE_MAX_PQ := 3
+
 # Flags to pass to the build tools. The version with no prefix is passed
 # when doing a regular build, the version with _DEBUG is passed for
 # debug builds (which includes when running the tests).
-COMMON_CFLAGS := -std=c++11 -Wall -Wextra -Werror
-COMMON_LDFLAGS :=
+COMMON_CFLAGS := -std=c++11 -pthread -Wall -Wextra -Werror
+COMMON_LDFLAGS := -pthread
+
+# Set to 1 to build the MPFR engine (include/SU3_mpfr.h), or 0 not to. By
+# default, it is built whenever the MPFR headers can be found. Programs using
+# the library then need to link with -lmpfr. If MPFR is installed somewhere
+# the compiler doesn't look, set MPFR_CFLAGS and MPFR_LIBS, for example to
+# -I<prefix>/include and -L<prefix>/lib -lmpfr. Run 'make clean-all' after
+# changing any of these.
+MPFR_CFLAGS :=
+MPFR_LIBS := -lmpfr
+USE_MPFR := $(shell printf '\043include <mpfr.h>\n' | $(LD) -E -x c++ $(MPFR_CFLAGS) - \
+		>/dev/null 2>&1 && echo 1 || echo 0)
+
+ifeq ($(USE_MPFR),1)
+COMMON_CFLAGS += -DSU3_USE_MPFR $(MPFR_CFLAGS)
+LIBRARIES := $(MPFR_LIBS) $(LIBRARIES)
+endif
 
 CFLAGS := $(COMMON_CFLAGS) -DNDEBUG -O2
 LDFLAGS := $(COMMON_LDFLAGS)
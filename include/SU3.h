@@ -4,6 +4,9 @@
 #define __SU3_H__
 
 #include <stddef.h>
+#include <stdio.h>
+#include <functional>
+#include <memory>
 #include <gmpxx.h>
 
 /* Macros to iterate over the states of a given coupling. We guarantee that:
@@ -62,6 +65,8 @@
 */
 class sqrat
 {
+    friend struct isf_io;
+
 private:
     mpq_class v;
 
@@ -105,8 +110,11 @@ public:
     friend bool operator>=(const sqrat&, const sqrat&);
 
     /* Conversions to various types */
-    char* tostring(char*, size_t);
-    explicit operator double();
+    char* tostring(char*, size_t) const;
+    explicit operator double() const;
+
+    /* Approximate number of bytes of memory used by this value */
+    size_t memory_usage() const;
 };
 
 /* Classes to hold SU(3) isoscalar factors and Clebsch-Gordan coefficients.
@@ -115,17 +123,49 @@ public:
     the same time, so we always return an array containing them all.
 */
 class isoarray;
+class isoarray_double;
+struct isf_mapping;
+struct isf_lazy;
 class cgarray;
+class decomposition;
+
+/* A single coupling (p1,q1) x (p2,q2) -> (p,q) */
+struct coupling
+{
+    long p, q, p1, q1, p2, q2;
+};
 
 /* A class to hold the isoscalar factors for a particular coupling */
 class isoarray
 {
     friend class cgarray;
+    friend class isf_cursor;
+    friend struct isf_io;
+    friend struct isf_symmetry;
+    friend isoarray* open_isoscalars_mapped(const char* path);
+    friend isoarray* isoscalars_lazy(long p, long q, long p1, long q1,
+                                        long p2, long q2);
 
 private:
     size_t size; // Size of the following array
     sqrat* isf_array;
 
+    /* If set, the coefficients are held in a memory-mapped file instead of
+        in isf_array (see open_isoscalars_mapped()) */
+    isf_mapping* mapping;
+
+    /* If set, the coefficients are calculated as they are looked up
+        instead (see isoscalars_lazy()) */
+    isf_lazy* lazy;
+
+    isoarray(long p, long q, long p1, long q1, long p2, long q2, long d,
+                isf_mapping* mapping);
+    isoarray(long p, long q, long p1, long q1, long p2, long q2, long d,
+                isf_lazy* lazy);
+
+    /* The coefficient at a given position in memory order */
+    sqrat value(size_t index) const;
+
     void set_isf(long n, long k, long l, long k1, long l1,
                     long k2, long l2, sqrat v);
 
@@ -150,41 +190,305 @@ public:
         Returns 0 if the arguments are out of bounds
     */
     sqrat operator()(long n, long k, long l, long k1, long l1,
-                        long k2, long l2);
+                        long k2, long l2) const;
 
     /* Convert to Clebsch-Gordans. This returns a newly-allocated cgarray object. */
-    cgarray* to_cgarray();
+    cgarray* to_cgarray() const;
+
+    /* Returns a newly-allocated copy of this object. The copy is always
+        held in memory, even if this object is backed by a file or is
+        calculated lazily. */
+    isoarray* copy() const;
+
+    /* Approximate number of bytes of memory used by this object. For an
+        object backed by a file, this does not include the file itself. */
+    size_t memory_usage() const;
+
+    /* Apply the various symmetry relations */
+    isoarray* exch_12() const;
+    isoarray* exch_13bar() const;
+    isoarray* exch_23bar() const;
+
+    /* The ISFs for the conjugate coupling, (q1,p1) x (q2,p2) -> (q,p) */
+    isoarray* conj() const;
+};
+
+/* Isoscalar factors for a particular coupling, calculated in floating point
+    by isoscalars_double(). The indexing is the same as for isoarray. */
+class isoarray_double
+{
+    friend struct isf_symmetry;
+
+private:
+    size_t size; // Size of the following array
+    double* isf_array;
+
+    void set_isf(long n, long k, long l, long k1, long l1,
+                    long k2, long l2, double v);
+    void check_sign_convention();
+
+public:
+    /* Target and factor reps */
+    const long p, q, p1, q1, p2, q2;
+
+    /* Degeneracy of target rep */
+    const long d;
+
+    /* Note: This type takes ownership of the array passed in */
+    isoarray_double(long p, long q, long p1, long q1, long p2, long q2, long d,
+                    double* isf_array);
+    ~isoarray_double();
+
+    /* Returns 0 if the arguments are out of bounds */
+    double operator()(long n, long k, long l, long k1, long l1,
+                        long k2, long l2) const;
 
     /* Apply the various symmetry relations */
-    isoarray* exch_12();
-    isoarray* exch_13bar();
-    isoarray* exch_23bar();
+    isoarray_double* exch_12() const;
+    isoarray_double* exch_13bar() const;
+    isoarray_double* exch_23bar() const;
+};
+
+/* One row of isoscalar factors, as produced by isoscalars_stream(): the
+    couplings for degenerate rep n to each state (k, l) of the target rep,
+    for one value of k. This does not own its values, which are only valid
+    while the callback it was passed to is running. */
+class isorow
+{
+private:
+    const sqrat* values;
+
+public:
+    /* Target and factor reps */
+    const long p, q, p1, q1, p2, q2;
+
+    /* Degeneracy of target rep, and the rep and row this holds */
+    const long d, n, k;
+
+    isorow(long p, long q, long p1, long q1, long p2, long q2, long d,
+            long n, long k, const sqrat* values);
+
+    /* Indexed like isoarray, with n and k fixed.
+        Returns 0 if the arguments are out of bounds */
+    sqrat operator()(long l, long k1, long l1, long k2, long l2) const;
+
+    /* Number of values in each row, and the values themselves in the same
+        order as in memory in an isoarray */
+    size_t size() const;
+    const sqrat* data() const { return values; }
+};
+
+/* The couplings to the state of highest weight (k=p+q, l=0) of each
+    degenerate rep, as produced by isoscalars_shw(). These are the only
+    values needed to fix each rep, so this is much smaller than an isoarray:
+    for each n, one value for each (k1, l1, k2). */
+class shwarray
+{
+private:
+    sqrat* values;
+
+public:
+    /* Target and factor reps */
+    const long p, q, p1, q1, p2, q2;
+
+    /* Degeneracy of target rep */
+    const long d;
+
+    /* Takes ownership of 'values', which are laid out as in size() below */
+    shwarray(long p, long q, long p1, long q1, long p2, long q2, long d,
+                sqrat* values);
+    ~shwarray();
+
+    /* Indexed like isoarray, with k=p+q and l=0.
+        Returns 0 if the arguments are out of bounds */
+    sqrat operator()(long n, long k1, long l1, long k2, long l2) const;
+
+    /* Number of values, and the values themselves: in the same order as
+        the k=p+q, l=0 entries of an isoarray, for each n in turn */
+    size_t size() const;
+    const sqrat* data() const { return values; }
+};
+
+/* A cursor for walking through an isoarray a row at a time, without the
+    checks which operator() makes on every lookup. Each row holds the
+    values for one (n, k, l, k1), for each l1 and k2, in the same order as
+    in memory; l2 is fixed by hypercharge conservation, as usual. The
+    position is checked when the cursor is moved, and values within the
+    row are then read directly.
+
+    For an isoarray held in memory, the cursor points into its array. For
+    one backed by a file or calculated lazily, each row is copied into a
+    buffer belonging to the cursor as the cursor reaches it. Either way,
+    references into a row are only valid until the cursor is next moved,
+    and the isoarray must outlive the cursor.
+*/
+class isf_cursor
+{
+private:
+    const isoarray& isf;
+    const sqrat* values;
+    sqrat* buffer; // For arrays which aren't held in memory
+    size_t row_size, start; // Position of 'values' in the isoarray
+    long cur_n, cur_k, cur_l, cur_k1;
+    long l2_offset; // l2 + l1 + k2, which is the same throughout a row
+
+    void load();
+
+public:
+    /* Starts at the first row, (0, q, 0, q1) */
+    isf_cursor(const isoarray& isf);
+    ~isf_cursor();
+
+    isf_cursor(const isf_cursor&) = delete;
+    isf_cursor& operator=(const isf_cursor&) = delete;
+
+    /* Move to the row for (n, k, l, k1). If that is out of bounds, this
+        returns false and the cursor stays where it was. */
+    bool seek(long n, long k, long l, long k1);
+
+    /* Move to the next row in memory order: k1 changes fastest, then l, k
+        and n. Returns false, leaving the cursor on the last row, at the end
+        of the array. */
+    bool next();
+
+    /* The current row */
+    long n() const { return cur_n; }
+    long k() const { return cur_k; }
+    long l() const { return cur_l; }
+    long k1() const { return cur_k1; }
+
+    /* The value at (l1, k2) in the current row. This is not checked, so
+        0 <= l1 <= q1 and q2 <= k2 <= p2+q2 are required. The value is zero
+        if l2 is out of range. */
+    const sqrat& operator()(long l1, long k2) const
+    {
+        return values[l1 * (isf.p2+1) + k2 - isf.q2];
+    }
+
+    /* The value of l2 which goes with (l1, k2) in the current row */
+    long l2(long l1, long k2) const { return l2_offset - l1 - k2; }
+
+    /* Number of values in each row, and the values themselves */
+    size_t size() const { return row_size; }
+    const sqrat* data() const { return values; }
 };
 
 /* A class to hold the Clebsch-Gordan coefficients for a particular coupling */
 class cgarray
 {
 private:
-    isoarray* isf;
+    std::shared_ptr<const isoarray> isf;
 
 public:
     /* Note: This type takes ownership of the isoarray object passed in */
     cgarray(isoarray* isf);
+
+    /* Build a cgarray which shares an existing (immutable) isoarray */
+    cgarray(std::shared_ptr<const isoarray> isf);
     ~cgarray();
 
     /* We use operator() instead of operator[] as an easy way to use
         multiple indices */
     sqrat operator()(long n, long k, long l, long m,
                         long k1, long l1, long m1,
-                        long k2, long l2, long m2);
+                        long k2, long l2, long m2) const;
 
     /* Convert to ISFs. This returns a newly-allocated isoarray object. */
-    isoarray* to_isoarray();
+    isoarray* to_isoarray() const;
 
     /* Apply the various symmetry relations */
-    cgarray* exch_12();
-    cgarray* exch_13bar();
-    cgarray* exch_23bar();
+    cgarray* exch_12() const;
+    cgarray* exch_13bar() const;
+    cgarray* exch_23bar() const;
+    cgarray* conj() const;
+};
+
+/* A class to hold the full Clebsch-Gordan series of (p1,q1) x (p2,q2),
+    along with the isoscalar factors for each irrep appearing in it.
+    Irreps are ordered by increasing p, then by increasing q.
+*/
+class decomposition
+{
+private:
+    long count; // Number of distinct irreps in the series
+    isoarray** isfs;
+
+public:
+    /* Factor reps */
+    const long p1, q1, p2, q2;
+
+    /* Note: This type takes ownership of the array passed in, and of each
+        isoarray in it */
+    decomposition(long p1, long q1, long p2, long q2, long count,
+                    isoarray** isfs);
+    ~decomposition();
+
+    /* Number of distinct irreps in the series */
+    long size() const;
+
+    /* The isoscalar factors for the ith irrep; the irrep itself and its
+        degeneracy can be read off from the isoarray. Returns NULL if i is
+        out of range. */
+    isoarray* operator[](long i) const;
+};
+
+/* Shared handles to immutable ISFs and CGCs. Any number of threads may read
+    through the same handle concurrently, without copying the coefficients. */
+typedef std::shared_ptr<const isoarray> isoarray_handle;
+typedef std::shared_ptr<const cgarray> cgarray_handle;
+
+/* Statistics about an isf_cache */
+struct isf_cache_stats
+{
+    unsigned long hits, misses, evictions;
+    size_t entries; // Number of couplings currently cached
+    size_t bytes;   // Approximate memory used by those couplings
+};
+
+/* A thread-safe cache of calculated isoscalar factors, keyed by the coupling.
+
+    The cache is split into a number of shards, each of which is guarded
+    by its own lock for updates. Lookups which hit the cache do not take any
+    locks. When the total memory used by the cached ISFs, across all of the
+    shards, exceeds 'max_bytes', the least recently used couplings are
+    evicted. A coupling which misses
+    the cache is derived from its conjugate, if that is cached, instead of
+    being calculated from scratch.
+*/
+class isf_cache
+{
+public:
+    /* Internal state for one shard of the cache */
+    struct shard;
+
+    /* Internal state for the memory limit, which covers every shard */
+    struct budget;
+
+private:
+    long nshards;
+    shard* shards;
+    budget* limit;
+
+    shard& shard_for(const coupling&);
+    void evict();
+
+public:
+    isf_cache(size_t max_bytes, long nshards = 16);
+    ~isf_cache();
+
+    /* Change the memory limit, evicting entries if necessary */
+    void set_max_bytes(size_t max_bytes);
+
+    /* Look up a set of ISFs, calculating them if they are not yet cached.
+        Returns an empty handle if (p,q) does not appear in (p1,q1) x (p2,q2).
+    */
+    isoarray_handle isoscalars(long p, long q, long p1, long q1, long p2, long q2);
+    cgarray_handle clebsch_gordans(long p, long q, long p1, long q1, long p2, long q2);
+
+    isf_cache_stats stats();
+
+    /* Remove every entry from the cache; this does not reset the counters */
+    void clear();
 };
 
 /* Calculate the dimension of one irrep */
@@ -229,4 +533,268 @@ sqrat su2_cgc(mpq_class I, mpq_class Iz, mpq_class i1, mpq_class i1z,
 isoarray* isoscalars(long p, long q, long p1, long q1, long p2, long q2);
 cgarray* clebsch_gordans(long p, long q, long p1, long q1, long p2, long q2);
 
+/* Calculate isoscalar factors in floating point. This runs the same
+    recursions as isoscalars(), so gives the same results up to rounding
+    error, but is much faster for large reps. If 'extended' is set, the
+    calculation is done in long double, and rounded to double at the end.
+
+    Note: This returns a heap-allocated object, or NULL if (p,q) does not
+    appear in (p1,q1) x (p2,q2).
+*/
+isoarray_double* isoscalars_double(long p, long q, long p1, long q1, long p2, long q2,
+                                    bool extended = false);
+
+/* Versions of the above which go through a process-wide isf_cache.
+    The size of that cache can be changed with set_isf_cache_size();
+    it defaults to 64MiB.
+*/
+isoarray_handle cached_isoscalars(long p, long q, long p1, long q1, long p2, long q2);
+cgarray_handle cached_clebsch_gordans(long p, long q, long p1, long q1, long p2, long q2);
+
+isf_cache& global_isf_cache();
+void set_isf_cache_size(size_t max_bytes);
+
+/* Persistent on-disk cache of isoscalar factors.
+    Once a directory has been set, isoscalars() (and everything built on it)
+    will look there for previously-calculated ISFs before calculating them,
+    and will store the results of any calculations it does.
+
+    The cache is safe to share between processes. Each coupling is stored in
+    its own file, keyed by a canonical representative of the coupling under the
+    symmetry relations and conjugation, and is written atomically. Files which fail their
+    checksum, or which were written by an incompatible version of libSU3,
+    are ignored and replaced.
+
+    When the files in the directory take up more than 'max_bytes', the least
+    recently used ones are deleted. Passing dir = NULL disables the cache.
+*/
+void set_isf_disk_cache(const char* dir, size_t max_bytes);
+
+/* Small couplings are answered from tables compiled into the library (see
+    BUILTIN_MAX_PQ in config.mk), before trying either cache. The tables can
+    be disabled, for example to check them against a fresh calculation.
+    get_builtin_isf_tables() returns the current setting, as do the other
+    get_ functions below.
+*/
+void set_builtin_isf_tables(bool enabled);
+bool get_builtin_isf_tables();
+
+/* Couplings where either factor is (1,0), (0,1) or (1,1) are next worked out
+    from closed forms, without running the recursions, except for targets of
+    degeneracy 2 in (p,q) x (1,1). Like the tables, these can be disabled.
+*/
+void set_closed_form_isfs(bool enabled);
+bool get_closed_form_isfs();
+
+/* Select the arithmetic used when ISFs have to be calculated.
+    ISF_ENGINE_SQRAT runs the recursions directly on exact sqrat values.
+    ISF_ENGINE_MODULAR runs them modulo several word-sized primes in parallel,
+    and reconstructs the exact values at the end. This avoids the growth of
+    the intermediate rationals, and gives bit-for-bit identical results.
+    ISF_ENGINE_BUILDUP builds each coupling of degeneracy 1 from a smaller
+    one, by recoupling the fundamental rep, and looks the smaller couplings
+    up with cached_isoscalars(). This gives bit-for-bit identical results,
+    and is faster than the recursion over a sweep of couplings through
+    cached_isoscalars(), where the smaller couplings have already been
+    calculated.
+    Couplings which the modular or build-up engines can't handle are
+    passed on to the sqrat engine. The default is ISF_ENGINE_SQRAT.
+*/
+enum isf_engine
+{
+    ISF_ENGINE_SQRAT,
+    ISF_ENGINE_MODULAR,
+    ISF_ENGINE_BUILDUP,
+};
+
+void set_isf_engine(isf_engine engine);
+isf_engine get_isf_engine();
+
+/* Select how the recursions lay out the values they are working on.
+    ISF_LAYOUT_STANDARD works directly in the layout of isoarray, one
+    degenerate rep after another.
+    ISF_LAYOUT_STENCIL works in a separate buffer, where the couplings to the
+    state of highest weight are stored plane by plane, the rest are stored
+    row by row in (k,l), and the degenerate reps are interleaved. The values
+    read by each step of the recursions are then close together, and each
+    step's coefficients are worked out once for all of the degenerate reps,
+    rather than once per rep. The results are moved into the usual layout at
+    the end, so this only changes speed and peak memory use (which roughly
+    doubles while the recursions run).
+    This applies to the full calculation of degenerate reps by every engine,
+    but not to the streaming, checkpointed or single-rep calculations. The
+    default is ISF_LAYOUT_STANDARD.
+*/
+enum isf_layout
+{
+    ISF_LAYOUT_STANDARD,
+    ISF_LAYOUT_STENCIL,
+};
+
+void set_isf_layout(isf_layout layout);
+isf_layout get_isf_layout();
+
+/* Calculate the isoscalar factors for every irrep in (p1,q1) x (p2,q2).
+    The irreps are calculated concurrently on 'nthreads' threads, with the
+    most expensive ones started first. If nthreads <= 0, one thread is used
+    per available core.
+
+    Note: This returns a heap-allocated object, which should be deleted
+    with 'delete' when you are finished with it.
+*/
+decomposition* decompose(long p1, long q1, long p2, long q2, long nthreads = 0);
+
+/* Calculate the isoscalar factors for many couplings at once.
+    Couplings which are related by the symmetry relations are only calculated
+    once: each one is mapped to a representative of its orbit under
+    exch_12, exch_13bar, exch_23bar and conj, the distinct representatives are
+    calculated concurrently on 'nthreads' threads, and the requested
+    couplings are derived from them.
+
+    Returns a newly-allocated array of 'count' isoarray pointers, in the same
+    order as the input. Entries for couplings of zero degeneracy are NULL.
+    Both the array (with 'delete[]') and each isoarray should be deleted
+    when you are finished with them.
+*/
+isoarray** isoscalars_batch(const coupling* couplings, long count,
+                            long nthreads = 0);
+
+/* Calculate the isoscalar factors for only one of the degenerate reps
+    (n = 0, ..., d-1, numbered as in isoarray). The couplings to the state
+    of highest weight are still calculated for every rep, since rep n is
+    orthonormalised against them, but only rep n is filled out from there.
+    For d >= 3 this saves most of the time and memory of isoscalars().
+
+    The result is an isoarray with d = 1, whose rep 0 is rep n of the full
+    isoarray. Returns NULL if (p,q) does not appear in (p1,q1) x (p2,q2), or
+    if n is out of range. As for isoscalars_shw() below, couplings which
+    need one of the symmetry relations are calculated in full.
+
+    Note: This returns a heap-allocated object, which should be deleted
+    with 'delete' when you are finished with it.
+*/
+isoarray* isoscalars_rep(long p, long q, long p1, long q1, long p2, long q2,
+                            long n);
+
+/* Calculate isoscalar factors lazily: only the couplings to the state of
+    highest weight are calculated up front (as in isoscalars_shw()), and
+    every other value is calculated the first time it is looked up, along
+    with just the values it depends on. Those are the values at the same k
+    with smaller l, and at larger k, so looking up a handful of values
+    costs far less than calculating the whole isoarray. Every value which
+    is calculated is kept, so later lookups reuse the earlier work.
+
+    Apart from that, the result behaves just like the isoarray from
+    isoscalars(), and gives identical values. It is safe to look up values
+    from several threads at once, though the lookups are serialised.
+    Returns NULL if (p,q) does not appear in (p1,q1) x (p2,q2). Couplings
+    which need one of the symmetry relations are calculated in full, as
+    for isoscalars_shw().
+
+    Note: This returns a heap-allocated object, which should be deleted
+    with 'delete' when you are finished with it.
+*/
+isoarray* isoscalars_lazy(long p, long q, long p1, long q1, long p2, long q2);
+
+/* Calculate only the couplings to the state of highest weight of (p,q) for
+    each degenerate rep, which is the first phase of isoscalars(): the
+    recursions through the planes of (k1, l1), followed by the
+    orthonormalisation and the sign convention. The values are exactly
+    those of the k=p+q, l=0 entries of the full isoarray, but the rest of
+    each multiplet is never filled in, which saves almost all of the time
+    and memory for large target reps.
+
+    Returns NULL if (p,q) does not appear in (p1,q1) x (p2,q2).
+    Couplings which need one of the symmetry relations (see isoscalars())
+    are calculated in full, as those relations do not map the state of
+    highest weight to itself.
+
+    Note: This returns a heap-allocated object, which should be deleted
+    with 'delete' when you are finished with it.
+*/
+shwarray* isoscalars_shw(long p, long q, long p1, long q1, long p2, long q2);
+
+/* Write a table of the CGCs for every coupling (p1,q1) x (p2,q2) -> (p,q)
+    with each of p+q, p1+q1 and p2+q2 at most 'max_pq', as doubles.
+    The table can be read, without GMP or the rest of libSU3, using the
+    cgc_table class in SU3_table.h.
+
+    The calculations are run on 'nthreads' threads, as for isoscalars_batch().
+    Returns false if the file could not be written.
+*/
+bool export_cgc_table(const char* path, long max_pq, long nthreads = 0);
+
+/* Calculate the isoscalar factors for one coupling a row at a time, without
+    ever holding the whole isoarray in memory. Only the couplings to the
+    state of highest weight and two rows are kept, so this can handle
+    couplings whose full set of ISFs would not fit in memory.
+
+    Each row is passed to 'callback' as soon as it is finished, in order of
+    increasing n and, for each n, decreasing k. Returns false if (p,q) does
+    not appear in (p1,q1) x (p2,q2).
+
+    Couplings which need one of the symmetry relations (see isoscalars())
+    are calculated in full and then passed on row by row, so the saving
+    in memory only applies to couplings which can be calculated directly.
+*/
+typedef std::function<void(const isorow&)> isorow_callback;
+
+bool isoscalars_stream(long p, long q, long p1, long q1, long p2, long q2,
+                        const isorow_callback& callback);
+
+/* As above, but writing the rows to 'out', in the same binary encoding as
+    the on-disk cache. Returns false if (p,q) does not appear in
+    (p1,q1) x (p2,q2), or if writing fails.
+    read_isoscalar_stream() reads such a file back into an isoarray,
+    returning NULL if it is incomplete or corrupt. */
+bool isoscalars_stream(long p, long q, long p1, long q1, long p2, long q2,
+                        FILE* out);
+isoarray* read_isoscalar_stream(FILE* in);
+
+/* Calculate isoscalar factors as isoscalars() does, saving the progress of
+    the calculation to the file at 'path' as it goes. If the calculation is
+    interrupted, calling this again with the same coupling and path carries
+    on from the last checkpoint, and gives exactly the same result as an
+    uninterrupted run. isoscalars_resume() does the same, taking the coupling
+    from the checkpoint file.
+
+    Checkpoints are taken after each step of the calculation (each plane of
+    couplings to the state of highest weight, and then each row), at most
+    once every 'interval' seconds, or after every step if interval <= 0.
+    The file is deleted once the calculation is complete.
+
+    A file at 'path' which isn't a checkpoint for this coupling (such as the
+    checkpoint for another one) is left alone, and NULL is returned, unless
+    'overwrite' is set; an empty file can always be used.
+
+    Returns NULL if (p,q) does not appear in (p1,q1) x (p2,q2), or if the
+    checkpoint file can't be created. isoscalars_resume() also returns NULL
+    if there is no valid checkpoint file at 'path'.
+*/
+isoarray* isoscalars_checkpointed(long p, long q, long p1, long q1, long p2, long q2,
+                                    const char* path, long interval = 60,
+                                    bool overwrite = false);
+isoarray* isoscalars_resume(const char* path, long interval = 60);
+
+/* Isoscalar factors held in a memory-mapped file, for couplings too large
+    to hold in memory. The values are stored in the same encoding as the
+    on-disk cache, along with a table of where each one starts, and are
+    decoded from the file as they are looked up. The kernel pages the file
+    in and out as needed, so the file can be larger than physical memory.
+
+    isoscalars_mapped() calculates a coupling into a new file at 'path', one
+    row at a time as in isoscalars_stream(), and then opens it.
+    open_isoscalars_mapped() reopens such a file, which is cheap however
+    large the file is: only the header is checked when it is opened, and
+    lookups of corrupt values throw std::runtime_error.
+
+    Both return NULL if the file cannot be written or read, and
+    isoscalars_mapped() also returns NULL if (p,q) does not appear in
+    (p1,q1) x (p2,q2). The returned isoarray can be used just like any other;
+    deleting it unmaps the file, but does not delete it.
+*/
+isoarray* isoscalars_mapped(long p, long q, long p1, long q1, long p2, long q2,
+                            const char* path);
+isoarray* open_isoscalars_mapped(const char* path);
+
 #endif
@@ -0,0 +1,75 @@
+/* libSU3: Compile-time versions of the functions giving information about
+    irreps of SU(3).
+
+    These match dimension(), degeneracy(), phase_exch_12() and phase_conj()
+    (which are implemented in terms of these), but can be evaluated at
+    compile time, for example in template arguments or static_asserts.
+    This header does not depend on GMP.
+*/
+
+#ifndef __SU3_CONSTEXPR_H__
+#define __SU3_CONSTEXPR_H__
+
+/* Internal helpers */
+constexpr long ct_min(long a, long b)
+{
+    return (a < b) ? a : b;
+}
+
+constexpr long ct_max(long a, long b)
+{
+    return (a > b) ? a : b;
+}
+
+constexpr long ct_sign(long v)
+{
+    return ((v % 2) == 0) ? 1 : -1;
+}
+
+/* Calculate the dimension of one irrep */
+constexpr long ct_dimension(long p, long q)
+{
+    return (p+1)*(q+1)*(p+q+2)/2;
+}
+
+/* Internal: The degeneracy, in terms of the intermediate values used in
+    degeneracy() (src/reps.cc). See there for details. */
+constexpr long ct_degeneracy_eta_prime(long p, long q, long p1, long q1,
+                                        long p2, long q2, long gamma, long sigma)
+{
+    return ct_min(ct_min(ct_min(3*p1 + sigma, 3*p2 + sigma),
+                         ct_min(3*q + sigma, 3*q1 + gamma)),
+                  ct_min(ct_min(ct_min(3*q2 + gamma, 3*p + gamma),
+                                ct_min(2*(gamma + sigma), 3*(p1+q1) - (gamma + sigma))),
+                         3*(p2+q2) - (gamma + sigma)));
+}
+
+constexpr long ct_degeneracy_eta(long p, long q, long p1, long q1,
+                                    long p2, long q2, long gamma, long sigma)
+{
+    return ((gamma - sigma) % 3) ? 0
+        : ct_max(ct_degeneracy_eta_prime(p, q, p1, q1, p2, q2, gamma, sigma)
+                    + 3 - ct_max(gamma, sigma), 0);
+}
+
+/* Calculate the degeneracy of the (p,q) irrep in the decomposition of
+    (p1,q1) x (p2,q2). Returns 0 if (p,q) is not a summand in this
+    decomposition.
+*/
+constexpr long ct_degeneracy(long p, long q, long p1, long q1, long p2, long q2)
+{
+    return ct_degeneracy_eta(p, q, p1, q1, p2, q2, p1 + p2 - p, q1 + q2 - q) / 3;
+}
+
+/* Phase changes under the 1<->2 symmetry and the conjugation symmetry */
+constexpr long ct_phase_exch_12(long p, long q, long p1, long q1, long p2, long q2)
+{
+    return ct_sign(ct_min(p1 + p2 - p, q1 + q2 - q));
+}
+
+constexpr long ct_phase_conj(long p, long q, long p1, long q1, long p2, long q2)
+{
+    return ct_sign(ct_max(p1 + p2 - p, q1 + q2 - q));
+}
+
+#endif
@@ -0,0 +1,225 @@
+/* libSU3: Clebsch-Gordan coefficients for couplings fixed at compile time.
+
+    fixed_cgarray<p, q, p1, q1, p2, q2> holds the CGCs for one coupling as
+    doubles, in a flat array whose size and layout are compile-time constants.
+    This is meant for inner loops which use a few small couplings: every
+    index calculation can be folded, and for_each() visits every valid set of
+    states with the loop fully unrolled.
+
+    The coefficients are calculated (or, for small couplings, taken from the
+    built-in tables) once, when the object is constructed.
+
+    The layout is the same as in SU3_table.h: a dense array indexed by
+    (n, k-q, l, m-l, k1-q1, l1, m1-l1, k2-q2), with n outermost.
+*/
+
+#ifndef __SU3_FIXED_H__
+#define __SU3_FIXED_H__
+
+#include <stdlib.h>
+
+#include "SU3.h"
+#include "SU3_constexpr.h"
+
+template<long p, long q, long p1, long q1, long p2, long q2>
+class fixed_cgarray
+{
+public:
+    static constexpr long d = ct_degeneracy(p, q, p1, q1, p2, q2);
+    static_assert(d > 0, "(p,q) does not appear in (p1,q1) x (p2,q2)");
+
+    /* Strides of each axis */
+    static constexpr size_t s_k2 = 1;
+    static constexpr size_t s_m1 = s_k2 * (p2+1);
+    static constexpr size_t s_l1 = s_m1 * (p1+q1+1);
+    static constexpr size_t s_k1 = s_l1 * (q1+1);
+    static constexpr size_t s_m  = s_k1 * (p1+1);
+    static constexpr size_t s_l  = s_m  * (p+q+1);
+    static constexpr size_t s_k  = s_l  * (q+1);
+    static constexpr size_t s_n  = s_k  * (p+1);
+    static constexpr size_t size = s_n  * d;
+
+    /* Position of a CGC in the array, with no range checks */
+    static constexpr size_t offset(long n, long k, long l, long m,
+                                    long k1, long l1, long m1, long k2)
+    {
+        return n*s_n + (k-q)*s_k + l*s_l + (m-l)*s_m
+            + (k1-q1)*s_k1 + l1*s_l1 + (m1-l1)*s_m1 + (k2-q2)*s_k2;
+    }
+
+    /* The values of l2 and m2 which are implied by conservation of
+        hypercharge and of Iz */
+    static constexpr long implied_l2(long k, long l, long k1, long l1, long k2)
+    {
+        return (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3 - (k1 + l1 + k2 - k - l);
+    }
+
+    static constexpr long implied_m2(long k, long l, long m, long k1, long l1,
+                                        long m1, long k2)
+    {
+        return (m - m1) - (k + l - k1 - l1 - k2 - implied_l2(k, l, k1, l1, k2))/2;
+    }
+
+    /* Whether a position in the array corresponds to a valid set of states,
+        ie. one which can have a nonzero CGC */
+    static constexpr bool valid_states(long k, long l, long m, long k1, long l1,
+                                        long m1, long k2, long l2, long m2)
+    {
+        return (m >= l) && (m <= k) && (m1 >= l1) && (m1 <= k1)
+            && (l2 >= 0) && (l2 <= q2) && (m2 >= l2) && (m2 <= k2)
+            && (((k-l-k1+l1-k2+l2) % 2) == 0)
+            && (ct_max(k1-l1-k2+l2, k2-l2-k1+l1) <= k-l) && (k-l <= k1-l1+k2-l2)
+            && (2*m - k - l == (2*m1 - k1 - l1) + (2*m2 - k2 - l2));
+    }
+
+    static constexpr bool valid_offset(size_t i)
+    {
+        return valid_states(q + (i / s_k) % (p+1), (i / s_l) % (q+1),
+                            (i / s_l) % (q+1) + (i / s_m) % (p+q+1),
+                            q1 + (i / s_k1) % (p1+1), (i / s_l1) % (q1+1),
+                            (i / s_l1) % (q1+1) + (i / s_m1) % (p1+q1+1),
+                            q2 + (i / s_k2) % (p2+1),
+                            l2_at(i), m2_at(i));
+    }
+
+    static constexpr long l2_at(size_t i)
+    {
+        return implied_l2(q + (i / s_k) % (p+1), (i / s_l) % (q+1),
+                            q1 + (i / s_k1) % (p1+1), (i / s_l1) % (q1+1),
+                            q2 + (i / s_k2) % (p2+1));
+    }
+
+    static constexpr long m2_at(size_t i)
+    {
+        return implied_m2(q + (i / s_k) % (p+1), (i / s_l) % (q+1),
+                            (i / s_l) % (q+1) + (i / s_m) % (p+q+1),
+                            q1 + (i / s_k1) % (p1+1), (i / s_l1) % (q1+1),
+                            (i / s_l1) % (q1+1) + (i / s_m1) % (p1+q1+1),
+                            q2 + (i / s_k2) % (p2+1));
+    }
+
+private:
+    double values[size];
+
+    /* Helper for for_each(): visit positions [begin, end) of the array,
+        by splitting the range in half until it contains one position. This
+        keeps the template recursion depth logarithmic in the array size. */
+    template<size_t begin, size_t end, int kind = (end - begin == 0) ? 0
+                                                : (end - begin == 1) ? 1 : 2>
+    struct unroll
+    {
+        template<typename F>
+        static void run(const double* values, F& f)
+        {
+            unroll<begin, (begin + end)/2>::run(values, f);
+            unroll<(begin + end)/2, end>::run(values, f);
+        }
+    };
+
+    template<size_t begin, size_t end>
+    struct unroll<begin, end, 0>
+    {
+        template<typename F>
+        static void run(const double*, F&) {}
+    };
+
+    template<size_t i, size_t end>
+    struct unroll<i, end, 1>
+    {
+        template<typename F>
+        static void run(const double* values, F& f)
+        {
+            visit<i, valid_offset(i)>::run(values, f);
+        }
+    };
+
+    template<size_t i, bool valid>
+    struct visit
+    {
+        template<typename F>
+        static void run(const double*, F&) {}
+    };
+
+    template<size_t i>
+    struct visit<i, true>
+    {
+        template<typename F>
+        static void run(const double* values, F& f)
+        {
+            f(i / s_n,
+                q + (i / s_k) % (p+1), (i / s_l) % (q+1),
+                (i / s_l) % (q+1) + (i / s_m) % (p+q+1),
+                q1 + (i / s_k1) % (p1+1), (i / s_l1) % (q1+1),
+                (i / s_l1) % (q1+1) + (i / s_m1) % (p1+q1+1),
+                q2 + (i / s_k2) % (p2+1), l2_at(i), m2_at(i),
+                values[i]);
+        }
+    };
+
+public:
+    fixed_cgarray()
+    {
+        size_t i;
+        for (i = 0; i < size; ++i)
+            values[i] = 0;
+
+        cgarray* cg = clebsch_gordans(p, q, p1, q1, p2, q2);
+        long n, k, l, m, k1, l1, m1, k2, l2, m2;
+        for (n = 0; n < d; ++n)
+            FOREACH_CGC(p, q, p1, q1, p2, q2, k, l, m, k1, l1, m1, k2, l2, m2)
+                values[offset(n, k, l, m, k1, l1, m1, k2)]
+                    = (double)(*cg)(n, k, l, m, k1, l1, m1, k2, l2, m2);
+        delete cg;
+    }
+
+    /* Look up one CGC, with the states given at compile time. Invalid
+        states are rejected at compile time. */
+    template<long n, long k, long l, long m, long k1, long l1, long m1,
+                long k2, long l2, long m2>
+    double get() const
+    {
+        static_assert((n >= 0) && (n < d), "n out of range");
+        static_assert((k >= q) && (k <= p+q) && (l >= 0) && (l <= q)
+                        && (k1 >= q1) && (k1 <= p1+q1) && (l1 >= 0) && (l1 <= q1)
+                        && (k2 >= q2) && (k2 <= p2+q2),
+                        "States out of range");
+        static_assert((l2 == implied_l2(k, l, k1, l1, k2))
+                        && (m2 == implied_m2(k, l, m, k1, l1, m1, k2))
+                        && valid_states(k, l, m, k1, l1, m1, k2, l2, m2),
+                        "States cannot couple");
+        return values[offset(n, k, l, m, k1, l1, m1, k2)];
+    }
+
+    /* Look up one CGC at runtime. Returns 0 for invalid states. */
+    double operator()(long n, long k, long l, long m, long k1, long l1, long m1,
+                        long k2, long l2, long m2) const
+    {
+        if ((n < 0) || (n >= d) || (k < q) || (k > p+q) || (l < 0) || (l > q)
+            || (k1 < q1) || (k1 > p1+q1) || (l1 < 0) || (l1 > q1)
+            || (k2 < q2) || (k2 > p2+q2)
+            || (l2 != implied_l2(k, l, k1, l1, k2))
+            || ! valid_states(k, l, m, k1, l1, m1, k2, l2, m2))
+            return 0;
+
+        return values[offset(n, k, l, m, k1, l1, m1, k2)];
+    }
+
+    /* Call f(n, k, l, m, k1, l1, m1, k2, l2, m2, value) for every valid set
+        of states, for each degenerate copy of the target rep. The loop over
+        states is fully unrolled at compile time, so this should only be
+        used for small couplings. */
+    template<typename F>
+    void for_each(F f) const
+    {
+        unroll<0, size>::run(values, f);
+    }
+};
+
+/* Out-of-class definitions of the static members, which are needed if they
+    are ever bound to a reference */
+template<long p, long q, long p1, long q1, long p2, long q2>
+constexpr long fixed_cgarray<p, q, p1, q1, p2, q2>::d;
+template<long p, long q, long p1, long q1, long p2, long q2>
+constexpr size_t fixed_cgarray<p, q, p1, q1, p2, q2>::size;
+
+#endif
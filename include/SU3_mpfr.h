@@ -0,0 +1,108 @@
+/* libSU3: Isoscalar factors in arbitrary-precision floating point, using MPFR.
+
+    This is for reps which are too large for the exact engines to be
+    practical, and where double precision loses too many digits to
+    cancellation in the recursions. The precision is chosen by the caller,
+    and each value carries a bound on its error, so that the precision which
+    was actually lost can be checked for each coupling.
+
+    This is only available if libSU3 was built with MPFR (see USE_MPFR in
+    config.mk). Programs using it must also link against MPFR, with
+    -lmpfr before -lgmpxx -lgmp.
+*/
+
+#ifndef __SU3_MPFR_H__
+#define __SU3_MPFR_H__
+
+#include <string>
+
+#include <mpfr.h>
+
+#include "SU3.h"
+
+/* A floating-point value together with a bound on its absolute error.
+    Values which are created without a precision take the precision of the
+    calculation in progress on this thread, or 53 bits otherwise. The bound
+    is itself an MPFR number, with only a few bits of precision but MPFR's
+    range of exponents, since at high precisions it is far smaller than any
+    long double. It is always rounded up. */
+class mpfr_value
+{
+public:
+    mpfr_t v;
+    mpfr_t err;
+
+    mpfr_value();
+    mpfr_value(long);
+    mpfr_value(const mpfr_value&);
+    ~mpfr_value();
+
+    mpfr_value& operator=(const mpfr_value&);
+    mpfr_value& operator+=(const mpfr_value&);
+
+    friend mpfr_value operator-(const mpfr_value&);
+    friend mpfr_value operator+(const mpfr_value&, const mpfr_value&);
+    friend mpfr_value operator-(const mpfr_value&, const mpfr_value&);
+    friend mpfr_value operator*(const mpfr_value&, const mpfr_value&);
+    friend mpfr_value operator/(const mpfr_value&, const mpfr_value&);
+    friend mpfr_value sqrt(const mpfr_value&);
+    friend bool operator<(const mpfr_value&, long);
+
+    /* Conversions. str() gives the value in decimal, with the given number
+        of significant digits, or enough to represent the full precision
+        if digits <= 0. */
+    explicit operator double() const;
+    std::string str(long digits = 0) const;
+
+    long precision() const;
+};
+
+/* Class to hold ISFs calculated with MPFR. This works like isoarray. */
+class isoarray_mpfr
+{
+    friend struct isf_symmetry;
+
+private:
+    mpfr_value* isf_array;
+    size_t size;
+
+    void set_isf(long n, long k, long l, long k1, long l1, long k2, long l2,
+                    const mpfr_value& v);
+
+public:
+    const long p, q, p1, q1, p2, q2;
+    const long d;
+
+    /* Note: This takes ownership of the array passed in */
+    isoarray_mpfr(long p, long q, long p1, long q1, long p2, long q2, long d,
+                    mpfr_value* isf_array);
+    ~isoarray_mpfr();
+
+    mpfr_value operator()(long n, long k, long l, long k1, long l1,
+                            long k2, long l2) const;
+
+    /* The precision the values were calculated with, and an estimate of the
+        number of bits of that which were lost to rounding errors, from the
+        largest error bound of any ISF. The ISFs are at most 1 in magnitude,
+        so all of them are accurate to about precision() - lost_bits() bits
+        after the binary point. */
+    long precision() const;
+    long lost_bits() const;
+
+    void check_sign_convention();
+
+    isoarray_mpfr* exch_12() const;
+    isoarray_mpfr* exch_13bar() const;
+    isoarray_mpfr* exch_23bar() const;
+};
+
+/* Calculate ISFs with 'precision' bits of precision. Returns NULL if (p,q)
+    does not appear in (p1,q1) x (p2,q2).
+
+    Note: This returns a heap-allocated object, which should be deleted
+    with 'delete' when you are finished with it.
+*/
+isoarray_mpfr* isoscalars_mpfr(long p, long q, long p1, long q1, long p2, long q2,
+                                long precision);
+
+#endif
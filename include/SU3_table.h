@@ -0,0 +1,299 @@
+/* libSU3: Header-only reader for tables of Clebsch-Gordan coefficients.
+
+    These tables are written by export_cgc_table() (or the su3table program),
+    and hold every CGC for couplings (p1,q1) x (p2,q2) -> (p,q) with each of
+    p+q, p1+q1, p2+q2 at most some bound, as doubles.
+
+    This header does not depend on GMP or on the rest of libSU3, so programs
+    which only need to read tables do not need to link against either.
+    The table is mmap()ed, and opening one only reads the directory, which
+    is checked against the size of the file, so that lookups never read
+    outside the table.
+
+    File format (all integers are 8 bytes, and all values are in the byte
+    order of the machine which wrote the table):
+    * The 8-byte magic string "libSU3:T"
+    * The format version (CGC_TABLE_VERSION below)
+    * The bound N on p+q, and the number of reps R = (N+1)(N+2)/2
+    * The offset of the directory and of the data section, in bytes
+    * A byte-order marker, the double 1.0
+    * The directory: one entry per coupling, each holding the degeneracy of
+      the target rep followed by the offset of the coupling's CGCs within the
+      data section, in doubles. The entry for (p1,q1) x (p2,q2) -> (p,q) is at
+      index (r(p,q)*R + r(p1,q1))*R + r(p2,q2), where
+      r(p,q) = (p+q)(p+q+1)/2 + q.
+    * The data section. The CGCs for each coupling are stored as a dense
+      array indexed by (n, k-q, l, m-l, k1-q1, l1, m1-l1, k2-q2),
+      with n outermost. Here l2 and m2 are fixed by conservation of
+      hypercharge and of Iz, so need no axes of their own.
+*/
+
+#ifndef __SU3_TABLE_H__
+#define __SU3_TABLE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define CGC_TABLE_MAGIC "libSU3:T"
+#define CGC_TABLE_VERSION 1
+
+/* Offsets (in 8-byte words) of the header fields */
+#define CGC_TABLE_HDR_VERSION   1
+#define CGC_TABLE_HDR_BOUND     2
+#define CGC_TABLE_HDR_NREPS     3
+#define CGC_TABLE_HDR_DIRECTORY 4
+#define CGC_TABLE_HDR_DATA      5
+#define CGC_TABLE_HDR_BOM       6
+#define CGC_TABLE_HDR_WORDS     7
+
+/* The CGCs for a single coupling within a table */
+class cgc_table_view
+{
+private:
+    const double* data; // NULL if the coupling does not appear in the table
+    long p, q, p1, q1, p2, q2, d;
+
+    /* Strides for each axis (in doubles), starting with the k axis;
+        the n axis has stride s[0] * (p+1) */
+    size_t s[8];
+
+public:
+    cgc_table_view() : data(NULL), p(0), q(0), p1(0), q1(0), p2(0), q2(0), d(0) {}
+
+    cgc_table_view(const double* data, long p, long q, long p1, long q1,
+                    long p2, long q2, long d)
+        : data(data), p(p), q(q), p1(p1), q1(q1), p2(p2), q2(q2), d(d)
+    {
+        long dims[8] = {p+1, q+1, p+q+1, p1+1, q1+1, p1+q1+1, p2+1, 1};
+        int i;
+        s[7] = 1;
+        for (i = 6; i >= 0; --i)
+            s[i] = s[i+1] * dims[i+1];
+    }
+
+    /* Degeneracy of the target rep; zero if the coupling is not in the table */
+    long degeneracy() const
+    {
+        return d;
+    }
+
+    /* Look up one CGC. Returns 0 for states which cannot couple. */
+    double operator()(long n, long k, long l, long m, long k1, long l1, long m1,
+                        long k2, long l2, long m2) const
+    {
+        if (   (n < 0) || (n >= d)
+            || (k  < q ) || (k  > p +q ) || (l  < 0) || (l  > q ) || (m  < l ) || (m  > k )
+            || (k1 < q1) || (k1 > p1+q1) || (l1 < 0) || (l1 > q1) || (m1 < l1) || (m1 > k1)
+            || (k2 < q2) || (k2 > p2+q2) || (l2 < 0) || (l2 > q2) || (m2 < l2) || (m2 > k2))
+            return 0;
+
+        /* Hypercharge and Iz conservation */
+        if (3*(k1+l1+k2+l2-k-l) != 2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)
+            return 0;
+        if (2*m - k - l != (2*m1 - k1 - l1) + (2*m2 - k2 - l2))
+            return 0;
+
+        return data[offset(n, k, l, m, k1, l1, m1, k2)];
+    }
+
+    /* Position of a CGC within the coupling's data, with no range checks */
+    size_t offset(long n, long k, long l, long m, long k1, long l1, long m1,
+                    long k2) const
+    {
+        return n*s[0]*(p+1) + (k-q)*s[0] + l*s[1] + (m-l)*s[2]
+            + (k1-q1)*s[3] + l1*s[4] + (m1-l1)*s[5] + (k2-q2)*s[6];
+    }
+};
+
+/* A table of CGCs, mapped into memory */
+class cgc_table
+{
+private:
+    void* map;
+    size_t map_len;
+
+    const uint64_t* header;
+    const uint64_t* directory;
+    const double* values;
+    long bound, nreps;
+
+    static long rep_index(long p, long q)
+    {
+        return (p+q)*(p+q+1)/2 + q;
+    }
+
+    /* Multiply x by y, returning false if the result would overflow */
+    static bool checked_mul(uint64_t& x, uint64_t y)
+    {
+        if ((y != 0) && (x > UINT64_MAX / y))
+            return false;
+        x *= y;
+        return true;
+    }
+
+    /* Check that every directory entry lies within the data section */
+    bool check_directory(uint64_t data_len) const
+    {
+        long p, q, p1, q1, p2, q2;
+        for (p = 0; p <= bound; ++p)
+        for (q = 0; p + q <= bound; ++q)
+        for (p1 = 0; p1 <= bound; ++p1)
+        for (q1 = 0; p1 + q1 <= bound; ++q1)
+        for (p2 = 0; p2 <= bound; ++p2)
+        for (q2 = 0; p2 + q2 <= bound; ++q2)
+        {
+            size_t entry = (rep_index(p, q)*nreps + rep_index(p1, q1))*nreps
+                            + rep_index(p2, q2);
+            uint64_t size = directory[2*entry];
+            if (size == 0) continue;
+
+            if (   ! checked_mul(size, (p+1) * (q+1) * (p+q+1))
+                || ! checked_mul(size, (p1+1) * (q1+1) * (p1+q1+1))
+                || ! checked_mul(size, p2+1)
+                || (directory[2*entry + 1] > data_len)
+                || (size > data_len - directory[2*entry + 1]))
+                return false;
+        }
+
+        return true;
+    }
+
+public:
+    cgc_table() : map(NULL), map_len(0), header(NULL), directory(NULL),
+                    values(NULL), bound(-1), nreps(0) {}
+
+    ~cgc_table()
+    {
+        close();
+    }
+
+    /* Open a table. Returns false if the file cannot be read or is not
+        a valid table. */
+    bool open(const char* path)
+    {
+        close();
+
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if ((fstat(fd, &st) != 0)
+            || ((size_t)st.st_size < CGC_TABLE_HDR_WORDS * sizeof(uint64_t)))
+        {
+            ::close(fd);
+            return false;
+        }
+
+        map_len = st.st_size;
+        map = mmap(NULL, map_len, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED)
+        {
+            map = NULL;
+            return false;
+        }
+
+        header = (const uint64_t*)map;
+        double bom;
+        memcpy(&bom, &header[CGC_TABLE_HDR_BOM], sizeof(bom));
+
+        if (memcmp(map, CGC_TABLE_MAGIC, 8)
+            || (header[CGC_TABLE_HDR_VERSION] != CGC_TABLE_VERSION)
+            || (bom != 1.0))
+        {
+            close();
+            return false;
+        }
+
+        /* The bound is limited so that the arithmetic below can't overflow;
+            a table this large wouldn't fit in memory anyway */
+        uint64_t hdr_bound = header[CGC_TABLE_HDR_BOUND];
+        uint64_t hdr_nreps = header[CGC_TABLE_HDR_NREPS];
+        uint64_t dir_offset = header[CGC_TABLE_HDR_DIRECTORY];
+        uint64_t data_offset = header[CGC_TABLE_HDR_DATA];
+        if ((hdr_bound > 10000) || (hdr_nreps != (hdr_bound+1)*(hdr_bound+2)/2))
+        {
+            close();
+            return false;
+        }
+
+        bound = hdr_bound;
+        nreps = hdr_nreps;
+
+        uint64_t dir_len = 2 * sizeof(uint64_t);
+        if (   ! checked_mul(dir_len, nreps) || ! checked_mul(dir_len, nreps)
+            || ! checked_mul(dir_len, nreps)
+            || (dir_offset % sizeof(uint64_t)) || (data_offset % sizeof(double))
+            || (dir_offset > map_len) || (dir_len > map_len - dir_offset)
+            || (data_offset > map_len))
+        {
+            close();
+            return false;
+        }
+
+        directory = (const uint64_t*)((const char*)map + dir_offset);
+        values = (const double*)((const char*)map + data_offset);
+
+        if (! check_directory((map_len - data_offset) / sizeof(double)))
+        {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+        if (map)
+            munmap(map, map_len);
+
+        map = NULL;
+        map_len = 0;
+        header = directory = NULL;
+        values = NULL;
+        bound = -1;
+        nreps = 0;
+    }
+
+    /* The bound on p+q for each rep in the table, or -1 if no table is open */
+    long max_pq() const
+    {
+        return bound;
+    }
+
+    /* Find the CGCs for one coupling. If the coupling is not in the table,
+        the result has degeneracy 0 and every CGC in it is 0. */
+    cgc_table_view lookup(long p, long q, long p1, long q1, long p2, long q2) const
+    {
+        if (   (p  < 0) || (q  < 0) || (p +q  > bound)
+            || (p1 < 0) || (q1 < 0) || (p1+q1 > bound)
+            || (p2 < 0) || (q2 < 0) || (p2+q2 > bound))
+            return cgc_table_view();
+
+        size_t entry = (rep_index(p, q)*nreps + rep_index(p1, q1))*nreps
+                        + rep_index(p2, q2);
+        long d = directory[2*entry];
+        if (d == 0)
+            return cgc_table_view();
+
+        return cgc_table_view(values + directory[2*entry + 1],
+                                p, q, p1, q1, p2, q2, d);
+    }
+
+    /* Look up one CGC directly */
+    double cgc(long p, long q, long p1, long q1, long p2, long q2,
+                long n, long k, long l, long m, long k1, long l1, long m1,
+                long k2, long l2, long m2) const
+    {
+        return lookup(p, q, p1, q1, p2, q2)(n, k, l, m, k1, l1, m1, k2, l2, m2);
+    }
+};
+
+#endif
@@ -1,12 +1,72 @@
 /* libSU3: Benchmarking program */
 
+#include <string.h>
 #include <time.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #include "SU3.h"
+#include "SU3_internal.h"
+#ifdef SU3_USE_MPFR
+#include "SU3_mpfr.h"
+#endif
 
 #define ITERS 25L
 #define DELTA(start, end) ((end - start) / (double)CLOCKS_PER_SEC)
 
+/* Counting cache misses with the Linux perf events interface. Where that
+    isn't available (other systems, or no access to the counters), the
+    counter can't be opened and the count is reported as unavailable. */
+static int start_cache_misses()
+{
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd >= 0)
+    {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+static void print_cache_misses(int fd)
+{
+#ifdef __linux__
+    long long count;
+    if (fd >= 0)
+    {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        bool ok = (read(fd, &count, sizeof(count)) == sizeof(count));
+        close(fd);
+        if (ok)
+        {
+            printf(" (%lld cache misses/iter)\n", count / ITERS);
+            return;
+        }
+    }
+#else
+    (void)fd;
+#endif
+    printf(" (cache misses unavailable)\n");
+}
+
 int main()
 {
     clock_t start, end;
@@ -52,5 +112,208 @@ int main()
     elapsed = DELTA(start, end);
     delete cgc;
 
-    printf("Total time: %7.3fs = %7.3fms/iter\n", elapsed, elapsed*1000./ITERS);
+    printf("Total time: %7.3fs = %7.3fms/iter\n\n", elapsed, elapsed*1000./ITERS);
+
+    printf("Comparing exact and floating-point engines for 64x27->64...\n");
+
+    start = clock();
+    for (i = 0; i < ITERS; ++i)
+    {
+        isf = isoscalars(3, 3, 3, 3, 2, 2);
+        delete isf;
+    }
+    end = clock();
+    elapsed = DELTA(start, end);
+    printf("Exact:        %7.3fs = %7.3fms/iter\n", elapsed, elapsed*1000./ITERS);
+
+    set_isf_engine(ISF_ENGINE_MODULAR);
+    start = clock();
+    for (i = 0; i < ITERS; ++i)
+    {
+        isf = isoscalars(3, 3, 3, 3, 2, 2);
+        delete isf;
+    }
+    end = clock();
+    elapsed = DELTA(start, end);
+    printf("Modular:      %7.3fs = %7.3fms/iter\n", elapsed, elapsed*1000./ITERS);
+
+    set_isf_engine(ISF_ENGINE_SQRAT);
+
+    isoarray_double* isf_double;
+    start = clock();
+    for (i = 0; i < ITERS; ++i)
+    {
+        isf_double = isoscalars_double(3, 3, 3, 3, 2, 2);
+        delete isf_double;
+    }
+    end = clock();
+    elapsed = DELTA(start, end);
+    printf("Double:       %7.3fs = %7.3fms/iter\n", elapsed, elapsed*1000./ITERS);
+
+    start = clock();
+    for (i = 0; i < ITERS; ++i)
+    {
+        isf_double = isoscalars_double(3, 3, 3, 3, 2, 2, true);
+        delete isf_double;
+    }
+    end = clock();
+    elapsed = DELTA(start, end);
+    printf("Long double:  %7.3fs = %7.3fms/iter\n", elapsed, elapsed*1000./ITERS);
+
+#ifdef SU3_USE_MPFR
+    long bits, lost = 0;
+    for (bits = 64; bits <= 256; bits *= 2)
+    {
+        isoarray_mpfr* isf_mpfr;
+        start = clock();
+        for (i = 0; i < ITERS; ++i)
+        {
+            isf_mpfr = isoscalars_mpfr(3, 3, 3, 3, 2, 2, bits);
+            lost = isf_mpfr->lost_bits();
+            delete isf_mpfr;
+        }
+        end = clock();
+        elapsed = DELTA(start, end);
+        printf("MPFR %3ld bits: %7.3fs = %7.3fms/iter (%ld bits lost)\n",
+                bits, elapsed, elapsed*1000./ITERS, lost);
+    }
+#endif
+
+    /* A sweep over every coupling of reps up to a given size, through the
+        cache, as when tabulating them. The cache is emptied before each pass,
+        so each coupling is calculated once per pass, and the build-up engine
+        finds the smaller couplings it needs already there. */
+    printf("\nComparing the recursion and the build-up engine for a sweep "
+            "up to p+q = 3...\n");
+    set_builtin_isf_tables(false);
+
+    isf_engine engines[2] = {ISF_ENGINE_SQRAT, ISF_ENGINE_BUILDUP};
+    const char* engine_names[2] = {"Recursion:", "Build-up: "};
+    long e;
+    for (e = 0; e < 2; ++e)
+    {
+        set_isf_engine(engines[e]);
+        start = clock();
+        for (i = 0; i < ITERS; ++i)
+        {
+            set_isf_cache_size(0);
+            set_isf_cache_size(64L << 20);
+
+            for (p1 = 0; p1 <= 3; ++p1)
+            for (q1 = 0; p1 + q1 <= 3; ++q1)
+            for (p2 = 0; p2 <= 3; ++p2)
+            for (q2 = 0; p2 + q2 <= 3; ++q2)
+            for (p = 0; p <= 6; ++p)
+            for (q = 0; p + q <= 6; ++q)
+                cached_isoscalars(p, q, p1, q1, p2, q2);
+        }
+        end = clock();
+        elapsed = DELTA(start, end);
+        printf("%s   %7.3fs = %7.3fms/iter\n", engine_names[e], elapsed,
+                elapsed*1000./ITERS);
+    }
+
+    set_isf_engine(ISF_ENGINE_SQRAT);
+    set_builtin_isf_tables(true);
+
+    /* The layouts only differ for degenerate reps */
+    printf("\nComparing ISF layouts for 125x125->125 (double) "
+            "and 64x64->64 (exact)...\n");
+
+    isf_layout layouts[2] = {ISF_LAYOUT_STANDARD, ISF_LAYOUT_STENCIL};
+    const char* layout_names[2] = {"Standard:", "Stencil: "};
+    long j;
+    for (j = 0; j < 2; ++j)
+    {
+        set_isf_layout(layouts[j]);
+
+        int counter = start_cache_misses();
+        start = clock();
+        for (i = 0; i < ITERS; ++i)
+        {
+            isf_double = isoscalars_double(4, 4, 4, 4, 4, 4);
+            delete isf_double;
+        }
+        end = clock();
+        elapsed = DELTA(start, end);
+        printf("%s double %7.3fs = %7.3fms/iter", layout_names[j], elapsed,
+                elapsed*1000./ITERS);
+        print_cache_misses(counter);
+
+        counter = start_cache_misses();
+        start = clock();
+        for (i = 0; i < ITERS; ++i)
+        {
+            isf = isoscalars(3, 3, 3, 3, 3, 3);
+            delete isf;
+        }
+        end = clock();
+        elapsed = DELTA(start, end);
+        printf("%s exact  %7.3fs = %7.3fms/iter", layout_names[j], elapsed,
+                elapsed*1000./ITERS);
+        print_cache_misses(counter);
+    }
+
+    set_isf_layout(ISF_LAYOUT_STANDARD);
+
+    /* Reading a whole array back, with full checks on each lookup and a
+        row at a time */
+    printf("\nReading 343x343->343 ISFs...\n");
+
+    isf = isoscalars(6, 6, 6, 6, 6, 6);
+    const sqrat zero(0);
+    long nonzero = 0;
+    start = clock();
+    for (i = 0; i < ITERS; ++i)
+        for (n = 0; n < isf->d; ++n)
+            FOREACH_ISF(6, 6, 6, 6, 6, 6, k, l, k1, l1, k2, l2)
+                if ((*isf)(n, k, l, k1, l1, k2, l2) != zero)
+                    ++nonzero;
+    end = clock();
+    elapsed = DELTA(start, end);
+    printf("operator(): %7.3fs = %7.3fms/iter (%ld nonzero)\n", elapsed,
+            elapsed*1000./ITERS, nonzero/ITERS);
+
+    nonzero = 0;
+    start = clock();
+    for (i = 0; i < ITERS; ++i)
+    {
+        isf_cursor row(*isf);
+        do
+        {
+            const sqrat* v;
+            for (v = row.data(); v < row.data() + row.size(); ++v)
+                if (*v != zero)
+                    ++nonzero;
+        } while (row.next());
+    }
+    end = clock();
+    elapsed = DELTA(start, end);
+    printf("Cursor:     %7.3fs = %7.3fms/iter (%ld nonzero)\n", elapsed,
+            elapsed*1000./ITERS, nonzero/ITERS);
+    delete isf;
+
+    /* A single rep is normalised in one pass, unless that is switched off */
+    printf("\nNormalising (8,8) x (4,4) -> (12,12), a single rep...\n");
+    set_builtin_isf_tables(false);
+    set_closed_form_isfs(false);
+
+    const char* normalisation_names[2] = {"General: ", "One pass:"};
+    for (j = 0; j < 2; ++j)
+    {
+        set_single_rep_normalisation(j == 1);
+        start = clock();
+        for (i = 0; i < ITERS; ++i)
+        {
+            shwarray* shw = isoscalars_shw(12, 12, 8, 8, 4, 4);
+            delete shw;
+        }
+        end = clock();
+        elapsed = DELTA(start, end);
+        printf("%s %7.3fs = %7.3fms/iter\n", normalisation_names[j], elapsed,
+                elapsed*1000./ITERS);
+    }
+
+    set_builtin_isf_tables(true);
+    set_closed_form_isfs(true);
 }
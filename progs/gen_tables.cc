@@ -0,0 +1,175 @@
+/* libSU3: Generator for the ISF tables compiled into the library.
+
+    This calculates every coupling (p1,q1) x (p2,q2) -> (p,q) with p1+q1 and
+    p2+q2 at most some bound, and writes out C++ source defining the tables
+    declared in SU3_internal.h:
+
+    * builtin_isf_max_pq: The bound
+    * builtin_isf_directory: One entry per coupling, indexed as described in
+      builtin_isf_entry_index() (src/builtin.cc)
+    * builtin_isf_values: Each distinct value which appears in the tables,
+      stored as the numerator and denominator of sign(x) * x^2
+    * builtin_isf_index: For each coupling in turn, the position in
+      builtin_isf_values of each of its coefficients, in the same order as
+      in an isoarray
+
+    Couplings with any coefficient which does not fit into a pair of longs
+    are left out, and are calculated at runtime as usual.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "SU3_internal.h"
+
+/* This program is linked against the library objects before the tables
+    exist, so it supplies an empty set of tables itself. */
+const long builtin_isf_max_pq = -1;
+const builtin_isf_entry builtin_isf_directory[] = {{0, 0}};
+const unsigned int builtin_isf_index[] = {0};
+const long builtin_isf_values[][2] = {{0, 1}};
+
+/* The real tables are indexed with this bound, so we can't use
+    builtin_isf_entry_index() here */
+static long max_pq;
+
+static long rep_index(long p, long q)
+{
+    return (p+q)*(p+q+1)/2 + q;
+}
+
+const char* usage_message = "\
+Usage: %s MAX_PQ OUTPUT\n\
+\n\
+Write C++ source for tables of every coupling (p1,q1) x (p2,q2) -> (p,q)\n\
+with p1+q1 and p2+q2 at most MAX_PQ to the file OUTPUT.\n\
+";
+
+int main(int argc, char** argv)
+{
+    char* end;
+    if (argc != 3)
+    {
+        printf(usage_message, argv[0]);
+        return 2;
+    }
+
+    max_pq = strtol(argv[1], &end, 10);
+    if (*end || (max_pq < 0))
+    {
+        printf(usage_message, argv[0]);
+        return 2;
+    }
+
+    long nreps = (max_pq+1)*(max_pq+2)/2;
+    long ntargets = (2*max_pq+1)*(2*max_pq+2)/2;
+    std::vector<builtin_isf_entry> directory(nreps * nreps * ntargets);
+    std::vector<unsigned int> index;
+    std::vector<std::pair<long, long> > values;
+    std::map<std::pair<long, long>, unsigned int> value_pos;
+    long p, q, p1, q1, p2, q2, skipped = 0;
+
+    values.push_back(std::make_pair(0L, 1L));
+    value_pos[values[0]] = 0;
+
+    for (p1 = 0; p1 <= max_pq; ++p1)
+    for (q1 = 0; p1 + q1 <= max_pq; ++q1)
+    for (p2 = 0; p2 <= max_pq; ++p2)
+    for (q2 = 0; p2 + q2 <= max_pq; ++q2)
+    for (p = 0; p <= 2*max_pq; ++p)
+    for (q = 0; p + q <= 2*max_pq; ++q)
+    {
+        long entry = (rep_index(p1, q1)*nreps + rep_index(p2, q2))*ntargets
+                        + rep_index(p, q);
+        directory[entry].d = 0;
+        directory[entry].first = 0;
+
+        isoarray* isf = isoscalars(p, q, p1, q1, p2, q2);
+        if (! isf) continue;
+
+        size_t size, i;
+        const sqrat* coefficients = isf_io::coefficients(*isf, size);
+        std::vector<unsigned int> positions(size);
+
+        for (i = 0; i < size; ++i)
+        {
+            const mpq_class& v = isf_io::squared(coefficients[i]);
+            if (! (v.get_num().fits_slong_p() && v.get_den().fits_slong_p()))
+                break;
+
+            std::pair<long, long> key(v.get_num().get_si(), v.get_den().get_si());
+            std::map<std::pair<long, long>, unsigned int>::iterator it = value_pos.find(key);
+            if (it == value_pos.end())
+            {
+                it = value_pos.insert(std::make_pair(key, (unsigned int)values.size())).first;
+                values.push_back(key);
+            }
+            positions[i] = it->second;
+        }
+
+        if (i == size)
+        {
+            directory[entry].d = isf->d;
+            directory[entry].first = index.size();
+            index.insert(index.end(), positions.begin(), positions.end());
+        }
+        else
+            ++skipped;
+
+        delete isf;
+    }
+
+    FILE* f = fopen(argv[2], "w");
+    if (! f)
+    {
+        fprintf(stderr, "Couldn't open %s for writing\n", argv[2]);
+        return 1;
+    }
+
+    fprintf(f, "/* libSU3: ISF tables for p1+q1, p2+q2 <= %ld.\n"
+                "    Generated by progs/gen_tables.cc; do not edit. */\n\n"
+                "#include \"SU3_internal.h\"\n\n"
+                "const long builtin_isf_max_pq = %ld;\n\n", max_pq, max_pq);
+
+    size_t i;
+    fprintf(f, "const builtin_isf_entry builtin_isf_directory[] = {");
+    for (i = 0; i < directory.size(); ++i)
+        fprintf(f, "%s{%u,%u},", (i % 8) ? "" : "\n    ",
+                directory[i].d, directory[i].first);
+    fprintf(f, "\n};\n\n");
+
+    /* Avoid an empty array if no couplings are present */
+    if (index.empty()) index.push_back(0);
+
+    fprintf(f, "const unsigned int builtin_isf_index[] = {");
+    for (i = 0; i < index.size(); ++i)
+        fprintf(f, "%s%u,", (i % 16) ? "" : "\n    ", index[i]);
+    fprintf(f, "\n};\n\n");
+
+    fprintf(f, "const long builtin_isf_values[][2] = {");
+    for (i = 0; i < values.size(); ++i)
+        fprintf(f, "%s{%ld,%ld},", (i % 8) ? "" : "\n    ",
+                values[i].first, values[i].second);
+    fprintf(f, "\n};\n");
+
+    if (fclose(f) != 0)
+    {
+        fprintf(stderr, "Couldn't write %s\n", argv[2]);
+        return 1;
+    }
+
+    printf("%lu couplings, %lu coefficients, %lu distinct values",
+            (unsigned long)(directory.size() - std::count_if(directory.begin(),
+                directory.end(), [](const builtin_isf_entry& e) { return e.d == 0; })),
+            (unsigned long)index.size(), (unsigned long)values.size());
+    if (skipped)
+        printf(" (%ld couplings left out)", skipped);
+    printf("\n");
+
+    return 0;
+}
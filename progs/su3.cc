@@ -33,27 +33,44 @@ void usage()
     exit(2);
 }
 
-/* Display values for a single irrep in a possibly-degenerate set */
-void print_isfs(isoarray* isf, long n, long p, long q,
-                long p1, long q1, long p2, long q2, long d)
+/* Display values for a single irrep in a possibly-degenerate set.
+    The values are for rep i of 'isf', which is labelled as rep n. */
+void print_isfs(isoarray* isf, long i, long n, long d)
 {
+    long q = isf->q, q1 = isf->q1, p2 = isf->p2, q2 = isf->q2;
     long k, l, k1, l1, k2, l2;
     char val_buf[BUF_SIZE];
 
     if (d > 1)
         printf("  Degenerate rep %ld/%ld:\n", n, d);
 
-    FOREACH_ISF(p, q, p1, q1, p2, q2, k, l, k1, l1, k2, l2)
+    /* Walk through the rows for rep i in memory order, which is the same
+        order as FOREACH_ISF */
+    isf_cursor row(*isf);
+    row.seek(i, q, 0, q1);
+    do
     {
-        (*isf)(n-1, k, l, k1, l1, k2, l2).tostring(val_buf, BUF_SIZE);
-        printf("    (%ld,%ld) : (%ld,%ld) x (%ld,%ld) = %s\n",
-            k, l, k1, l1, k2, l2, val_buf);
-    }
+        k = row.k();
+        l = row.l();
+        k1 = row.k1();
+        for (l1 = 0; l1 <= q1; ++l1)
+            for (k2 = q2; k2 <= p2+q2; ++k2)
+            {
+                l2 = row.l2(l1, k2);
+                if ((l2 < 0) || (l2 > q2)
+                    || (abs(k1-l1-k2+l2) > k-l) || (k-l > k1-l1+k2-l2))
+                    continue;
+
+                row(l1, k2).tostring(val_buf, BUF_SIZE);
+                printf("    (%ld,%ld) : (%ld,%ld) x (%ld,%ld) = %s\n",
+                    k, l, k1, l1, k2, l2, val_buf);
+            }
+    } while (row.next() && (row.n() == i));
 
     printf("\n");
 }
 
-void print_cgcs(cgarray* cg, long n, long p, long q,
+void print_cgcs(cgarray* cg, long i, long n, long p, long q,
                 long p1, long q1, long p2, long q2, long d)
 {
     long k, l, m, k1, l1, m1, k2, l2, m2;
@@ -64,7 +81,7 @@ void print_cgcs(cgarray* cg, long n, long p, long q,
 
     FOREACH_CGC(p, q, p1, q1, p2, q2, k, l, m, k1, l1, m1, k2, l2, m2)
     {
-        (*cg)(n-1, k, l, m, k1, l1, m1, k2, l2, m2).tostring(val_buf, BUF_SIZE);
+        (*cg)(i, k, l, m, k1, l1, m1, k2, l2, m2).tostring(val_buf, BUF_SIZE);
         printf("    (%ld,%ld,%ld) : (%ld,%ld,%ld) x (%ld,%ld,%ld) = %s\n",
             k, l, m, k1, l1, m1, k2, l2, m2, val_buf);
     }
@@ -72,48 +89,41 @@ void print_cgcs(cgarray* cg, long n, long p, long q,
     printf("\n");
 }
 
-/* Print the values for a particular target representation, but possibly with degeneracy >1. */
-void do_rep(long p, long q, long p1, long q1, long p2, long q2, long n, enum print_mode mode)
+/* Print the values for a particular target representation, which has
+    degeneracy d. The ISFs for that representation are passed in: either
+    for every rep, or (if n > 0) for only rep n. */
+void do_rep(isoarray* isf, long n, long d, enum print_mode mode)
 {
-    long d = degeneracy(p, q, p1, q1, p2, q2);
-    if (d == 0) return;
-    if ((n < -1) || (n == 0) || (n > d))
-    {
-        printf("Error: Degeneracy label %ld is not in valid range 1,...,%ld\n",
-                n, d);
-        return;
-    }
+    long p = isf->p, q = isf->q, p1 = isf->p1, q1 = isf->q1,
+        p2 = isf->p2, q2 = isf->q2;
 
     if (mode == MODE_ISF)
     {
         printf("Isoscalar factors for (%ld,%ld) x (%ld,%ld) -> (%ld,%ld), degeneracy %ld:\n",
                 p1, q1, p2, q2, p, q, d);
 
-        isoarray* isf = isoscalars(p, q, p1, q1, p2, q2);
         if (n > 0)
-            print_isfs(isf, n, p, q, p1, q1, p2, q2, d);
+            print_isfs(isf, 0, n, d);
         else
         {
             /* Print all reps */
             for (n = 1; n <= d; ++n)
-                print_isfs(isf, n, p, q, p1, q1, p2, q2, d);
+                print_isfs(isf, n-1, n, d);
         }
-
-        delete isf;
     }
     else if (mode == MODE_CGC)
     {
         printf("Clebsch-Gordan coefficients for (%ld,%ld) x (%ld,%ld) -> (%ld,%ld), degeneracy %ld:\n",
                 p1, q1, p2, q2, p, q, d);
 
-        cgarray* cg = clebsch_gordans(p, q, p1, q1, p2, q2);
+        cgarray* cg = isf->to_cgarray();
         if (n > 0)
-            print_cgcs(cg, n, p, q, p1, q1, p2, q2, d);
+            print_cgcs(cg, 0, n, p, q, p1, q1, p2, q2, d);
         else
         {
             /* Print all reps */
             for (n = 1; n <= d; ++n)
-                print_cgcs(cg, n, p, q, p1, q1, p2, q2, d);
+                print_cgcs(cg, n-1, n, p, q, p1, q1, p2, q2, d);
         }
 
         delete cg;
@@ -134,40 +144,49 @@ void print_values(char* command, enum print_mode mode)
 
     if (p == -1)
     {
-        /* Crude bounds on which reps can appear */
-        long upper = p1+q1+p2+q2;
+        /* Calculate every irrep in the series at once */
+        decomposition* decomp = decompose(p1, q1, p2, q2);
+        long i;
 
         /* Print a decomposition at the top */
-        int any_printed = 0; // Keeps track of whether we need to print a '+'
         printf("Clebsch-Gordan series:\n");
         printf("(%ld,%ld) x (%ld,%ld) =", p1, q1, p2, q2);
-        for (p = 0; p <= upper; ++p)
-            for (q = 0; q <= upper; ++q)
-            {
-                long d = degeneracy(p, q, p1, q1, p2, q2);
-
-                if (d == 0) continue;
-                else if (d == 1)
-                {
-                    printf("%s (%ld,%ld)", any_printed ? " +" : "", p, q);
-                    any_printed = 1;
-                }
-                else
-                {
-                    printf("%s %ldx(%ld,%ld)",
-                            any_printed ? " +" : "", d, p, q);
-                    any_printed = 1;
-                }
-            }
+        for (i = 0; i < decomp->size(); ++i)
+        {
+            isoarray* isf = (*decomp)[i];
+            const char* sep = (i > 0) ? " +" : "";
+
+            if (isf->d == 1)
+                printf("%s (%ld,%ld)", sep, isf->p, isf->q);
+            else
+                printf("%s %ldx(%ld,%ld)", sep, isf->d, isf->p, isf->q);
+        }
         printf("\n\n");
 
         /* Print individual values */
-        for (p = 0; p <= upper; ++p)
-            for (q = 0; q <= upper; ++q)
-                do_rep(p, q, p1, q1, p2, q2, -1, mode);
+        for (i = 0; i < decomp->size(); ++i)
+            do_rep((*decomp)[i], -1, (*decomp)[i]->d, mode);
+
+        delete decomp;
     }
     else
-        do_rep(p, q, p1, q1, p2, q2, n, mode);
+    {
+        long d = degeneracy(p, q, p1, q1, p2, q2);
+        if (! d) return; /* (p,q) does not appear in the series */
+
+        if ((n < -1) || (n == 0) || (n > d))
+        {
+            printf("Error: Degeneracy label %ld is not in valid range 1,...,%ld\n",
+                    n, d);
+            return;
+        }
+
+        /* If only one rep was asked for, only calculate that one */
+        isoarray* isf = (n > 0) ? isoscalars_rep(p, q, p1, q1, p2, q2, n-1)
+                                : isoscalars(p, q, p1, q1, p2, q2);
+        do_rep(isf, n, d, mode);
+        delete isf;
+    }
 }
 
 /* Main function: Just check that the arguments are in the right format and
@@ -0,0 +1,50 @@
+/* libSU3: Program to write a table of CGCs as doubles, for use with SU3_table.h */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SU3.h"
+
+const char* usage_message = "\
+Usage: %s FILE MAX_PQ [THREADS]\n\
+\n\
+Write the CGCs for every coupling (p1,q1) x (p2,q2) -> (p,q) with each of\n\
+p+q, p1+q1 and p2+q2 at most MAX_PQ to FILE. If THREADS is not given, one\n\
+thread is used per available core.\n\
+";
+
+int main(int argc, char** argv)
+{
+    if ((argc != 3) && (argc != 4))
+    {
+        printf(usage_message, argv[0]);
+        return 2;
+    }
+
+    char* end;
+    long max_pq = strtol(argv[2], &end, 10);
+    if (*end || (max_pq < 0))
+    {
+        printf(usage_message, argv[0]);
+        return 2;
+    }
+
+    long nthreads = 0;
+    if (argc == 4)
+    {
+        nthreads = strtol(argv[3], &end, 10);
+        if (*end)
+        {
+            printf(usage_message, argv[0]);
+            return 2;
+        }
+    }
+
+    if (! export_cgc_table(argv[1], max_pq, nthreads))
+    {
+        fprintf(stderr, "Couldn't write %s\n", argv[1]);
+        return 1;
+    }
+
+    return 0;
+}
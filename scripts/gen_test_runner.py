@@ -12,6 +12,7 @@ HEADER = """\
 
 #include <stdio.h>
 #include <limits.h>
+#include <time.h>
 
 #include "SU3.h"
 #include "test.h"
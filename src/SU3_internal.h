@@ -3,8 +3,22 @@
 #ifndef __SU3_INTERNAL_H__
 #define __SU3_INTERNAL_H__
 
+#include <limits.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "SU3.h"
 
+#ifdef SU3_USE_MPFR
+#include "SU3_mpfr.h"
+#endif
+
 /* Various useful functions */
 long min(long, long);
 long min(long, long, long);
@@ -15,16 +29,520 @@ long max(long, long, long);
 /* Macro to calculate (-1)^v */
 #define SIGN(v) ((((v) % 2) == 0) ? 1 : -1)
 
+/* Estimated relative cost of calculating the ISFs for one coupling of
+    degeneracy d: the size of the array for one copy of the irrep, times
+    d^2 for the d copies and the orthonormalisation between them. */
+double isoscalars_cost(long p, long q, long p1, long q1, long p2, long q2, long d);
+
+/* The symmetry relations between couplings, as implemented by
+    isoarray::exch_12() etc. Each of these is its own inverse. */
+enum symmetry_op
+{
+    SYM_EXCH_12,
+    SYM_EXCH_13BAR,
+    SYM_EXCH_23BAR,
+    SYM_CONJ
+};
+
+/* The coupling which the given symmetry relation maps 'c' to */
+coupling apply_symmetry(symmetry_op op, const coupling& c);
+
+/* Map a coupling to a canonical representative of its orbit under the
+    symmetry relations. The operations which map the representative back to
+    'c' are stored in 'path', in the order they should be applied.
+*/
+coupling canonical_coupling(const coupling& c, std::vector<symmetry_op>& path);
+
+/* Apply a sequence of symmetry relations to a set of ISFs.
+    Always returns a newly-allocated object, even if 'path' is empty. */
+isoarray* apply_symmetries(isoarray* isf, const std::vector<symmetry_op>& path);
+
+bool operator<(const coupling&, const coupling&);
+bool operator==(const coupling&, const coupling&);
+
+/* Reading and writing ISFs in a portable binary format (see serialize.cc).
+    The decode functions return false / NULL if the data is malformed. */
+struct isf_io
+{
+    static void put_u64(std::string& out, unsigned long long v);
+    static bool get_u64(const unsigned char*& pos, const unsigned char* end,
+                        unsigned long long& v);
+
+    static void put_sqrat(std::string& out, const sqrat& v);
+    static bool get_sqrat(const unsigned char*& pos, const unsigned char* end,
+                            sqrat& v);
+
+    /* A whole isoarray, including a header with a format version and a
+        checksum of the coefficients */
+    static std::string encode(const isoarray& isf);
+    static isoarray* decode(const unsigned char* data, size_t len);
+
+    /* Check the labels of a coupling read from a file before using them:
+        each of p, q, p1, q1, p2, q2 must be at most MAX_STORED_LABEL (see
+        serialize.cc), d must be the coupling's nonzero degeneracy, and the
+        number of coefficients, which is stored in 'size', must not overflow.
+        Returns false if any of these fail. */
+    static bool check_coupling(unsigned long long p, unsigned long long q,
+                                unsigned long long p1, unsigned long long q1,
+                                unsigned long long p2, unsigned long long q2,
+                                unsigned long long d, size_t& size);
+
+    /* Raw access to the stored values, for the table generator and the
+        tests: sign(v)*v^2, and an isoarray's coefficients in
+        memory order (which is only possible for an isoarray held in
+        memory, not one backed by a file) */
+    static const mpq_class& squared(const sqrat& v) { return v.v; }
+    static const sqrat* coefficients(const isoarray& isf, size_t& size)
+    {
+        size = isf.size;
+        return isf.isf_array;
+    }
+};
+
+/* The sign convention and the symmetry relations, shared between isoarray
+    and isoarray_double (see isoarray.cc). 'Array' is the array type, and T is
+    the type of value it holds. */
+struct isf_symmetry
+{
+    template<typename Array, typename T>
+    static void check_sign_convention(Array& array);
+
+    template<typename Array, typename T>
+    static Array* exch_12(const Array& array);
+
+    template<typename Array, typename T>
+    static Array* exch_13bar(const Array& array);
+
+    template<typename Array, typename T>
+    static Array* conj(const Array& array);
+};
+
+/* 64-bit FNV-1a hash, used as a checksum */
+unsigned long long checksum64(const unsigned char* data, size_t len);
+
+/* A file of ISFs mapped into memory (see mapped.cc). get() decodes the
+    value at a given position in memory order, throwing std::runtime_error
+    if it is corrupt. Each row is checked against its checksum the first
+    time it is used. */
+struct isf_mapping
+{
+    void* map;
+    size_t map_len;
+    const unsigned char* rows;    // Position, length and checksum of each row
+    const unsigned char* offsets; // Position of each value
+    const unsigned char* data;
+    size_t data_len;
+    size_t row_size;
+    mutable std::vector<std::atomic<bool> > checked;
+
+    ~isf_mapping();
+    sqrat get(size_t index) const;
+};
+
+/* The on-disk cache (see diskcache.cc). disk_cache_load returns NULL if the
+    coupling is not in the cache, or if the cache is disabled. */
+isoarray* disk_cache_load(const coupling& c, long d);
+void disk_cache_store(const isoarray& isf);
+bool disk_cache_enabled();
+
+/* Tables of ISFs compiled into the library. These are generated at build time
+    by progs/gen_tables.cc; see there for the layout.
+    builtin_isoscalars() returns NULL if the coupling is not in the tables,
+    or if they have been disabled with set_builtin_isf_tables(false). */
+struct builtin_isf_entry
+{
+    unsigned int d;     // Degeneracy, or 0 if the coupling is not present
+    unsigned int first; // Position of the first coefficient in builtin_isf_index
+};
+
+extern const long builtin_isf_max_pq;
+extern const builtin_isf_entry builtin_isf_directory[];
+extern const unsigned int builtin_isf_index[];
+extern const long builtin_isf_values[][2];
+
+long builtin_isf_entry_index(long p, long q, long p1, long q1, long p2, long q2);
+isoarray* builtin_isoscalars(long p, long q, long p1, long q1, long p2, long q2);
+
+/* Closed forms for couplings with (1,0), (0,1) or (1,1) as either factor
+    (see closedform.cc). Returns NULL if the coupling isn't one of these, or
+    if the closed forms have been disabled with set_closed_form_isfs(false). */
+isoarray* closed_form_isoscalars(long p, long q, long p1, long q1, long p2,
+                                    long q2, long d);
+
+/* Single values from those closed forms: the ISFs for (p1,q1) x (1,0) and
+    (p1,q1) x (0,1) -> (p,q), which are 0 for any arguments which can't
+    couple, and the SU(2) Clebsch-Gordans coupling anything to isospin 0, 1/2
+    or 1 (with doubled arguments, as for su2_cgc_2i()). These ignore
+    set_closed_form_isfs(). */
+sqrat isf_10(long p, long q, long p1, long q1, long k, long l,
+                long k1, long l1, long k2, long l2);
+sqrat isf_01(long p, long q, long p1, long q1, long k, long l,
+                long k1, long l1, long k2, long l2);
+sqrat su2_small(long I, long Iz, long i1, long i1z, long i2, long i2z);
+
+/* A sum of square roots of rationals. The terms are grouped by which
+    square root they are a rational multiple of; the whole sum is expected
+    to collapse to a single one of these, and value() throws
+    std::logic_error if it doesn't.
+
+    Each group is held as a rational multiple of its first term, so adding
+    a term only takes rational arithmetic and the square roots of its ratio
+    to that term. Almost every sum has a single group, which is kept
+    outside the vector, and clear() keeps its storage (and that of the
+    scratch values) for the next sum. */
+class radical_sum
+{
+private:
+    struct group
+    {
+        sqrat term;
+        mpq_class coefficient;
+    };
+
+    long ngroups;
+    group first;
+    std::vector<group> others;
+    mpq_class ratio, root;
+
+    bool add_to(group& g, const sqrat& x);
+
+public:
+    radical_sum() : ngroups(0) {}
+
+    void add(const sqrat& x);
+    sqrat value() const;
+
+    /* Start a new sum */
+    void clear();
+};
+
+/* Build up ISFs by coupling (1,0) or (0,1) onto smaller cached couplings
+    (see buildup.cc). Returns false if this engine can't handle the coupling,
+    in which case the sqrat engine should be used. Otherwise, 'result' is set
+    to the ISFs. */
+bool isoscalars_buildup(long p, long q, long p1, long q1, long p2, long q2,
+                        long d, isoarray*& result);
+
+/* A small work-stealing thread pool, used for running independent
+    calculations concurrently.
+
+    All tasks are queued up before calling run(). They are then sorted by their
+    estimated cost, most expensive first, and dealt out to one queue per
+    worker thread. Each worker takes tasks from the front of its own queue;
+    once that is empty, it steals from the back of the other workers' queues.
+
+    If a task throws an exception, the remaining tasks are abandoned and
+    run() rethrows the first such exception in the calling thread.
+
+    A pool which is run from inside one of another pool's tasks runs its
+    tasks one after another in the calling thread, since the outer pool is
+    already using every thread it was given.
+*/
+class work_pool
+{
+public:
+    typedef std::function<void()> task;
+
+    /* nthreads <= 0 means "one thread per available core" */
+    work_pool(long nthreads);
+
+    void add(task t, double cost);
+    void run();
+
+    /* The number of threads which run() will use */
+    long threads();
+
+private:
+    struct queued_task
+    {
+        task t;
+        double cost;
+    };
+
+    struct worker_queue
+    {
+        std::mutex lock;
+        std::deque<task> tasks;
+    };
+
+    long nthreads;
+    std::vector<queued_task> pending;
+
+    bool take(std::vector<worker_queue>& queues, long self, task& t);
+};
+
+/* Operations which the recursions in isoscalar_context need, beyond ordinary
+    arithmetic, for each type of value they can be run with (see values.cc).
+
+    signed_sqrt<T>(num, den) returns sign(num*den) * sqrt(|num/den|).
+    negligible(x, scale) checks whether x should be treated as zero, given
+    that it was calculated from values of magnitude around 'scale'. This is
+    an exact test for sqrat, but allows for rounding errors in floating point.
+*/
+template<typename T> T signed_sqrt(long num, long den);
+template<> sqrat signed_sqrt<sqrat>(long num, long den);
+template<> double signed_sqrt<double>(long num, long den);
+template<> long double signed_sqrt<long double>(long num, long den);
+
+/* As signed_sqrt(), for numerators and denominators which don't fit in
+    a long. This is only used for very large reps; see coefficient_width. */
+template<typename T> T signed_sqrt_mpz(const mpz_class& num, const mpz_class& den);
+template<> sqrat signed_sqrt_mpz<sqrat>(const mpz_class& num, const mpz_class& den);
+template<> double signed_sqrt_mpz<double>(const mpz_class& num, const mpz_class& den);
+template<> long double signed_sqrt_mpz<long double>(const mpz_class& num,
+                                                        const mpz_class& den);
+
+/* The integer type needed to evaluate the numerators and denominators of the
+    recursion coefficients, and of the factors in the symmetry relations,
+    without overflow. Each is a product of at most five factors (and a small
+    constant), each bounded by a multiple of the size of the reps involved,
+    so this is decided once per coupling. */
+enum coefficient_width
+{
+    COEFFICIENT_LONG,
+    COEFFICIENT_INT128,
+    COEFFICIENT_MPZ,
+};
+
+coefficient_width choose_coefficient_width(long p, long q, long p1, long q1,
+                                            long p2, long q2);
+
+/* Make choose_coefficient_width() return at least 'width', so that the
+    wider types can be tested on small couplings. COEFFICIENT_LONG restores
+    the usual choice. */
+void set_min_coefficient_width(coefficient_width width);
+
+/* signed_sqrt(num, den), for num and den of any of the above types.
+    Wider values are reduced to lowest terms first, and passed on to
+    signed_sqrt() if they then fit in a long. */
+template<typename T>
+inline T coefficient_sqrt(long num, long den)
+{
+    return signed_sqrt<T>(num, den);
+}
+
+mpz_class int128_to_mpz(__int128 v);
+
+template<typename T>
+T coefficient_sqrt(__int128 num, __int128 den)
+{
+    if ((num >= LONG_MIN) && (num <= LONG_MAX) && (den >= LONG_MIN) && (den <= LONG_MAX))
+        return signed_sqrt<T>((long)num, (long)den);
+
+    unsigned __int128 a = (num < 0) ? -(unsigned __int128)num : (unsigned __int128)num;
+    unsigned __int128 b = (den < 0) ? -(unsigned __int128)den : (unsigned __int128)den;
+    while (b)
+    {
+        unsigned __int128 r = a % b;
+        a = b;
+        b = r;
+    }
+    if (a > 1)
+    {
+        num /= (__int128)a;
+        den /= (__int128)a;
+        if ((num >= LONG_MIN) && (num <= LONG_MAX) && (den >= LONG_MIN) && (den <= LONG_MAX))
+            return signed_sqrt<T>((long)num, (long)den);
+    }
+
+    return signed_sqrt_mpz<T>(int128_to_mpz(num), int128_to_mpz(den));
+}
+
+template<typename T>
+T coefficient_sqrt(const mpz_class& num, const mpz_class& den)
+{
+    if (num.fits_slong_p() && den.fits_slong_p())
+        return signed_sqrt<T>(num.get_si(), den.get_si());
+
+    mpz_class g;
+    mpz_gcd(g.get_mpz_t(), num.get_mpz_t(), den.get_mpz_t());
+    mpz_class n = num / g, m = den / g;
+    if (n.fits_slong_p() && m.fits_slong_p())
+        return signed_sqrt<T>(n.get_si(), m.get_si());
+
+    return signed_sqrt_mpz<T>(n, m);
+}
+
+/* A value r * sqrt(m), as used by the multi-modular engine (modular.cc).
+    r is stored modulo the prime for the channel being calculated on the
+    current thread, and the squarefree integer m is stored as a bitmask of
+    entries in a table of small primes. */
+struct modular_value
+{
+    unsigned long long r;
+    unsigned long long m[2];
+
+    modular_value() : r(0)
+    {
+        m[0] = m[1] = 0;
+    }
+
+    modular_value(long v);
+
+    modular_value& operator+=(const modular_value&);
+};
+
+modular_value operator-(const modular_value&);
+modular_value operator+(const modular_value&, const modular_value&);
+modular_value operator-(const modular_value&, const modular_value&);
+modular_value operator*(const modular_value&, const modular_value&);
+modular_value operator/(const modular_value&, const modular_value&);
+
+template<> modular_value signed_sqrt<modular_value>(long num, long den);
+template<> modular_value signed_sqrt_mpz<modular_value>(const mpz_class& num,
+                                                        const mpz_class& den);
+
+/* Calculate ISFs with the multi-modular engine. Returns false if this engine
+    can't handle the coupling, in which case the sqrat engine should be used.
+    Otherwise, 'result' is set as for isoscalars_single() (isoscalars.cc):
+    it is NULL if the recursions can't be used directly for this coupling. */
+bool isoscalars_modular(long p, long q, long p1, long q1, long p2, long q2,
+                        long d, isoarray*& result);
+
+/* For testing: make the next 'count' channels of the modular engine fail,
+    as though their primes were unlucky. Returns the number of forced
+    failures which were still to come. */
+long set_modular_channel_failures(long count);
+
+bool negligible(const sqrat& x, const sqrat& scale);
+bool negligible(double x, double scale);
+bool negligible(long double x, long double scale);
+
+/* The MPFR engine (isoscalars_mpfr.cc), if enabled in config.mk */
+#ifdef SU3_USE_MPFR
+template<> mpfr_value signed_sqrt<mpfr_value>(long num, long den);
+template<> mpfr_value signed_sqrt_mpz<mpfr_value>(const mpz_class& num,
+                                                    const mpz_class& den);
+bool negligible(const mpfr_value& x, const mpfr_value& scale);
+#endif
+
+/* Fill 'coefficients' (which must be zeroed, and have the same layout as in
+    an isoarray) with the ISFs for one coupling, calculated directly with
+    values of type T. Returns false if the recursions cannot be used for this
+    coupling, in which case one of the symmetry relations must be used. */
+template<typename T>
+bool isoscalars_fill(long p, long q, long p1, long q1, long p2, long q2,
+                        long d, T* coefficients);
+
+/* As isoscalars_fill(), but keeping only a window of rows in memory
+    (see isoscalars_stream()). 'window' must hold isoscalars_window_size()
+    values. Each row (n, k) is passed to 'on_row' as soon as it is finished,
+    laid out as in an isorow; the values are only valid during the call. */
+template<typename T>
+using isf_row_handler = std::function<void(long n, long k, const T* values)>;
+
+size_t isoscalars_window_size(long p, long q, long p1, long q1, long p2, long q2,
+                                long d);
+
+template<typename T>
+bool isoscalars_fill_rows(long p, long q, long p1, long q1, long p2, long q2,
+                            long d, T* window, const isf_row_handler<T>& on_row);
+
+/* Calculate only degenerate rep n in full (see isoscalars_rep()).
+    'coefficients' must be zeroed and hold isoscalars_rep_size() values: the
+    first part is laid out as an isoarray with d = 1, and the rest holds the
+    couplings to the state of highest weight of the other reps, which are
+    needed to orthonormalise rep n. Returns false if the recursions cannot
+    be used for this coupling. */
+size_t isoscalars_rep_size(long p, long q, long p1, long q1, long p2, long q2,
+                            long d);
+
+template<typename T>
+bool isoscalars_fill_rep(long p, long q, long p1, long q1, long p2, long q2,
+                            long d, long n, T* coefficients);
+
+/* Calculate only the couplings to the state of highest weight for each rep
+    (see isoscalars_shw()). 'shw' must be zeroed, and hold d blocks of
+    (p1+1) * (q1+1) * (p2+1) values, laid out as in a shwarray. Returns false
+    if the recursions cannot be used for this coupling. */
+template<typename T>
+bool isoscalars_fill_shw(long p, long q, long p1, long q1, long p2, long q2,
+                            long d, T* shw);
+
+/* Checkpoints for a long-running calculation (see checkpoint.cc).
+    isoscalar_context reports each finished plane of the calculation in
+    calc_shw(), the end of calc_shw(), and each finished row of
+    calc_isoscalars(), and skips any work which the checkpoint says has
+    already been done.
+
+    Creating this restores the values from any existing checkpoint file for
+    the same coupling into 'coefficients' (which has the same layout as in an
+    isoarray). Any other existing file is left alone, and ok() is false,
+    unless 'overwrite' is set. Checkpoints are written at the next boundary once 'interval'
+    seconds have passed since the last one, or at every boundary if
+    interval <= 0. */
+class isf_checkpoint
+{
+private:
+    std::string path;
+    int fd;
+    long long file_len;
+    long p, q, p1, q1, p2, q2, d;
+    sqrat* coefficients;
+    long interval;
+    long last_write;
+
+    /* Progress: planes with s > next_s have been calculated; rows are
+        calculated in order of increasing n and then decreasing k, and the
+        first 'rows' of them have been calculated. */
+    long next_s;
+    bool shw_finished;
+    long rows;
+
+    /* How much of the above is in the file */
+    long saved_s;
+    bool saved_shw;
+    long saved_rows;
+
+    bool restore(const coupling& requested);
+    void start(const coupling& requested, bool overwrite);
+    bool append(const std::string& record);
+    void save();
+
+public:
+    isf_checkpoint(const char* path, const coupling& requested, long p, long q,
+                    long p1, long q1, long p2, long q2, long d,
+                    sqrat* coefficients, long interval, bool overwrite);
+    ~isf_checkpoint();
+
+    /* Whether the checkpoint file could be created */
+    bool ok() const { return fd >= 0; }
+
+    /* Read the coupling a checkpoint file was written for */
+    static bool requested_coupling(const char* path, coupling& c);
+
+    long resume_s() const { return next_s; }
+    bool shw_done() const { return shw_finished; }
+    bool row_done(long n, long k) const { return n * (p+1) + (p+q-k) < rows; }
+
+    void finish_plane(long s);
+    void finish_shw();
+    void finish_row(long n, long k);
+
+    /* Delete the checkpoint file, once the calculation is complete */
+    void remove();
+};
+
+/* As isoscalars_fill(), for sqrat values, with checkpoints */
+bool isoscalars_fill_checkpointed(long p, long q, long p1, long q1, long p2,
+                                    long q2, long d, sqrat* coefficients,
+                                    isf_checkpoint& checkpoint);
+
 /* A class for storing a bunch of useful values during our calculations.
     All functions are run as methods of an object of this class, so we have
-    easy access to those values */
+    easy access to those values.
+
+    The recursions are written in terms of a value type T, which is sqrat for
+    exact calculations (see isoscalars()) or a floating-point type
+    (see isoscalars_double()). */
+template<typename T>
 class isoscalar_context
 {
 public:
     /* Functions to get/set particular isoscalar factors. */
-    sqrat isf(long n, long k, long l, long k1, long l1, long k2, long l2);
+    T isf(long n, long k, long l, long k1, long l1, long k2, long l2);
     void set_isf(long n, long k, long l, long k1, long l1, long k2, long l2,
-                    sqrat value);
+                    T value);
 
 private:
     /* Values which many functions need access to */
@@ -32,10 +550,59 @@ private:
     long d; // Degeneracy
     long A; // = 1/3 (2(p1+p2) + 4(q1+q2) + (p-q))
 
-    sqrat* coefficients;
+    T* coefficients;
+
+    /* If set, 'coefficients' only holds a window of rows: the couplings to
+        the state of highest weight for each rep, followed by two full rows,
+        for k of each parity. Finished rows are passed to this function. */
+    const isf_row_handler<T>* on_row;
+
+    /* If set, progress is saved to (and restored from) this */
+    isf_checkpoint* checkpoint;
+
+    /* If >= 0, only this rep is filled out past the couplings to the state
+        of highest weight, and it is stored as rep 0. The couplings to the
+        state of highest weight for the other reps follow it. */
+    long only_rep;
+
+    /* For a product of a rep with itself, the 1 <-> 2 exchange symmetry
+        maps each rep onto itself, so that
+        F(n; k, l; k2, l2; k1, l1) = mirror_sign[n] (-1)^((k-l-k1+l1-k2+l2)/2)
+                                        F(n; k, l; k1, l1; k2, l2)
+        If this has been set up, only the entries with (k1, l1) >= (k2, l2)
+        are calculated by the recursions, and the rest are filled in from
+        those. Empty if not. */
+    std::vector<long> mirror_sign;
+
+    /* For a single rep (d = 1), the sum of the squares of the couplings to
+        the state of highest weight, accumulated as they are calculated.
+        This is only valid if every one of them was calculated here (and
+        not restored from a checkpoint). */
+    T shw_norm;
+    bool shw_norm_valid;
+
+    /* The integer type used for the recursion coefficients */
+    coefficient_width width;
+
+    /* If set, 'coefficients' is laid out to suit the recursions (see
+        index()), and is moved into the usual layout by copy_out() */
+    bool stencil;
 
     isoscalar_context(long p, long q, long p1, long q1, long p2, long q2,
-                        long d, sqrat* coefficients);
+                        long d, T* coefficients,
+                        const isf_row_handler<T>* on_row = NULL);
+
+    /* Position of a value in 'coefficients' */
+    size_t index(long n, long k, long l, long k1, long l1, long k2);
+
+    /* The size of 'coefficients' with the stencil layout, and moving the
+        values from it into an array with the usual layout */
+    size_t stencil_size();
+    void copy_out(T* out);
+
+    /* Called once all the couplings to (k, l) for each l have been
+        calculated for rep n */
+    void finish_row(long n, long k);
 
     /* Calculate the coefficients for each of the four recursion relations.
        Each stores the coefficients in its last four arguments.
@@ -52,13 +619,27 @@ private:
        special-case it to be zero instead.
     */
     void a_coefficients(long k1, long l1, long k2, long l2,
-                        sqrat& a1, sqrat& a2, sqrat& a3, sqrat& a4);
+                        T& a1, T& a2, T& a3, T& a4);
     void b_coefficients(long k1, long l1, long k2, long l2,
-                        sqrat& b1, sqrat& b2, sqrat& b3, sqrat& b4);
+                        T& b1, T& b2, T& b3, T& b4);
     void c_coefficients(long k, long l, long k1, long l1, long k2, long l2,
-                sqrat& alpha, sqrat& c1, sqrat& c2, sqrat& c3, sqrat& c4);
+                T& alpha, T& c1, T& c2, T& c3, T& c4);
     void d_coefficients(long k, long k1, long l1, long k2, long l2,
-                sqrat& beta, sqrat& d1, sqrat& d2, sqrat& d3);
+                T& beta, T& d1, T& d2, T& d3);
+
+    /* The above, with the coefficients evaluated using integers of type I */
+    template<typename I>
+    void a_coefficients_as(long k1, long l1, long k2, long l2,
+                            T& a1, T& a2, T& a3, T& a4);
+    template<typename I>
+    void b_coefficients_as(long k1, long l1, long k2, long l2,
+                            T& b1, T& b2, T& b3, T& b4);
+    template<typename I>
+    void c_coefficients_as(long k, long l, long k1, long l1, long k2, long l2,
+                            T& alpha, T& c1, T& c2, T& c3, T& c4);
+    template<typename I>
+    void d_coefficients_as(long k, long k1, long l1, long k2, long l2,
+                            T& beta, T& d1, T& d2, T& d3);
 
     /* Use the A and B recursion relations to step along the
        k1 and l1 axes within a plane of constant s.
@@ -80,6 +661,10 @@ private:
     void step_k_down(long n, long k, long k1, long l1, long k2, long l2);
     void step_l_up(long n, long k, long l, long k1, long l1, long k2, long l2);
 
+    /* The same, for every rep at once */
+    void step_k_down_all(long k, long k1, long l1, long k2, long l2);
+    void step_l_up_all(long k, long l, long k1, long l1, long k2, long l2);
+
     /* Step down from one plane (at s+2) to the next plane (at s).
        In principle this can fail, in which case you need to use the exchange
        symmetries in order to calculate the values. This should never happen with
@@ -106,7 +691,7 @@ private:
     void step_s_down(long n, long s);
 
     /* Calculate the inner product of two sets of isoscalar factors */
-    sqrat inner_product(long m, long n);
+    T inner_product(long m, long n);
 
     /* Calculate couplings to the state of highest weight.
         This can throw std::logic_error if we can't calculate directly. This should
@@ -114,13 +699,86 @@ private:
     */
     void calc_shw();
 
+    /* Store a coupling to the state of highest weight */
+    void set_shw(long n, long k1, long l1, long k2, long l2, T value);
+
+    /* Orthonormalise the couplings to the state of highest weight for the
+        degenerate reps, and apply the sign convention */
+    void orthonormalise();
+
+    /* The norm 'v' of rep n, with the sign needed to apply the sign
+        convention when dividing through by it */
+    T signed_norm(long n, T v);
+
+    /* Find mirror_sign (see above) from the couplings to the state of
+        highest weight. This only does anything for sqrat values, which
+        can be compared exactly. */
+    void find_mirror_signs();
+
+    /* Whether an entry is filled in by mirror() instead of calculated */
+    bool mirrored(long k1, long l1, long k2, long l2);
+
+    /* Fill in the mirrored entries for (k, l) in rep n */
+    void mirror(long n, long k, long l);
+
     /* Fill out each multiplet, assuming that the SHWs have been calculated */
     void calc_isoscalars();
 
     /* Allow the top-level driver function to interact with
         objects of this class */
-    friend isoarray* isoscalars_single(long p, long q, long p1, long q1,
-                                        long p2, long q2, long d);
+    friend bool isoscalars_fill<T>(long p, long q, long p1, long q1,
+                                    long p2, long q2, long d, T* coefficients);
+    friend bool isoscalars_fill_rows<T>(long p, long q, long p1, long q1,
+                                        long p2, long q2, long d, T* window,
+                                        const isf_row_handler<T>& on_row);
+    friend bool isoscalars_fill_rep<T>(long p, long q, long p1, long q1,
+                                        long p2, long q2, long d, long n,
+                                        T* coefficients);
+    friend struct isf_lazy;
+    friend bool isoscalars_fill_shw<T>(long p, long q, long p1, long q1,
+                                        long p2, long q2, long d, T* shw);
+    friend bool isoscalars_fill_checkpointed(long p, long q, long p1, long q1,
+                                        long p2, long q2, long d,
+                                        sqrat* coefficients,
+                                        isf_checkpoint& checkpoint);
 };
 
+/* The state of a lazy calculation (see lazy.cc). This holds the couplings
+    to the state of highest weight for each rep, laid out as in a shwarray,
+    and every other value which has been calculated so far. */
+struct isf_lazy
+{
+    long p, q, p1, q1, p2, q2, d;
+    sqrat* shw;
+
+    /* Only used for the recursion coefficients */
+    isoscalar_context<sqrat>* ctx;
+
+    /* The values calculated so far, by position in the isoarray */
+    std::unordered_map<size_t, sqrat> known;
+    std::mutex lock;
+
+    isf_lazy(long p, long q, long p1, long q1, long p2, long q2, long d,
+                sqrat* shw);
+    ~isf_lazy();
+
+    sqrat get(size_t index);
+    size_t memory_usage();
+
+private:
+    sqrat isf(long n, long k, long l, long k1, long l1, long k2, long l2);
+};
+
+/* Modular values can't be normalised (that needs a square root, and the
+    sign of each value), so the multi-modular engine only orthogonalises the
+    degenerate reps. The normalisation and sign convention are applied once
+    the exact values have been reconstructed. */
+template<> void isoscalar_context<modular_value>::orthonormalise();
+template<> void isoscalar_context<sqrat>::find_mirror_signs();
+
+/* For testing and benchmarking: whether orthonormalise() normalises a single
+    rep in one pass (shw.cc). If not, it goes through the general
+    Gram-Schmidt loop like degenerate reps do. This is on by default. */
+void set_single_rep_normalisation(bool enabled);
+
 #endif
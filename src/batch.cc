@@ -0,0 +1,94 @@
+/* libSU3: Calculating isoscalar factors for many couplings at once */
+
+#include <map>
+#include <vector>
+
+#include "SU3_internal.h"
+
+isoarray** isoscalars_batch(const coupling* couplings, long count, long nthreads)
+{
+    isoarray** results = new isoarray*[count];
+
+    /* Map each coupling to its orbit representative, and collect up the
+        distinct representatives which need calculating */
+    std::vector<std::vector<symmetry_op> > paths(count);
+    std::vector<long> rep_index(count, -1);
+    std::map<coupling, long> index_of;
+    std::vector<coupling> reps;
+    std::vector<long> rep_d;
+    long i;
+
+    for (i = 0; i < count; ++i)
+    {
+        const coupling& c = couplings[i];
+        results[i] = NULL;
+
+        long d = degeneracy(c.p, c.q, c.p1, c.q1, c.p2, c.q2);
+        if (! d) continue;
+
+        coupling rep = canonical_coupling(c, paths[i]);
+        std::map<coupling, long>::iterator it = index_of.find(rep);
+        if (it == index_of.end())
+        {
+            it = index_of.insert(std::make_pair(rep, (long)reps.size())).first;
+            reps.push_back(rep);
+            rep_d.push_back(d);
+        }
+
+        rep_index[i] = it->second;
+    }
+
+    /* Calculate each representative once */
+    std::vector<isoarray*> rep_isfs(reps.size(), NULL);
+
+    try
+    {
+        work_pool pool(nthreads);
+        size_t r;
+        for (r = 0; r < reps.size(); ++r)
+        {
+            const coupling& c = reps[r];
+            double cost = isoscalars_cost(c.p, c.q, c.p1, c.q1, c.p2, c.q2, rep_d[r]);
+            pool.add([&reps, &rep_isfs, r]()
+                {
+                    const coupling& c = reps[r];
+                    rep_isfs[r] = isoscalars(c.p, c.q, c.p1, c.q1, c.p2, c.q2);
+                }, cost);
+        }
+        pool.run();
+
+        /* Derive the requested couplings from the representatives. This is
+            much cheaper than the calculations above, but for large batches it
+            is still worth spreading over all threads. */
+        work_pool derive_pool(nthreads);
+        for (i = 0; i < count; ++i)
+        {
+            if (rep_index[i] < 0) continue;
+
+            const coupling& c = reps[rep_index[i]];
+            double cost = isoscalars_cost(c.p, c.q, c.p1, c.q1, c.p2, c.q2, rep_d[rep_index[i]]);
+            derive_pool.add([&rep_isfs, &rep_index, &paths, results, i]()
+                {
+                    results[i] = apply_symmetries(rep_isfs[rep_index[i]], paths[i]);
+                }, cost);
+        }
+        derive_pool.run();
+    }
+    catch (...)
+    {
+        for (i = 0; i < count; ++i)
+            delete results[i];
+        delete[] results;
+
+        size_t r;
+        for (r = 0; r < rep_isfs.size(); ++r)
+            delete rep_isfs[r];
+        throw;
+    }
+
+    size_t r;
+    for (r = 0; r < rep_isfs.size(); ++r)
+        delete rep_isfs[r];
+
+    return results;
+}
@@ -0,0 +1,345 @@
+/* libSU3: Building up ISFs from smaller couplings.
+
+    The states of (p2,q2) are contained in (p2-1,q2) x (1,0), or, if p2 = 0,
+    in (0,q2-1) x (0,1). So, as for the (1,1) closed form in closedform.cc,
+    the couplings (p1,q1) x (p2,q2) -> (p,q) can be found by coupling
+    (p1,q1) and the smaller rep to some intermediate rep, coupling the
+    fundamental rep onto that, and projecting onto (p2,q2). The first step
+    uses ISFs which are looked up in the process-wide cache (and are built
+    up in the same way when they aren't there), and the other two use the
+    closed forms.
+
+    For a target of degeneracy 1, any intermediate coupling which doesn't
+    project to zero gives the ISFs up to normalisation. For higher
+    degeneracies, the projections would have to be separated in the same
+    way as calc_shw() separates the degenerate reps, so those are left to
+    the recursion.
+
+    Each ISF here is a sum of a few products of cached values, where the
+    recursion needs a few products of freshly calculated square roots. The
+    SU(2) recoupling coefficients and the closed-form tables are shared
+    between couplings, and the products of the closed forms are shared
+    between the states of (p1,q1), so the work for each term of an ISF is a
+    couple of multiplications by small rationals, and the terms are summed
+    with rational arithmetic (see radical_sum). Over a sweep of couplings
+    through the cache, where the smaller couplings are already there, this
+    takes about two thirds of the time of the recursion (see
+    progs/bench.cc). A coupling on its own also has to calculate the smaller
+    couplings, so the recursion is still the default.
+*/
+
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+#include "SU3_internal.h"
+
+/* The SU(2) part of coupling the smaller rep and then the fundamental rep
+    onto state 1, compared with coupling (p2,q2) onto it directly: the
+    recoupling coefficient <(i1 ia) ii, 1/2; I | i1, (ia 1/2) it; I>, with
+    doubled isospins. As in closedform.cc, this is found from a single
+    choice of components, so that only two terms contribute. */
+static sqrat recoupling(long i1, long ia, long ii, long I, long it)
+{
+    long i1z = max(-i1, I - it), itz = I - i1z;
+    if ((i1z > i1) || (itz > it)) return sqrat(0);
+
+    sqrat w = su2_cgc_2i(I, I, i1, i1z, it, itz);
+    if (w == sqrat(0)) return sqrat(0);
+
+    radical_sum sum;
+    long ibz;
+    for (ibz = -1; ibz <= 1; ibz += 2)
+    {
+        long iaz = itz - ibz, iiz = i1z + iaz;
+        if ((abs(iaz) > ia) || (abs(iiz) > ii)) continue;
+
+        sum.add(su2_small(it, itz, ia, iaz, 1, ibz)
+                * su2_cgc_2i(ii, iiz, i1, i1z, ia, iaz)
+                * su2_small(I, I, ii, iiz, 1, ibz));
+    }
+
+    return sum.value() / w;
+}
+
+/* Values of recoupling(). These only depend on the isospins, so the same
+    few values are needed over and over across a sweep of couplings, and
+    each thread keeps every one it has calculated. ii is within 1/2 of I,
+    and it is within 1/2 of ia. */
+static thread_local std::unordered_map<unsigned long long, sqrat> recoupling_cache;
+
+static const sqrat& cached_recoupling(long i1, long ia, long ii, long I, long it)
+{
+    unsigned long long key = ((((unsigned long long)i1 << 20 | ia) << 20 | I) << 2)
+                                | (ii > I) << 1 | (it > ia);
+    auto found = recoupling_cache.find(key);
+    if (found != recoupling_cache.end())
+        return found->second;
+
+    return recoupling_cache[key] = recoupling(i1, ia, ii, I, it);
+}
+
+/* The closed-form ISFs for (pa,qa) x (pb,qb) -> (p,q), where (pb,qb) is the
+    fundamental rep, for each state (k,l) of (p,q), each state of (pb,qb),
+    and each of the (at most two) states of (pa,qa) which can couple. The
+    state of (pa,qa) is picked by its isospin, ia = k-l -/+ (kb-lb). */
+class fundamental_table
+{
+private:
+    long p, q, pa, qa, pb, qb, off;
+    std::vector<sqrat> values;
+
+public:
+    fundamental_table(long p, long q, long pa, long qa, long pb, long qb)
+        : p(p), q(q), pa(pa), qa(qa), pb(pb), qb(qb),
+        off((2*pa + 2*pb + 4*qa + 4*qb - 2*p - 4*q)/3),
+        values((p+1) * (q+1) * 4)
+    {
+        long k, l, kb, lb, j, ka, la;
+        for (k = q; k <= p+q; ++k)
+            for (l = 0; l <= q; ++l)
+                for (kb = pb ? 0 : 1; kb <= 1; ++kb)
+                    for (lb = 0; lb <= qb; ++lb)
+                        for (j = 0; j < 2; ++j)
+                            if (state(k, l, kb, lb, j, ka, la))
+                                values[index(k, l, kb, lb, j)] = pb
+                                    ? isf_10(p, q, pa, qa, k, l, ka, la, kb, lb)
+                                    : isf_01(p, q, pa, qa, k, l, ka, la, kb, lb);
+    }
+
+    size_t index(long k, long l, long kb, long lb, long j) const
+    {
+        return (((k-q)*(q+1) + l)*2 + (pb ? kb : lb))*2 + j;
+    }
+
+    /* Find the j'th state (ka,la) of (pa,qa) which can couple to (k,l).
+        Returns false if there isn't one. */
+    bool state(long k, long l, long kb, long lb, long j, long& ka, long& la) const
+    {
+        long ib = kb-lb, ia = k-l + (2*j-1)*ib, sa = k+l + off - kb-lb;
+        if ((ia < 0) || ((sa + ia) % 2) || ((ib == 0) && j)) return false;
+        ka = (sa + ia)/2;
+        la = (sa - ia)/2;
+        return true;
+    }
+
+    const sqrat& operator()(long k, long l, long kb, long lb, long j) const
+    {
+        return values[index(k, l, kb, lb, j)];
+    }
+};
+
+/* The tables above for each target rep are shared by every coupling to
+    it, and (as the split of (p2,q2)) by every coupling from it, so each
+    thread keeps the ones it has built, up to a limit. The fundamental rep
+    is given by pb, since it is either (1,0) or (0,1). */
+#define MAX_FUNDAMENTAL_TABLES 4096
+
+struct fundamental_key_hash
+{
+    size_t operator()(const std::array<long, 5>& key) const
+    {
+        size_t h = 0;
+        for (long x : key)
+            h = h * 1000003 + std::hash<long>()(x);
+        return h;
+    }
+};
+
+static thread_local std::unordered_map<std::array<long, 5>, fundamental_table,
+                                        fundamental_key_hash> fundamental_cache;
+
+static const fundamental_table& cached_fundamental(long p, long q, long pa,
+                                                    long qa, long pb, long qb)
+{
+    std::array<long, 5> key = {{p, q, pa, qa, pb}};
+    auto found = fundamental_cache.find(key);
+    if (found != fundamental_cache.end())
+        return found->second;
+
+    return fundamental_cache.emplace(key, fundamental_table(p, q, pa, qa, pb,
+                                                            qb)).first->second;
+}
+
+/* The ISFs for one choice of intermediate coupling, (p1,q1) x (pa,qa) ->
+    (pi,qi) in degenerate rep ni, multiplied by 'scale'. The fundamental rep
+    is (pb,qb). Only the states (k,l) of (p,q) with k >= kmin and l <= lmax
+    are filled in, so that the couplings to the state of highest weight can
+    be found first, to fix the normalisation. 'values' holds the ISFs in
+    'inner', which must be held in memory. */
+static void buildup_fill(long p, long q, long p1, long q1, long p2, long q2,
+                            long pa, long qa, long pb, long qb, long pi, long qi,
+                            const sqrat* values, long ni, long kmin, long lmax,
+                            const sqrat& scale, sqrat* isf_array)
+{
+    /* Inserting more tables never moves the ones we already hold, so only
+        clear them out between couplings */
+    if (fundamental_cache.size() >= MAX_FUNDAMENTAL_TABLES)
+        fundamental_cache.clear();
+    const fundamental_table& outer = cached_fundamental(p, q, pi, qi, pb, qb);
+    const fundamental_table& split = cached_fundamental(p2, q2, pa, qa, pb, qb);
+
+    /* The ISFs of the fundamental rep only depend on the states of (p,q)
+        and (p2,q2), so for each pair of those, we take their products (and
+        the scale) once, and then run over the states of (p1,q1). Each
+        route also keeps the position of its first inner ISF. */
+    struct route
+    {
+        sqrat factor;
+        long ia, ii;
+        size_t offset;
+        bool recouple;
+    } routes[8];
+    long y = (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3;
+
+    /* Scratch space, which keeps its storage from one ISF to the next */
+    radical_sum sum;
+    sqrat term;
+
+    long k, l, k1, l1, k2, l2, kb, lb, ja, ji, r, nroutes;
+    long ka = 0, la = 0, ki = 0, li = 0;
+    for (k = kmin; k <= p+q; ++k)
+        for (l = 0; l <= lmax; ++l)
+            for (k2 = q2; k2 <= p2+q2; ++k2)
+                for (l2 = 0; l2 <= q2; ++l2)
+                {
+                    /* The states of (1,0) are (0,0) and (1,0), and those of
+                        (0,1) are (1,0) and (1,1) */
+                    nroutes = 0;
+                    for (kb = pb ? 0 : 1; kb <= 1; ++kb)
+                        for (lb = 0; lb <= qb; ++lb)
+                            for (ja = 0; ja < 2; ++ja)
+                            {
+                                const sqrat& fa = split(k2, l2, kb, lb, ja);
+                                if (isf_io::squared(fa) == 0) continue;
+                                split.state(k2, l2, kb, lb, ja, ka, la);
+                                if ((ka < qa) || (ka > pa+qa)
+                                    || (la < 0) || (la > qa))
+                                    continue;
+
+                                for (ji = 0; ji < 2; ++ji)
+                                {
+                                    const sqrat& f2 = outer(k, l, kb, lb, ji);
+                                    if (isf_io::squared(f2) == 0) continue;
+                                    outer.state(k, l, kb, lb, ji, ki, li);
+                                    if ((ki < qi) || (ki > pi+qi)
+                                        || (li < 0) || (li > qi))
+                                        continue;
+
+                                    route& rt = routes[nroutes++];
+                                    rt.factor = fa;
+                                    rt.factor *= f2;
+                                    rt.factor *= scale;
+                                    rt.ia = ka-la;
+                                    rt.ii = ki-li;
+                                    rt.offset = (((ni*(pi+1) + ki-qi)*(qi+1) + li)
+                                                    *(p1+1)*(q1+1))*(pa+1) + ka-qa;
+                                    rt.recouple = (kb != lb);
+                                }
+                            }
+                    if (! nroutes) continue;
+
+                    long I = k-l, it = k2-l2;
+                    for (k1 = q1; k1 <= p1+q1; ++k1)
+                    {
+                        /* Hypercharge fixes l1 */
+                        l1 = y + k + l - k2 - l2 - k1;
+                        if ((l1 < 0) || (l1 > q1)) continue;
+                        long i1 = k1-l1;
+                        if ((abs(i1 - it) > I) || (I > i1 + it)) continue;
+
+                        size_t step = ((k1-q1)*(q1+1) + l1)*(pa+1);
+                        sum.clear();
+                        for (r = 0; r < nroutes; ++r)
+                        {
+                            const route& rt = routes[r];
+                            const sqrat& f1 = values[rt.offset + step];
+                            if (isf_io::squared(f1) == 0) continue;
+
+                            /* The other factors are small, so multiply them
+                                together first */
+                            term = rt.factor;
+                            if (rt.recouple)
+                                term *= cached_recoupling(i1, rt.ia, rt.ii, I, it);
+                            term *= f1;
+                            sum.add(term);
+                        }
+
+                        isf_array[((((k-q)*(q+1) + l)*(p1+1) + k1-q1)*(q1+1) + l1)
+                                    *(p2+1) + k2-q2] = sum.value();
+                    }
+                }
+}
+
+bool isoscalars_buildup(long p, long q, long p1, long q1, long p2, long q2,
+                        long d, isoarray*& result)
+{
+    /* Smaller factors are handled by the closed forms */
+    if ((d != 1) || (p2 + q2 < 2))
+        return false;
+
+    long pa = p2, qa = q2, pb, qb;
+    if (p2 > 0)
+    {
+        --pa;
+        pb = 1;
+        qb = 0;
+    }
+    else
+    {
+        --qa;
+        pb = 0;
+        qb = 1;
+    }
+
+    /* Intermediate reps which the fundamental rep can couple to (p,q).
+        The third possibility is larger than (p,q), and is never used, so
+        that each step goes to a strictly smaller coupling and the
+        recursion through the cache terminates. */
+    long intermediates[2][2] = {{p-pb, q-qb}, {p-qb+pb, q-pb+qb}};
+    size_t size = (p+1) * (q+1) * (p1+1) * (q1+1) * (p2+1);
+    int i;
+    for (i = 0; i < 2; ++i)
+    {
+        long pi = intermediates[i][0], qi = intermediates[i][1];
+        if ((pi < 0) || (qi < 0)) continue;
+        long di = degeneracy(pi, qi, p1, q1, pa, qa);
+        if (! di) continue;
+
+        isoarray_handle inner = cached_isoscalars(pi, qi, p1, q1, pa, qa);
+        size_t inner_size;
+        const sqrat* values = isf_io::coefficients(*inner, inner_size);
+        if (! values) continue;
+
+        long ni;
+        for (ni = 0; ni < di; ++ni)
+        {
+            /* Normalise using the couplings to the state of highest weight,
+                which are the k = p+q, l = 0 block of the array */
+            sqrat* isf_array = new sqrat[size]();
+            buildup_fill(p, q, p1, q1, p2, q2, pa, qa, pb, qb, pi, qi, values,
+                            ni, p+q, 0, sqrat(1), isf_array);
+
+            size_t R = (p1+1) * (q1+1) * (p2+1);
+            sqrat norm(0);
+            size_t j;
+            for (j = p * (q+1) * R; j < (p * (q+1) + 1) * R; ++j)
+                norm += isf_array[j] * isf_array[j];
+
+            if (norm == sqrat(0))
+            {
+                delete[] isf_array;
+                continue;
+            }
+
+            buildup_fill(p, q, p1, q1, p2, q2, pa, qa, pb, qb, pi, qi, values,
+                            ni, q, q, sqrat(1) / sqrt(norm), isf_array);
+
+            result = new isoarray(p, q, p1, q1, p2, q2, 1, isf_array);
+            isf_symmetry::check_sign_convention<isoarray, sqrat>(*result);
+            return true;
+        }
+    }
+
+    return false;
+}
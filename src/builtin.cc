@@ -0,0 +1,65 @@
+/* libSU3: Looking up isoscalar factors in the tables compiled into the library.
+
+    The tables hold every coupling (p1,q1) x (p2,q2) -> (p,q) with p1+q1 and
+    p2+q2 at most builtin_isf_max_pq, so that the full decomposition of each
+    small product is available without any calculation.
+*/
+
+#include <atomic>
+
+#include "SU3_internal.h"
+
+static std::atomic<bool> builtin_enabled(true);
+
+void set_builtin_isf_tables(bool enabled)
+{
+    builtin_enabled = enabled;
+}
+
+bool get_builtin_isf_tables()
+{
+    return builtin_enabled;
+}
+
+/* Helper: Index of a rep among those with p+q <= some bound */
+static long rep_index(long p, long q)
+{
+    return (p+q)*(p+q+1)/2 + q;
+}
+
+/* Position of a coupling in builtin_isf_directory, or -1 if it is outside
+    the range of the tables */
+long builtin_isf_entry_index(long p, long q, long p1, long q1, long p2, long q2)
+{
+    long max_pq = builtin_isf_max_pq;
+    if ((p1+q1 > max_pq) || (p2+q2 > max_pq) || (p+q > 2*max_pq))
+        return -1;
+
+    long nreps = (max_pq+1)*(max_pq+2)/2;
+    long ntargets = (2*max_pq+1)*(2*max_pq+2)/2;
+    return (rep_index(p1, q1)*nreps + rep_index(p2, q2))*ntargets + rep_index(p, q);
+}
+
+isoarray* builtin_isoscalars(long p, long q, long p1, long q1, long p2, long q2)
+{
+    if (! builtin_enabled) return NULL;
+
+    long entry = builtin_isf_entry_index(p, q, p1, q1, p2, q2);
+    if (entry < 0) return NULL;
+
+    long d = builtin_isf_directory[entry].d;
+    if (d == 0) return NULL;
+
+    size_t size = d * (p+1) * (q+1) * (p1+1) * (q1+1) * (p2+1);
+    const unsigned int* index = &builtin_isf_index[builtin_isf_directory[entry].first];
+    sqrat* coefficients = new sqrat[size];
+    size_t i;
+
+    for (i = 0; i < size; ++i)
+    {
+        const long* v = builtin_isf_values[index[i]];
+        coefficients[i] = sqrat(v[0], v[1]);
+    }
+
+    return new isoarray(p, q, p1, q1, p2, q2, d, coefficients);
+}
@@ -0,0 +1,382 @@
+/* libSU3: Thread-safe in-process cache of calculated isoscalar factors.
+
+    Each shard holds an immutable table of entries, sorted by coupling.
+    Lookups read whichever table is current without taking any locks.
+    Updates (inserting or evicting entries) are serialised by a per-shard
+    mutex: they build a new table, publish it, and only free the old table
+    once no reader can still be using it.
+
+    To tell when that is, each reader registers itself in one of two counters,
+    chosen by the parity of the shard's epoch. After publishing a new table,
+    the writer advances the epoch and waits for the counter for the previous
+    parity to drain, twice over. Any reader which could have seen the old table
+    must have registered under one of the two parities, so after both waits
+    the old table is unused.
+
+    The memory limit covers the whole cache, so that a single large coupling
+    can use all of it. Entries are only ever removed with the budget's lock
+    held, which is always taken before any shard's lock. Eviction takes a
+    snapshot of every entry's last use, then removes the oldest entries
+    across all of the shards.
+
+    Note that two threads which miss on the same coupling at the same time will
+    both calculate it; the second one to finish will find the first one's
+    entry and return that instead.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "SU3_internal.h"
+
+struct cache_entry
+{
+    coupling key;
+    isoarray_handle isf;
+    size_t bytes;
+
+    /* Value of the shard's clock when this entry was last used */
+    std::atomic<unsigned long> last_used;
+};
+
+typedef std::vector<std::shared_ptr<cache_entry> > cache_table;
+
+struct isf_cache::shard
+{
+    /* Serialises updates to this shard. Readers never take it. */
+    std::mutex lock;
+
+    std::atomic<const cache_table*> current;
+    std::atomic<unsigned long> epoch;
+    std::atomic<long> readers[2];
+
+    /* Logical clock, used for LRU eviction */
+    std::atomic<unsigned long> clock;
+
+    std::atomic<unsigned long> hits, misses, evictions;
+
+    /* Only accessed with 'lock' held */
+    size_t bytes;
+
+    shard() : current(new cache_table()), epoch(0), clock(0),
+                hits(0), misses(0), evictions(0), bytes(0)
+    {
+        readers[0] = 0;
+        readers[1] = 0;
+    }
+
+    ~shard()
+    {
+        delete current.load();
+    }
+};
+
+struct isf_cache::budget
+{
+    /* Serialises removing entries, and is taken before any shard's lock */
+    std::mutex lock;
+
+    /* The total is updated as entries are added, without this lock */
+    std::atomic<size_t> bytes, max_bytes;
+
+    budget() : bytes(0), max_bytes(0) {}
+};
+
+/* Helper: Find an entry in a table. Returns NULL if it isn't present. */
+static cache_entry* find_entry(const cache_table* table, const coupling& key)
+{
+    cache_table::const_iterator it = std::lower_bound(table->begin(), table->end(),
+        key, [](const std::shared_ptr<cache_entry>& e, const coupling& k)
+        { return e->key < k; });
+
+    if ((it == table->end()) || !((*it)->key == key))
+        return NULL;
+    return it->get();
+}
+
+/* Helper: Lock-free lookup of a coupling in one shard */
+static isoarray_handle lookup(isf_cache::shard& s, const coupling& key)
+{
+    unsigned long e = s.epoch.load();
+    s.readers[e & 1].fetch_add(1);
+
+    isoarray_handle result;
+    cache_entry* entry = find_entry(s.current.load(), key);
+    if (entry)
+    {
+        result = entry->isf;
+        entry->last_used.store(s.clock.fetch_add(1, std::memory_order_relaxed) + 1,
+                               std::memory_order_relaxed);
+    }
+
+    s.readers[e & 1].fetch_sub(1);
+    return result;
+}
+
+/* Helper: Replace the current table of a shard, and free the old table once
+    no readers can be using it. Must be called with the shard's lock held. */
+static void publish(isf_cache::shard& s, const cache_table* table)
+{
+    const cache_table* old = s.current.exchange(table);
+
+    int i;
+    for (i = 0; i < 2; ++i)
+    {
+        unsigned long e = s.epoch.fetch_add(1);
+        while (s.readers[e & 1].load() != 0)
+            std::this_thread::yield();
+    }
+
+    delete old;
+}
+
+isf_cache::isf_cache(size_t max_bytes, long nshards) : nshards(nshards)
+{
+    if (this->nshards < 1)
+        this->nshards = 1;
+
+    shards = new shard[this->nshards];
+    limit = new budget();
+    set_max_bytes(max_bytes);
+}
+
+isf_cache::~isf_cache()
+{
+    delete[] shards;
+    delete limit;
+}
+
+isf_cache::shard& isf_cache::shard_for(const coupling& c)
+{
+    unsigned long h = c.p;
+    h = h * 31 + c.q;
+    h = h * 31 + c.p1;
+    h = h * 31 + c.q1;
+    h = h * 31 + c.p2;
+    h = h * 31 + c.q2;
+    h ^= h >> 7;
+    return shards[h % nshards];
+}
+
+/* One entry, as seen by evict(). The time of last use is copied, since
+    readers keep updating it. */
+struct eviction_candidate
+{
+    unsigned long last_used;
+    long shard;
+    const cache_entry* entry;
+    size_t bytes;
+
+    bool operator<(const eviction_candidate& other) const
+    {
+        return last_used < other.last_used;
+    }
+};
+
+/* Evict the least recently used entries, across all of the shards, until
+    the cache fits within its limit */
+void isf_cache::evict()
+{
+    std::lock_guard<std::mutex> guard(limit->lock);
+    if (limit->bytes <= limit->max_bytes)
+        return;
+
+    /* Entries can't be removed while we hold the budget's lock, so these
+        stay valid (though more may be added) */
+    std::vector<eviction_candidate> candidates;
+    long i;
+    size_t j;
+    for (i = 0; i < nshards; ++i)
+    {
+        shard& s = shards[i];
+        std::lock_guard<std::mutex> shard_guard(s.lock);
+        const cache_table* table = s.current.load();
+        for (j = 0; j < table->size(); ++j)
+        {
+            const cache_entry* e = (*table)[j].get();
+            eviction_candidate c = {e->last_used.load(std::memory_order_relaxed),
+                                    i, e, e->bytes};
+            candidates.push_back(c);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    /* Pick entries to remove, then remove them shard by shard, preserving
+        the order of the rest of each table */
+    size_t bytes = limit->bytes;
+    std::vector<std::vector<const cache_entry*> > victims(nshards);
+    for (j = 0; (j < candidates.size()) && (bytes > limit->max_bytes); ++j)
+    {
+        victims[candidates[j].shard].push_back(candidates[j].entry);
+        bytes -= candidates[j].bytes;
+    }
+
+    for (i = 0; i < nshards; ++i)
+    {
+        std::vector<const cache_entry*>& v = victims[i];
+        if (v.empty()) continue;
+        std::sort(v.begin(), v.end());
+
+        shard& s = shards[i];
+        std::lock_guard<std::mutex> shard_guard(s.lock);
+        cache_table* table = new cache_table(*s.current.load());
+        table->erase(std::remove_if(table->begin(), table->end(),
+            [&v](const std::shared_ptr<cache_entry>& e)
+            { return std::binary_search(v.begin(), v.end(),
+                                        (const cache_entry*)e.get()); }),
+            table->end());
+
+        for (j = 0; j < v.size(); ++j)
+        {
+            s.bytes -= v[j]->bytes;
+            limit->bytes -= v[j]->bytes;
+            s.evictions.fetch_add(1);
+        }
+        publish(s, table);
+    }
+}
+
+/* Change the memory limit, evicting entries if necessary */
+void isf_cache::set_max_bytes(size_t max_bytes)
+{
+    limit->max_bytes = max_bytes;
+    evict();
+}
+
+/* Look up a set of ISFs, calculating them if they are not yet cached */
+isoarray_handle isf_cache::isoscalars(long p, long q, long p1, long q1,
+                                        long p2, long q2)
+{
+    coupling key = {p, q, p1, q1, p2, q2};
+    shard& s = shard_for(key);
+
+    isoarray_handle result = lookup(s, key);
+    if (result)
+    {
+        s.hits.fetch_add(1);
+        return result;
+    }
+
+    if (! degeneracy(p, q, p1, q1, p2, q2))
+        return result;
+
+    /* Calculate the ISFs without holding any locks. If the conjugate
+        coupling is cached, conjugating that is much cheaper. */
+    s.misses.fetch_add(1);
+    coupling conj_key = apply_symmetry(SYM_CONJ, key);
+    isoarray_handle conj_isf;
+    if (! (conj_key == key))
+        conj_isf = lookup(shard_for(conj_key), conj_key);
+
+    if (conj_isf)
+        result = isoarray_handle(conj_isf->conj());
+    else
+        result = isoarray_handle(::isoscalars(p, q, p1, q1, p2, q2));
+
+    std::shared_ptr<cache_entry> entry(new cache_entry());
+    entry->key = key;
+    entry->isf = result;
+    entry->bytes = result->memory_usage();
+    entry->last_used = s.clock.fetch_add(1) + 1;
+
+    /* Don't bother caching things which are too big to ever fit */
+    if (entry->bytes > limit->max_bytes)
+        return result;
+
+    {
+        std::lock_guard<std::mutex> guard(s.lock);
+
+        /* Someone else may have got there first */
+        const cache_table* old = s.current.load();
+        cache_entry* existing = find_entry(old, key);
+        if (existing)
+            return existing->isf;
+
+        cache_table* table = new cache_table(*old);
+        table->insert(std::lower_bound(table->begin(), table->end(), key,
+            [](const std::shared_ptr<cache_entry>& e, const coupling& k)
+            { return e->key < k; }), entry);
+        s.bytes += entry->bytes;
+        limit->bytes += entry->bytes;
+
+        publish(s, table);
+    }
+
+    if (limit->bytes > limit->max_bytes)
+        evict();
+
+    return result;
+}
+
+cgarray_handle isf_cache::clebsch_gordans(long p, long q, long p1, long q1,
+                                            long p2, long q2)
+{
+    isoarray_handle isf = isoscalars(p, q, p1, q1, p2, q2);
+    if (! isf)
+        return cgarray_handle();
+
+    /* The cgarray shares the cached ISFs, rather than copying them */
+    return cgarray_handle(new cgarray(isf));
+}
+
+isf_cache_stats isf_cache::stats()
+{
+    isf_cache_stats res = {0, 0, 0, 0, 0};
+
+    long i;
+    for (i = 0; i < nshards; ++i)
+    {
+        shard& s = shards[i];
+        std::lock_guard<std::mutex> guard(s.lock);
+
+        res.hits += s.hits;
+        res.misses += s.misses;
+        res.evictions += s.evictions;
+        res.entries += s.current.load()->size();
+        res.bytes += s.bytes;
+    }
+
+    return res;
+}
+
+/* Remove every entry from the cache; this does not reset the counters */
+void isf_cache::clear()
+{
+    std::lock_guard<std::mutex> budget_guard(limit->lock);
+
+    long i;
+    for (i = 0; i < nshards; ++i)
+    {
+        shard& s = shards[i];
+        std::lock_guard<std::mutex> guard(s.lock);
+
+        limit->bytes -= s.bytes;
+        s.bytes = 0;
+        publish(s, new cache_table());
+    }
+}
+
+/* The process-wide cache */
+isf_cache& global_isf_cache()
+{
+    static isf_cache cache(64L << 20);
+    return cache;
+}
+
+void set_isf_cache_size(size_t max_bytes)
+{
+    global_isf_cache().set_max_bytes(max_bytes);
+}
+
+isoarray_handle cached_isoscalars(long p, long q, long p1, long q1, long p2, long q2)
+{
+    return global_isf_cache().isoscalars(p, q, p1, q1, p2, q2);
+}
+
+cgarray_handle cached_clebsch_gordans(long p, long q, long p1, long q1, long p2, long q2)
+{
+    return global_isf_cache().clebsch_gordans(p, q, p1, q1, p2, q2);
+}
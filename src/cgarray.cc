@@ -10,16 +10,16 @@
 /* Note: This type takes ownership of the isoarray object passed in */
 cgarray::cgarray(isoarray* isf) : isf(isf) {}
 
-cgarray::~cgarray()
-{
-    delete isf;
-}
+/* Build a cgarray which shares an existing (immutable) isoarray */
+cgarray::cgarray(std::shared_ptr<const isoarray> isf) : isf(isf) {}
+
+cgarray::~cgarray() {}
 
 /* We use operator() instead of operator[] as an easy way to use
     multiple indices */
 sqrat cgarray::operator()(long n, long k, long l, long m,
                             long k1, long l1, long m1,
-                            long k2, long l2, long m2)
+                            long k2, long l2, long m2) const
 {
     /* Bounds checks */
     assert((m >= l) && (m <= k));
@@ -37,33 +37,28 @@ sqrat cgarray::operator()(long n, long k, long l, long m,
 }
 
 /* Convert to ISFs. This returns a newly-allocated isoarray object. */
-isoarray* cgarray::to_isoarray()
+isoarray* cgarray::to_isoarray() const
 {
-    /* Create a new coefficient array, to be owned by the isoarray we will
-        end up returning */
-    sqrat* new_isf_array = new sqrat[isf->size];
-
-    /* Explicitly copy each element of the array */
-    size_t i;
-    for (i = 0; i < isf->size; ++i)
-        new_isf_array[i] = isf->isf_array[i];
-
-    return new isoarray(isf->p, isf->q, isf->p1, isf->q1,
-                            isf->p2, isf->q2, isf->d, new_isf_array);
+    return isf->copy();
 }
 
 /* Apply the various symmetry relations */
-cgarray* cgarray::exch_12()
+cgarray* cgarray::exch_12() const
 {
     return new cgarray(isf->exch_12());
 }
 
-cgarray* cgarray::exch_13bar()
+cgarray* cgarray::exch_13bar() const
 {
     return new cgarray(isf->exch_13bar());
 }
 
-cgarray* cgarray::exch_23bar()
+cgarray* cgarray::exch_23bar() const
 {
     return new cgarray(isf->exch_23bar());
 }
+
+cgarray* cgarray::conj() const
+{
+    return new cgarray(isf->conj());
+}
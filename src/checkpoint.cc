@@ -0,0 +1,407 @@
+/* libSU3: Checkpoints for long-running calculations.
+
+    A checkpoint file is a journal: each record is appended as the
+    calculation progresses, and the state is restored by replaying them.
+    The values use the encoding in serialize.cc, and all integers are
+    stored as 8 bytes, least significant byte first. The file holds:
+    * The 8-byte magic string "libSU3:C"
+    * The format version (FORMAT_VERSION below)
+    * The coupling which was asked for, and the coupling actually being
+      calculated (which may differ, if a symmetry relation is needed),
+      each as p, q, p1, q1, p2, q2
+    * The degeneracy d
+
+    Followed by any number of records, each holding:
+    * The record type (RECORD_SHW or RECORD_ROW), and two fields which
+      depend on the type
+    * The length of the values, and a checksum (checksum64) of them
+    * The values
+
+    A RECORD_SHW record holds the couplings to the state of highest weight
+    for each rep, after all planes with s > next_s have been calculated. Its
+    fields are next_s and whether the reps have been orthonormalised. Each
+    RECORD_ROW record holds the next row (n, k) to be finished, after the
+    couplings to the state of highest weight are complete.
+
+    The calculation may be killed at any point, including in the middle of
+    writing a record, so restoring stops at the first record which is
+    incomplete or fails its checksum, and anything after that is discarded.
+
+    A new file is only started in place of an existing one which is empty,
+    or holds no more than part of a header (as left if the calculation was
+    killed while creating it), unless asked to overwrite it. Anything else
+    may be the checkpoint for some other calculation.
+*/
+
+#include <assert.h>
+#include <limits.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "SU3_internal.h"
+
+#define FORMAT_VERSION 1ULL
+#define MAGIC "libSU3:C"
+#define MAGIC_LEN 8
+#define HEADER_LEN (MAGIC_LEN + 14*8)
+#define RECORD_HEADER_LEN (5*8)
+
+#define RECORD_SHW 1ULL
+#define RECORD_ROW 2ULL
+
+/* Helper: Read exactly 'len' bytes */
+static bool read_all(int fd, void* buf, size_t len)
+{
+    size_t done = 0;
+    while (done < len)
+    {
+        ssize_t n = read(fd, (char*)buf + done, len - done);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (n == 0) return false;
+        done += n;
+    }
+
+    return true;
+}
+
+/* Helper: Read the header of a checkpoint file */
+static bool read_header(int fd, coupling& requested, coupling& computed,
+                        unsigned long long& d)
+{
+    unsigned char buf[HEADER_LEN];
+    if (! read_all(fd, buf, HEADER_LEN) || memcmp(buf, MAGIC, MAGIC_LEN))
+        return false;
+
+    const unsigned char* pos = buf + MAGIC_LEN;
+    const unsigned char* end = buf + HEADER_LEN;
+    unsigned long long version, v[12];
+    if (! isf_io::get_u64(pos, end, version) || (version != FORMAT_VERSION))
+        return false;
+
+    int i;
+    for (i = 0; i < 12; ++i)
+        isf_io::get_u64(pos, end, v[i]);
+    isf_io::get_u64(pos, end, d);
+
+    coupling r = {(long)v[0], (long)v[1], (long)v[2], (long)v[3], (long)v[4], (long)v[5]};
+    coupling c = {(long)v[6], (long)v[7], (long)v[8], (long)v[9], (long)v[10], (long)v[11]};
+    requested = r;
+    computed = c;
+    return true;
+}
+
+/* Helper: Whether the file at 'path' holds no more than the start of a
+    header, so that nothing is lost by starting it again */
+static bool unfinished_header(const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    unsigned char buf[HEADER_LEN];
+    bool ok = (fstat(fd, &st) == 0) && (st.st_size < HEADER_LEN)
+        && read_all(fd, buf, st.st_size)
+        && ! memcmp(buf, MAGIC, std::min((size_t)st.st_size, (size_t)MAGIC_LEN));
+    close(fd);
+    return ok;
+}
+
+static bool same_coupling(const coupling& a, const coupling& b)
+{
+    return (a.p == b.p) && (a.q == b.q) && (a.p1 == b.p1) && (a.q1 == b.q1)
+        && (a.p2 == b.p2) && (a.q2 == b.q2);
+}
+
+isf_checkpoint::isf_checkpoint(const char* path, const coupling& requested,
+        long p, long q, long p1, long q1, long p2, long q2, long d,
+        sqrat* coefficients, long interval, bool overwrite) : path(path),
+        fd(-1), file_len(0),
+        p(p), q(q), p1(p1), q1(q1), p2(p2), q2(q2), d(d),
+        coefficients(coefficients), interval(interval), last_write(time(NULL)),
+        next_s(LONG_MAX), shw_finished(false), rows(0),
+        saved_s(LONG_MAX), saved_shw(false), saved_rows(0)
+{
+    if (! restore(requested))
+        start(requested, overwrite);
+}
+
+isf_checkpoint::~isf_checkpoint()
+{
+    if (fd >= 0)
+        close(fd);
+}
+
+bool isf_checkpoint::requested_coupling(const char* path, coupling& c)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    coupling computed;
+    unsigned long long d;
+    bool ok = read_header(fd, c, computed, d);
+    close(fd);
+    return ok;
+}
+
+/* Replay an existing checkpoint file, if there is one for this coupling */
+bool isf_checkpoint::restore(const coupling& requested)
+{
+    fd = open(path.c_str(), O_RDWR);
+    if (fd < 0) return false;
+
+    coupling file_requested, file_computed, computed = {p, q, p1, q1, p2, q2};
+    unsigned long long file_d;
+    struct stat st;
+    if (! read_header(fd, file_requested, file_computed, file_d)
+        || ! same_coupling(file_requested, requested)
+        || ! same_coupling(file_computed, computed)
+        || (file_d != (unsigned long long)d)
+        || (fstat(fd, &st) != 0))
+    {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    size_t row_size = (p1+1) * (q1+1) * (p2+1);
+    file_len = HEADER_LEN;
+
+    while (true)
+    {
+        unsigned char buf[RECORD_HEADER_LEN];
+        if (! read_all(fd, buf, RECORD_HEADER_LEN)) break;
+
+        const unsigned char* pos = buf;
+        const unsigned char* end = buf + RECORD_HEADER_LEN;
+        unsigned long long type, a, b, payload_len, checksum;
+        isf_io::get_u64(pos, end, type);
+        isf_io::get_u64(pos, end, a);
+        isf_io::get_u64(pos, end, b);
+        isf_io::get_u64(pos, end, payload_len);
+        isf_io::get_u64(pos, end, checksum);
+
+        if (payload_len > (unsigned long long)(st.st_size - file_len - RECORD_HEADER_LEN))
+            break;
+
+        std::vector<unsigned char> payload(payload_len);
+        if (! read_all(fd, payload.data(), payload_len)
+            || (checksum64(payload.data(), payload_len) != checksum))
+            break;
+
+        pos = payload.data();
+        end = pos + payload_len;
+        if ((type == RECORD_SHW) && (rows == 0))
+        {
+            /* Decode all of the values before using any of them */
+            std::vector<sqrat> values(d * row_size);
+            size_t i;
+            for (i = 0; i < values.size(); ++i)
+                if (! isf_io::get_sqrat(pos, end, values[i]))
+                    break;
+            if ((i < values.size()) || (pos != end)) break;
+
+            long n;
+            for (n = 0; n < d; ++n)
+                std::copy(values.begin() + n * row_size, values.begin() + (n+1) * row_size,
+                            coefficients + (n * (p+1) + p) * (q+1) * row_size);
+
+            next_s = (long)a;
+            shw_finished = (b != 0);
+        }
+        else if ((type == RECORD_ROW) && shw_finished && (rows < d * (p+1))
+                    && ((long)a == rows / (p+1)) && ((long)b == p+q - rows % (p+1)))
+        {
+            sqrat* row = coefficients + ((long)a * (p+1) + (long)b-q) * (q+1) * row_size;
+            size_t i;
+            for (i = 0; i < (q+1) * row_size; ++i)
+                if (! isf_io::get_sqrat(pos, end, row[i]))
+                    break;
+            if ((i < (q+1) * row_size) || (pos != end)) break;
+
+            ++rows;
+        }
+        else
+            break;
+
+        file_len += RECORD_HEADER_LEN + payload_len;
+    }
+
+    /* Drop anything after the last good record */
+    if (ftruncate(fd, file_len) != 0)
+    {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    saved_s = next_s;
+    saved_shw = shw_finished;
+    saved_rows = rows;
+    return true;
+}
+
+/* Start a new checkpoint file */
+void isf_checkpoint::start(const coupling& requested, bool overwrite)
+{
+    next_s = saved_s = LONG_MAX;
+    shw_finished = saved_shw = false;
+    rows = saved_rows = 0;
+
+    /* A checkpoint which failed part of the way through restoring may have
+        left values behind */
+    std::fill(coefficients, coefficients + d * (p+1) * (q+1) * (p1+1) * (q1+1) * (p2+1),
+                sqrat(0));
+
+    fd = open(path.c_str(), O_RDWR | O_CREAT | (overwrite ? O_TRUNC : O_EXCL), 0666);
+    if ((fd < 0) && (errno == EEXIST) && unfinished_header(path.c_str()))
+        fd = open(path.c_str(), O_RDWR | O_TRUNC);
+    if (fd < 0) return;
+
+    std::string header(MAGIC, MAGIC_LEN);
+    isf_io::put_u64(header, FORMAT_VERSION);
+    isf_io::put_u64(header, requested.p);
+    isf_io::put_u64(header, requested.q);
+    isf_io::put_u64(header, requested.p1);
+    isf_io::put_u64(header, requested.q1);
+    isf_io::put_u64(header, requested.p2);
+    isf_io::put_u64(header, requested.q2);
+    isf_io::put_u64(header, p);
+    isf_io::put_u64(header, q);
+    isf_io::put_u64(header, p1);
+    isf_io::put_u64(header, q1);
+    isf_io::put_u64(header, p2);
+    isf_io::put_u64(header, q2);
+    isf_io::put_u64(header, d);
+
+    file_len = 0;
+    if (! append(header) || (fsync(fd) != 0))
+    {
+        close(fd);
+        unlink(path.c_str());
+        fd = -1;
+    }
+}
+
+/* Append to the file. If this fails, the file is truncated back to the
+    last complete record. */
+bool isf_checkpoint::append(const std::string& record)
+{
+    size_t done = 0;
+    while (done < record.size())
+    {
+        ssize_t n = pwrite(fd, record.data() + done, record.size() - done,
+                            file_len + done);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            int ignored = ftruncate(fd, file_len);
+            (void)ignored;
+            return false;
+        }
+        done += n;
+    }
+
+    file_len += record.size();
+    return true;
+}
+
+/* Helper: Build a record holding some values */
+static std::string make_record(unsigned long long type, unsigned long long a,
+                                unsigned long long b, const sqrat* values,
+                                size_t count)
+{
+    std::string payload;
+    size_t i;
+    for (i = 0; i < count; ++i)
+        isf_io::put_sqrat(payload, values[i]);
+
+    std::string record;
+    isf_io::put_u64(record, type);
+    isf_io::put_u64(record, a);
+    isf_io::put_u64(record, b);
+    isf_io::put_u64(record, payload.size());
+    isf_io::put_u64(record, checksum64((const unsigned char*)payload.data(),
+                                        payload.size()));
+    return record + payload;
+}
+
+/* Write out any progress which isn't in the file yet, if it's time to */
+void isf_checkpoint::save()
+{
+    if (fd < 0) return;
+    if ((interval > 0) && (time(NULL) - last_write < interval))
+        return;
+
+    size_t row_size = (p1+1) * (q1+1) * (p2+1);
+    if (! saved_shw && ((next_s != saved_s) || shw_finished))
+    {
+        std::vector<sqrat> values(d * row_size);
+        long n;
+        for (n = 0; n < d; ++n)
+        {
+            const sqrat* shw = coefficients + (n * (p+1) + p) * (q+1) * row_size;
+            std::copy(shw, shw + row_size, values.begin() + n * row_size);
+        }
+
+        if (! append(make_record(RECORD_SHW, next_s, shw_finished, values.data(),
+                                    values.size())))
+            return;
+
+        saved_s = next_s;
+        saved_shw = shw_finished;
+    }
+
+    while (saved_rows < rows)
+    {
+        long n = saved_rows / (p+1), k = p+q - saved_rows % (p+1);
+        const sqrat* row = coefficients + (n * (p+1) + k-q) * (q+1) * row_size;
+        if (! append(make_record(RECORD_ROW, n, k, row, (q+1) * row_size)))
+            return;
+
+        ++saved_rows;
+    }
+
+    if (fsync(fd) == 0)
+        last_write = time(NULL);
+}
+
+void isf_checkpoint::finish_plane(long s)
+{
+    next_s = s - 2;
+    save();
+}
+
+void isf_checkpoint::finish_shw()
+{
+    shw_finished = true;
+    save();
+}
+
+void isf_checkpoint::finish_row(long n, long k)
+{
+    (void)n;
+    (void)k;
+    assert((n == rows / (p+1)) && (k == p+q - rows % (p+1)));
+
+    ++rows;
+    save();
+}
+
+void isf_checkpoint::remove()
+{
+    if (fd >= 0)
+        close(fd);
+    fd = -1;
+    unlink(path.c_str());
+}
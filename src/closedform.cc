@@ -0,0 +1,482 @@
+/* libSU3: Closed forms for couplings to the fundamental and adjoint reps.
+
+    In our labelling, the state (k,l) of the rep (p,q) has the Gelfand-Tsetlin
+    pattern
+        p+q   q   0
+           k    l
+    and the isoscalar factors for (p1,q1) x (1,0) are the U(3):U(2) reduced
+    Wigner coefficients of the fundamental tensor operator. These are
+    products of simple factors of the pattern entries (see Biedenharn and
+    Louck, or arXiv:1009.0437), so each one can be written down directly.
+    The isoscalar factors for (p1,q1) x (0,1) are the conjugates of these, up
+    to a phase.
+
+    The states of (1,1) are contained in (1,0) x (0,1), so the couplings
+    (p1,q1) x (1,1) -> (p,q) can be built by coupling (1,0) and then (0,1)
+    onto (p1,q1), via some intermediate rep, and projecting onto (1,1). For a
+    target of degeneracy 1, any intermediate rep which can be used at all
+    gives the ISFs up to normalisation. A target of degeneracy 2 would need
+    the two copies separating in the same way as calc_shw() separates them,
+    so those are left to the recursion.
+
+    The phases here were chosen to match the conventions used elsewhere in
+    the library; see tests/closedform.cc.
+*/
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "SU3_internal.h"
+
+static std::atomic<bool> closed_form_enabled(true);
+
+void set_closed_form_isfs(bool enabled)
+{
+    closed_form_enabled = enabled;
+}
+
+bool get_closed_form_isfs()
+{
+    return closed_form_enabled;
+}
+
+/* Helper: The ISF for (p1,q1) x (1,0), where the target's pattern has a box
+    added to row i (i = 0, 1, 2 for targets (p1+1,q1), (p1-1,q1+1), (p1,q1-1))
+    and the middle row has a box added at position j (j = 0, 1), or is
+    unchanged (j = -1, which is the state (k2,l2) = (0,0)) */
+static sqrat fundamental(long p1, long q1, long k1, long l1, int i, int j)
+{
+    /* Shifted pattern entries. Each factor below is bounded by p1+q1+3,
+        and there are at most three of them in each product, so these
+        can't overflow for any reps whose ISFs fit in memory. */
+    __int128 top[3] = {p1+q1+2, q1+1, 0};
+    __int128 mid[2] = {k1+1, l1};
+    __int128 num = 1, den = 1;
+    int a;
+
+    for (a = 0; a < 3; ++a)
+        if (a != i)
+            den *= top[a] - top[i];
+
+    if (j < 0)
+    {
+        for (a = 0; a < 2; ++a)
+            num *= mid[a] - top[i];
+        return coefficient_sqrt<sqrat>((num < 0) ? -num : num, (den < 0) ? -den : den);
+    }
+
+    num = mid[1-j] - top[i];
+    for (a = 0; a < 3; ++a)
+        if (a != i)
+            num *= top[a] - mid[j] - 1;
+    den *= mid[1-j] - mid[j] - 1;
+
+    sqrat v = coefficient_sqrt<sqrat>((num < 0) ? -num : num, (den < 0) ? -den : den);
+    bool negative = (j == 0) ? (i != 0) : (i != 2);
+    return negative ? -v : v;
+}
+
+/* Helper: Check that (k,l) is a state of (p,q) */
+static bool valid_state(long p, long q, long k, long l)
+{
+    return (k >= q) && (k <= p+q) && (l >= 0) && (l <= q);
+}
+
+/* ISF for (p1,q1) x (1,0) -> (p,q). Returns 0 for any set of arguments
+    which can't couple. */
+sqrat isf_10(long p, long q, long p1, long q1, long k, long l,
+                long k1, long l1, long k2, long l2)
+{
+    if (! valid_state(p, q, k, l) || ! valid_state(p1, q1, k1, l1)
+        || ! valid_state(1, 0, k2, l2))
+        return sqrat(0);
+
+    /* Position of the box in the target's pattern. When it goes in the
+        bottom row, the pattern has to be shifted to match our labels. */
+    int i;
+    if ((p == p1+1) && (q == q1))
+        i = 0;
+    else if ((p == p1-1) && (q == q1+1))
+        i = 1;
+    else if ((p == p1) && (q == q1-1))
+    {
+        i = 2;
+        ++k;
+        ++l;
+    }
+    else
+        return sqrat(0);
+
+    int j;
+    if (k2 == 0)
+    {
+        if ((k != k1) || (l != l1)) return sqrat(0);
+        j = -1;
+    }
+    else if ((k == k1+1) && (l == l1))
+        j = 0;
+    else if ((k == k1) && (l == l1+1))
+        j = 1;
+    else
+        return sqrat(0);
+
+    return fundamental(p1, q1, k1, l1, i, j);
+}
+
+/* ISF for (p1,q1) x (0,1) -> (p,q), from the conjugate coupling
+    (q1,p1) x (1,0) -> (q,p) */
+sqrat isf_01(long p, long q, long p1, long q1, long k, long l,
+                long k1, long l1, long k2, long l2)
+{
+    if (! valid_state(0, 1, k2, l2))
+        return sqrat(0);
+
+    sqrat v = isf_10(q, p, q1, p1, p+q-l, p+q-k, p1+q1-l1, p1+q1-k1,
+                        1-l2, 1-k2);
+
+    long parity;
+    if (l2 == 1)
+        parity = (p == p1-1) ? 1 : 0;
+    else if ((p == p1+1) && (q == q1-1))
+        parity = k + k1;
+    else
+        parity = l + l1;
+
+    return SIGN(parity) * v;
+}
+
+/* SU(2) Clebsch-Gordans coupling anything to isospin 0, 1/2 or 1, from the
+    usual tables. As in su2_cgc_2i(), all arguments are doubled. */
+sqrat su2_small(long I, long Iz, long i1, long i1z, long i2, long i2z)
+{
+    if ((Iz != i1z + i2z) || (I > i1 + i2) || (I < i1 - i2) || (I < i2 - i1)
+        || (abs(Iz) > I) || (abs(i1z) > i1) || (abs(i2z) > i2))
+        return sqrat(0);
+
+    long a = i1 + Iz, b = i1 - Iz;
+    switch (i2)
+    {
+    case 0:
+        return sqrat(1);
+
+    case 1:
+        if (I == i1+1)
+            return (i2z > 0) ? sqrat(a+1, 2*(i1+1)) : sqrat(b+1, 2*(i1+1));
+        else
+            return (i2z > 0) ? -sqrat(b+1, 2*(i1+1)) : sqrat(a+1, 2*(i1+1));
+
+    case 2:
+        if (I == i1+2)
+        {
+            if (i2z > 0)  return sqrat(a*(a+2), 4*(i1+1)*(i1+2));
+            if (i2z == 0) return sqrat((a+2)*(b+2), 2*(i1+1)*(i1+2));
+            return sqrat(b*(b+2), 4*(i1+1)*(i1+2));
+        }
+        else if (I == i1)
+        {
+            if (i2z > 0)  return -sqrat(a*(b+2), 2*i1*(i1+2));
+            if (i2z == 0) return sqrat(Iz*abs(Iz), i1*(i1+2));
+            return sqrat(b*(a+2), 2*i1*(i1+2));
+        }
+        else
+        {
+            if (i2z > 0)  return sqrat(b*(b+2), 4*i1*(i1+1));
+            if (i2z == 0) return -sqrat(a*b, 2*i1*(i1+1));
+            return sqrat(a*(a+2), 4*i1*(i1+1));
+        }
+
+    default:
+        throw std::logic_error("su2_small() only handles isospin up to 1");
+    }
+}
+
+/* Helper for radical_sum: Add x to a group if it is a rational multiple of
+    the group's first term. Returns false, leaving the group alone, if it
+    isn't. */
+bool radical_sum::add_to(group& g, const sqrat& x)
+{
+    /* The ratio of the squares is negative if the signs differ */
+    mpq_div(ratio.get_mpq_t(), isf_io::squared(x).get_mpq_t(),
+            isf_io::squared(g.term).get_mpq_t());
+    bool negative = (ratio < 0);
+    if (negative)
+        mpq_neg(ratio.get_mpq_t(), ratio.get_mpq_t());
+
+    /* Both parts of the ratio are already in lowest terms, so their roots
+        are too */
+    if ((! mpz_root(root.get_num_mpz_t(), ratio.get_num_mpz_t(), 2))
+        || (! mpz_root(root.get_den_mpz_t(), ratio.get_den_mpz_t(), 2)))
+        return false;
+
+    if (negative)
+        g.coefficient -= root;
+    else
+        g.coefficient += root;
+    return true;
+}
+
+void radical_sum::clear()
+{
+    ngroups = 0;
+    others.clear();
+}
+
+void radical_sum::add(const sqrat& x)
+{
+    if (isf_io::squared(x) == 0) return;
+
+    if (ngroups && add_to(first, x))
+        return;
+
+    size_t i;
+    for (i = 0; i < others.size(); ++i)
+        if (add_to(others[i], x))
+            return;
+
+    if (ngroups++)
+    {
+        others.push_back(group());
+        others.back().term = x;
+        others.back().coefficient = 1;
+    }
+    else
+    {
+        first.term = x;
+        first.coefficient = 1;
+    }
+}
+
+sqrat radical_sum::value() const
+{
+    const group* found = NULL;
+    size_t i;
+
+    for (i = 0; i < (size_t)ngroups; ++i)
+    {
+        const group& g = i ? others[i-1] : first;
+        if (g.coefficient == 0) continue;
+        if (found)
+            throw std::logic_error("Sum of ISF terms is not the square root "
+                                    "of a rational. Please report this as "
+                                    "a bug in libSU3.");
+        found = &g;
+    }
+
+    if (! found)
+        return sqrat(0);
+    if (found->coefficient == 1)
+        return found->term;
+    return sqrat(found->coefficient) * found->term;
+}
+
+/* The SU(2) part of coupling (1,0) and then (0,1) onto state 1, compared
+    with coupling (1,1) onto it directly: the recoupling coefficient
+    <(i1 ia) ii, ib; I | i1, (ia ib) it; I>, with doubled isospins. This is
+    found from the Clebsch-Gordans for a single choice of components: the
+    highest Iz in the target, and the lowest component of i1 which can
+    couple to it. */
+static sqrat recoupling(long i1, long ia, long ii, long ib, long I, long it)
+{
+    long i1z = max(-i1, I - it), itz = I - i1z;
+    sqrat w = su2_small(I, I, i1, i1z, it, itz);
+    if (w == sqrat(0)) return sqrat(0);
+
+    radical_sum sum;
+    long iaz;
+    for (iaz = -ia; iaz <= ia; iaz += 2)
+        sum.add(su2_small(it, itz, ia, iaz, ib, itz - iaz)
+                * su2_small(ii, i1z + iaz, i1, i1z, ia, iaz)
+                * su2_small(I, I, ii, i1z + iaz, ib, itz - iaz));
+
+    return sum.value() / w;
+}
+
+/* recoupling() only ever sees isospins within 1 of i1, apart from it
+    (which is at most 1), so its values are kept for each i1 */
+class recoupling_table
+{
+private:
+    std::vector<sqrat> values;
+    std::vector<bool> known;
+
+public:
+    recoupling_table(long max_i1) : values(108 * (max_i1+1)),
+        known(108 * (max_i1+1), false) {}
+
+    const sqrat& get(long i1, long ia, long ii, long ib, long I, long it)
+    {
+        size_t index = ((((i1*2 + ia)*3 + ii-i1+1)*2 + ib)*3 + I-ii+1)*3 + it;
+        if (! known[index])
+        {
+            values[index] = recoupling(i1, ia, ii, ib, I, it);
+            known[index] = true;
+        }
+        return values[index];
+    }
+};
+
+/* ISF for (p1,q1) x (1,1) -> (p,q), up to a factor which depends only on
+    the reps, via the intermediate rep (pi,qi) */
+static sqrat isf_11_unnormalised(long p, long q, long p1, long q1, long pi, long qi,
+                                    long k, long l, long k1, long l1, long kt, long lt,
+                                    recoupling_table& table)
+{
+    /* The patterns of the intermediate rep are shifted if the first box went
+        in the bottom row */
+    long shift = ((pi == p1) && (qi == q1-1)) ? 1 : 0;
+
+    radical_sum sum;
+    long ka, lb, ki, li, j;
+    for (ka = 0; ka <= 1; ++ka)
+        for (lb = 0; lb <= 1; ++lb)
+        {
+            sqrat f_adj = isf_01(1, 1, 1, 0, kt, lt, ka, 0, 1, lb);
+            if (f_adj == sqrat(0)) continue;
+
+            /* The first box goes in either position in the middle row of
+                the pattern, or (for (ka,la) = (0,0)) in neither */
+            for (j = (ka ? 0 : -1); j <= (ka ? 1 : -1); ++j)
+            {
+                ki = k1 + (j == 0) - shift;
+                li = l1 + (j == 1) - shift;
+
+                sqrat f1 = isf_10(pi, qi, p1, q1, ki, li, k1, l1, ka, 0);
+                if (f1 == sqrat(0)) continue;
+                sqrat f2 = isf_01(p, q, pi, qi, k, l, ki, li, 1, lb);
+                if (f2 == sqrat(0)) continue;
+
+                sum.add(f_adj * f1 * f2
+                        * table.get(k1-l1, ka, ki-li, 1-lb, k-l, kt-lt));
+            }
+        }
+
+    return sum.value();
+}
+
+/* Helper: Position of an ISF within the array, as in isoarray.cc. Here k2
+    is given relative to q2. */
+static size_t isf_index(long p, long q, long p1, long q1, long p2, long n,
+                        long k, long l, long k1, long l1, long k2)
+{
+    return ((((n*(p+1) + k-q)*(q+1) + l)*(p1+1) + k1-q1)*(q1+1) + l1)*(p2+1) + k2;
+}
+
+static isoarray* closed_form_10(long p, long q, long p1, long q1)
+{
+    size_t size = (p+1) * (q+1) * (p1+1) * (q1+1) * 2;
+    sqrat* isf_array = new sqrat[size]();
+
+    long k, l, k1, l1, k2, l2;
+    FOREACH_ISF(p, q, p1, q1, 1, 0, k, l, k1, l1, k2, l2)
+        isf_array[isf_index(p, q, p1, q1, 1, 0, k, l, k1, l1, k2)]
+            = isf_10(p, q, p1, q1, k, l, k1, l1, k2, l2);
+
+    return new isoarray(p, q, p1, q1, 1, 0, 1, isf_array);
+}
+
+static isoarray* closed_form_01(long p, long q, long p1, long q1)
+{
+    size_t size = (p+1) * (q+1) * (p1+1) * (q1+1);
+    sqrat* isf_array = new sqrat[size]();
+
+    long k, l, k1, l1, k2, l2;
+    FOREACH_ISF(p, q, p1, q1, 0, 1, k, l, k1, l1, k2, l2)
+        isf_array[isf_index(p, q, p1, q1, 0, 0, k, l, k1, l1, k2-1)]
+            = isf_01(p, q, p1, q1, k, l, k1, l1, k2, l2);
+
+    return new isoarray(p, q, p1, q1, 0, 1, 1, isf_array);
+}
+
+static isoarray* closed_form_11(long p, long q, long p1, long q1)
+{
+    /* Pick an intermediate rep which (1,0) and (0,1) can go through */
+    long intermediates[3][2] = {{p1+1, q1}, {p1-1, q1+1}, {p1, q1-1}};
+    long pi = -1, qi = -1;
+    int i;
+    for (i = 0; i < 3; ++i)
+    {
+        long a = intermediates[i][0], b = intermediates[i][1];
+        if ((a >= 0) && (b >= 0) && degeneracy(p, q, a, b, 0, 1))
+        {
+            pi = a;
+            qi = b;
+            break;
+        }
+    }
+    if (pi < 0) return NULL;
+
+    size_t size = (p+1) * (q+1) * (p1+1) * (q1+1) * 2;
+    sqrat* isf_array = new sqrat[size]();
+
+    recoupling_table table(p1+q1);
+    long k, l, k1, l1, k2, l2;
+    FOREACH_ISF(p, q, p1, q1, 1, 1, k, l, k1, l1, k2, l2)
+        isf_array[isf_index(p, q, p1, q1, 1, 0, k, l, k1, l1, k2-1)]
+            = isf_11_unnormalised(p, q, p1, q1, pi, qi, k, l, k1, l1, k2, l2, table);
+
+    /* Normalise using the couplings to the state of highest weight */
+    sqrat norm(0);
+    k = p+q;
+    l = 0;
+    for (k1 = q1; k1 <= p1+q1; ++k1)
+        for (l1 = 0; l1 <= q1; ++l1)
+            for (k2 = 1; k2 <= 2; ++k2)
+            {
+                sqrat v = isf_array[isf_index(p, q, p1, q1, 1, 0, k, l, k1, l1, k2-1)];
+                norm += v * v;
+            }
+
+    if (norm == sqrat(0))
+    {
+        delete[] isf_array;
+        throw std::logic_error("Closed-form ISFs vanish. "
+                                "Please report this as a bug in libSU3.");
+    }
+
+    norm = sqrt(norm);
+    if (norm != sqrat(1))
+    {
+        size_t j;
+        for (j = 0; j < size; ++j)
+            isf_array[j] /= norm;
+    }
+
+    isoarray* isf = new isoarray(p, q, p1, q1, 1, 1, 1, isf_array);
+    isf_symmetry::check_sign_convention<isoarray, sqrat>(*isf);
+    return isf;
+}
+
+/* Helper: The closed forms with the fundamental or adjoint rep second */
+static isoarray* closed_form(long p, long q, long p1, long q1, long p2, long q2,
+                                long d)
+{
+    if ((p2 == 1) && (q2 == 0))
+        return closed_form_10(p, q, p1, q1);
+    else if ((p2 == 0) && (q2 == 1))
+        return closed_form_01(p, q, p1, q1);
+    else if ((p2 == 1) && (q2 == 1) && (d == 1))
+        return closed_form_11(p, q, p1, q1);
+    else
+        return NULL;
+}
+
+isoarray* closed_form_isoscalars(long p, long q, long p1, long q1, long p2,
+                                    long q2, long d)
+{
+    if (! closed_form_enabled) return NULL;
+
+    isoarray* isf = closed_form(p, q, p1, q1, p2, q2, d);
+    if (isf) return isf;
+
+    /* With the reps the other way around, use the 1<->2 exchange */
+    isf = closed_form(p, q, p2, q2, p1, q1, d);
+    if (isf)
+    {
+        isoarray* new_isf = isf->exch_12();
+        delete isf;
+        return new_isf;
+    }
+
+    return NULL;
+}
@@ -14,133 +14,141 @@
 
 #include "SU3_internal.h"
 
-void isoscalar_context::a_coefficients(long k1, long l1, long k2, long l2,
-                                    sqrat& a1, sqrat& a2, sqrat& a3, sqrat& a4)
+template<typename T>
+template<typename I>
+void isoscalar_context<T>::a_coefficients_as(long k1, long l1, long k2, long l2,
+                                    T& a1, T& a2, T& a3, T& a4)
 {
-    long numerator, denominator;
+    I numerator, denominator;
     long s = k1 - l1 + k2 - l2; /* = 2(I_1 + I_2) */
     long t = k1 - l1 - k2 + l2; /* = 2(I_1 - I_2) */
 
     if (k1 == l1)
-        a1 = sqrat(0);
+        a1 = T(0);
     else
     {
-        numerator = 2 * (k1+1) * (k1-q1) * (p1+q1-k1+1) * (p+q+s+3) * (p+q+t+1);
-        denominator = (k1-l1) * (k1-l1+1);
-        a1 = sqrat(numerator, denominator);
+        numerator = I(2) * (k1+1) * (k1-q1) * (p1+q1-k1+1) * (p+q+s+3) * (p+q+t+1);
+        denominator = I(k1-l1) * (k1-l1+1);
+        a1 = coefficient_sqrt<T>(numerator, denominator);
     }
 
     if (k2 == l2)
     {
-        a2 = sqrat(0);
+        a2 = T(0);
     }
     else
     {
-        numerator = 2 * (k2+1) * (k2-q2) * (p2+q2-k2+1) * (p+q+s+3) * (p+q-t+1);
-        denominator = (k2-l2) * (k2-l2+1);
-        a2 = sqrat(numerator, denominator);
+        numerator = I(2) * (k2+1) * (k2-q2) * (p2+q2-k2+1) * (p+q+s+3) * (p+q-t+1);
+        denominator = I(k2-l2) * (k2-l2+1);
+        a2 = coefficient_sqrt<T>(numerator, denominator);
     }
 
-    numerator = -2 * l1 * (q1-l1+1) * (p1+q1-l1+2) * (-p-q+s+1) * (p+q-t+1);
-    denominator = (k1-l1+1) * (k1-l1+2);
-    a3 = sqrat(numerator, denominator);
+    numerator = -I(2) * l1 * (q1-l1+1) * (p1+q1-l1+2) * (-p-q+s+1) * (p+q-t+1);
+    denominator = I(k1-l1+1) * (k1-l1+2);
+    a3 = coefficient_sqrt<T>(numerator, denominator);
 
-    numerator = 2 * l2 * (q2-l2+1) * (p2+q2-l2+2) * (-p-q+s+1) * (p+q+t+1);
-    denominator = (k2-l2+1) * (k2-l2+2);
-    a4 = sqrat(numerator, denominator);
+    numerator = I(2) * l2 * (q2-l2+1) * (p2+q2-l2+2) * (-p-q+s+1) * (p+q+t+1);
+    denominator = I(k2-l2+1) * (k2-l2+2);
+    a4 = coefficient_sqrt<T>(numerator, denominator);
 }
 
-void isoscalar_context::b_coefficients(long k1, long l1, long k2, long l2,
-                                    sqrat& b1, sqrat& b2, sqrat& b3, sqrat& b4)
+template<typename T>
+template<typename I>
+void isoscalar_context<T>::b_coefficients_as(long k1, long l1, long k2, long l2,
+                                    T& b1, T& b2, T& b3, T& b4)
 {
-    long numerator, denominator;
+    I numerator, denominator;
     long s = k1 - l1 + k2 - l2; /* = 2(I_1 + I_2) */
     long t = k1 - l1 - k2 + l2; /* = 2(I_1 - I_2) */
 
-    numerator = 2 * (k1+2) * (k1-q1+1) * (p1+q1-k1) * (-p-q+s+1) * (p+q-t+1);
-    denominator = (k1-l1+1) * (k1-l1+2);
-    b1 = sqrat(numerator, denominator);
+    numerator = I(2) * (k1+2) * (k1-q1+1) * (p1+q1-k1) * (-p-q+s+1) * (p+q-t+1);
+    denominator = I(k1-l1+1) * (k1-l1+2);
+    b1 = coefficient_sqrt<T>(numerator, denominator);
 
-    numerator = -2 * (k2+2) * (k2-q2+1) * (p2+q2-k2) * (-p-q+s+1) * (p+q+t+1);
-    denominator = (k2-l2+1) * (k2-l2+2);
-    b2 = sqrat(numerator, denominator);
+    numerator = -I(2) * (k2+2) * (k2-q2+1) * (p2+q2-k2) * (-p-q+s+1) * (p+q+t+1);
+    denominator = I(k2-l2+1) * (k2-l2+2);
+    b2 = coefficient_sqrt<T>(numerator, denominator);
 
     if (k1 == l1)
-        b3 = sqrat(0);
+        b3 = T(0);
     else
     {
-        numerator = 2 * (l1+1) * (q1-l1) * (p1+q1-l1+1) * (p+q+s+3) * (p+q+t+1);
-        denominator = (k1-l1) * (k1-l1+1);
-        b3 = sqrat(numerator, denominator);
+        numerator = I(2) * (l1+1) * (q1-l1) * (p1+q1-l1+1) * (p+q+s+3) * (p+q+t+1);
+        denominator = I(k1-l1) * (k1-l1+1);
+        b3 = coefficient_sqrt<T>(numerator, denominator);
     }
 
     if (k2 == l2)
-        b4 = sqrat(0);
+        b4 = T(0);
     else
     {
-        numerator = 2 * (l2+1) * (q2-l2) * (p2+q2-l2+1) * (p+q+s+3) * (p+q-t+1);
-        denominator = (k2-l2) * (k2-l2+1);
-        b4 = sqrat(numerator, denominator);
+        numerator = I(2) * (l2+1) * (q2-l2) * (p2+q2-l2+1) * (p+q+s+3) * (p+q-t+1);
+        denominator = I(k2-l2) * (k2-l2+1);
+        b4 = coefficient_sqrt<T>(numerator, denominator);
     }
 }
 
-void isoscalar_context::c_coefficients(long k, long l, long k1, long l1,
-                    long k2, long l2, sqrat& alpha, sqrat& c1, sqrat& c2,
-                    sqrat& c3, sqrat& c4)
+template<typename T>
+template<typename I>
+void isoscalar_context<T>::c_coefficients_as(long k, long l, long k1, long l1,
+                    long k2, long l2, T& alpha, T& c1, T& c2,
+                    T& c3, T& c4)
 {
-    long numerator, denominator;
+    I numerator, denominator;
     long s = k1 - l1 + k2 - l2; /* = 2(I_1 + I_2) */
     long t = k1 - l1 - k2 + l2; /* = 2(I_1 - I_2) */
 
-    numerator = (k-l+2)*(k-l+2);
-    denominator = l*(q-l+1)*(p+q-l+2);
-    alpha = sqrat(numerator, denominator);
+    numerator = I(k-l+2)*(k-l+2);
+    denominator = I(l)*(q-l+1)*(p+q-l+2);
+    alpha = coefficient_sqrt<T>(numerator, denominator);
 
     if (k-l+t+2 == 0)
     {
-        c1 = sqrat(0);
-        c2 = sqrat(0);
-        c3 = sqrat(0);
+        c1 = T(0);
+        c2 = T(0);
+        c3 = T(0);
     }
     else
     {
-        numerator = (k+2)*(k-q+1)*(p+q-k)*(s-k+l)*(k-l-t+2);
-        denominator = (k-l+2)*(k-l+2)*(k-l+s+4)*(k-l+t+2);
-        c1 = sqrat(numerator, denominator);
+        numerator = I(k+2)*(k-q+1)*(p+q-k)*(s-k+l)*(k-l-t+2);
+        denominator = I(k-l+2)*(k-l+2)*(k-l+s+4)*(k-l+t+2);
+        c1 = coefficient_sqrt<T>(numerator, denominator);
 
-        numerator = 4*l1*(q1-l1+1)*(p1+q1-l1+2)*(k1-l1+1);
-        denominator = (k1-l1+2)*(k-l+s+4)*(k-l+t+2);
-        c2 = sqrat(numerator, denominator);
+        numerator = I(4)*l1*(q1-l1+1)*(p1+q1-l1+2)*(k1-l1+1);
+        denominator = I(k1-l1+2)*(k-l+s+4)*(k-l+t+2);
+        c2 = coefficient_sqrt<T>(numerator, denominator);
 
         /* If k2==l2, c3 is infinite or indeterminate. But in that case,
             it is the coefficient of a state with l2>k2, which is impossible
             (ie, there must be zero coupling). Thus we can just replace it by 0.
         */
         if (k2 == l2)
-            c3 = sqrat(0);
+            c3 = T(0);
         else
         {
-            numerator = -(k2+1)*(k2-q2)*(s-k+l)*(p2+q2-k2+1);
-            denominator = (k2-l2)*(k2-l2+1)*(k-l+t+2);
-            c3 = sqrat(numerator, denominator);
+            numerator = -I(k2+1)*(k2-q2)*(s-k+l)*(p2+q2-k2+1);
+            denominator = I(k2-l2)*(k2-l2+1)*(k-l+t+2);
+            c3 = coefficient_sqrt<T>(numerator, denominator);
         }
     }
 
-    numerator = l2*(q2-l2+1)*(p2+q2-l2+2)*(k-l-t+2);
-    denominator = (k2-l2+1)*(k2-l2+2)*(k-l+s+4);
-    c4 = sqrat(numerator, denominator);
+    numerator = I(l2)*(q2-l2+1)*(p2+q2-l2+2)*(k-l-t+2);
+    denominator = I(k2-l2+1)*(k2-l2+2)*(k-l+s+4);
+    c4 = coefficient_sqrt<T>(numerator, denominator);
 }
 
-void isoscalar_context::d_coefficients(long k, long k1, long l1,
-                long k2, long l2, sqrat& beta, sqrat& d1, sqrat& d2, sqrat& d3)
+template<typename T>
+template<typename I>
+void isoscalar_context<T>::d_coefficients_as(long k, long k1, long l1,
+                long k2, long l2, T& beta, T& d1, T& d2, T& d3)
 {
-    long numerator, denominator;
+    I numerator, denominator;
     long s = k1 - l1 + k2 - l2; /* = 2(I_1 + I_2) */
     long t = k1 - l1 - k2 + l2; /* = 2(I_1 - I_2) */
 
-    numerator = k+2;
-    denominator = (k-q+1)*(p+q-k);
-    beta = sqrat(numerator, denominator);
+    numerator = I(k+2);
+    denominator = I(k-q+1)*(p+q-k);
+    beta = coefficient_sqrt<T>(numerator, denominator);
 
     /* If k+t+2==0, then the state at which we are evaluating the recurrence
         relation is invalid (as it requires I=(I_2 - I_1) - 1, but in fact we
@@ -148,30 +156,102 @@ void isoscalar_context::d_coefficients(long k, long k1, long l1,
         Hence we need to replace some coefficients by zero */
     if (k+t+2 == 0)
     {
-        d1 = sqrat(0);
-        d3 = sqrat(0);
+        d1 = T(0);
+        d3 = T(0);
     }
     else
     {
-        numerator = 4*(k1+2)*(k1-q1+1)*(p1+q1-k1)*(k1-l1+1);
-        denominator = (k1-l1+2)*(k+s+4)*(k+t+2);
-        d1 = sqrat(numerator, denominator);
+        numerator = I(4)*(k1+2)*(k1-q1+1)*(p1+q1-k1)*(k1-l1+1);
+        denominator = I(k1-l1+2)*(k+s+4)*(k+t+2);
+        d1 = coefficient_sqrt<T>(numerator, denominator);
 
         /* If k2==l2, d3 is infinite or indeterminate. But in that case,
             it is the coefficient of a state with l2>k2, which is impossible
             (ie, there must be zero coupling). Thus we can just replace it by 0.
         */
         if (k2 == l2)
-            d3 = sqrat(0);
+            d3 = T(0);
         else
         {
-            numerator = (l2+1)*(q2-l2)*(p2+q2-l2+1)*(s-k);
-            denominator = (k2-l2)*(k2-l2+1)*(k+t+2);
-            d3 = sqrat(numerator, denominator);
+            numerator = I(l2+1)*(q2-l2)*(p2+q2-l2+1)*(s-k);
+            denominator = I(k2-l2)*(k2-l2+1)*(k+t+2);
+            d3 = coefficient_sqrt<T>(numerator, denominator);
         }
     }
 
-    numerator = (k2+2)*(k2-q2+1)*(p2+q2-k2)*(k-t+2);
-    denominator = (k2-l2+1)*(k2-l2+2)*(k+s+4);
-    d2 = sqrat(numerator, denominator);
+    numerator = I(k2+2)*(k2-q2+1)*(p2+q2-k2)*(k-t+2);
+    denominator = I(k2-l2+1)*(k2-l2+2)*(k+s+4);
+    d2 = coefficient_sqrt<T>(numerator, denominator);
 }
+
+/* Evaluate the coefficients with the narrowest integer type which can't
+    overflow for this coupling (see choose_coefficient_width()). For all but
+    very large reps, this is just long. */
+template<typename T>
+void isoscalar_context<T>::a_coefficients(long k1, long l1, long k2, long l2,
+                                    T& a1, T& a2, T& a3, T& a4)
+{
+    if (width == COEFFICIENT_LONG)
+        a_coefficients_as<long>(k1, l1, k2, l2, a1, a2, a3, a4);
+    else if (width == COEFFICIENT_INT128)
+        a_coefficients_as<__int128>(k1, l1, k2, l2, a1, a2, a3, a4);
+    else
+        a_coefficients_as<mpz_class>(k1, l1, k2, l2, a1, a2, a3, a4);
+}
+
+template<typename T>
+void isoscalar_context<T>::b_coefficients(long k1, long l1, long k2, long l2,
+                                    T& b1, T& b2, T& b3, T& b4)
+{
+    if (width == COEFFICIENT_LONG)
+        b_coefficients_as<long>(k1, l1, k2, l2, b1, b2, b3, b4);
+    else if (width == COEFFICIENT_INT128)
+        b_coefficients_as<__int128>(k1, l1, k2, l2, b1, b2, b3, b4);
+    else
+        b_coefficients_as<mpz_class>(k1, l1, k2, l2, b1, b2, b3, b4);
+}
+
+template<typename T>
+void isoscalar_context<T>::c_coefficients(long k, long l, long k1, long l1,
+                    long k2, long l2, T& alpha, T& c1, T& c2,
+                    T& c3, T& c4)
+{
+    if (width == COEFFICIENT_LONG)
+        c_coefficients_as<long>(k, l, k1, l1, k2, l2, alpha, c1, c2, c3, c4);
+    else if (width == COEFFICIENT_INT128)
+        c_coefficients_as<__int128>(k, l, k1, l1, k2, l2, alpha, c1, c2, c3, c4);
+    else
+        c_coefficients_as<mpz_class>(k, l, k1, l1, k2, l2, alpha, c1, c2, c3, c4);
+}
+
+template<typename T>
+void isoscalar_context<T>::d_coefficients(long k, long k1, long l1,
+                long k2, long l2, T& beta, T& d1, T& d2, T& d3)
+{
+    if (width == COEFFICIENT_LONG)
+        d_coefficients_as<long>(k, k1, l1, k2, l2, beta, d1, d2, d3);
+    else if (width == COEFFICIENT_INT128)
+        d_coefficients_as<__int128>(k, k1, l1, k2, l2, beta, d1, d2, d3);
+    else
+        d_coefficients_as<mpz_class>(k, k1, l1, k2, l2, beta, d1, d2, d3);
+}
+
+/* Instantiate the functions defined here for each type of value they are
+    used with. The class itself is instantiated in isoscalars.cc. */
+#define INSTANTIATE_COEFFICIENTS(T) \
+    template void isoscalar_context<T>::a_coefficients(long, long, long, long, \
+                                                        T&, T&, T&, T&); \
+    template void isoscalar_context<T>::b_coefficients(long, long, long, long, \
+                                                        T&, T&, T&, T&); \
+    template void isoscalar_context<T>::c_coefficients(long, long, long, long, \
+                                        long, long, T&, T&, T&, T&, T&); \
+    template void isoscalar_context<T>::d_coefficients(long, long, long, long, \
+                                        long, T&, T&, T&, T&);
+
+INSTANTIATE_COEFFICIENTS(sqrat)
+INSTANTIATE_COEFFICIENTS(double)
+INSTANTIATE_COEFFICIENTS(long double)
+INSTANTIATE_COEFFICIENTS(modular_value)
+#ifdef SU3_USE_MPFR
+INSTANTIATE_COEFFICIENTS(mpfr_value)
+#endif
@@ -0,0 +1,114 @@
+/* libSU3: Full Clebsch-Gordan decomposition of a product of two irreps */
+
+#include <vector>
+
+#include "SU3_internal.h"
+
+/* Note: This type takes ownership of the array passed in, and of each
+    isoarray in it */
+decomposition::decomposition(long p1, long q1, long p2, long q2, long count,
+    isoarray** isfs) : count(count), isfs(isfs), p1(p1), q1(q1), p2(p2), q2(q2)
+{}
+
+decomposition::~decomposition()
+{
+    long i;
+    for (i = 0; i < count; ++i)
+        delete isfs[i];
+    delete[] isfs;
+}
+
+long decomposition::size() const
+{
+    return count;
+}
+
+isoarray* decomposition::operator[](long i) const
+{
+    if ((i < 0) || (i >= count))
+        return NULL;
+    return isfs[i];
+}
+
+/* Calculate the isoscalar factors for every irrep in (p1,q1) x (p2,q2) */
+decomposition* decompose(long p1, long q1, long p2, long q2, long nthreads)
+{
+    /* Crude bounds on which reps can appear */
+    long upper = p1+q1+p2+q2;
+    long p, q, d;
+
+    std::vector<long> ps, qs, ds;
+    for (p = 0; p <= upper; ++p)
+        for (q = 0; q <= upper-p; ++q)
+        {
+            d = degeneracy(p, q, p1, q1, p2, q2);
+            if (d == 0) continue;
+
+            ps.push_back(p);
+            qs.push_back(q);
+            ds.push_back(d);
+        }
+
+    long count = ps.size();
+    isoarray** isfs = new isoarray*[count];
+    long i;
+    for (i = 0; i < count; ++i)
+        isfs[i] = NULL;
+
+    /* If both factors are self-conjugate, or they are conjugates of each
+        other, then (q,p) appears whenever (p,q) does, and its ISFs can be
+        found by conjugating those for (p,q) (followed by exch_12 in the
+        second case). So only one of each such pair is calculated. */
+    bool self_conj = (p1 == q1) && (p2 == q2);
+    bool swapped_conj = (p1 == q2) && (q1 == p2);
+    std::vector<long> source(count, -1);
+    long j;
+    if (self_conj || swapped_conj)
+        for (i = 0; i < count; ++i)
+            for (j = 0; (j < count) && (qs[i] < ps[i]); ++j)
+                if ((ps[j] == qs[i]) && (qs[j] == ps[i]))
+                {
+                    source[i] = j;
+                    break;
+                }
+
+    /* Queue up one task per irrep which needs calculating */
+    work_pool pool(nthreads);
+    for (i = 0; i < count; ++i)
+    {
+        if (source[i] >= 0) continue;
+
+        double cost = isoscalars_cost(ps[i], qs[i], p1, q1, p2, q2, ds[i]);
+        pool.add([&ps, &qs, isfs, i, p1, q1, p2, q2]()
+            {
+                isfs[i] = isoscalars(ps[i], qs[i], p1, q1, p2, q2);
+            }, cost);
+    }
+
+    try
+    {
+        pool.run();
+
+        for (i = 0; i < count; ++i)
+        {
+            if (source[i] < 0) continue;
+
+            isfs[i] = isfs[source[i]]->conj();
+            if (! self_conj)
+            {
+                isoarray* swapped = isfs[i]->exch_12();
+                delete isfs[i];
+                isfs[i] = swapped;
+            }
+        }
+    }
+    catch (...)
+    {
+        for (i = 0; i < count; ++i)
+            delete isfs[i];
+        delete[] isfs;
+        throw;
+    }
+
+    return new decomposition(p1, q1, p2, q2, count, isfs);
+}
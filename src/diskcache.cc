@@ -0,0 +1,253 @@
+/* libSU3: Persistent on-disk cache of isoscalar factors.
+
+    Each cached coupling lives in its own file, named after the canonical
+    representative of the coupling (see symmetry.cc) and its degeneracy.
+    The file contents are as produced by isf_io::encode().
+
+    New files are written under a temporary name and then renamed into
+    place, so other processes only ever see complete files. Two processes
+    may occasionally calculate the same coupling at the same time; in that
+    case both write identical files, and whichever rename happens last wins.
+
+    Reading a file updates its modification time, so that the size limit can
+    be enforced by deleting the least recently used files first.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "SU3_internal.h"
+
+#define SUFFIX ".isf"
+
+/* Configuration, set by set_isf_disk_cache() */
+static std::mutex config_lock;
+static std::string cache_dir;
+static size_t cache_max_bytes;
+static std::atomic<bool> cache_enabled(false);
+
+/* Counter to make temporary file names unique within this process */
+static std::atomic<unsigned long> tmp_counter(0);
+
+void set_isf_disk_cache(const char* dir, size_t max_bytes)
+{
+    std::lock_guard<std::mutex> guard(config_lock);
+
+    if (dir)
+    {
+        cache_dir = dir;
+        cache_max_bytes = max_bytes;
+        mkdir(dir, 0777); // Fine if it already exists
+        cache_enabled = true;
+    }
+    else
+    {
+        cache_enabled = false;
+        cache_dir.clear();
+    }
+}
+
+bool disk_cache_enabled()
+{
+    return cache_enabled;
+}
+
+/* Helper: Get a consistent copy of the configuration.
+    Returns false if the cache is disabled. */
+static bool get_config(std::string& dir, size_t& max_bytes)
+{
+    std::lock_guard<std::mutex> guard(config_lock);
+    if (! cache_enabled) return false;
+
+    dir = cache_dir;
+    max_bytes = cache_max_bytes;
+    return true;
+}
+
+static std::string file_name(const std::string& dir, const coupling& c, long d)
+{
+    char buf[128];
+    snprintf(buf, sizeof(buf), "/%ld_%ld_%ld_%ld_%ld_%ld_%ld" SUFFIX,
+                c.p, c.q, c.p1, c.q1, c.p2, c.q2, d);
+    return dir + buf;
+}
+
+/* Helper: Read a whole file. Returns false if it can't be read. */
+static bool read_file(const std::string& path, std::string& contents)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    char buf[65536];
+    ssize_t len;
+    contents.clear();
+    while ((len = read(fd, buf, sizeof(buf))) != 0)
+    {
+        if (len < 0)
+        {
+            if (errno == EINTR) continue;
+            close(fd);
+            return false;
+        }
+        contents.append(buf, len);
+    }
+
+    close(fd);
+    return true;
+}
+
+/* Helper: Write a file atomically, by writing to a temporary file
+    in the same directory and renaming it into place */
+static bool write_file(const std::string& dir, const std::string& path,
+                        const std::string& contents)
+{
+    char buf[128];
+    snprintf(buf, sizeof(buf), "/.tmp.%ld.%lu.%lu", (long)getpid(),
+                (unsigned long)std::hash<std::thread::id>()(std::this_thread::get_id()),
+                tmp_counter.fetch_add(1));
+    std::string tmp_path = dir + buf;
+
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if (fd < 0) return false;
+
+    size_t done = 0;
+    while (done < contents.size())
+    {
+        ssize_t len = write(fd, contents.data() + done, contents.size() - done);
+        if (len < 0)
+        {
+            if (errno == EINTR) continue;
+            close(fd);
+            unlink(tmp_path.c_str());
+            return false;
+        }
+        done += len;
+    }
+
+    if ((fsync(fd) != 0) || (close(fd) != 0)
+        || (rename(tmp_path.c_str(), path.c_str()) != 0))
+    {
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+/* Helper: Delete the least recently used files until the directory
+    fits within the size limit. The file at 'keep' has just been written,
+    so is the most recently used one, even if file timestamps are too coarse
+    to tell. */
+static void enforce_limit(const std::string& dir, size_t max_bytes,
+                            const std::string& keep)
+{
+    DIR* dp = opendir(dir.c_str());
+    if (! dp) return;
+
+    struct file_info
+    {
+        std::string path;
+        struct timespec mtime;
+        size_t size;
+    };
+
+    std::vector<file_info> files;
+    size_t total = 0;
+    struct dirent* entry;
+    size_t suffix_len = strlen(SUFFIX);
+
+    while ((entry = readdir(dp)))
+    {
+        size_t len = strlen(entry->d_name);
+        if ((len <= suffix_len) || strcmp(entry->d_name + len - suffix_len, SUFFIX))
+            continue;
+
+        file_info info;
+        struct stat st;
+        info.path = dir + "/" + entry->d_name;
+        if (stat(info.path.c_str(), &st) != 0) continue;
+
+        info.mtime = st.st_mtim;
+        info.size = st.st_size;
+        total += info.size;
+        files.push_back(info);
+    }
+    closedir(dp);
+
+    if (total <= max_bytes) return;
+
+    std::sort(files.begin(), files.end(),
+        [](const file_info& a, const file_info& b)
+        {
+            if (a.mtime.tv_sec != b.mtime.tv_sec)
+                return a.mtime.tv_sec < b.mtime.tv_sec;
+            return a.mtime.tv_nsec < b.mtime.tv_nsec;
+        });
+
+    size_t i;
+    for (i = 0; (i < files.size()) && (total > max_bytes); ++i)
+        if ((files[i].path != keep) && (unlink(files[i].path.c_str()) == 0))
+            total -= files[i].size;
+}
+
+/* Look up a coupling in the cache. Returns NULL if it is not present. */
+isoarray* disk_cache_load(const coupling& c, long d)
+{
+    std::string dir;
+    size_t max_bytes;
+    if (! get_config(dir, max_bytes)) return NULL;
+
+    std::string path = file_name(dir, c, d);
+    std::string contents;
+    if (! read_file(path, contents)) return NULL;
+
+    isoarray* isf = isf_io::decode((const unsigned char*)contents.data(),
+                                    contents.size());
+
+    /* Check that we got the file we asked for, as well as a valid one */
+    if (isf && ((isf->p != c.p) || (isf->q != c.q) || (isf->p1 != c.p1)
+        || (isf->q1 != c.q1) || (isf->p2 != c.p2) || (isf->q2 != c.q2)))
+    {
+        delete isf;
+        isf = NULL;
+    }
+
+    if (! isf)
+    {
+        /* Corrupt, or from an incompatible version; it will be replaced */
+        unlink(path.c_str());
+        return NULL;
+    }
+
+    /* Mark the file as recently used */
+    utimes(path.c_str(), NULL);
+    return isf;
+}
+
+void disk_cache_store(const isoarray& isf)
+{
+    std::string dir;
+    size_t max_bytes;
+    if (! get_config(dir, max_bytes)) return;
+
+    coupling c = {isf.p, isf.q, isf.p1, isf.q1, isf.p2, isf.q2};
+    std::string contents = isf_io::encode(isf);
+
+    /* Failing to write to the cache is not an error; we just won't be able
+        to use it next time */
+    std::string path = file_name(dir, c, isf.d);
+    if (contents.size() > max_bytes) return;
+    if (! write_file(dir, path, contents)) return;
+
+    enforce_limit(dir, max_bytes, path);
+}
@@ -24,8 +24,24 @@
 /* Note: This type takes ownership of the array passed in - that is, it will
     delete the array when the isoarray object is deleted. */
 isoarray::isoarray(long p, long q, long p1, long q1, long p2, long q2, long d,
-    sqrat* isf_array) : isf_array(isf_array), p(p), q(q), p1(p1), q1(q1),
-    p2(p2), q2(q2), d(d)
+    sqrat* isf_array) : isf_array(isf_array), mapping(NULL), lazy(NULL),
+    p(p), q(q), p1(p1), q1(q1), p2(p2), q2(q2), d(d)
+{
+    size = d * (p+1) * (q+1) * (p1+1) * (q1+1) * (p2+1);
+}
+
+/* As above, but taking ownership of a mapped file (see mapped.cc) */
+isoarray::isoarray(long p, long q, long p1, long q1, long p2, long q2, long d,
+    isf_mapping* mapping) : isf_array(NULL), mapping(mapping), lazy(NULL),
+    p(p), q(q), p1(p1), q1(q1), p2(p2), q2(q2), d(d)
+{
+    size = d * (p+1) * (q+1) * (p1+1) * (q1+1) * (p2+1);
+}
+
+/* As above, but taking ownership of a lazy calculation (see lazy.cc) */
+isoarray::isoarray(long p, long q, long p1, long q1, long p2, long q2, long d,
+    isf_lazy* lazy) : isf_array(NULL), mapping(NULL), lazy(lazy),
+    p(p), q(q), p1(p1), q1(q1), p2(p2), q2(q2), d(d)
 {
     size = d * (p+1) * (q+1) * (p1+1) * (q1+1) * (p2+1);
 }
@@ -33,6 +49,18 @@ isoarray::isoarray(long p, long q, long p1, long q1, long p2, long q2, long d,
 isoarray::~isoarray()
 {
     delete[] isf_array;
+    delete mapping;
+    delete lazy;
+}
+
+sqrat isoarray::value(size_t index) const
+{
+    assert(index < size);
+    if (mapping)
+        return mapping->get(index);
+    if (lazy)
+        return lazy->get(index);
+    return isf_array[index];
 }
 
 void isoarray::set_isf(long n, long k, long l, long k1, long l1,
@@ -57,13 +85,14 @@ void isoarray::set_isf(long n, long k, long l, long k1, long l1,
     size_t index = ((((n * (p+1) + k-q) * (q+1) + l) * (p1+1) + k1-q1)
                     * (q1+1) + l1) * (p2+1) + k2-q2;
     assert(index < size);
+    assert(! mapping && ! lazy);
     isf_array[index] = v;
 }
 
 /* We use operator() instead of operator[] as an easy way to use
     multiple indices */
 sqrat isoarray::operator()(long n, long k, long l, long k1, long l1,
-                            long k2, long l2)
+                            long k2, long l2) const
 {
     /* Bounds checks - as this is a user-visible function, we don't want
         to crash if an invalid value is passed, just to return zero.
@@ -80,24 +109,114 @@ sqrat isoarray::operator()(long n, long k, long l, long k1, long l1,
 
     size_t index = ((((n * (p+1) + k-q) * (q+1) + l) * (p1+1) + k1-q1)
                     * (q1+1) + l1) * (p2+1) + k2-q2;
-    assert(index < size);
-    return isf_array[index];
+    return value(index);
 }
 
 /* Convert to Clebsch-Gordans. This returns a newly-allocated cgarray object. */
-cgarray* isoarray::to_cgarray()
+cgarray* isoarray::to_cgarray() const
+{
+    return new cgarray(this->copy());
+}
+
+/* Returns a newly-allocated copy of this object */
+isoarray* isoarray::copy() const
 {
-    /* Create a new coefficient array, to be owned by the cgarray we will
-        end up returning */
     sqrat* new_isf_array = new sqrat[size];
 
     /* Explicitly copy each element of the array */
     size_t i;
     for (i = 0; i < size; ++i)
-        new_isf_array[i] = isf_array[i];
+        new_isf_array[i] = value(i);
 
-    isoarray* isf = new isoarray(p, q, p1, q1, p2, q2, d, new_isf_array);
-    return new cgarray(isf);
+    return new isoarray(p, q, p1, q1, p2, q2, d, new_isf_array);
+}
+
+/* Approximate number of bytes of memory used by this object */
+size_t isoarray::memory_usage() const
+{
+    size_t total = sizeof(isoarray);
+    if (mapping)
+        return total + sizeof(isf_mapping);
+    if (lazy)
+        return total + lazy->memory_usage();
+
+    size_t i;
+    for (i = 0; i < size; ++i)
+        total += isf_array[i].memory_usage();
+    return total;
+}
+
+isf_cursor::isf_cursor(const isoarray& isf) : isf(isf), values(NULL),
+    buffer(NULL), row_size((isf.q1+1) * (isf.p2+1)), start(0), cur_n(0),
+    cur_k(isf.q), cur_l(0), cur_k1(isf.q1)
+{
+    if (! isf.isf_array)
+        buffer = new sqrat[row_size];
+    load();
+}
+
+isf_cursor::~isf_cursor()
+{
+    delete[] buffer;
+}
+
+/* Point at the row starting at 'start', copying it first if need be */
+void isf_cursor::load()
+{
+    long p = isf.p, q = isf.q, p1 = isf.p1, q1 = isf.q1, p2 = isf.p2, q2 = isf.q2;
+    l2_offset = (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3 + cur_k + cur_l - cur_k1;
+
+    if (! buffer)
+    {
+        values = isf.isf_array + start;
+        return;
+    }
+
+    size_t i;
+    for (i = 0; i < row_size; ++i)
+        buffer[i] = isf.value(start + i);
+    values = buffer;
+}
+
+bool isf_cursor::seek(long n, long k, long l, long k1)
+{
+    long p = isf.p, q = isf.q, p1 = isf.p1, q1 = isf.q1;
+    if (    (n  < 0 ) || (n  >= isf.d )
+         || (k  < q ) || (k  > p +q  ) || (l  < 0) || (l  > q )
+         || (k1 < q1) || (k1 > p1+q1 ))
+        return false;
+
+    cur_n = n;
+    cur_k = k;
+    cur_l = l;
+    cur_k1 = k1;
+    start = (((n * (p+1) + k-q) * (q+1) + l) * (p1+1) + k1-q1) * row_size;
+    load();
+    return true;
+}
+
+bool isf_cursor::next()
+{
+    if (start + row_size >= isf.size)
+        return false;
+
+    if (++cur_k1 > isf.p1 + isf.q1)
+    {
+        cur_k1 = isf.q1;
+        if (++cur_l > isf.q)
+        {
+            cur_l = 0;
+            if (++cur_k > isf.p + isf.q)
+            {
+                cur_k = isf.q;
+                ++cur_n;
+            }
+        }
+    }
+
+    start += row_size;
+    load();
+    return true;
 }
 
 /* Internal: Check that the sign convention is obeyed.
@@ -105,28 +224,33 @@ cgarray* isoarray::to_cgarray()
     is consistent between degenerate irreps, we just might have an overall
     - sign on everything.
 */
-void isoarray::check_sign_convention()
+template<typename Array, typename T>
+void isf_symmetry::check_sign_convention(Array& array)
 {
+    long p = array.p, q = array.q, p1 = array.p1, q1 = array.q1,
+        p2 = array.p2, q2 = array.q2, d = array.d;
     long B = (-p1 + 2*p2 + q1 + 4*q2 + p - q)/3;
     long k2max = min(p2+q2, B);
     long l2min = max(0, B - p2 - q2);
 
-    while ((*this)(0, p+q, 0, p1+q1, 0, k2max, l2min) == 0)
+    /* The ISFs are normalised, so 1 is the right scale for deciding which
+        values are zero */
+    while (negligible(array(0, p+q, 0, p1+q1, 0, k2max, l2min), T(1)))
     {
         k2max -= 1;
         l2min += 1;
     }
 
     /* Check the sign */
-    if ((*this)(0, p+q, 0, p1+q1, 0, k2max, l2min) < 0)
+    if (array(0, p+q, 0, p1+q1, 0, k2max, l2min) < 0)
     {
         /* If the sign is wrong, enforce the convention */
         long n, k, l, k1, l1, k2, l2;
         for (n = 0; n < d; ++n)
             FOREACH_ISF(p, q, p1, q1, p2, q2, k, l, k1, l1, k2, l2)
             {
-                this->set_isf(n, k, l, k1, l1, k2, l2,
-                    -(*this)(n, k, l, k1, l1, k2, l2));
+                array.set_isf(n, k, l, k1, l1, k2, l2,
+                    -array(n, k, l, k1, l1, k2, l2));
             }
     }
 }
@@ -134,11 +258,14 @@ void isoarray::check_sign_convention()
 /* Apply the various symmetry relations.
     The formulas for these relations are adapted from Williams.
 */
-isoarray* isoarray::exch_12()
+template<typename Array, typename T>
+Array* isf_symmetry::exch_12(const Array& src)
 {
+    long p = src.p, q = src.q, p1 = src.p1, q1 = src.q1,
+        p2 = src.p2, q2 = src.q2, d = src.d;
     size_t new_size = d * (p+1) * (q+1) * (p2+1) * (q2+1) * (p1+1);
-    sqrat* new_isf_array = new sqrat[new_size];
-    isoarray* array = new isoarray(p, q, p2, q2, p1, q1, d, new_isf_array);
+    T* new_isf_array = new T[new_size]();
+    Array* array = new Array(p, q, p2, q2, p1, q1, d, new_isf_array);
 
     /* Fill the new array */
     long xi_1 = phase_exch_12(p, q, p1, q1, p2, q2);
@@ -148,36 +275,125 @@ isoarray* isoarray::exch_12()
         FOREACH_ISF(p, q, p2, q2, p1, q1, k, l, k2, l2, k1, l1)
             array->set_isf(n, k, l, k2, l2, k1, l1,
                 SIGN((k-l-k1+l1-k2+l2)/2) * SIGN(n) * xi_1
-                * (*this)(n, k, l, k1, l1, k2, l2));
+                * src(n, k, l, k1, l1, k2, l2));
 
-    array->check_sign_convention();
+    check_sign_convention<Array, T>(*array);
 
     return array;
 }
 
-isoarray* isoarray::exch_13bar()
+/* Helper for exch_13bar: sqrt(dim(a) (i+1) / (dim(b) (j+1))), without the
+    factors of 1/2 in the dimensions, evaluated in a wide enough type */
+template<typename T, typename I>
+static T dimension_ratio_sqrt_as(long pa, long qa, long i, long pb, long qb, long j)
+{
+    I num = I(pa+1) * (qa+1) * (pa+qa+2) * (i+1);
+    I den = I(pb+1) * (qb+1) * (pb+qb+2) * (j+1);
+    return coefficient_sqrt<T>(num, den);
+}
+
+template<typename T>
+static T dimension_ratio_sqrt(coefficient_width width, long pa, long qa, long i,
+                                long pb, long qb, long j)
 {
+    if (width == COEFFICIENT_LONG)
+        return dimension_ratio_sqrt_as<T, long>(pa, qa, i, pb, qb, j);
+    else if (width == COEFFICIENT_INT128)
+        return dimension_ratio_sqrt_as<T, __int128>(pa, qa, i, pb, qb, j);
+    else
+        return dimension_ratio_sqrt_as<T, mpz_class>(pa, qa, i, pb, qb, j);
+}
+
+template<typename Array, typename T>
+Array* isf_symmetry::exch_13bar(const Array& src)
+{
+    long p = src.p, q = src.q, p1 = src.p1, q1 = src.q1,
+        p2 = src.p2, q2 = src.q2, d = src.d;
+
     /* For this symmetry, the array size is unchanged */
-    sqrat* new_isf_array = new sqrat[size];
-    isoarray* array = new isoarray(q1, p1, q, p, p2, q2, d, new_isf_array);
+    T* new_isf_array = new T[src.size]();
+    Array* array = new Array(q1, p1, q, p, p2, q2, d, new_isf_array);
 
     /* Fill the new array */
+    coefficient_width width = choose_coefficient_width(p, q, p1, q1, p2, q2);
     long n, k, l, k1, l1, k2, l2;
 
     for (n = 0; n < d; ++n)
         FOREACH_ISF(p, q, p1, q1, p2, q2, k, l, k1, l1, k2, l2)
             array->set_isf(n, p1+q1-l1, p1+q1-k1, p+q-l, p+q-k, k2, l2,
                     SIGN(l2+n)
-                  * sqrat((p1+1)*(q1+1)*(p1+q1+2)*(k-l+1), (p+1)*(q+1)*(p+q+2)*(k1-l1+1))
-                  * (*this)(n, k, l, k1, l1, k2, l2));
+                  * dimension_ratio_sqrt<T>(width, p1, q1, k-l, p, q, k1-l1)
+                  * src(n, k, l, k1, l1, k2, l2));
+
+    check_sign_convention<Array, T>(*array);
+
+    return array;
+}
+
+/* Conjugation maps the state (k, l) of (p,q) to (p+q-l, p+q-k) of (q,p),
+    and similarly for the factor reps. Each degenerate rep maps to the same
+    rep of the conjugate coupling. */
+template<typename Array, typename T>
+Array* isf_symmetry::conj(const Array& src)
+{
+    long p = src.p, q = src.q, p1 = src.p1, q1 = src.q1,
+        p2 = src.p2, q2 = src.q2, d = src.d;
+    size_t new_size = d * (q+1) * (p+1) * (q1+1) * (p1+1) * (q2+1);
+    T* new_isf_array = new T[new_size]();
+    Array* array = new Array(q, p, q1, p1, q2, p2, d, new_isf_array);
 
-    array->check_sign_convention();
+    /* Fill the new array */
+    long xi_3 = phase_conj(p, q, p1, q1, p2, q2);
+    long n, k, l, k1, l1, k2, l2;
+
+    for (n = 0; n < d; ++n)
+        FOREACH_ISF(p, q, p1, q1, p2, q2, k, l, k1, l1, k2, l2)
+            array->set_isf(n, p+q-l, p+q-k, p1+q1-l1, p1+q1-k1, p2+q2-l2, p2+q2-k2,
+                SIGN(l+l1+l2) * SIGN(n) * xi_3
+                * src(n, k, l, k1, l1, k2, l2));
+
+    check_sign_convention<Array, T>(*array);
 
     return array;
 }
 
+template void isf_symmetry::check_sign_convention<isoarray, sqrat>(isoarray&);
+template isoarray* isf_symmetry::exch_12<isoarray, sqrat>(const isoarray&);
+template isoarray* isf_symmetry::exch_13bar<isoarray, sqrat>(const isoarray&);
+template isoarray* isf_symmetry::conj<isoarray, sqrat>(const isoarray&);
+
+template void isf_symmetry::check_sign_convention<isoarray_double, double>(isoarray_double&);
+template isoarray_double* isf_symmetry::exch_12<isoarray_double, double>(const isoarray_double&);
+template isoarray_double* isf_symmetry::exch_13bar<isoarray_double, double>(const isoarray_double&);
+
+#ifdef SU3_USE_MPFR
+template void isf_symmetry::check_sign_convention<isoarray_mpfr, mpfr_value>(isoarray_mpfr&);
+template isoarray_mpfr* isf_symmetry::exch_12<isoarray_mpfr, mpfr_value>(const isoarray_mpfr&);
+template isoarray_mpfr* isf_symmetry::exch_13bar<isoarray_mpfr, mpfr_value>(const isoarray_mpfr&);
+#endif
+
+void isoarray::check_sign_convention()
+{
+    isf_symmetry::check_sign_convention<isoarray, sqrat>(*this);
+}
+
+isoarray* isoarray::exch_12() const
+{
+    return isf_symmetry::exch_12<isoarray, sqrat>(*this);
+}
+
+isoarray* isoarray::exch_13bar() const
+{
+    return isf_symmetry::exch_13bar<isoarray, sqrat>(*this);
+}
+
+isoarray* isoarray::conj() const
+{
+    return isf_symmetry::conj<isoarray, sqrat>(*this);
+}
+
 /* Combination of the above two, for simplicity */
-isoarray* isoarray::exch_23bar()
+isoarray* isoarray::exch_23bar() const
 {
     isoarray* tmp1 = this->exch_12();
     isoarray* tmp2 = tmp1->exch_13bar();
@@ -5,15 +5,106 @@
 #include <stdio.h>
 #include <assert.h>
 #include <stdexcept>
+#include <algorithm>
+#include <atomic>
 
 #include "SU3_internal.h"
 
-isoscalar_context::isoscalar_context(long p, long q, long p1,
-            long q1, long p2, long q2, long d, sqrat* coefficients)
+static std::atomic<int> layout(ISF_LAYOUT_STANDARD);
+
+void set_isf_layout(isf_layout new_layout)
+{
+    layout = new_layout;
+}
+
+isf_layout get_isf_layout()
+{
+    return (isf_layout)layout.load();
+}
+
+template<typename T>
+isoscalar_context<T>::isoscalar_context(long p, long q, long p1,
+            long q1, long p2, long q2, long d, T* coefficients,
+            const isf_row_handler<T>* on_row)
             : p(p), q(q), p1(p1), q1(q1), p2(p2), q2(q2), d(d),
-            coefficients(coefficients)
+            coefficients(coefficients), on_row(on_row), checkpoint(NULL),
+            only_rep(-1), shw_norm(0), shw_norm_valid(d == 1), stencil(false)
 {
     A = (2*p1 + 2*p2 + 4*q1 + 4*q2 + p - q)/3;
+    width = choose_coefficient_width(p, q, p1, q1, p2, q2);
+}
+
+/* Position of a value in the coefficient array. With a row handler, the
+    couplings to the state of highest weight (k=p+q, l=0) are kept for every
+    rep, since calc_shw() and the first row of each rep need them. Otherwise,
+    the recursions only ever read rows k and k+1, so we keep two rows and
+    alternate between them.
+    When only one rep is being filled out, it goes first, laid out as if it
+    were rep 0, and only the couplings to the state of highest weight are
+    kept for the others.
+    With the stencil layout, the reps are interleaved. The couplings to the
+    state of highest weight come first, plane by plane (each plane has
+    constant k1+k2), so that the A and B recursions read from the same plane
+    or the one above; the other couplings follow, row by row in (k,l), so
+    that the C and D recursions read from the same row or the one before. */
+template<typename T>
+size_t isoscalar_context<T>::index(long n, long k, long l, long k1, long l1,
+                                    long k2)
+{
+    size_t state = ((k1-q1) * (q1+1) + l1) * (p2+1) + k2-q2;
+    size_t row_size = (p1+1) * (q1+1) * (p2+1);
+
+    if (stencil)
+    {
+        if ((k == p+q) && (l == 0))
+            return (((k1+k2 - q1-q2) * (p1+1) + k1-q1) * (q1+1) + l1) * d + n;
+
+        size_t shw_size = (p1+p2+1) * (p1+1) * (q1+1) * d;
+        return shw_size + ((((k-q) * (q+1) + l) * row_size) + state) * d + n;
+    }
+
+    if (only_rep >= 0)
+    {
+        if (n == only_rep)
+            return (((k-q) * (q+1) + l) * row_size) + state;
+
+        assert((k == p+q) && (l == 0));
+        return ((p+1) * (q+1) + n - (n > only_rep)) * row_size + state;
+    }
+
+    if (! on_row)
+        return (((n * (p+1) + k-q) * (q+1) + l) * row_size) + state;
+
+    if ((k == p+q) && (l == 0))
+        return n * row_size + state;
+
+    return (d + ((k-q) % 2) * (q+1) + l) * row_size + state;
+}
+
+template<typename T>
+size_t isoscalar_context<T>::stencil_size()
+{
+    return ((p1+p2+1) * (p1+1) * (q1+1)
+            + (p+1) * (q+1) * (p1+1) * (q1+1) * (p2+1)) * d;
+}
+
+template<typename T>
+void isoscalar_context<T>::copy_out(T* out)
+{
+    T* pos = out;
+    long n, k, l, k1, l1, k2, l2;
+    for (n = 0; n < d; ++n)
+        for (k = q; k <= p+q; ++k)
+            for (l = 0; l <= q; ++l)
+                for (k1 = q1; k1 <= p1+q1; ++k1)
+                    for (l1 = 0; l1 <= q1; ++l1)
+                        for (k2 = q2; k2 <= p2+q2; ++k2, ++pos)
+                        {
+                            l2 = (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3
+                                    - (k1 + l1 + k2 - k - l);
+                            if ((l2 >= 0) && (l2 <= q2))
+                                std::swap(*pos, coefficients[index(n, k, l, k1, l1, k2)]);
+                        }
 }
 
 /* Functions to get/set particular isoscalar factors.
@@ -22,7 +113,8 @@ isoscalar_context::isoscalar_context(long p, long q, long p1,
     0 for those couplings. This is because doing so greatly simplifies the
     main calculation code.
 */
-sqrat isoscalar_context::isf(long n, long k, long l, long k1, long l1,
+template<typename T>
+T isoscalar_context<T>::isf(long n, long k, long l, long k1, long l1,
                             long k2, long l2)
 {
     /* Bounds checks; here we allow one space extra around the valid range */
@@ -52,13 +144,12 @@ sqrat isoscalar_context::isf(long n, long k, long l, long k1, long l1,
         return 0;
 
     /* Otherwise, get the value from our coefficient array */
-    size_t index = ((((n * (p+1) + k-q) * (q+1) + l) * (p1+1) + k1-q1)
-                    * (q1+1) + l1) * (p2+1) + k2-q2;
-    return coefficients[index];
+    return coefficients[index(n, k, l, k1, l1, k2)];
 }
 
-void isoscalar_context::set_isf(long n, long k, long l, long k1, long l1,
-                            long k2, long l2, sqrat value)
+template<typename T>
+void isoscalar_context<T>::set_isf(long n, long k, long l, long k1, long l1,
+                            long k2, long l2, T value)
 {
     /* Bounds checks */
     assert((n >= 0) && (n < d));
@@ -76,9 +167,41 @@ void isoscalar_context::set_isf(long n, long k, long l, long k1, long l1,
         about l2 being unused */
     (void)l2;
 
-    size_t index = ((((n * (p+1) + k-q) * (q+1) + l) * (p1+1) + k1-q1)
-                    * (q1+1) + l1) * (p2+1) + k2-q2;
-    coefficients[index] = value;
+    coefficients[index(n, k, l, k1, l1, k2)] = value;
+}
+
+/* Pass a finished row to the row handler, if there is one. The couplings
+    to the state of highest weight are stored separately, so copy them into
+    place first. The two row slots are reused, so the entries where l2 is
+    out of range, which are never calculated, would hold values from an
+    earlier row; zero them, so that the row matches the layout of an
+    isoarray exactly. */
+template<typename T>
+void isoscalar_context<T>::finish_row(long n, long k)
+{
+    if (checkpoint)
+        checkpoint->finish_row(n, k);
+    if (! on_row) return;
+
+    size_t row_size = (p1+1) * (q1+1) * (p2+1);
+    T* row = coefficients + (d + ((k-q) % 2) * (q+1)) * row_size;
+    if (k == p+q)
+        std::copy(coefficients + n * row_size, coefficients + (n+1) * row_size, row);
+
+    T* pos = row;
+    long l, k1, l1, k2, l2;
+    for (l = 0; l <= q; ++l)
+        for (k1 = q1; k1 <= p1+q1; ++k1)
+            for (l1 = 0; l1 <= q1; ++l1)
+                for (k2 = q2; k2 <= p2+q2; ++k2, ++pos)
+                {
+                    l2 = (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3
+                            - (k1 + l1 + k2 - k - l);
+                    if ((l2 < 0) || (l2 > q2))
+                        *pos = 0;
+                }
+
+    (*on_row)(n, k, row);
 }
 
 /* Use the C and D recursion relations to step along the
@@ -87,82 +210,246 @@ void isoscalar_context::set_isf(long n, long k, long l, long k1, long l1,
 
    The arguments identify the state to be calclated, *not* the values
    of k1,l1,k2,l2 used in the recursion relation itself. */
-void isoscalar_context::step_k_down(long n, long k, long k1, long l1,
+template<typename T>
+void isoscalar_context<T>::step_k_down(long n, long k, long k1, long l1,
                                     long k2, long l2)
 {
-    sqrat beta, d1, d2, d3;
+    T beta, d1, d2, d3;
     d_coefficients(k, k1, l1, k2, l2, beta, d1, d2, d3);
 
     /* Calculate the value at (k,0,k1,l1,k2,l2) using surrounding values */
-    sqrat res = (d1 * isf(n, k+1, 0L, k1+1, l1, k2, l2)
+    T res = (d1 * isf(n, k+1, 0L, k1+1, l1, k2, l2)
                 +d2 * isf(n, k+1, 0L, k1, l1, k2+1, l2)
                 +d3 * isf(n, k+1, 0L, k1, l1, k2, l2+1)) * beta;
     set_isf(n, k, 0L, k1, l1, k2, l2, res);
 }
 
-void isoscalar_context::step_l_up(long n, long k, long l, long k1,
+template<typename T>
+void isoscalar_context<T>::step_l_up(long n, long k, long l, long k1,
                                     long l1, long k2, long l2)
 {
-    sqrat alpha, c1, c2, c3, c4;
+    T alpha, c1, c2, c3, c4;
 
     c_coefficients(k, l, k1, l1, k2, l2, alpha, c1, c2, c3, c4);
 
     /* Calculate the value at (k,l,k1,l1,k2,l2) using surrounding values */
-    sqrat res = (c1 * isf(n, k+1, l-1, k1, l1, k2, l2)
+    T res = (c1 * isf(n, k+1, l-1, k1, l1, k2, l2)
                 +c2 * isf(n, k, l-1, k1, l1-1, k2, l2)
                 +c3 * isf(n, k, l-1, k1, l1, k2-1, l2)
                 +c4 * isf(n, k, l-1, k1, l1, k2, l2-1)) * alpha;
     set_isf(n, k, l, k1, l1, k2, l2, res);
 }
 
+template<typename T>
+void isoscalar_context<T>::step_k_down_all(long k, long k1, long l1, long k2,
+                                            long l2)
+{
+    T beta, d1, d2, d3;
+    d_coefficients(k, k1, l1, k2, l2, beta, d1, d2, d3);
+
+    long n;
+    for (n = 0; n < d; ++n)
+    {
+        T res = (d1 * isf(n, k+1, 0L, k1+1, l1, k2, l2)
+                    +d2 * isf(n, k+1, 0L, k1, l1, k2+1, l2)
+                    +d3 * isf(n, k+1, 0L, k1, l1, k2, l2+1)) * beta;
+        set_isf(n, k, 0L, k1, l1, k2, l2, res);
+    }
+}
+
+template<typename T>
+void isoscalar_context<T>::step_l_up_all(long k, long l, long k1, long l1,
+                                            long k2, long l2)
+{
+    T alpha, c1, c2, c3, c4;
+    c_coefficients(k, l, k1, l1, k2, l2, alpha, c1, c2, c3, c4);
+
+    long n;
+    for (n = 0; n < d; ++n)
+    {
+        T res = (c1 * isf(n, k+1, l-1, k1, l1, k2, l2)
+                    +c2 * isf(n, k, l-1, k1, l1-1, k2, l2)
+                    +c3 * isf(n, k, l-1, k1, l1, k2-1, l2)
+                    +c4 * isf(n, k, l-1, k1, l1, k2, l2-1)) * alpha;
+        set_isf(n, k, l, k1, l1, k2, l2, res);
+    }
+}
+
+/* The 1 <-> 2 exchange symmetry for products of a rep with itself (see
+    mirror_sign). Each rep's sign is found by comparing every coupling to
+    the state of highest weight with its mirror image, which were both
+    calculated in full by calc_shw(). If any pair doesn't agree on the
+    sign (or every pair is zero), the symmetry isn't used. */
+template<typename T>
+void isoscalar_context<T>::find_mirror_signs()
+{
+}
+
+template<>
+void isoscalar_context<sqrat>::find_mirror_signs()
+{
+    if ((p1 != p2) || (q1 != q2))
+        return;
+
+    std::vector<long> signs(d, 0);
+    long n, k1, l1, k2, l2;
+    for (n = 0; n < d; ++n)
+    {
+        for (k1 = q1; k1 <= p1+q1; ++k1)
+            for (l1 = 0; l1 <= q1; ++l1)
+                for (k2 = q2; k2 <= p2+q2; ++k2)
+                {
+                    l2 = A - (k1+l1+k2);
+                    if ((l2 < 0) || (l2 > q2)) continue;
+
+                    sqrat v = isf(n, p+q, 0, k1, l1, k2, l2);
+                    sqrat w = isf(n, p+q, 0, k2, l2, k1, l1);
+                    if (SIGN((p+q-k1+l1-k2+l2)/2) < 0)
+                        v = -v;
+
+                    if (v == 0)
+                    {
+                        if (w != 0)
+                            return;
+                    }
+                    else if ((w == v) && (signs[n] >= 0))
+                        signs[n] = 1;
+                    else if ((w == -v) && (signs[n] <= 0))
+                        signs[n] = -1;
+                    else
+                        return;
+                }
+
+        if (! signs[n])
+            return;
+    }
+
+    mirror_sign = signs;
+}
+
+template<typename T>
+bool isoscalar_context<T>::mirrored(long k1, long l1, long k2, long l2)
+{
+    return ! mirror_sign.empty() && ((k1 < k2) || ((k1 == k2) && (l1 < l2)));
+}
+
+template<typename T>
+void isoscalar_context<T>::mirror(long n, long k, long l)
+{
+    if (mirror_sign.empty())
+        return;
+
+    long k1, l1, k2, l2;
+    for (k1 = q1; k1 <= p1+q1; ++k1)
+        for (l1 = 0; l1 <= q1; ++l1)
+            for (k2 = q2; k2 <= p2+q2; ++k2)
+            {
+                l2 = (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3 - (k1 + l1 + k2 - k - l);
+                if ((l2 < 0) || (l2 > q2) || ! mirrored(k1, l1, k2, l2)) continue;
+
+                T v = isf(n, k, l, k2, l2, k1, l1);
+                if (mirror_sign[n] * SIGN((k-l-k1+l1-k2+l2)/2) < 0)
+                    v = -v;
+                set_isf(n, k, l, k1, l1, k2, l2, v);
+            }
+}
+
 /* Internal function: Calculate the isoscalar factors for a particular
     combination of reps. */
-void isoscalar_context::calc_isoscalars()
+template<typename T>
+void isoscalar_context<T>::calc_isoscalars()
 {
     /* Calculate couplings to the state of highest weight (k=p+q, l=0). */
     this->calc_shw();
 
-    /* Then fill in the rest of the couplings */
+    /* For a product of a rep with itself, only calculate half of each row */
+    find_mirror_signs();
+
+    /* Then fill in the rest of the couplings. With the stencil layout, every
+        rep is stepped along at once. This is never used with a checkpoint,
+        a row handler or a single rep. */
     long n, k, l, k1, l1, k2, l2;
+    if (stencil)
+    {
+        for (k = p+q; k >= q; --k)
+            for (l = (k == p+q) ? 1 : 0; l <= q; ++l)
+            {
+                for (k1 = q1; k1 <= p1+q1; ++k1)
+                    for (l1 = 0; l1 <= q1; ++l1)
+                        for (k2 = q2; k2 <= p2+q2; ++k2)
+                        {
+                            l2 = (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3 - (k1 + l1 + k2 - k - l);
+                            if ((l2 < 0) || (l2 > q2) || mirrored(k1, l1, k2, l2)) continue;
+
+                            if (l == 0)
+                                step_k_down_all(k, k1, l1, k2, l2);
+                            else
+                                step_l_up_all(k, l, k1, l1, k2, l2);
+                        }
+
+                for (n = 0; n < d; ++n)
+                    mirror(n, k, l);
+            }
+        return;
+    }
+
     for (n = 0; n < d; ++n)
     {
+        if ((only_rep >= 0) && (n != only_rep))
+            continue;
+
         /* Fill in the rest of the k=p+q row */
         k = p+q;
-        for (l = 1; l <= q; ++l)
-            for (k1 = q1; k1 <= p1+q1; ++k1)
-                for (l1 = 0; l1 <= q1; ++l1)
-                    for (k2 = q2; k2 <= p2+q2; ++k2)
-                    {
-                        l2 = (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3 - (k1 + l1 + k2 - k - l);
-                        if ((l2 < 0) || (l2 > q2)) continue;
+        if (! (checkpoint && checkpoint->row_done(n, k)))
+        {
+            for (l = 1; l <= q; ++l)
+            {
+                for (k1 = q1; k1 <= p1+q1; ++k1)
+                    for (l1 = 0; l1 <= q1; ++l1)
+                        for (k2 = q2; k2 <= p2+q2; ++k2)
+                        {
+                            l2 = (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3 - (k1 + l1 + k2 - k - l);
+                            if ((l2 < 0) || (l2 > q2) || mirrored(k1, l1, k2, l2)) continue;
 
-                        step_l_up(n, k, l, k1, l1, k2, l2);
-                    }
+                            step_l_up(n, k, l, k1, l1, k2, l2);
+                        }
+                mirror(n, k, l);
+            }
+            finish_row(n, k);
+        }
 
         /* Fill in couplings to one state on this row */
         for (k = p+q-1; k >= q; --k)
         {
+            if (checkpoint && checkpoint->row_done(n, k))
+                continue;
+
             for (k1 = q1; k1 <= p1+q1; ++k1)
                 for (l1 = 0; l1 <= q1; ++l1)
                     for (k2 = q2; k2 <= p2+q2; ++k2)
                     {
                         l2 = (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3 - (k1 + l1 + k2 - k);
-                        if ((l2 < 0) || (l2 > q2)) continue;
+                        if ((l2 < 0) || (l2 > q2) || mirrored(k1, l1, k2, l2)) continue;
 
                         step_k_down(n, k, k1, l1, k2, l2);
                     }
+            mirror(n, k, 0);
 
             /* Fill in the rest of the row */
             for (l = 1; l <= q; ++l)
+            {
                 for (k1 = q1; k1 <= p1+q1; ++k1)
                     for (l1 = 0; l1 <= q1; ++l1)
                         for (k2 = q2; k2 <= p2+q2; ++k2)
                         {
                             l2 = (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3 - (k1 + l1 + k2 - k - l);
-                            if ((l2 < 0) || (l2 > q2)) continue;
+                            if ((l2 < 0) || (l2 > q2) || mirrored(k1, l1, k2, l2)) continue;
 
                             step_l_up(n, k, l, k1, l1, k2, l2);
                         }
+                mirror(n, k, l);
+            }
+            finish_row(n, k);
         }
     }
 }
@@ -190,33 +477,243 @@ static int can_calculate(long p, long q, long p1, long q1, long p2, long q2,
         return 0;
 }
 
+/* Internal: Calculate values for one irrep combination directly, with
+    values of type T. Returns false if this isn't possible. */
+template<typename T>
+bool isoscalars_fill(long p, long q, long p1, long q1, long p2, long q2,
+                        long d, T* coefficients)
+{
+    /* Check that a direct calculation will succeed, before we do it */
+    if (! can_calculate(p, q, p1, q1, p2, q2, d))
+        return false;
+
+    isoscalar_context<T>* ctx = new isoscalar_context<T>(p, q, p1, q1, p2, q2,
+                                                            d, coefficients);
+    /* With a single rep, the stencil layout only moves the couplings to
+        the state of highest weight, which isn't worth the extra copy */
+    if ((layout == ISF_LAYOUT_STENCIL) && (d > 1))
+    {
+        ctx->stencil = true;
+        ctx->coefficients = new T[ctx->stencil_size()]();
+    }
+
+    try
+    {
+        ctx->calc_isoscalars();
+        if (ctx->stencil)
+            ctx->copy_out(coefficients);
+    }
+    catch (...)
+    {
+        if (ctx->stencil)
+            delete[] ctx->coefficients;
+        delete ctx;
+        throw;
+    }
+
+    if (ctx->stencil)
+        delete[] ctx->coefficients;
+    delete ctx;
+    return true;
+}
+
+size_t isoscalars_window_size(long p, long q, long p1, long q1, long p2, long q2,
+                                long d)
+{
+    (void)p;
+    (void)q2;
+    return (d + 2 * (q+1)) * (p1+1) * (q1+1) * (p2+1);
+}
+
+template<typename T>
+bool isoscalars_fill_rows(long p, long q, long p1, long q1, long p2, long q2,
+                            long d, T* window, const isf_row_handler<T>& on_row)
+{
+    if (! can_calculate(p, q, p1, q1, p2, q2, d))
+        return false;
+
+    isoscalar_context<T>* ctx = new isoscalar_context<T>(p, q, p1, q1, p2, q2,
+                                                            d, window, &on_row);
+    try
+    {
+        ctx->calc_isoscalars();
+    }
+    catch (...)
+    {
+        delete ctx;
+        throw;
+    }
+
+    delete ctx;
+    return true;
+}
+
+size_t isoscalars_rep_size(long p, long q, long p1, long q1, long p2, long q2,
+                            long d)
+{
+    (void)q2;
+    return ((p+1) * (q+1) + d-1) * (p1+1) * (q1+1) * (p2+1);
+}
+
+template<typename T>
+bool isoscalars_fill_rep(long p, long q, long p1, long q1, long p2, long q2,
+                            long d, long n, T* coefficients)
+{
+    if (! can_calculate(p, q, p1, q1, p2, q2, d))
+        return false;
+
+    isoscalar_context<T>* ctx = new isoscalar_context<T>(p, q, p1, q1, p2, q2,
+                                                            d, coefficients);
+    ctx->only_rep = n;
+    try
+    {
+        ctx->calc_isoscalars();
+    }
+    catch (...)
+    {
+        delete ctx;
+        throw;
+    }
+
+    delete ctx;
+    return true;
+}
+
+/* In window mode (see index()), the couplings to the state of highest
+    weight come first, so they can be calculated on their own into a buffer
+    just big enough to hold them. No rows are ever finished, so the row
+    handler is never called. */
+template<typename T>
+bool isoscalars_fill_shw(long p, long q, long p1, long q1, long p2, long q2,
+                            long d, T* shw)
+{
+    if (! can_calculate(p, q, p1, q1, p2, q2, d))
+        return false;
+
+    isf_row_handler<T> unused = [](long, long, const T*) {};
+    isoscalar_context<T>* ctx = new isoscalar_context<T>(p, q, p1, q1, p2, q2,
+                                                            d, shw, &unused);
+    try
+    {
+        ctx->calc_shw();
+    }
+    catch (...)
+    {
+        delete ctx;
+        throw;
+    }
+
+    delete ctx;
+    return true;
+}
+
+bool isoscalars_fill_checkpointed(long p, long q, long p1, long q1, long p2,
+                                    long q2, long d, sqrat* coefficients,
+                                    isf_checkpoint& checkpoint)
+{
+    if (! can_calculate(p, q, p1, q1, p2, q2, d))
+        return false;
+
+    isoscalar_context<sqrat>* ctx = new isoscalar_context<sqrat>(p, q, p1, q1,
+                                                        p2, q2, d, coefficients);
+    ctx->checkpoint = &checkpoint;
+    try
+    {
+        ctx->calc_isoscalars();
+    }
+    catch (...)
+    {
+        delete ctx;
+        throw;
+    }
+
+    delete ctx;
+    return true;
+}
+
+/* Instantiate the recursions for each type of value they are used with.
+    The members defined in coeff.cc and shw.cc are instantiated there. */
+template class isoscalar_context<sqrat>;
+template class isoscalar_context<double>;
+template class isoscalar_context<long double>;
+template class isoscalar_context<modular_value>;
+#ifdef SU3_USE_MPFR
+template class isoscalar_context<mpfr_value>;
+#endif
+
+template bool isoscalars_fill<sqrat>(long, long, long, long, long, long, long, sqrat*);
+template bool isoscalars_fill<double>(long, long, long, long, long, long, long, double*);
+template bool isoscalars_fill<long double>(long, long, long, long, long, long, long,
+                                            long double*);
+template bool isoscalars_fill<modular_value>(long, long, long, long, long, long, long,
+                                                modular_value*);
+#ifdef SU3_USE_MPFR
+template bool isoscalars_fill<mpfr_value>(long, long, long, long, long, long, long,
+                                            mpfr_value*);
+#endif
+
+template bool isoscalars_fill_rows<sqrat>(long, long, long, long, long, long, long,
+                                            sqrat*, const isf_row_handler<sqrat>&);
+template bool isoscalars_fill_rep<sqrat>(long, long, long, long, long, long, long,
+                                            long, sqrat*);
+template bool isoscalars_fill_shw<sqrat>(long, long, long, long, long, long, long,
+                                            sqrat*);
+
+static std::atomic<int> engine(ISF_ENGINE_SQRAT);
+
+void set_isf_engine(isf_engine new_engine)
+{
+    engine = new_engine;
+}
+
+isf_engine get_isf_engine()
+{
+    return (isf_engine)engine.load();
+}
+
 /* Internal: Calculate values for one irrep combination, without trying
     the symmetry relations. Returns NULL on failure.
 */
-isoarray* isoscalars_single(long p, long q, long p1, long q1,
+static isoarray* isoscalars_single(long p, long q, long p1, long q1,
                                     long p2, long q2, long d)
 {
-    /* Check that a direct calculation will succeed, before we do it */
-    if (! can_calculate(p, q, p1, q1, p2, q2, d))
-        return NULL;
+    isoarray* result;
+    if ((engine == ISF_ENGINE_MODULAR)
+        && isoscalars_modular(p, q, p1, q1, p2, q2, d, result))
+        return result;
+    if ((engine == ISF_ENGINE_BUILDUP)
+        && isoscalars_buildup(p, q, p1, q1, p2, q2, d, result))
+        return result;
 
     size_t size = d * (p+1) * (q+1) * (p1+1) * (q1+1) * (p2+1);
     sqrat* coefficients = new sqrat[size];
-    isoscalar_context* ctx = new isoscalar_context(p, q, p1, q1, p2, q2,
-                                                    d, coefficients);
     isoarray* isf = new isoarray(p, q, p1, q1, p2, q2, d, coefficients);
 
-    ctx->calc_isoscalars();
-    delete ctx;
+    bool ok;
+    try
+    {
+        ok = isoscalars_fill(p, q, p1, q1, p2, q2, d, coefficients);
+    }
+    catch (...)
+    {
+        delete isf;
+        throw;
+    }
+
+    if (! ok)
+    {
+        delete isf;
+        return NULL;
+    }
+
     return isf;
 }
 
-/* Main calculation function */
-isoarray* isoscalars(long p, long q, long p1, long q1, long p2, long q2)
+/* Internal: Calculate values for one irrep combination, using the symmetry
+    relations if the direct calculation fails */
+static isoarray* isoscalars_compute(long p, long q, long p1, long q1,
+                                    long p2, long q2, long d)
 {
-    long d = degeneracy(p, q, p1, q1, p2, q2);
-    if (! d) return NULL; /* Ignore reps of zero degeneracy */
-
     /* Try to calculate directly */
     isoarray* isf = isoscalars_single(p, q, p1, q1, p2, q2, d);
     if (isf)
@@ -250,6 +747,188 @@ isoarray* isoscalars(long p, long q, long p1, long q1, long p2, long q2)
                             "please report this as a bug in libSU3.");
 }
 
+/* Internal: Look up a coupling in the on-disk cache, calculating and storing
+    it if it isn't there. The cache only holds one coupling from each orbit
+    under the symmetry relations, and we derive the others from it. */
+static isoarray* isoscalars_disk_cached(long p, long q, long p1, long q1,
+                                        long p2, long q2, long d)
+{
+    coupling c = {p, q, p1, q1, p2, q2};
+    std::vector<symmetry_op> path;
+    coupling rep = canonical_coupling(c, path);
+
+    isoarray* rep_isf = disk_cache_load(rep, d);
+    if (! rep_isf)
+    {
+        rep_isf = isoscalars_compute(rep.p, rep.q, rep.p1, rep.q1,
+                                        rep.p2, rep.q2, d);
+        disk_cache_store(*rep_isf);
+    }
+
+    if (path.empty())
+        return rep_isf;
+
+    isoarray* isf = apply_symmetries(rep_isf, path);
+    delete rep_isf;
+    return isf;
+}
+
+/* Internal: As isoscalars_single(), saving progress to a checkpoint file.
+    Sets 'failed' if the checkpoint file can't be created. */
+static isoarray* isoscalars_single_checkpointed(const coupling& requested,
+                    long p, long q, long p1, long q1, long p2, long q2, long d,
+                    const char* path, long interval, bool overwrite,
+                    bool& failed)
+{
+    /* Don't touch the checkpoint file unless this is the coupling which
+        will actually be calculated */
+    if (! can_calculate(p, q, p1, q1, p2, q2, d))
+        return NULL;
+
+    size_t size = d * (p+1) * (q+1) * (p1+1) * (q1+1) * (p2+1);
+    sqrat* coefficients = new sqrat[size];
+    isoarray* isf = new isoarray(p, q, p1, q1, p2, q2, d, coefficients);
+
+    isf_checkpoint checkpoint(path, requested, p, q, p1, q1, p2, q2, d,
+                                coefficients, interval, overwrite);
+    if (! checkpoint.ok())
+    {
+        delete isf;
+        failed = true;
+        return NULL;
+    }
+
+    try
+    {
+        isoscalars_fill_checkpointed(p, q, p1, q1, p2, q2, d, coefficients,
+                                        checkpoint);
+    }
+    catch (...)
+    {
+        delete isf;
+        throw;
+    }
+
+    checkpoint.remove();
+    return isf;
+}
+
+/* As isoscalars_compute(), with checkpoints */
+isoarray* isoscalars_checkpointed(long p, long q, long p1, long q1, long p2,
+                                    long q2, const char* path, long interval,
+                                    bool overwrite)
+{
+    long d = degeneracy(p, q, p1, q1, p2, q2);
+    if (! d) return NULL;
+
+    isoarray* isf = builtin_isoscalars(p, q, p1, q1, p2, q2);
+    if (isf) return isf;
+
+    coupling requested = {p, q, p1, q1, p2, q2};
+    bool failed = false;
+    isf = isoscalars_single_checkpointed(requested, p, q, p1, q1, p2, q2, d,
+                                            path, interval, overwrite, failed);
+    if (isf || failed)
+        return isf;
+
+    isf = isoscalars_single_checkpointed(requested, q1, p1, q, p, p2, q2, d,
+                                            path, interval, overwrite, failed);
+    if (isf)
+    {
+        isoarray* new_isf = isf->exch_13bar();
+        delete isf;
+        return new_isf;
+    }
+    if (failed)
+        return NULL;
+
+    isf = isoscalars_single_checkpointed(requested, q2, p2, p1, q1, q, p, d,
+                                            path, interval, overwrite, failed);
+    if (isf)
+    {
+        isoarray* new_isf = isf->exch_23bar();
+        delete isf;
+        return new_isf;
+    }
+    if (failed)
+        return NULL;
+
+    throw std::logic_error("Calculation of ISFs failed. "
+                            "please report this as a bug in libSU3.");
+}
+
+isoarray* isoscalars_resume(const char* path, long interval)
+{
+    coupling c;
+    if (! isf_checkpoint::requested_coupling(path, c))
+        return NULL;
+
+    return isoscalars_checkpointed(c.p, c.q, c.p1, c.q1, c.p2, c.q2, path, interval);
+}
+
+/* Main calculation function */
+isoarray* isoscalars(long p, long q, long p1, long q1, long p2, long q2)
+{
+    long d = degeneracy(p, q, p1, q1, p2, q2);
+    if (! d) return NULL; /* Ignore reps of zero degeneracy */
+
+    isoarray* isf = builtin_isoscalars(p, q, p1, q1, p2, q2);
+    if (isf) return isf;
+
+    isf = closed_form_isoscalars(p, q, p1, q1, p2, q2, d);
+    if (isf) return isf;
+
+    if (disk_cache_enabled())
+        return isoscalars_disk_cached(p, q, p1, q1, p2, q2, d);
+
+    return isoscalars_compute(p, q, p1, q1, p2, q2, d);
+}
+
+isoarray* isoscalars_rep(long p, long q, long p1, long q1, long p2, long q2,
+                        long n)
+{
+    long d = degeneracy(p, q, p1, q1, p2, q2);
+    if ((n < 0) || (n >= d)) return NULL;
+    if (d == 1) return isoscalars(p, q, p1, q1, p2, q2);
+
+    size_t size, rep_size = (p+1) * (q+1) * (p1+1) * (q1+1) * (p2+1);
+    sqrat* work = new sqrat[isoscalars_rep_size(p, q, p1, q1, p2, q2, d)];
+    sqrat* coefficients;
+
+    bool ok;
+    try
+    {
+        ok = isoscalars_fill_rep(p, q, p1, q1, p2, q2, d, n, work);
+    }
+    catch (...)
+    {
+        delete[] work;
+        throw;
+    }
+
+    /* Drop the couplings to the state of highest weight of the other reps,
+        which were only needed to orthonormalise rep n */
+    if (ok)
+    {
+        coefficients = new sqrat[rep_size];
+        std::copy(work, work + rep_size, coefficients);
+        delete[] work;
+        return new isoarray(p, q, p1, q1, p2, q2, 1, coefficients);
+    }
+    delete[] work;
+
+    /* The symmetry relations fix the overall sign using rep 0, so for
+        these we need every rep */
+    isoarray* all = isoscalars(p, q, p1, q1, p2, q2);
+    const sqrat* values = isf_io::coefficients(*all, size);
+
+    coefficients = new sqrat[rep_size];
+    std::copy(values + n * rep_size, values + (n+1) * rep_size, coefficients);
+    delete all;
+
+    return new isoarray(p, q, p1, q1, p2, q2, 1, coefficients);
+}
+
 /* Wrapper around the above to provide an array of Clebsch-Gordans instead */
 cgarray* clebsch_gordans(long p, long q, long p1, long q1, long p2, long q2)
 {
@@ -0,0 +1,152 @@
+/* libSU3: Calculation of isoscalar factors in floating point.
+
+    This runs exactly the same recursions as isoscalars() (see
+    isoscalar_context), just with floating-point values in place of sqrat.
+    Each step of the recursions only combines a handful of nearby values,
+    and the orthonormalisation of degenerate reps uses modified Gram-Schmidt
+    (each rep is projected against the already-orthogonalised version of
+    itself), so rounding errors stay small.
+*/
+
+#include <assert.h>
+#include <stdexcept>
+
+#include "SU3_internal.h"
+
+/* Note: This type takes ownership of the array passed in */
+isoarray_double::isoarray_double(long p, long q, long p1, long q1, long p2,
+    long q2, long d, double* isf_array) : isf_array(isf_array), p(p), q(q),
+    p1(p1), q1(q1), p2(p2), q2(q2), d(d)
+{
+    size = d * (p+1) * (q+1) * (p1+1) * (q1+1) * (p2+1);
+}
+
+isoarray_double::~isoarray_double()
+{
+    delete[] isf_array;
+}
+
+/* Indexing is exactly as in isoarray.cc */
+void isoarray_double::set_isf(long n, long k, long l, long k1, long l1,
+                                long k2, long l2, double v)
+{
+    assert((n >= 0) && (n < d));
+    assert((k >= q) && (k <= p+q));
+    assert((l >= 0) && (l <= q));
+    assert((k1 >= q1) && (k1 <= p1+q1));
+    assert((l1 >= 0) && (l1 <= q1));
+    assert((k2 >= q2) && (k2 <= p2+q2));
+    assert((l2 >= 0) && (l2 <= q2));
+    assert(k1+l1+k2+l2-k-l == (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3);
+    (void)l2;
+
+    size_t index = ((((n * (p+1) + k-q) * (q+1) + l) * (p1+1) + k1-q1)
+                    * (q1+1) + l1) * (p2+1) + k2-q2;
+    assert(index < size);
+    isf_array[index] = v;
+}
+
+double isoarray_double::operator()(long n, long k, long l, long k1, long l1,
+                                    long k2, long l2) const
+{
+    if (    (n < 0) || (n >= d)
+         || (k  < q ) || (k  > p +q ) || (l  < 0) || (l  > q )
+         || (k1 < q1) || (k1 > p1+q1) || (l1 < 0) || (l1 > q1)
+         || (k2 < q2) || (k2 > p2+q2) || (l2 < 0) || (l2 > q2))
+        return 0;
+
+    if (k1+l1+k2+l2-k-l != (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3)
+        return 0;
+
+    size_t index = ((((n * (p+1) + k-q) * (q+1) + l) * (p1+1) + k1-q1)
+                    * (q1+1) + l1) * (p2+1) + k2-q2;
+    assert(index < size);
+    return isf_array[index];
+}
+
+void isoarray_double::check_sign_convention()
+{
+    isf_symmetry::check_sign_convention<isoarray_double, double>(*this);
+}
+
+isoarray_double* isoarray_double::exch_12() const
+{
+    return isf_symmetry::exch_12<isoarray_double, double>(*this);
+}
+
+isoarray_double* isoarray_double::exch_13bar() const
+{
+    return isf_symmetry::exch_13bar<isoarray_double, double>(*this);
+}
+
+isoarray_double* isoarray_double::exch_23bar() const
+{
+    isoarray_double* tmp1 = this->exch_12();
+    isoarray_double* tmp2 = tmp1->exch_13bar();
+    isoarray_double* result = tmp2->exch_12();
+
+    delete tmp1;
+    delete tmp2;
+    return result;
+}
+
+/* Internal: Calculate values for one irrep combination directly, running the
+    recursions with values of type T. Returns NULL on failure. */
+template<typename T>
+static isoarray_double* isoscalars_double_single(long p, long q, long p1, long q1,
+                                                    long p2, long q2, long d)
+{
+    size_t size = d * (p+1) * (q+1) * (p1+1) * (q1+1) * (p2+1);
+    std::vector<T> coefficients(size, T(0));
+
+    if (! isoscalars_fill(p, q, p1, q1, p2, q2, d, coefficients.data()))
+        return NULL;
+
+    double* values = new double[size];
+    size_t i;
+    for (i = 0; i < size; ++i)
+        values[i] = (double)coefficients[i];
+
+    return new isoarray_double(p, q, p1, q1, p2, q2, d, values);
+}
+
+/* As isoscalars_compute() (isoscalars.cc), but in floating point */
+template<typename T>
+static isoarray_double* isoscalars_double_compute(long p, long q, long p1, long q1,
+                                                    long p2, long q2, long d)
+{
+    isoarray_double* isf = isoscalars_double_single<T>(p, q, p1, q1, p2, q2, d);
+    if (isf)
+        return isf;
+
+    isf = isoscalars_double_single<T>(q1, p1, q, p, p2, q2, d);
+    if (isf)
+    {
+        isoarray_double* new_isf = isf->exch_13bar();
+        delete isf;
+        return new_isf;
+    }
+
+    isf = isoscalars_double_single<T>(q2, p2, p1, q1, q, p, d);
+    if (isf)
+    {
+        isoarray_double* new_isf = isf->exch_23bar();
+        delete isf;
+        return new_isf;
+    }
+
+    throw std::logic_error("Calculation of ISFs failed. "
+                            "please report this as a bug in libSU3.");
+}
+
+isoarray_double* isoscalars_double(long p, long q, long p1, long q1, long p2, long q2,
+                                    bool extended)
+{
+    long d = degeneracy(p, q, p1, q1, p2, q2);
+    if (! d) return NULL;
+
+    if (extended)
+        return isoscalars_double_compute<long double>(p, q, p1, q1, p2, q2, d);
+    else
+        return isoscalars_double_compute<double>(p, q, p1, q1, p2, q2, d);
+}
@@ -0,0 +1,459 @@
+/* libSU3: Calculation of isoscalar factors in arbitrary precision, using MPFR.
+
+    As in isoscalars_fp.cc, this runs the same recursions as isoscalars(),
+    just with mpfr_values in place of sqrat. Alongside each value, we keep
+    a bound on its error, which is propagated through each operation: the
+    bounds of the operands are combined, and the rounding error of the
+    result itself is added.
+
+    This file is only built if USE_MPFR is set in config.mk.
+*/
+
+#ifdef SU3_USE_MPFR
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include <new>
+#include <stdexcept>
+
+#include "SU3_internal.h"
+
+/* The precision for new values. This is set for the duration of each
+    calculation, on the thread doing it. */
+static thread_local long working_precision = 53;
+
+struct precision_guard
+{
+    long saved;
+
+    precision_guard(long precision) : saved(working_precision)
+    {
+        working_precision = precision;
+    }
+
+    ~precision_guard()
+    {
+        working_precision = saved;
+    }
+};
+
+/* The precision of the error bounds. These only need to be accurate to
+    within a few percent. */
+#define BOUND_PRECISION 32
+
+/* A temporary error bound, or any other quantity which only needs its
+    precision */
+struct bound
+{
+    mpfr_t b;
+
+    bound()
+    {
+        mpfr_init2(b, BOUND_PRECISION);
+        mpfr_set_si(b, 0, MPFR_RNDN);
+    }
+
+    ~bound()
+    {
+        mpfr_clear(b);
+    }
+};
+
+/* Helper: |x|, rounded up or down to the precision of 'out' */
+static void magnitude(mpfr_t out, const mpfr_value& x, mpfr_rnd_t rnd)
+{
+    mpfr_abs(out, x.v, rnd);
+}
+
+/* Helper: Add the error from rounding the value of x, 'ulps' times over */
+static void add_rounding(mpfr_value& x, long ulps)
+{
+    bound r;
+    magnitude(r.b, x, MPFR_RNDU);
+    mpfr_mul_2si(r.b, r.b, 1 - x.precision(), MPFR_RNDU);
+    mpfr_mul_si(r.b, r.b, ulps, MPFR_RNDU);
+    mpfr_add(x.err, x.err, r.b, MPFR_RNDU);
+}
+
+mpfr_value::mpfr_value()
+{
+    mpfr_init2(v, working_precision);
+    mpfr_set_si(v, 0, MPFR_RNDN);
+    mpfr_init2(err, BOUND_PRECISION);
+    mpfr_set_si(err, 0, MPFR_RNDN);
+}
+
+mpfr_value::mpfr_value(long x)
+{
+    mpfr_init2(v, working_precision);
+    mpfr_set_si(v, x, MPFR_RNDN);
+    mpfr_init2(err, BOUND_PRECISION);
+    mpfr_set_si(err, 0, MPFR_RNDN);
+}
+
+mpfr_value::mpfr_value(const mpfr_value& other)
+{
+    mpfr_init2(v, mpfr_get_prec(other.v));
+    mpfr_set(v, other.v, MPFR_RNDN);
+    mpfr_init2(err, BOUND_PRECISION);
+    mpfr_set(err, other.err, MPFR_RNDU);
+}
+
+mpfr_value::~mpfr_value()
+{
+    mpfr_clear(v);
+    mpfr_clear(err);
+}
+
+mpfr_value& mpfr_value::operator=(const mpfr_value& other)
+{
+    if (mpfr_get_prec(v) != mpfr_get_prec(other.v))
+        mpfr_set_prec(v, mpfr_get_prec(other.v));
+    mpfr_set(v, other.v, MPFR_RNDN);
+    mpfr_set(err, other.err, MPFR_RNDU);
+    return *this;
+}
+
+mpfr_value& mpfr_value::operator+=(const mpfr_value& other)
+{
+    *this = *this + other;
+    return *this;
+}
+
+long mpfr_value::precision() const
+{
+    return mpfr_get_prec(v);
+}
+
+mpfr_value operator-(const mpfr_value& a)
+{
+    mpfr_value result(a);
+    mpfr_neg(result.v, a.v, MPFR_RNDN);
+    return result;
+}
+
+mpfr_value operator+(const mpfr_value& a, const mpfr_value& b)
+{
+    mpfr_value result;
+    mpfr_add(result.v, a.v, b.v, MPFR_RNDN);
+    mpfr_add(result.err, a.err, b.err, MPFR_RNDU);
+    add_rounding(result, 1);
+    return result;
+}
+
+mpfr_value operator-(const mpfr_value& a, const mpfr_value& b)
+{
+    mpfr_value result;
+    mpfr_sub(result.v, a.v, b.v, MPFR_RNDN);
+    mpfr_add(result.err, a.err, b.err, MPFR_RNDU);
+    add_rounding(result, 1);
+    return result;
+}
+
+/* |a| b.err + |b| a.err + a.err b.err */
+mpfr_value operator*(const mpfr_value& a, const mpfr_value& b)
+{
+    mpfr_value result;
+    mpfr_mul(result.v, a.v, b.v, MPFR_RNDN);
+
+    bound amag, bmag, term;
+    magnitude(amag.b, a, MPFR_RNDU);
+    magnitude(bmag.b, b, MPFR_RNDU);
+    mpfr_mul(result.err, amag.b, b.err, MPFR_RNDU);
+    mpfr_mul(term.b, bmag.b, a.err, MPFR_RNDU);
+    mpfr_add(result.err, result.err, term.b, MPFR_RNDU);
+    mpfr_mul(term.b, a.err, b.err, MPFR_RNDU);
+    mpfr_add(result.err, result.err, term.b, MPFR_RNDU);
+    add_rounding(result, 1);
+    return result;
+}
+
+/* (|a| b.err + |b| a.err) / (|b| (|b| - b.err)), where the denominator is
+    rounded down */
+mpfr_value operator/(const mpfr_value& a, const mpfr_value& b)
+{
+    mpfr_value result;
+    mpfr_div(result.v, a.v, b.v, MPFR_RNDN);
+
+    bound low, den, amag, bmag, term;
+    magnitude(low.b, b, MPFR_RNDD);
+    if (mpfr_cmp(low.b, b.err) <= 0)
+    {
+        mpfr_set_inf(result.err, 1);
+        return result;
+    }
+
+    mpfr_sub(den.b, low.b, b.err, MPFR_RNDD);
+    mpfr_mul(den.b, den.b, low.b, MPFR_RNDD);
+
+    magnitude(amag.b, a, MPFR_RNDU);
+    magnitude(bmag.b, b, MPFR_RNDU);
+    mpfr_mul(result.err, amag.b, b.err, MPFR_RNDU);
+    mpfr_mul(term.b, bmag.b, a.err, MPFR_RNDU);
+    mpfr_add(result.err, result.err, term.b, MPFR_RNDU);
+    mpfr_div(result.err, result.err, den.b, MPFR_RNDU);
+    add_rounding(result, 1);
+    return result;
+}
+
+/* a.err / (sqrt(a - a.err) + sqrt(a)), or sqrt(max(a, 0) + a.err) if a
+    might be negative */
+mpfr_value sqrt(const mpfr_value& a)
+{
+    mpfr_value result;
+    bound low, term;
+    mpfr_set(low.b, a.v, MPFR_RNDD);
+
+    if (mpfr_cmp(low.b, a.err) <= 0)
+    {
+        if (mpfr_sgn(a.v) > 0)
+            mpfr_sqrt(result.v, a.v, MPFR_RNDN);
+        else
+            mpfr_set_si(low.b, 0, MPFR_RNDN);
+        mpfr_add(result.err, low.b, a.err, MPFR_RNDU);
+        mpfr_sqrt(result.err, result.err, MPFR_RNDU);
+        return result;
+    }
+
+    mpfr_sqrt(result.v, a.v, MPFR_RNDN);
+    mpfr_sub(term.b, low.b, a.err, MPFR_RNDD);
+    mpfr_sqrt(term.b, term.b, MPFR_RNDD);
+    mpfr_sqrt(low.b, low.b, MPFR_RNDD);
+    mpfr_add(term.b, term.b, low.b, MPFR_RNDD);
+    mpfr_div(result.err, a.err, term.b, MPFR_RNDU);
+    add_rounding(result, 1);
+    return result;
+}
+
+bool operator<(const mpfr_value& a, long b)
+{
+    return mpfr_cmp_si(a.v, b) < 0;
+}
+
+mpfr_value::operator double() const
+{
+    return mpfr_get_d(v, MPFR_RNDN);
+}
+
+std::string mpfr_value::str(long digits) const
+{
+    /* Enough decimal digits to represent every bit */
+    if (digits <= 0)
+        digits = 1 + (long)ceil(precision() * 0.30103);
+
+    char* buf;
+    if (mpfr_asprintf(&buf, "%.*Rg", (int)digits, v) < 0)
+        throw std::bad_alloc();
+
+    std::string result(buf);
+    mpfr_free_str(buf);
+    return result;
+}
+
+template<>
+mpfr_value signed_sqrt<mpfr_value>(long num, long den)
+{
+    mpfr_value result(labs(num));
+    mpfr_div_si(result.v, result.v, labs(den), MPFR_RNDN);
+    mpfr_sqrt(result.v, result.v, MPFR_RNDN);
+    if ((num < 0) != (den < 0))
+        mpfr_neg(result.v, result.v, MPFR_RNDN);
+
+    add_rounding(result, 2);
+    return result;
+}
+
+template<>
+mpfr_value signed_sqrt_mpz<mpfr_value>(const mpz_class& num, const mpz_class& den)
+{
+    mpfr_value result;
+    mpfr_set_z(result.v, num.get_mpz_t(), MPFR_RNDN);
+    mpfr_div_z(result.v, result.v, den.get_mpz_t(), MPFR_RNDN);
+    bool negative = mpfr_sgn(result.v) < 0;
+    mpfr_abs(result.v, result.v, MPFR_RNDN);
+    mpfr_sqrt(result.v, result.v, MPFR_RNDN);
+    if (negative)
+        mpfr_neg(result.v, result.v, MPFR_RNDN);
+
+    add_rounding(result, 3);
+    return result;
+}
+
+/* As for long double, but with the tolerance set by the precision, and
+    treating anything which might be zero as negligible */
+bool negligible(const mpfr_value& x, const mpfr_value& scale)
+{
+    if (mpfr_cmpabs(x.v, x.err) <= 0)
+        return true;
+
+    bound tolerance;
+    magnitude(tolerance.b, scale, MPFR_RNDU);
+    mpfr_mul_2si(tolerance.b, tolerance.b, -x.precision()/2, MPFR_RNDU);
+    return mpfr_cmpabs(x.v, tolerance.b) <= 0;
+}
+
+/* Note: This type takes ownership of the array passed in */
+isoarray_mpfr::isoarray_mpfr(long p, long q, long p1, long q1, long p2,
+    long q2, long d, mpfr_value* isf_array) : isf_array(isf_array), p(p), q(q),
+    p1(p1), q1(q1), p2(p2), q2(q2), d(d)
+{
+    size = d * (p+1) * (q+1) * (p1+1) * (q1+1) * (p2+1);
+}
+
+isoarray_mpfr::~isoarray_mpfr()
+{
+    delete[] isf_array;
+}
+
+/* Indexing is exactly as in isoarray.cc */
+void isoarray_mpfr::set_isf(long n, long k, long l, long k1, long l1,
+                            long k2, long l2, const mpfr_value& v)
+{
+    assert((n >= 0) && (n < d));
+    assert((k >= q) && (k <= p+q));
+    assert((l >= 0) && (l <= q));
+    assert((k1 >= q1) && (k1 <= p1+q1));
+    assert((l1 >= 0) && (l1 <= q1));
+    assert((k2 >= q2) && (k2 <= p2+q2));
+    assert((l2 >= 0) && (l2 <= q2));
+    assert(k1+l1+k2+l2-k-l == (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3);
+    (void)l2;
+
+    size_t index = ((((n * (p+1) + k-q) * (q+1) + l) * (p1+1) + k1-q1)
+                    * (q1+1) + l1) * (p2+1) + k2-q2;
+    assert(index < size);
+    isf_array[index] = v;
+}
+
+mpfr_value isoarray_mpfr::operator()(long n, long k, long l, long k1, long l1,
+                                        long k2, long l2) const
+{
+    if (    (n < 0) || (n >= d)
+         || (k  < q ) || (k  > p +q ) || (l  < 0) || (l  > q )
+         || (k1 < q1) || (k1 > p1+q1) || (l1 < 0) || (l1 > q1)
+         || (k2 < q2) || (k2 > p2+q2) || (l2 < 0) || (l2 > q2))
+        return mpfr_value(0);
+
+    if (k1+l1+k2+l2-k-l != (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3)
+        return mpfr_value(0);
+
+    size_t index = ((((n * (p+1) + k-q) * (q+1) + l) * (p1+1) + k1-q1)
+                    * (q1+1) + l1) * (p2+1) + k2-q2;
+    assert(index < size);
+    return isf_array[index];
+}
+
+long isoarray_mpfr::precision() const
+{
+    return isf_array[0].precision();
+}
+
+long isoarray_mpfr::lost_bits() const
+{
+    bound worst;
+    size_t i;
+    for (i = 0; i < size; ++i)
+        mpfr_max(worst.b, worst.b, isf_array[i].err, MPFR_RNDU);
+
+    /* worst < 2^e */
+    long prec = precision();
+    if (mpfr_zero_p(worst.b)) return 0;
+    if (! mpfr_number_p(worst.b)) return prec;
+    long e = mpfr_get_exp(worst.b);
+    return max(0L, min(prec, prec + e));
+}
+
+void isoarray_mpfr::check_sign_convention()
+{
+    precision_guard guard(precision());
+    isf_symmetry::check_sign_convention<isoarray_mpfr, mpfr_value>(*this);
+}
+
+isoarray_mpfr* isoarray_mpfr::exch_12() const
+{
+    precision_guard guard(precision());
+    return isf_symmetry::exch_12<isoarray_mpfr, mpfr_value>(*this);
+}
+
+isoarray_mpfr* isoarray_mpfr::exch_13bar() const
+{
+    precision_guard guard(precision());
+    return isf_symmetry::exch_13bar<isoarray_mpfr, mpfr_value>(*this);
+}
+
+isoarray_mpfr* isoarray_mpfr::exch_23bar() const
+{
+    isoarray_mpfr* tmp1 = this->exch_12();
+    isoarray_mpfr* tmp2 = tmp1->exch_13bar();
+    isoarray_mpfr* result = tmp2->exch_12();
+
+    delete tmp1;
+    delete tmp2;
+    return result;
+}
+
+/* Internal: Calculate values for one irrep combination directly.
+    Returns NULL on failure. */
+static isoarray_mpfr* isoscalars_mpfr_single(long p, long q, long p1, long q1,
+                                                long p2, long q2, long d)
+{
+    size_t size = d * (p+1) * (q+1) * (p1+1) * (q1+1) * (p2+1);
+    mpfr_value* coefficients = new mpfr_value[size];
+    isoarray_mpfr* isf = new isoarray_mpfr(p, q, p1, q1, p2, q2, d, coefficients);
+
+    bool ok;
+    try
+    {
+        ok = isoscalars_fill(p, q, p1, q1, p2, q2, d, coefficients);
+    }
+    catch (...)
+    {
+        delete isf;
+        throw;
+    }
+
+    if (! ok)
+    {
+        delete isf;
+        return NULL;
+    }
+
+    return isf;
+}
+
+/* As isoscalars_compute() (isoscalars.cc) */
+isoarray_mpfr* isoscalars_mpfr(long p, long q, long p1, long q1, long p2, long q2,
+                                long precision)
+{
+    long d = degeneracy(p, q, p1, q1, p2, q2);
+    if (! d) return NULL;
+
+    precision_guard guard(precision);
+
+    isoarray_mpfr* isf = isoscalars_mpfr_single(p, q, p1, q1, p2, q2, d);
+    if (isf)
+        return isf;
+
+    isf = isoscalars_mpfr_single(q1, p1, q, p, p2, q2, d);
+    if (isf)
+    {
+        isoarray_mpfr* new_isf = isf->exch_13bar();
+        delete isf;
+        return new_isf;
+    }
+
+    isf = isoscalars_mpfr_single(q2, p2, p1, q1, q, p, d);
+    if (isf)
+    {
+        isoarray_mpfr* new_isf = isf->exch_23bar();
+        delete isf;
+        return new_isf;
+    }
+
+    throw std::logic_error("Calculation of ISFs failed. "
+                            "please report this as a bug in libSU3.");
+}
+
+#endif
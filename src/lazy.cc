@@ -0,0 +1,127 @@
+/* libSU3: Isoscalar factors calculated as they are looked up.
+
+    Once the couplings to the state of highest weight are known, each other
+    value follows from one of the two recursions in isoscalars.cc:
+    step_l_up() gives (k, l) from values at (k+1, l-1) and (k, l-1), and
+    step_k_down() gives (k, 0) from values at (k+1, 0). So, to look up one
+    value, we only need to follow those back up to the state of highest
+    weight, remembering each value on the way in case it is needed again.
+*/
+
+#include "SU3_internal.h"
+
+isf_lazy::isf_lazy(long p, long q, long p1, long q1, long p2, long q2, long d,
+                    sqrat* shw) : p(p), q(q), p1(p1), q1(q1), p2(p2), q2(q2),
+                    d(d), shw(shw)
+{
+    ctx = new isoscalar_context<sqrat>(p, q, p1, q1, p2, q2, d, NULL);
+}
+
+isf_lazy::~isf_lazy()
+{
+    delete ctx;
+    delete[] shw;
+}
+
+size_t isf_lazy::memory_usage()
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    size_t total = sizeof(isf_lazy) + sizeof(isoscalar_context<sqrat>);
+    size_t i;
+    for (i = 0; i < (size_t)(d * (p1+1) * (q1+1) * (p2+1)); ++i)
+        total += shw[i].memory_usage();
+
+    std::unordered_map<size_t, sqrat>::const_iterator it;
+    for (it = known.begin(); it != known.end(); ++it)
+        total += sizeof(*it) + it->second.memory_usage();
+    return total;
+}
+
+/* Look up the value at a position in the isoarray */
+sqrat isf_lazy::get(size_t index)
+{
+    long k2 = index % (p2+1) + q2; index /= (p2+1);
+    long l1 = index % (q1+1);      index /= (q1+1);
+    long k1 = index % (p1+1) + q1; index /= (p1+1);
+    long l  = index % (q+1);       index /= (q+1);
+    long k  = index % (p+1) + q;   index /= (p+1);
+    long n  = index;
+    long l2 = (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3 - (k1+l1+k2-k-l);
+
+    std::lock_guard<std::mutex> guard(lock);
+    return isf(n, k, l, k1, l1, k2, l2);
+}
+
+/* As isoscalar_context<T>::isf(), calculating values as needed. This
+    allows values one space off the edge, which are zero. */
+sqrat isf_lazy::isf(long n, long k, long l, long k1, long l1, long k2, long l2)
+{
+    if (   (k  < q ) || (k  > p +q ) || (l  < 0) || (l  > q )
+        || (k1 < q1) || (k1 > p1+q1) || (l1 < 0) || (l1 > q1)
+        || (k2 < q2) || (k2 > p2+q2) || (l2 < 0) || (l2 > q2))
+        return 0;
+
+    if ((k == p+q) && (l == 0))
+        return shw[((n * (p1+1) + k1-q1) * (q1+1) + l1) * (p2+1) + k2-q2];
+
+    size_t index = ((((n * (p+1) + k-q) * (q+1) + l) * (p1+1) + k1-q1)
+                    * (q1+1) + l1) * (p2+1) + k2-q2;
+    std::unordered_map<size_t, sqrat>::const_iterator it = known.find(index);
+    if (it != known.end())
+        return it->second;
+
+    /* The same recursions, in the same order, as in step_l_up() and
+        step_k_down(), so that the results are identical */
+    sqrat res;
+    if (l > 0)
+    {
+        sqrat alpha, c1, c2, c3, c4;
+        ctx->c_coefficients(k, l, k1, l1, k2, l2, alpha, c1, c2, c3, c4);
+        res = (c1 * isf(n, k+1, l-1, k1, l1, k2, l2)
+                +c2 * isf(n, k, l-1, k1, l1-1, k2, l2)
+                +c3 * isf(n, k, l-1, k1, l1, k2-1, l2)
+                +c4 * isf(n, k, l-1, k1, l1, k2, l2-1)) * alpha;
+    }
+    else
+    {
+        sqrat beta, d1, d2, d3;
+        ctx->d_coefficients(k, k1, l1, k2, l2, beta, d1, d2, d3);
+        res = (d1 * isf(n, k+1, 0L, k1+1, l1, k2, l2)
+                +d2 * isf(n, k+1, 0L, k1, l1, k2+1, l2)
+                +d3 * isf(n, k+1, 0L, k1, l1, k2, l2+1)) * beta;
+    }
+
+    known[index] = res;
+    return res;
+}
+
+isoarray* isoscalars_lazy(long p, long q, long p1, long q1, long p2, long q2)
+{
+    long d = degeneracy(p, q, p1, q1, p2, q2);
+    if (! d) return NULL;
+
+    isoarray* isf = builtin_isoscalars(p, q, p1, q1, p2, q2);
+    if (isf) return isf;
+
+    sqrat* shw = new sqrat[d * (p1+1) * (q1+1) * (p2+1)];
+    bool ok;
+    try
+    {
+        ok = isoscalars_fill_shw(p, q, p1, q1, p2, q2, d, shw);
+    }
+    catch (...)
+    {
+        delete[] shw;
+        throw;
+    }
+
+    if (! ok)
+    {
+        delete[] shw;
+        return isoscalars(p, q, p1, q1, p2, q2);
+    }
+
+    return new isoarray(p, q, p1, q1, p2, q2, d, new isf_lazy(p, q, p1, q1,
+                                                                p2, q2, d, shw));
+}
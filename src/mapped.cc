@@ -0,0 +1,263 @@
+/* libSU3: Isoscalar factors held in a memory-mapped file.
+
+    The values themselves use the encoding in serialize.cc, which takes a
+    different amount of space for each value, so the file also holds the
+    position of each one. The rows are written in the order they are
+    calculated, which is not the order they are in memory. All integers are
+    stored as 8 bytes, least significant byte first. The file holds:
+    * The 8-byte magic string "libSU3:M"
+    * The format version (FORMAT_VERSION below)
+    * p, q, p1, q1, p2, q2, d
+    * The number of coefficients and the length of the coefficient data
+    * For each row (n, k), in the same order as in memory: the position and
+      length of its values within the coefficient data, and a checksum
+      (checksum64) of them
+    * The position of each coefficient within the coefficient data, in the
+      same order as in memory
+    * The coefficient data
+
+    The coefficients are calculated a row at a time (see stream.cc), and
+    written out as each row is finished. As in diskcache.cc, the file is
+    written under a temporary name and renamed into place once it is complete.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <stdexcept>
+
+#include "SU3_internal.h"
+
+#define FORMAT_VERSION 1ULL
+#define MAGIC "libSU3:M"
+#define MAGIC_LEN 8
+#define HEADER_LEN (MAGIC_LEN + 10*8)
+#define ROW_ENTRY_LEN (3*8)
+
+/* Counter to make temporary file names unique within this process */
+static std::atomic<unsigned long> tmp_counter(0);
+
+isf_mapping::~isf_mapping()
+{
+    munmap(map, map_len);
+}
+
+/* Helper: Read the nth 8-byte integer in a table */
+static unsigned long long table_entry(const unsigned char* table, size_t n)
+{
+    const unsigned char* pos = table + 8*n;
+    unsigned long long v;
+    isf_io::get_u64(pos, pos + 8, v);
+    return v;
+}
+
+sqrat isf_mapping::get(size_t index) const
+{
+    size_t row = index / row_size;
+    unsigned long long start = table_entry(rows, 3*row);
+    unsigned long long len = table_entry(rows, 3*row + 1);
+    if ((start > data_len) || (len > data_len - start))
+        throw std::runtime_error("libSU3: Corrupt row in mapped ISF file");
+
+    /* Racing threads may both check the same row, which is harmless */
+    if (! checked[row])
+    {
+        if (checksum64(data + start, len) != table_entry(rows, 3*row + 2))
+            throw std::runtime_error("libSU3: Corrupt row in mapped ISF file");
+        checked[row] = true;
+    }
+
+    unsigned long long offset = table_entry(offsets, index);
+    sqrat result;
+    const unsigned char* pos = data + offset;
+    if ((offset < start) || (offset >= start + len)
+        || ! isf_io::get_sqrat(pos, data + start + len, result))
+        throw std::runtime_error("libSU3: Corrupt value in mapped ISF file");
+
+    return result;
+}
+
+/* Thrown from inside the calculation to stop it if the output fails */
+struct mapped_write_failed {};
+
+/* Helper: Write all of 'len' bytes at 'offset' in the file */
+static bool write_at(int fd, const void* buf, size_t len, off_t offset)
+{
+    size_t done = 0;
+    while (done < len)
+    {
+        ssize_t n = pwrite(fd, (const char*)buf + done, len - done, offset + done);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        done += n;
+    }
+
+    return true;
+}
+
+isoarray* isoscalars_mapped(long p, long q, long p1, long q1, long p2, long q2,
+                            const char* path)
+{
+    long d = degeneracy(p, q, p1, q1, p2, q2);
+    if (! d) return NULL;
+
+    char buf[64];
+    snprintf(buf, sizeof(buf), ".tmp.%ld.%lu", (long)getpid(),
+                tmp_counter.fetch_add(1));
+    std::string tmp_path = std::string(path) + buf;
+
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if (fd < 0) return NULL;
+
+    size_t size = d * (p+1) * (q+1) * (p1+1) * (q1+1) * (p2+1);
+    size_t row_size = (q+1) * (p1+1) * (q1+1) * (p2+1);
+    off_t rows_start = HEADER_LEN;
+    off_t offsets_start = rows_start + ROW_ENTRY_LEN * d * (p+1);
+    off_t data_start = offsets_start + 8 * size;
+    unsigned long long data_len = 0;
+
+    /* Each row's entry and offsets go into their place in the tables, and
+        its values are appended to the data */
+    isorow_callback write_row = [&](const isorow& row)
+    {
+        std::string offsets, payload, entry;
+        size_t i;
+        for (i = 0; i < row_size; ++i)
+        {
+            isf_io::put_u64(offsets, data_len + payload.size());
+            isf_io::put_sqrat(payload, row.data()[i]);
+        }
+
+        isf_io::put_u64(entry, data_len);
+        isf_io::put_u64(entry, payload.size());
+        isf_io::put_u64(entry, checksum64((const unsigned char*)payload.data(),
+                                            payload.size()));
+
+        size_t r = row.n * (p+1) + row.k-q;
+        if (! write_at(fd, entry.data(), entry.size(), rows_start + ROW_ENTRY_LEN * r)
+            || ! write_at(fd, offsets.data(), offsets.size(),
+                            offsets_start + 8 * r * row_size)
+            || ! write_at(fd, payload.data(), payload.size(), data_start + data_len))
+            throw mapped_write_failed();
+
+        data_len += payload.size();
+    };
+
+    bool ok;
+    try
+    {
+        ok = isoscalars_stream(p, q, p1, q1, p2, q2, write_row);
+    }
+    catch (mapped_write_failed&)
+    {
+        ok = false;
+    }
+    catch (...)
+    {
+        close(fd);
+        unlink(tmp_path.c_str());
+        throw;
+    }
+
+    /* The header goes in last */
+    std::string header(MAGIC, MAGIC_LEN);
+    isf_io::put_u64(header, FORMAT_VERSION);
+    isf_io::put_u64(header, p);
+    isf_io::put_u64(header, q);
+    isf_io::put_u64(header, p1);
+    isf_io::put_u64(header, q1);
+    isf_io::put_u64(header, p2);
+    isf_io::put_u64(header, q2);
+    isf_io::put_u64(header, d);
+    isf_io::put_u64(header, size);
+    isf_io::put_u64(header, data_len);
+
+    ok = ok && write_at(fd, header.data(), header.size(), 0)
+            && (fsync(fd) == 0);
+    if (close(fd) != 0)
+        ok = false;
+
+    if (! ok || (rename(tmp_path.c_str(), path) != 0))
+    {
+        unlink(tmp_path.c_str());
+        return NULL;
+    }
+
+    return open_isoscalars_mapped(path);
+}
+
+isoarray* open_isoscalars_mapped(const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || ((size_t)st.st_size < HEADER_LEN))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    size_t map_len = st.st_size;
+    void* map = mmap(NULL, map_len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    isf_mapping* mapping = new isf_mapping;
+    mapping->map = map;
+    mapping->map_len = map_len;
+
+    const unsigned char* pos = (const unsigned char*)map + MAGIC_LEN;
+    const unsigned char* end = (const unsigned char*)map + HEADER_LEN;
+    unsigned long long version, p, q, p1, q1, p2, q2, d, size, data_len;
+    if (memcmp(map, MAGIC, MAGIC_LEN)
+        || ! (isf_io::get_u64(pos, end, version) && (version == FORMAT_VERSION)
+        && isf_io::get_u64(pos, end, p)  && isf_io::get_u64(pos, end, q)
+        && isf_io::get_u64(pos, end, p1) && isf_io::get_u64(pos, end, q1)
+        && isf_io::get_u64(pos, end, p2) && isf_io::get_u64(pos, end, q2)
+        && isf_io::get_u64(pos, end, d)
+        && isf_io::get_u64(pos, end, size)
+        && isf_io::get_u64(pos, end, data_len)))
+    {
+        delete mapping;
+        return NULL;
+    }
+
+    /* Check that the header is consistent and that the file is the right
+        length; the values themselves are checked as they are used. Once
+        the size is known to fit in the file, the tables' length can't
+        overflow. */
+    size_t expected_size;
+    if (! isf_io::check_coupling(p, q, p1, q1, p2, q2, d, expected_size)
+        || (size != expected_size) || (size >= map_len / 8))
+    {
+        delete mapping;
+        return NULL;
+    }
+
+    size_t tables_len = ROW_ENTRY_LEN * d * (p+1) + 8 * size;
+    if ((HEADER_LEN + tables_len > map_len)
+        || (data_len != map_len - HEADER_LEN - tables_len))
+    {
+        delete mapping;
+        return NULL;
+    }
+
+    mapping->rows = (const unsigned char*)map + HEADER_LEN;
+    mapping->offsets = mapping->rows + ROW_ENTRY_LEN * d * (p+1);
+    mapping->data = mapping->offsets + 8 * size;
+    mapping->data_len = data_len;
+    mapping->row_size = (q+1) * (p1+1) * (q1+1) * (p2+1);
+    mapping->checked = std::vector<std::atomic<bool> >(d * (p+1));
+
+    return new isoarray(p, q, p1, q1, p2, q2, d, mapping);
+}
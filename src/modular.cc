@@ -0,0 +1,608 @@
+/* libSU3: Multi-modular engine for calculating isoscalar factors exactly.
+
+    Every ISF is r * sqrt(m) for some rational r and squarefree integer m,
+    and the same is true of every intermediate value in the recursions, as
+    long as the degenerate reps are not normalised. So instead of running
+    the recursions with sqrat values (where the rationals can grow very large),
+    we run them once for each of several word-sized primes, keeping r modulo
+    that prime and m as a set of small primes. This only needs fixed-width
+    arithmetic, and the different primes (channels) are independent, so they
+    are calculated in parallel.
+
+    Afterwards, each r is reconstructed from its residues by the Chinese
+    remainder theorem, followed by rational reconstruction. This is checked
+    against a further prime, and if the check fails we repeat with more primes.
+    Finally, the degenerate reps are normalised and the sign convention is
+    applied, exactly as in the sqrat engine. As the results are exact, they
+    match those of the sqrat engine bit-for-bit.
+
+    A channel can fail if its prime happens to divide a value we need to divide
+    by. Such channels are simply dropped and replaced by another prime.
+*/
+
+#include <stdint.h>
+
+#include <atomic>
+#include <iterator>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "SU3_internal.h"
+
+/* The primes which may appear in m. Recursion coefficients with any larger
+    prime factor make the engine give up (see isoscalars_modular()), but this
+    only happens for very large reps. */
+static const unsigned long long small_primes[128] = {
+      2,   3,   5,   7,  11,  13,  17,  19,  23,  29,  31,  37,  41,  43,  47,  53,
+     59,  61,  67,  71,  73,  79,  83,  89,  97, 101, 103, 107, 109, 113, 127, 131,
+    137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193, 197, 199, 211, 223,
+    227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281, 283, 293, 307, 311,
+    313, 317, 331, 337, 347, 349, 353, 359, 367, 373, 379, 383, 389, 397, 401, 409,
+    419, 421, 431, 433, 439, 443, 449, 457, 461, 463, 467, 479, 487, 491, 499, 503,
+    509, 521, 523, 541, 547, 557, 563, 569, 571, 577, 587, 593, 599, 601, 607, 613,
+    617, 619, 631, 641, 643, 647, 653, 659, 661, 673, 677, 683, 691, 701, 709, 719
+};
+
+/* Thrown when a channel fails, ie. when its prime turns out to be unlucky */
+struct modular_channel_failure {};
+
+/* Thrown when the engine can't represent some value */
+struct modular_unsupported {};
+
+/* The prime for the channel running on this thread */
+static thread_local unsigned long long modulus;
+
+/* Helpers for arithmetic modulo 'modulus'. The moduli are below 2^31,
+    so products fit in 64 bits. */
+static unsigned long long mod_mul(unsigned long long a, unsigned long long b)
+{
+    return (a * b) % modulus;
+}
+
+static unsigned long long mod_pow(unsigned long long a, unsigned long long e)
+{
+    unsigned long long result = 1;
+    while (e)
+    {
+        if (e & 1) result = mod_mul(result, a);
+        a = mod_mul(a, a);
+        e >>= 1;
+    }
+    return result;
+}
+
+static unsigned long long mod_inverse(unsigned long long a)
+{
+    if (a == 0) throw modular_channel_failure();
+    return mod_pow(a, modulus - 2);
+}
+
+static unsigned long long mod_reduce(long v)
+{
+    long r = v % (long)modulus;
+    return (r < 0) ? r + modulus : r;
+}
+
+/* Product of the small primes in a radical, modulo 'modulus' */
+static unsigned long long radical_product(const unsigned long long m[2])
+{
+    unsigned long long result = 1;
+    int i;
+    for (i = 0; i < 2; ++i)
+    {
+        unsigned long long bits = m[i];
+        while (bits)
+        {
+            result = mod_mul(result, small_primes[64*i + __builtin_ctzll(bits)]);
+            bits &= bits - 1;
+        }
+    }
+    return result;
+}
+
+modular_value::modular_value(long v) : r(mod_reduce(v))
+{
+    m[0] = m[1] = 0;
+}
+
+modular_value& modular_value::operator+=(const modular_value& other)
+{
+    *this = *this + other;
+    return *this;
+}
+
+modular_value operator-(const modular_value& a)
+{
+    modular_value result = a;
+    result.r = a.r ? modulus - a.r : 0;
+    return result;
+}
+
+/* Values can only be added if they have the same radical, unless one is zero.
+    In exact arithmetic this is always true (otherwise the sum couldn't be
+    represented as r * sqrt(m)), so if it fails, then some value which is really
+    nonzero must be zero modulo our prime. */
+modular_value operator+(const modular_value& a, const modular_value& b)
+{
+    if (b.r == 0) return a;
+    if (a.r == 0) return b;
+    if ((a.m[0] != b.m[0]) || (a.m[1] != b.m[1]))
+        throw modular_channel_failure();
+
+    modular_value result = a;
+    result.r = (a.r + b.r) % modulus;
+    return result;
+}
+
+modular_value operator-(const modular_value& a, const modular_value& b)
+{
+    return a + (-b);
+}
+
+/* r1 sqrt(m1) * r2 sqrt(m2) = r1 r2 gcd(m1,m2) sqrt(m1 m2 / gcd(m1,m2)^2) */
+modular_value operator*(const modular_value& a, const modular_value& b)
+{
+    modular_value result;
+    if ((a.r == 0) || (b.r == 0)) return result;
+
+    unsigned long long common[2] = {a.m[0] & b.m[0], a.m[1] & b.m[1]};
+    result.r = mod_mul(mod_mul(a.r, b.r), radical_product(common));
+    result.m[0] = a.m[0] ^ b.m[0];
+    result.m[1] = a.m[1] ^ b.m[1];
+    return result;
+}
+
+/* r1 sqrt(m1) / (r2 sqrt(m2)) = (r1 sqrt(m1) * sqrt(m2)) / (r2 m2) */
+modular_value operator/(const modular_value& a, const modular_value& b)
+{
+    if (b.r == 0) throw modular_channel_failure();
+
+    modular_value root_m2;
+    root_m2.r = 1;
+    root_m2.m[0] = b.m[0];
+    root_m2.m[1] = b.m[1];
+
+    modular_value result = a * root_m2;
+    result.r = mod_mul(result.r, mod_inverse(mod_mul(b.r, radical_product(b.m))));
+    return result;
+}
+
+/* sign(num*den) * sqrt(|num/den|) = sign(num*den) * sqrt(|num*den|) / |den| */
+static modular_value calc_signed_sqrt(long num, long den)
+{
+    modular_value result;
+
+    bool negative = (num < 0) != (den < 0);
+    unsigned long long a = (num < 0) ? -num : num;
+    unsigned long long b = (den < 0) ? -den : den;
+    unsigned long long b_mod = b % modulus;
+
+    /* Split |num*den| into a square and a squarefree part, one prime at a time */
+    result.r = 1;
+    int i;
+    for (i = 0; (i < 128) && ((a > 1) || (b > 1)); ++i)
+    {
+        unsigned long long prime = small_primes[i];
+        long e = 0;
+        while (a % prime == 0) { a /= prime; ++e; }
+        while (b % prime == 0) { b /= prime; ++e; }
+
+        result.r = mod_mul(result.r, mod_pow(prime, e/2));
+        if (e % 2)
+            result.m[i/64] |= 1ULL << (i % 64);
+    }
+
+    if ((a > 1) || (b > 1))
+        throw modular_unsupported();
+
+    result.r = mod_mul(result.r, mod_inverse(b_mod));
+    if (negative)
+        result.r = result.r ? modulus - result.r : 0;
+    return result;
+}
+
+/* The recursions take square roots of the same few values over and over,
+    so each thread keeps the results for its current prime */
+struct signed_sqrt_key_hash
+{
+    size_t operator()(const std::pair<long, long>& key) const
+    {
+        return std::hash<long>()(key.first * 1000003L + key.second);
+    }
+};
+
+static thread_local unsigned long long signed_sqrt_modulus;
+static thread_local std::unordered_map<std::pair<long, long>, modular_value,
+                                        signed_sqrt_key_hash> signed_sqrt_cache;
+
+template<>
+modular_value signed_sqrt<modular_value>(long num, long den)
+{
+    if (num == 0) return modular_value();
+
+    if (signed_sqrt_modulus != modulus)
+    {
+        signed_sqrt_cache.clear();
+        signed_sqrt_modulus = modulus;
+    }
+
+    std::pair<long, long> key(num, den);
+    auto it = signed_sqrt_cache.find(key);
+    if (it != signed_sqrt_cache.end())
+        return it->second;
+
+    modular_value result = calc_signed_sqrt(num, den);
+    signed_sqrt_cache[key] = result;
+    return result;
+}
+
+/* As calc_signed_sqrt(), for very large reps. These values are rarely
+    repeated, so aren't cached. */
+template<>
+modular_value signed_sqrt_mpz<modular_value>(const mpz_class& num, const mpz_class& den)
+{
+    modular_value result;
+    if (num == 0) return result;
+
+    bool negative = (sgn(num) < 0) != (sgn(den) < 0);
+    mpz_class a = abs(num), b = abs(den);
+    unsigned long long b_mod = mpz_fdiv_ui(b.get_mpz_t(), modulus);
+
+    result.r = 1;
+    int i;
+    for (i = 0; (i < 128) && ((a > 1) || (b > 1)); ++i)
+    {
+        unsigned long prime = small_primes[i];
+        long e = 0;
+        while (mpz_divisible_ui_p(a.get_mpz_t(), prime))
+        {
+            mpz_divexact_ui(a.get_mpz_t(), a.get_mpz_t(), prime);
+            ++e;
+        }
+        while (mpz_divisible_ui_p(b.get_mpz_t(), prime))
+        {
+            mpz_divexact_ui(b.get_mpz_t(), b.get_mpz_t(), prime);
+            ++e;
+        }
+
+        result.r = mod_mul(result.r, mod_pow(prime, e/2));
+        if (e % 2)
+            result.m[i/64] |= 1ULL << (i % 64);
+    }
+
+    if ((a > 1) || (b > 1))
+        throw modular_unsupported();
+
+    result.r = mod_mul(result.r, mod_inverse(b_mod));
+    if (negative)
+        result.r = result.r ? modulus - result.r : 0;
+    return result;
+}
+
+/* Orthogonalise, but don't normalise, the degenerate reps. This is the same
+    as the generic version (shw.cc), but as the later reps are not normalised
+    we need to divide by their norms. */
+template<>
+void isoscalar_context<modular_value>::orthonormalise()
+{
+    long k1, l1, k2, l2;
+    long m, n;
+
+    for (n = d-1; n >= 0; --n)
+        for (m = n+1; m < d; ++m)
+        {
+            modular_value v = inner_product(m, n) / inner_product(m, m);
+
+            for (k1 = q1; k1 <= p1+q1; ++k1)
+                for (l1 = 0; l1 <= q1; ++l1)
+                    for (k2 = q2; k2 <= p2+q2; ++k2)
+                    {
+                        l2 = A - (k1+l1+k2);
+                        if ((l2 < 0) || (l2 > q2)) continue;
+
+                        set_isf(n, p+q, 0, k1, l1, k2, l2,
+                            isf(n, p+q, 0, k1, l1, k2, l2)
+                            - v * isf(m, p+q, 0, k1, l1, k2, l2));
+                    }
+        }
+}
+
+/* The primes we use for channels: the largest primes below 2^31, in
+    decreasing order. These are found as needed and shared between calls. */
+static std::mutex channel_primes_lock;
+static std::vector<unsigned long long> channel_primes;
+
+static unsigned long long channel_prime(size_t i)
+{
+    std::lock_guard<std::mutex> guard(channel_primes_lock);
+
+    unsigned long long candidate = channel_primes.empty()
+                                    ? (1ULL << 31) : channel_primes.back();
+    while (channel_primes.size() <= i)
+    {
+        bool prime;
+        do
+        {
+            candidate -= 1;
+            prime = (candidate % 2 != 0);
+
+            unsigned long long f;
+            for (f = 3; prime && (f*f <= candidate); f += 2)
+                if (candidate % f == 0) prime = false;
+        } while (! prime);
+
+        channel_primes.push_back(candidate);
+    }
+
+    return channel_primes[i];
+}
+
+/* Limits on the number of channels, beyond which we give up */
+static const size_t max_channels = 1024;
+static const size_t max_failed_channels = 16;
+
+/* The result of running the recursions for one prime */
+struct modular_channel
+{
+    unsigned long long prime;
+    enum { OK, FAILED, CANNOT_CALCULATE, UNSUPPORTED } status;
+    std::vector<modular_value> values;
+};
+
+/* The number of channels still to be failed on purpose (see
+    set_modular_channel_failures()) */
+static std::atomic<long> forced_failures(0);
+
+long set_modular_channel_failures(long count)
+{
+    return forced_failures.exchange(count);
+}
+
+static void run_channel(modular_channel& channel, long p, long q, long p1,
+                        long q1, long p2, long q2, long d, size_t size)
+{
+    modulus = channel.prime;
+    channel.values.assign(size, modular_value());
+
+    long pending = forced_failures.load();
+    while ((pending > 0)
+            && ! forced_failures.compare_exchange_weak(pending, pending - 1)) {}
+    if (pending > 0)
+    {
+        channel.status = modular_channel::FAILED;
+        return;
+    }
+
+    try
+    {
+        if (isoscalars_fill(p, q, p1, q1, p2, q2, d, channel.values.data()))
+            channel.status = modular_channel::OK;
+        else
+            channel.status = modular_channel::CANNOT_CALCULATE;
+    }
+    catch (modular_channel_failure&)
+    {
+        channel.status = modular_channel::FAILED;
+    }
+    catch (modular_unsupported&)
+    {
+        channel.status = modular_channel::UNSUPPORTED;
+    }
+}
+
+/* Reconstruct a rational num/den from its value x modulo P, with
+    |num|, den <= bound. Returns false if there is no such rational. */
+static bool rational_reconstruct(const mpz_class& x, const mpz_class& P,
+                                    const mpz_class& bound, mpq_class& result)
+{
+    mpz_class r0 = P, r1 = x, t0 = 0, t1 = 1, quot, tmp;
+
+    while (r1 > bound)
+    {
+        quot = r0 / r1;
+        tmp = r0 - quot * r1; r0 = r1; r1 = tmp;
+        tmp = t0 - quot * t1; t0 = t1; t1 = tmp;
+    }
+
+    if ((abs(t1) > bound) || (t1 == 0)) return false;
+
+    mpz_class g;
+    mpz_gcd(g.get_mpz_t(), r1.get_mpz_t(), t1.get_mpz_t());
+    if (g != 1) return false;
+
+    result = mpq_class(r1, t1);
+    result.canonicalize();
+    return true;
+}
+
+/* Reconstruct every r from the channels [0, count-1), and check them
+    against the channel 'count-1'. Returns false if the check fails. */
+static bool reconstruct(const std::vector<modular_channel>& channels, size_t count,
+                        std::vector<mpq_class>& r, std::vector<const modular_value*>& radical)
+{
+    size_t nused = count - 1;
+    size_t size = channels[0].values.size();
+    size_t i, j;
+
+    /* CRT: x = sum_j r_j * y_j * (P/p_j), where y_j = (P/p_j)^(-1) mod p_j */
+    mpz_class P = 1;
+    for (j = 0; j < nused; ++j)
+        P *= (unsigned long)channels[j].prime;
+
+    std::vector<mpz_class> basis(nused);
+    for (j = 0; j < nused; ++j)
+    {
+        mpz_class Mj = P / (unsigned long)channels[j].prime;
+        mpz_class pj = (unsigned long)channels[j].prime, yj;
+        mpz_invert(yj.get_mpz_t(), Mj.get_mpz_t(), pj.get_mpz_t());
+        basis[j] = Mj * yj;
+    }
+
+    mpz_class bound = sqrt(P / 2);
+    const modular_channel& check = channels[count-1];
+    mpz_class check_prime = (unsigned long)check.prime;
+
+    r.assign(size, mpq_class(0));
+    radical.assign(size, NULL);
+
+    for (i = 0; i < size; ++i)
+    {
+        mpz_class x = 0;
+        for (j = 0; j < nused; ++j)
+        {
+            const modular_value& v = channels[j].values[i];
+            if (v.r)
+            {
+                x += basis[j] * (unsigned long)v.r;
+                if (! radical[i]) radical[i] = &v;
+                else if ((radical[i]->m[0] != v.m[0]) || (radical[i]->m[1] != v.m[1]))
+                    return false;
+            }
+        }
+        x %= P;
+
+        if (! rational_reconstruct(x, P, bound, r[i]))
+            return false;
+
+        /* Check the result against the last channel */
+        mpz_class num = r[i].get_num() % check_prime, den = r[i].get_den() % check_prime;
+        if (num < 0) num += check_prime;
+        mpz_class expected = (unsigned long)check.values[i].r;
+        if ((num - den * expected) % check_prime != 0)
+            return false;
+
+        if (check.values[i].r && radical[i]
+            && ((radical[i]->m[0] != check.values[i].m[0])
+                || (radical[i]->m[1] != check.values[i].m[1])))
+            return false;
+    }
+
+    return true;
+}
+
+/* Helper: The squarefree integer represented by a radical */
+static mpz_class radical_value(const modular_value* v)
+{
+    mpz_class result = 1;
+    if (! v) return result;
+
+    int i;
+    for (i = 0; i < 128; ++i)
+        if (v->m[i/64] & (1ULL << (i % 64)))
+            result *= (unsigned long)small_primes[i];
+    return result;
+}
+
+bool isoscalars_modular(long p, long q, long p1, long q1, long p2, long q2,
+                        long d, isoarray*& result)
+{
+    size_t size = d * (p+1) * (q+1) * (p1+1) * (q1+1) * (p2+1);
+    std::vector<modular_channel> channels;
+    std::vector<mpq_class> r;
+    std::vector<const modular_value*> radical;
+    size_t next_prime = 0, wanted = 4, failed = 0;
+
+    result = NULL;
+
+    while (true)
+    {
+        /* Run enough new channels to have 'wanted' successful ones */
+        while (channels.size() < wanted)
+        {
+            size_t first = channels.size();
+            channels.resize(wanted);
+
+            work_pool pool(0);
+            size_t j;
+            for (j = first; j < wanted; ++j)
+            {
+                channels[j].prime = channel_prime(next_prime++);
+                modular_channel* channel = &channels[j];
+                pool.add([=]()
+                    {
+                        run_channel(*channel, p, q, p1, q1, p2, q2, d, size);
+                    }, 1);
+            }
+            pool.run();
+
+            /* Handle the results, dropping unlucky channels */
+            std::vector<modular_channel> kept(std::make_move_iterator(channels.begin()),
+                                                std::make_move_iterator(channels.begin() + first));
+            for (j = first; j < wanted; ++j)
+            {
+                if (channels[j].status == modular_channel::UNSUPPORTED)
+                    return false;
+                if (channels[j].status == modular_channel::CANNOT_CALCULATE)
+                    return true;
+                if (channels[j].status == modular_channel::OK)
+                    kept.push_back(std::move(channels[j]));
+                else
+                    ++failed;
+            }
+            channels.swap(kept);
+
+            /* Unlucky primes are rare, so if many channels fail then something
+                can't be represented in this form. Let the sqrat engine handle it. */
+            if (failed > max_failed_channels)
+                return false;
+        }
+
+        if (reconstruct(channels, channels.size(), r, radical))
+            break;
+
+        wanted *= 2;
+        if (wanted > max_channels)
+            return false;
+    }
+
+    /* Normalise each degenerate rep and apply the sign convention, as in
+        isoscalar_context::orthonormalise() */
+    long A = (2*p1 + 2*p2 + 4*q1 + 4*q2 + p - q)/3;
+    long B = (-p1 + 2*p2 + q1 + 4*q2 + p - q)/3;
+    sqrat* coefficients = new sqrat[size];
+    long n, k1, l1, k2, l2;
+
+    #define SHW_INDEX(n, k1, l1, k2) \
+        (((((n) * (p+1) + p) * (q+1)) * (p1+1) + (k1)-q1) * (q1+1) + (l1)) * (p2+1) + (k2)-q2
+
+    for (n = 0; n < d; ++n)
+    {
+        mpq_class norm = 0;
+        for (k1 = q1; k1 <= p1+q1; ++k1)
+            for (l1 = 0; l1 <= q1; ++l1)
+                for (k2 = q2; k2 <= p2+q2; ++k2)
+                {
+                    l2 = A - (k1+l1+k2);
+                    if ((l2 < 0) || (l2 > q2)) continue;
+
+                    size_t i = SHW_INDEX(n, k1, l1, k2);
+                    norm += r[i] * r[i] * radical_value(radical[i]);
+                }
+
+        long k2max = min(p2+q2, B);
+        long l2min = max(0, B - p2 - q2);
+        while (r[SHW_INDEX(n, p1+q1, 0, k2max)] == 0)
+        {
+            k2max -= 1;
+            l2min += 1;
+        }
+        int sign = sgn(r[SHW_INDEX(n, p1+q1, 0, k2max)]);
+
+        /* Each coefficient is sign * r * sqrt(m / norm), so is stored as
+            sign(r) * r^2 * m / norm */
+        size_t per_rep = size / d, i;
+        for (i = n * per_rep; i < (n+1) * per_rep; ++i)
+        {
+            mpq_class v = r[i] * r[i] * radical_value(radical[i]) / norm;
+            if (sign * sgn(r[i]) < 0) v = -v;
+            coefficients[i] = sqrat(v.get_num(), v.get_den());
+        }
+    }
+
+    #undef SHW_INDEX
+
+    result = new isoarray(p, q, p1, q1, p2, q2, d, coefficients);
+    return true;
+}
@@ -0,0 +1,138 @@
+/* libSU3: Work-stealing thread pool for running independent calculations */
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+
+#include "SU3_internal.h"
+
+/* Whether this thread is running a task for a pool with several workers */
+static thread_local bool in_pool_task = false;
+
+/* nthreads <= 0 means "one thread per available core" */
+work_pool::work_pool(long nthreads) : nthreads(nthreads)
+{
+    if (this->nthreads <= 0)
+        this->nthreads = std::thread::hardware_concurrency();
+
+    /* hardware_concurrency() is allowed to return 0 if it can't tell */
+    if (this->nthreads <= 0)
+        this->nthreads = 1;
+}
+
+long work_pool::threads()
+{
+    return nthreads;
+}
+
+void work_pool::add(task t, double cost)
+{
+    queued_task qt = {t, cost};
+    pending.push_back(qt);
+}
+
+/* Internal: Find the next task for worker 'self' to run.
+    Returns false if there is no work left anywhere.
+*/
+bool work_pool::take(std::vector<worker_queue>& queues, long self, task& t)
+{
+    long n = queues.size();
+    long i;
+
+    /* Our own queue is sorted most expensive first, so take from the front */
+    {
+        std::lock_guard<std::mutex> guard(queues[self].lock);
+        if (! queues[self].tasks.empty())
+        {
+            t = queues[self].tasks.front();
+            queues[self].tasks.pop_front();
+            return true;
+        }
+    }
+
+    /* Otherwise steal the cheapest task from someone else's queue, leaving
+        the owner to carry on with its expensive tasks */
+    for (i = 1; i < n; ++i)
+    {
+        worker_queue& victim = queues[(self + i) % n];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (! victim.tasks.empty())
+        {
+            t = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void work_pool::run()
+{
+    /* Most expensive tasks first */
+    std::stable_sort(pending.begin(), pending.end(),
+        [](const queued_task& a, const queued_task& b)
+        { return a.cost > b.cost; });
+
+    long nworkers = std::min(nthreads, (long)pending.size());
+    if ((nworkers <= 1) || in_pool_task)
+    {
+        /* Not worth starting any threads, or the threads are already in
+            use by an outer pool */
+        size_t i;
+        for (i = 0; i < pending.size(); ++i)
+            pending[i].t();
+        pending.clear();
+        return;
+    }
+
+    /* Deal the tasks out round-robin, so that each queue is itself sorted
+        and the most expensive tasks are the first ones to start */
+    std::vector<worker_queue> queues(nworkers);
+    size_t i;
+    for (i = 0; i < pending.size(); ++i)
+        queues[i % nworkers].tasks.push_back(pending[i].t);
+    pending.clear();
+
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex error_lock;
+
+    auto worker = [&](long self)
+    {
+        bool was_in_task = in_pool_task;
+        in_pool_task = true;
+
+        task t;
+        while ((! failed) && take(queues, self, t))
+        {
+            try
+            {
+                t();
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> guard(error_lock);
+                if (! error)
+                    error = std::current_exception();
+                failed = true;
+            }
+        }
+
+        in_pool_task = was_in_task;
+    };
+
+    /* The calling thread acts as worker 0 */
+    std::vector<std::thread> threads;
+    long w;
+    for (w = 1; w < nworkers; ++w)
+        threads.push_back(std::thread(worker, w));
+    worker(0);
+
+    for (w = 0; w < (long)threads.size(); ++w)
+        threads[w].join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
@@ -4,70 +4,63 @@
 #include <assert.h>
 
 #include "SU3_internal.h"
+#include "SU3_constexpr.h"
 
-/* Calculate the dimension of one irrep */
+/* These are all implemented in SU3_constexpr.h, so that they can also be
+    evaluated at compile time */
 long dimension(long p, long q)
 {
-    return (p+1)*(q+1)*(p+q+2)/2;
+    return ct_dimension(p, q);
 }
 
-/* Calculate the degeneracy of the (p,q) irrep in the decomposition of
-    (p1,q1) x (p2,q2). Returns 0 if (p,q) is not a summand in this
-    decomposition.
-    Note: The intermediate values used in this function are based on those in
+/* Note: The intermediate values used in this function are based on those in
     arXiv:hep-th/9509167, but are all multiplied by 3 relative to that paper.
-    We also define delta = gamma + sigma.
+    We also define delta = gamma + sigma. Then the rep appears iff
+    eta = max(eta_prime + 3 - max(gamma, sigma), 0) is positive, where
+
+    eta_prime = min(3*p1 + sigma, 3*p2 + sigma, 3*q + sigma,
+                    3*q1 + gamma, 3*q2 + gamma, 3*p + gamma,
+                    2*delta, 3*(p1+q1) - delta, 3*(p2+q2) - delta)
+
+    Aside: This is invariant under all of the symmetry transformations.
+    See docs/degeneracy.md for proof.
 */
 long degeneracy(long p, long q, long p1, long q1, long p2, long q2)
 {
-    long gamma = (p1 + p2 - p);
-    long sigma = (q1 + q2 - q);
-    long delta = gamma + sigma;
-
-    /* Reps can only appear if gamma-sigma is a multiple of three */
-    if ((gamma - sigma) % 3) return 0;
-
-    /* Aside: This is invariant under all of the symmetry transformations.
-        See docs/degeneracy.md for proof.
-    */
-    long eta_prime = min(3*p1 + sigma, 3*p2 + sigma, 3*q + sigma,
-                         3*q1 + gamma, 3*q2 + gamma, 3*p + gamma,
-                         2*delta, 3*(p1+q1) - delta, 3*(p2+q2) - delta);
+    /* Eta should be 3*(degeneracy), and the degeneracy is an integer */
+    assert(! (ct_degeneracy_eta(p, q, p1, q1, p2, q2, p1 + p2 - p, q1 + q2 - q) % 3));
+    return ct_degeneracy(p, q, p1, q1, p2, q2);
+}
 
-    /* If we get here, we have a formula for the degeneracy of the
-        rep; the rep appears iff this value is positive */
-    long eta = max(eta_prime + 3 - max(gamma, sigma), 0);
+/* Phase changes under the 1<->2 symmetry and the conjugation symmetry.
 
-    /* Eta should now be 3*(degeneracy), and the degeneracy is an integer */
-    assert(! (eta % 3));
-    return eta/3;
-}
+    Note: The phase as given in Williams, converted to our variables, is
+    (-1)^(gamma/3 + sigma/3 + max(gamma/3, sigma/3)),
+    where the exponent is guaranteed to be an integer. Hence we can multiply
+    it by 3 to get an equivalent phase of:
+    (-1)^(gamma + sigma + max(gamma, sigma))
+ == (-1)^(2*max(gamma, sigma) + min(gamma, sigma))
+ == (-1)^min(gamma, sigma)
 
-/* Phase changes under the 1<->2 symmetry and the conjugation symmetry */
+    Williams' expression for the conjugation phase is the same, except with
+    max replaced by min. A similar argument simplifies it to
+    (-1)^max(gamma, sigma)
+*/
 long phase_exch_12(long p, long q, long p1, long q1, long p2, long q2)
 {
-    long gamma = (p1 + p2 - p);
-    long sigma = (q1 + q2 - q);
-
-    /* Note: The phase as given in Williams, converted to our variables, is
-        (-1)^(gamma/3 + sigma/3 + max(gamma/3, sigma/3)),
-        where the exponent is guaranteed to be an integer. Hence we can multiply
-        it by 3 to get an equivalent phase of:
-        (-1)^(gamma + sigma + max(gamma, sigma))
-     == (-1)^(2*max(gamma, sigma) + min(gamma, sigma))
-     == (-1)^min(gamma, sigma)
-    */
-    return SIGN(min(gamma, sigma));
+    return ct_phase_exch_12(p, q, p1, q1, p2, q2);
 }
 
 long phase_conj(long p, long q, long p1, long q1, long p2, long q2)
 {
-    long gamma = (p1 + p2 - p);
-    long sigma = (q1 + q2 - q);
+    return ct_phase_conj(p, q, p1, q1, p2, q2);
+}
 
-    /* Note: Williams' expression for this phase is the same as above,
-        except with max replaced by min. A similar argument simplifies
-        it to (-1)^max(gamma, sigma)
-    */
-    return SIGN(max(gamma, sigma));
+/* Estimated relative cost of calculating the ISFs for one coupling of
+    degeneracy d: the size of the array for one copy of the irrep, times
+    d^2 for the d copies and the orthonormalisation between them. */
+double isoscalars_cost(long p, long q, long p1, long q1, long p2, long q2, long d)
+{
+    (void)q2; // The array has no l2 axis
+    return (double)d * d * (p+1) * (q+1) * (p1+1) * (q1+1) * (p2+1);
 }
@@ -0,0 +1,225 @@
+/* libSU3: Binary format for storing isoscalar factors.
+
+    All integers are stored as 8 bytes, least significant byte first.
+
+    A single sqrat is stored as one byte giving the sign of the value
+    (0 = zero, 1 = positive, 2 = negative), followed (for nonzero values)
+    by the numerator and denominator of the rational number it stores.
+    Each of those is stored as its length in bytes, followed by the
+    magnitude, least significant byte first.
+
+    A whole isoarray is stored as:
+    * The 8-byte magic string "libSU3:I"
+    * The format version (FORMAT_VERSION below)
+    * p, q, p1, q1, p2, q2, d
+    * The number of coefficients, and the length of the coefficient data
+    * A checksum (checksum64) of the coefficient data
+    * The coefficient data itself, in the same order as in memory
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "SU3_internal.h"
+
+#define FORMAT_VERSION 1ULL
+#define MAGIC "libSU3:I"
+#define MAGIC_LEN 8
+
+/* No stored coupling has labels anywhere near this large (the coefficients
+    would not fit in memory), so anything larger means the file is corrupt.
+    It also keeps the arithmetic in degeneracy() well away from overflow. */
+#define MAX_STORED_LABEL 10000ULL
+
+/* 64-bit FNV-1a hash, used as a checksum */
+unsigned long long checksum64(const unsigned char* data, size_t len)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    size_t i;
+
+    for (i = 0; i < len; ++i)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+void isf_io::put_u64(std::string& out, unsigned long long v)
+{
+    int i;
+    for (i = 0; i < 8; ++i)
+        out.push_back((char)((v >> (8*i)) & 0xff));
+}
+
+bool isf_io::get_u64(const unsigned char*& pos, const unsigned char* end,
+                        unsigned long long& v)
+{
+    if (end - pos < 8) return false;
+
+    int i;
+    v = 0;
+    for (i = 0; i < 8; ++i)
+        v |= (unsigned long long)pos[i] << (8*i);
+
+    pos += 8;
+    return true;
+}
+
+/* Helper: Store the magnitude of an integer */
+static void put_mpz(std::string& out, const mpz_class& z)
+{
+    size_t len = 0;
+    unsigned char* bytes = (unsigned char*)mpz_export(NULL, &len, -1, 1, 0, 0,
+                                                        z.get_mpz_t());
+    isf_io::put_u64(out, len);
+    out.append((const char*)bytes, len);
+
+    /* mpz_export() allocates with GMP's allocator, so free it the same way */
+    void (*free_func)(void*, size_t);
+    mp_get_memory_functions(NULL, NULL, &free_func);
+    free_func(bytes, len);
+}
+
+static bool get_mpz(const unsigned char*& pos, const unsigned char* end,
+                    mpz_class& z)
+{
+    unsigned long long len;
+    if (! isf_io::get_u64(pos, end, len)) return false;
+    if ((unsigned long long)(end - pos) < len) return false;
+
+    mpz_import(z.get_mpz_t(), len, -1, 1, 0, 0, pos);
+    pos += len;
+    return true;
+}
+
+void isf_io::put_sqrat(std::string& out, const sqrat& v)
+{
+    int sign = sgn(v.v);
+    if (sign == 0)
+    {
+        out.push_back(0);
+        return;
+    }
+
+    out.push_back((sign > 0) ? 1 : 2);
+    put_mpz(out, v.v.get_num());
+    put_mpz(out, v.v.get_den());
+}
+
+bool isf_io::get_sqrat(const unsigned char*& pos, const unsigned char* end,
+                        sqrat& v)
+{
+    if (pos == end) return false;
+    unsigned char sign = *pos++;
+
+    if (sign == 0)
+    {
+        v = sqrat(0);
+        return true;
+    }
+    if (sign > 2) return false;
+
+    mpz_class num, den;
+    if (! get_mpz(pos, end, num)) return false;
+    if (! get_mpz(pos, end, den)) return false;
+    if (den == 0) return false;
+
+    if (sign == 2) num = -num;
+
+    /* sqrat(num, den) stores num/den directly */
+    v = sqrat(num, den);
+    return true;
+}
+
+std::string isf_io::encode(const isoarray& isf)
+{
+    std::string payload;
+    size_t i;
+    for (i = 0; i < isf.size; ++i)
+        put_sqrat(payload, isf.value(i));
+
+    std::string out(MAGIC, MAGIC_LEN);
+    put_u64(out, FORMAT_VERSION);
+    put_u64(out, isf.p);
+    put_u64(out, isf.q);
+    put_u64(out, isf.p1);
+    put_u64(out, isf.q1);
+    put_u64(out, isf.p2);
+    put_u64(out, isf.q2);
+    put_u64(out, isf.d);
+    put_u64(out, isf.size);
+    put_u64(out, payload.size());
+    put_u64(out, checksum64((const unsigned char*)payload.data(), payload.size()));
+    out += payload;
+
+    return out;
+}
+
+/* Helper: Multiply x by y, returning false if the result would overflow */
+static bool checked_mul(size_t& x, unsigned long long y)
+{
+    if ((y != 0) && (x > SIZE_MAX / y))
+        return false;
+    x *= y;
+    return true;
+}
+
+bool isf_io::check_coupling(unsigned long long p, unsigned long long q,
+                            unsigned long long p1, unsigned long long q1,
+                            unsigned long long p2, unsigned long long q2,
+                            unsigned long long d, size_t& size)
+{
+    if ((p > MAX_STORED_LABEL) || (q > MAX_STORED_LABEL)
+        || (p1 > MAX_STORED_LABEL) || (q1 > MAX_STORED_LABEL)
+        || (p2 > MAX_STORED_LABEL) || (q2 > MAX_STORED_LABEL)
+        || (d == 0) || (d != (unsigned long long)degeneracy(p, q, p1, q1, p2, q2)))
+        return false;
+
+    size = 1;
+    return checked_mul(size, d) && checked_mul(size, p+1) && checked_mul(size, q+1)
+        && checked_mul(size, p1+1) && checked_mul(size, q1+1)
+        && checked_mul(size, p2+1);
+}
+
+isoarray* isf_io::decode(const unsigned char* data, size_t len)
+{
+    const unsigned char* pos = data;
+    const unsigned char* end = data + len;
+
+    if ((len < MAGIC_LEN) || memcmp(data, MAGIC, MAGIC_LEN))
+        return NULL;
+    pos += MAGIC_LEN;
+
+    unsigned long long version, p, q, p1, q1, p2, q2, d, size, payload_len, checksum;
+    if (! (get_u64(pos, end, version) && (version == FORMAT_VERSION)
+        && get_u64(pos, end, p)  && get_u64(pos, end, q)
+        && get_u64(pos, end, p1) && get_u64(pos, end, q1)
+        && get_u64(pos, end, p2) && get_u64(pos, end, q2)
+        && get_u64(pos, end, d)
+        && get_u64(pos, end, size)
+        && get_u64(pos, end, payload_len)
+        && get_u64(pos, end, checksum)))
+        return NULL;
+
+    /* Check the header is consistent, then check the payload */
+    size_t expected_size;
+    if (! check_coupling(p, q, p1, q1, p2, q2, d, expected_size)
+        || (size != expected_size)
+        || (payload_len != (unsigned long long)(end - pos))
+        || (size > payload_len) // Each coefficient takes at least one byte
+        || (checksum != checksum64(pos, payload_len)))
+        return NULL;
+
+    sqrat* coefficients = new sqrat[size];
+    size_t i;
+    for (i = 0; i < size; ++i)
+        if (! get_sqrat(pos, end, coefficients[i]))
+        {
+            delete[] coefficients;
+            return NULL;
+        }
+
+    return new isoarray(p, q, p1, q1, p2, q2, d, coefficients);
+}
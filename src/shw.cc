@@ -2,7 +2,9 @@
     (that is, the state of highest I) */
 
 #include <stdio.h>
+#include <math.h>
 #include <stdexcept>
+#include <atomic>
 
 #include "SU3_internal.h"
 
@@ -12,64 +14,90 @@
     The arguments identify the state to be calclated, *not* the values
     of k1,l1,k2,l2 used in the recursion relation itself.
 */
-void isoscalar_context::step_k1_up(long n, long s, long k1, long l1)
+template<typename T>
+void isoscalar_context<T>::step_k1_up(long n, long s, long k1, long l1)
 {
     long k2 = (A+s)/2 - k1, l2 = (A-s)/2 - l1;
 
     /* Calculate coefficients for the A recursion relation */
-    sqrat a1, a2, a3, a4;
+    T a1, a2, a3, a4;
     a_coefficients(k1, l1, k2+1, l2, a1, a2, a3, a4);
 
     /* Calculate the value at (k1,l1,k2,l2) using surrounding values */
-    sqrat res = (-a1 * isf(n, p+q, 0, k1-1, l1, k2+1, l2)
+    T res = (-a1 * isf(n, p+q, 0, k1-1, l1, k2+1, l2)
                  -a3 * isf(n, p+q, 0, k1, l1-1, k2+1, l2)
                  -a4 * isf(n, p+q, 0, k1, l1, k2+1, l2-1)) / a2;
-    set_isf(n, p+q, 0, k1, l1, k2, l2, res);
+    set_shw(n, k1, l1, k2, l2, res);
 }
 
-void isoscalar_context::step_k1_down(long n, long s, long k1, long l1)
+template<typename T>
+void isoscalar_context<T>::step_k1_down(long n, long s, long k1, long l1)
 {
     long k2 = (A+s)/2 - k1, l2 = (A-s)/2 - l1;
 
     /* Calculate coefficients for the A recursion relation */
-    sqrat a1, a2, a3, a4;
+    T a1, a2, a3, a4;
     a_coefficients(k1+1, l1, k2, l2, a1, a2, a3, a4);
 
     /* Calculate the value at (k1,l1,k2,l2) using surrounding values */
-    sqrat res = (-a2 * isf(n, p+q, 0, k1+1, l1, k2-1, l2)
+    T res = (-a2 * isf(n, p+q, 0, k1+1, l1, k2-1, l2)
                  -a3 * isf(n, p+q, 0, k1+1, l1-1, k2, l2)
                  -a4 * isf(n, p+q, 0, k1+1, l1, k2, l2-1)) / a1;
-    set_isf(n, p+q, 0, k1, l1, k2, l2, res);
+    set_shw(n, k1, l1, k2, l2, res);
 }
 
-void isoscalar_context::step_l1_up(long n, long s, long k1, long l1)
+template<typename T>
+void isoscalar_context<T>::step_l1_up(long n, long s, long k1, long l1)
 {
     long k2 = (A+s)/2 - k1, l2 = (A-s)/2 - l1;
 
     /* Calculate coefficients for the B recursion relation */
-    sqrat b1, b2, b3, b4;
+    T b1, b2, b3, b4;
     b_coefficients(k1, l1-1, k2, l2, b1, b2, b3, b4);
 
     /* Calculate the value at (k1,l1,k2,l2) using surrounding values */
-    sqrat res = (-b1 * isf(n, p+q, 0, k1+1, l1-1, k2, l2)
+    T res = (-b1 * isf(n, p+q, 0, k1+1, l1-1, k2, l2)
                  -b2 * isf(n, p+q, 0, k1, l1-1, k2+1, l2)
                  -b4 * isf(n, p+q, 0, k1, l1-1, k2, l2+1)) / b3;
-    set_isf(n, p+q, 0, k1, l1, k2, l2, res);
+    set_shw(n, k1, l1, k2, l2, res);
 }
 
-void isoscalar_context::step_l1_down(long n, long s, long k1, long l1)
+template<typename T>
+void isoscalar_context<T>::step_l1_down(long n, long s, long k1, long l1)
 {
     long k2 = (A+s)/2 - k1, l2 = (A-s)/2 - l1;
 
     /* Calculate coefficients for the B recursion relation */
-    sqrat b1, b2, b3, b4;
+    T b1, b2, b3, b4;
     b_coefficients(k1, l1, k2, l2-1, b1, b2, b3, b4);
 
     /* Calculate the value at (k1,l1,k2,l2) using surrounding values */
-    sqrat res = (-b1 * isf(n, p+q, 0, k1+1, l1, k2, l2-1)
+    T res = (-b1 * isf(n, p+q, 0, k1+1, l1, k2, l2-1)
                  -b2 * isf(n, p+q, 0, k1, l1, k2+1, l2-1)
                  -b3 * isf(n, p+q, 0, k1, l1+1, k2, l2-1)) / b4;
-    set_isf(n, p+q, 0, k1, l1, k2, l2, res);
+    set_shw(n, k1, l1, k2, l2, res);
+}
+
+/* Helper: Add a value's square to a running norm. Modular values are never
+    normalised (see modular.cc), so nothing is kept for them. */
+template<typename T>
+static inline void add_square(T& norm, const T& value)
+{
+    norm += value * value;
+}
+
+static inline void add_square(modular_value&, const modular_value&)
+{}
+
+/* Each coupling to the state of highest weight is calculated exactly once,
+    so for a single rep we can find the norm as we go */
+template<typename T>
+void isoscalar_context<T>::set_shw(long n, long k1, long l1, long k2, long l2,
+                                    T value)
+{
+    if (d == 1)
+        add_square(shw_norm, value);
+    set_isf(n, p+q, 0, k1, l1, k2, l2, value);
 }
 
 /* Step down from one plane (at s+2) to the next plane (at s).
@@ -95,7 +123,8 @@ void isoscalar_context::step_l1_down(long n, long s, long k1, long l1)
     request (certain) non-existent states and just returns 0 for the coupling
     coefficient. This is exactly what we need for the stepping to work properly.
 */
-void isoscalar_context::step_s_down(long n, long s)
+template<typename T>
+void isoscalar_context<T>::step_s_down(long n, long s)
 {
     /* Calculate unconstrained versions of the min/max values */
     long k1min_u = (A + s)/2 - (p2+q2);
@@ -156,10 +185,11 @@ void isoscalar_context::step_s_down(long n, long s)
 }
 
 /* Calculate the inner product of two sets of isoscalar factors */
-sqrat isoscalar_context::inner_product(long m, long n)
+template<typename T>
+T isoscalar_context<T>::inner_product(long m, long n)
 {
     long k1, l1, k2, l2;
-    sqrat result = sqrat(0);
+    T result = T(0);
 
     for (k1 = q1; k1 <= p1+q1; ++k1)
         for (l1 = 0; l1 <= q1; ++l1)
@@ -181,19 +211,26 @@ sqrat isoscalar_context::inner_product(long m, long n)
     This can throw std::logic_error if we can't calculate directly. This should
     never happen, however, as isoscalars() has logic to avoid those cases.
 */
-void isoscalar_context::calc_shw()
+template<typename T>
+void isoscalar_context<T>::calc_shw()
 {
     long smax = min(A, (2*q1 + 2*q2 + 4*p1 + 4*p2 + q - p)/3);
     long smin = max(p + q, abs(2*q1 + 2*q2 - A));
 
     long k1min, k1max, l1min, l1max;
-    long k1, l1, k2, l2;
+    long k1, l1;
 
     /* Fill out the topmost d planes for each of the degenerate reps */
     long m, n, s;
     for (m = 0; m < d; ++m)
     {
         s = smax - 2*m;
+        if (checkpoint && (s > checkpoint->resume_s()))
+        {
+            shw_norm_valid = false;
+            continue;
+        }
+
         k1min = max(q1, (A + s)/2 - (p2+q2));
         k1max = min(p1+q1, (A + s)/2 - q2);
         l1min = max(0, (A - s)/2 - q2);
@@ -201,7 +238,7 @@ void isoscalar_context::calc_shw()
 
         /* Set one ISF in one particular irrep (leaving the same ISF
             in the other irreps as zero) */
-        set_isf(m, p+q, 0, k1min, l1min, (A+s)/2 - k1min, (A-s)/2 - l1min, 1);
+        set_shw(m, k1min, l1min, (A+s)/2 - k1min, (A-s)/2 - l1min, 1);
 
         for (n = 0; n < d; ++n)
         {
@@ -221,20 +258,108 @@ void isoscalar_context::calc_shw()
                     step_l1_up(n, s, k1, l1);
             }
         }
+
+        if (checkpoint)
+            checkpoint->finish_plane(s);
     }
 
     /* Now we have filled out the topmost d planes, step down
         through the rest of them */
     for (s = smax - 2*d; s >= smin; s -= 2)
+    {
+        if (checkpoint && (s > checkpoint->resume_s()))
+        {
+            shw_norm_valid = false;
+            continue;
+        }
+
         for (n = 0; n < d; ++n)
             step_s_down(n, s);
 
-    /* Orthonormalise the ISFs for different representations.
-        We orthogonalise each rep against *later* reps in order to get equivalent
+        if (checkpoint)
+            checkpoint->finish_plane(s);
+    }
+
+    /* Finally, make the degenerate reps orthonormal */
+    if (checkpoint && checkpoint->shw_done())
+        return;
+
+    orthonormalise();
+    if (checkpoint)
+        checkpoint->finish_shw();
+}
+
+static std::atomic<bool> single_rep_pass(true);
+
+void set_single_rep_normalisation(bool enabled)
+{
+    single_rep_pass = enabled;
+}
+
+/* Apply the sign convention to the norm 'v' of rep n, giving the value to
+    divide the rep by to normalise it.
+
+    The convention is that F(p+q, 0; p1+q1, 0, k2max, l2min) > 0.
+    Here k2max means "The highest k2 which couples the state
+    (p1+q1, 0) in rep 1 to (p+q, 0) in the target rep".
+    This works out to be determined by the following:
+*/
+template<typename T>
+T isoscalar_context<T>::signed_norm(long n, T v)
+{
+    long B = (-p1 + 2*p2 + q1 + 4*q2 + p - q)/3;
+    long k2max = min(p2+q2, B);
+    long l2min = max(0, B - p2 - q2);
+
+    /* Step through until we find a state which couples */
+    while (negligible(isf(n, p+q, 0, p1+q1, 0, k2max, l2min), v))
+    {
+        k2max -= 1;
+        l2min += 1;
+    }
+
+    /* If this state has negative coupling, we need to negate the rep,
+        in order to match the sign convention */
+    if (isf(n, p+q, 0, p1+q1, 0, k2max, l2min) < 0)
+        v = -v;
+
+    return v;
+}
+
+/* Orthonormalise the ISFs for different representations, and apply the
+    sign convention. This only needs the couplings to the state of highest
+    weight, which are all that have been calculated when this is called. */
+template<typename T>
+void isoscalar_context<T>::orthonormalise()
+{
+    long k1, l1, k2, l2;
+    long m, n;
+
+    /* For a single rep, there is nothing to orthogonalise against, and we
+        already have the norm (see set_shw()), so only one pass is needed */
+    if ((d == 1) && single_rep_pass)
+    {
+        T v = signed_norm(0, sqrt(shw_norm_valid ? shw_norm : inner_product(0, 0)));
+
+        /* Normalise in place, without going through isf() and set_isf() */
+        for (k1 = q1; k1 <= p1+q1; ++k1)
+            for (l1 = 0; l1 <= q1; ++l1)
+                for (k2 = q2; k2 <= p2+q2; ++k2)
+                {
+                    l2 = A - (k1+l1+k2);
+                    if ((l2 < 0) || (l2 > q2)) continue;
+
+                    T& x = coefficients[index(0, p+q, 0, k1, l1, k2)];
+                    x = x / v;
+                }
+        return;
+    }
+
+    /* We orthogonalise each rep against *later* reps in order to get equivalent
         results to the algorithm described in our references. */
     for (n = d-1; n >= 0; --n)
     {
-        sqrat v;
+        T v;
         for (m = n+1; m < d; ++m)
         {
             /* Factor to multiply rep 'm' by when subtracting from rep 'n'.
@@ -257,30 +382,8 @@ void isoscalar_context::calc_shw()
                     }
         }
 
-        /* Normalisation.
-            Note that, at the same time, we enforce the sign convention that
-            F(p+q, 0; p1+q1, 0, k2max, l2min) > 0.
-            Here k2max means "The highest k2 which couples the state
-            (p1+q1, 0) in rep 1 to (p+q, 0) in the target rep".
-            This works out to be determined by the following:
-        */
-        long B = (-p1 + 2*p2 + q1 + 4*q2 + p - q)/3;
-        long k2max = min(p2+q2, B);
-        long l2min = max(0, B - p2 - q2);
-
-        v = sqrt(inner_product(n, n));
-
-        /* Step through until we find a state which couples */
-        while (isf(n, p+q, 0, p1+q1, 0, k2max, l2min) == 0)
-        {
-            k2max -= 1;
-            l2min += 1;
-        }
-
-        /* If this state has negative coupling, we need to negate the rep,
-            in order to match the sign convention */
-        if (isf(n, p+q, 0, p1+q1, 0, k2max, l2min) < 0)
-            v = -v;
+        /* Normalisation, with the sign convention */
+        v = signed_norm(n, sqrt(inner_product(n, n)));
 
         for (k1 = q1; k1 <= p1+q1; ++k1)
             for (l1 = 0; l1 <= q1; ++l1)
@@ -296,3 +399,31 @@ void isoscalar_context::calc_shw()
                 }
     }
 }
+
+/* Instantiate the functions defined here for each type of value they are
+    used with. The class itself is instantiated in isoscalars.cc, and
+    orthonormalise() is specialised for modular values in modular.cc. */
+#define INSTANTIATE_SHW(T) \
+    template void isoscalar_context<T>::step_k1_up(long, long, long, long); \
+    template void isoscalar_context<T>::step_k1_down(long, long, long, long); \
+    template void isoscalar_context<T>::step_l1_up(long, long, long, long); \
+    template void isoscalar_context<T>::step_l1_down(long, long, long, long); \
+    template void isoscalar_context<T>::set_shw(long, long, long, long, long, T); \
+    template void isoscalar_context<T>::step_s_down(long, long); \
+    template T isoscalar_context<T>::inner_product(long, long); \
+    template void isoscalar_context<T>::calc_shw();
+
+INSTANTIATE_SHW(sqrat)
+INSTANTIATE_SHW(double)
+INSTANTIATE_SHW(long double)
+INSTANTIATE_SHW(modular_value)
+#ifdef SU3_USE_MPFR
+INSTANTIATE_SHW(mpfr_value)
+#endif
+
+template void isoscalar_context<sqrat>::orthonormalise();
+template void isoscalar_context<double>::orthonormalise();
+template void isoscalar_context<long double>::orthonormalise();
+#ifdef SU3_USE_MPFR
+template void isoscalar_context<mpfr_value>::orthonormalise();
+#endif
@@ -0,0 +1,96 @@
+/* libSU3: Couplings to the state of highest weight on their own.
+
+    The first phase of the calculation in isoscalars.cc fixes each
+    degenerate rep by its couplings to the state of highest weight, and the
+    second fills in the rest of each multiplet from those. isoscalars_shw()
+    runs just the first phase, for callers which need nothing else.
+*/
+
+#include <assert.h>
+
+#include "SU3_internal.h"
+
+shwarray::shwarray(long p, long q, long p1, long q1, long p2, long q2, long d,
+                    sqrat* values) : values(values), p(p), q(q), p1(p1),
+                    q1(q1), p2(p2), q2(q2), d(d)
+{
+}
+
+shwarray::~shwarray()
+{
+    delete[] values;
+}
+
+size_t shwarray::size() const
+{
+    return d * (p1+1) * (q1+1) * (p2+1);
+}
+
+sqrat shwarray::operator()(long n, long k1, long l1, long k2, long l2) const
+{
+    if (    (n  < 0 ) || (n  >= d   )
+         || (k1 < q1) || (k1 > p1+q1) || (l1 < 0) || (l1 > q1)
+         || (k2 < q2) || (k2 > p2+q2) || (l2 < 0) || (l2 > q2))
+        return 0;
+
+    if (k1+l1+k2+l2-p-q != (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3)
+        return 0;
+
+    size_t index = ((n * (p1+1) + k1-q1) * (q1+1) + l1) * (p2+1) + k2-q2;
+    assert(index < size());
+    return values[index];
+}
+
+/* Helper: Copy the couplings to the state of highest weight out of a full
+    isoarray */
+static shwarray* extract_shw(const isoarray* isf)
+{
+    long p = isf->p, q = isf->q, p1 = isf->p1, q1 = isf->q1,
+        p2 = isf->p2, q2 = isf->q2, d = isf->d;
+    long B = (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3;
+
+    sqrat* values = new sqrat[d * (p1+1) * (q1+1) * (p2+1)];
+    sqrat* pos = values;
+    long n, k1, l1, k2;
+    for (n = 0; n < d; ++n)
+        for (k1 = q1; k1 <= p1+q1; ++k1)
+            for (l1 = 0; l1 <= q1; ++l1)
+                for (k2 = q2; k2 <= p2+q2; ++k2)
+                    *pos++ = (*isf)(n, p+q, 0, k1, l1, k2, B + p+q - k1-l1-k2);
+
+    return new shwarray(p, q, p1, q1, p2, q2, d, values);
+}
+
+shwarray* isoscalars_shw(long p, long q, long p1, long q1, long p2, long q2)
+{
+    long d = degeneracy(p, q, p1, q1, p2, q2);
+    if (! d) return NULL;
+
+    isoarray* isf = builtin_isoscalars(p, q, p1, q1, p2, q2);
+    if (! isf)
+    {
+        sqrat* values = new sqrat[d * (p1+1) * (q1+1) * (p2+1)];
+        bool ok;
+        try
+        {
+            ok = isoscalars_fill_shw(p, q, p1, q1, p2, q2, d, values);
+        }
+        catch (...)
+        {
+            delete[] values;
+            throw;
+        }
+
+        if (ok)
+            return new shwarray(p, q, p1, q1, p2, q2, d, values);
+        delete[] values;
+
+        /* The symmetry relations mix the state of highest weight with the
+            other states, so we need everything */
+        isf = isoscalars(p, q, p1, q1, p2, q2);
+    }
+
+    shwarray* shw = extract_shw(isf);
+    delete isf;
+    return shw;
+}
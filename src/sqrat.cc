@@ -213,7 +213,7 @@ bool operator>=(const sqrat& left, const sqrat& right)
 }
 
 /* Conversions to various types */
-char* sqrat::tostring(char* buffer, size_t len)
+char* sqrat::tostring(char* buffer, size_t len) const
 {
     if (v < 0)
     {
@@ -225,7 +225,7 @@ char* sqrat::tostring(char* buffer, size_t len)
     return buffer;
 }
 
-sqrat::operator double()
+sqrat::operator double() const
 {
     double x = v.get_d();
 
@@ -236,3 +236,11 @@ sqrat::operator double()
     else
         return sqrt(x);
 }
+
+/* Approximate number of bytes of memory used by this value */
+size_t sqrat::memory_usage() const
+{
+    return sizeof(sqrat)
+         + (v.get_num_mpz_t()->_mp_alloc + v.get_den_mpz_t()->_mp_alloc)
+            * sizeof(mp_limb_t);
+}
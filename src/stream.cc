@@ -0,0 +1,256 @@
+/* libSU3: Calculation of isoscalar factors one row at a time.
+
+    The recursions in isoscalars.cc only ever look at two rows (values of k)
+    at once, once the couplings to the state of highest weight are known.
+    So, with a row handler, isoscalar_context keeps just those and passes on
+    each row as it is finished.
+
+    Streamed rows are written using the encoding in serialize.cc:
+    * The 8-byte magic string "libSU3:S"
+    * The format version (FORMAT_VERSION below)
+    * p, q, p1, q1, p2, q2, d
+    Followed by, for each row:
+    * n, k
+    * The length of the coefficient data, and a checksum (checksum64) of it
+    * The coefficient data itself, in the same order as in an isoarray
+*/
+
+#include <assert.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "SU3_internal.h"
+
+#define FORMAT_VERSION 1ULL
+#define MAGIC "libSU3:S"
+#define MAGIC_LEN 8
+#define HEADER_LEN (MAGIC_LEN + 8*8)
+#define ROW_HEADER_LEN (4*8)
+
+isorow::isorow(long p, long q, long p1, long q1, long p2, long q2, long d,
+                long n, long k, const sqrat* values) : values(values), p(p),
+                q(q), p1(p1), q1(q1), p2(p2), q2(q2), d(d), n(n), k(k)
+{
+}
+
+size_t isorow::size() const
+{
+    return (q+1) * (p1+1) * (q1+1) * (p2+1);
+}
+
+sqrat isorow::operator()(long l, long k1, long l1, long k2, long l2) const
+{
+    if (    (l  < 0 ) || (l  > q    )
+         || (k1 < q1) || (k1 > p1+q1) || (l1 < 0) || (l1 > q1)
+         || (k2 < q2) || (k2 > p2+q2) || (l2 < 0) || (l2 > q2))
+        return 0;
+
+    if (k1+l1+k2+l2-k-l != (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3)
+        return 0;
+
+    size_t index = ((l * (p1+1) + k1-q1) * (q1+1) + l1) * (p2+1) + k2-q2;
+    assert(index < size());
+    return values[index];
+}
+
+/* Helper: Pass on each row of a fully-calculated isoarray */
+static void stream_isoarray(const isoarray& isf, const isorow_callback& callback)
+{
+    size_t size;
+    const sqrat* coefficients = isf_io::coefficients(isf, size);
+    size_t row_size = (isf.q+1) * (isf.p1+1) * (isf.q1+1) * (isf.p2+1);
+
+    long n, k;
+    for (n = 0; n < isf.d; ++n)
+        for (k = isf.p+isf.q; k >= isf.q; --k)
+        {
+            isorow row(isf.p, isf.q, isf.p1, isf.q1, isf.p2, isf.q2, isf.d, n, k,
+                        coefficients + (n * (isf.p+1) + k-isf.q) * row_size);
+            callback(row);
+        }
+}
+
+bool isoscalars_stream(long p, long q, long p1, long q1, long p2, long q2,
+                        const isorow_callback& callback)
+{
+    long d = degeneracy(p, q, p1, q1, p2, q2);
+    if (! d) return false;
+
+    /* Small couplings are in the built-in tables anyway */
+    isoarray* isf = builtin_isoscalars(p, q, p1, q1, p2, q2);
+    if (isf)
+    {
+        try
+        {
+            stream_isoarray(*isf, callback);
+        }
+        catch (...)
+        {
+            delete isf;
+            throw;
+        }
+
+        delete isf;
+        return true;
+    }
+
+    std::vector<sqrat> window(isoscalars_window_size(p, q, p1, q1, p2, q2, d));
+    isf_row_handler<sqrat> on_row = [&](long n, long k, const sqrat* values)
+    {
+        isorow row(p, q, p1, q1, p2, q2, d, n, k, values);
+        callback(row);
+    };
+
+    if (isoscalars_fill_rows(p, q, p1, q1, p2, q2, d, window.data(), on_row))
+        return true;
+
+    /* The symmetry relations need the whole of the other coupling */
+    isf = isoscalars(p, q, p1, q1, p2, q2);
+    try
+    {
+        stream_isoarray(*isf, callback);
+    }
+    catch (...)
+    {
+        delete isf;
+        throw;
+    }
+
+    delete isf;
+    return true;
+}
+
+/* Thrown from inside the calculation to stop it if the output fails */
+struct stream_write_failed {};
+
+bool isoscalars_stream(long p, long q, long p1, long q1, long p2, long q2,
+                        FILE* out)
+{
+    long d = degeneracy(p, q, p1, q1, p2, q2);
+    if (! d) return false;
+
+    std::string header(MAGIC, MAGIC_LEN);
+    isf_io::put_u64(header, FORMAT_VERSION);
+    isf_io::put_u64(header, p);
+    isf_io::put_u64(header, q);
+    isf_io::put_u64(header, p1);
+    isf_io::put_u64(header, q1);
+    isf_io::put_u64(header, p2);
+    isf_io::put_u64(header, q2);
+    isf_io::put_u64(header, d);
+    if (fwrite(header.data(), 1, header.size(), out) != header.size())
+        return false;
+
+    isorow_callback write_row = [out](const isorow& row)
+    {
+        std::string payload;
+        size_t i;
+        for (i = 0; i < row.size(); ++i)
+            isf_io::put_sqrat(payload, row.data()[i]);
+
+        std::string record;
+        isf_io::put_u64(record, row.n);
+        isf_io::put_u64(record, row.k);
+        isf_io::put_u64(record, payload.size());
+        isf_io::put_u64(record, checksum64((const unsigned char*)payload.data(),
+                                            payload.size()));
+        record += payload;
+
+        if (fwrite(record.data(), 1, record.size(), out) != record.size())
+            throw stream_write_failed();
+    };
+
+    try
+    {
+        isoscalars_stream(p, q, p1, q1, p2, q2, write_row);
+    }
+    catch (stream_write_failed&)
+    {
+        return false;
+    }
+
+    return fflush(out) == 0;
+}
+
+/* Helper: Read and check one row */
+static bool read_row(FILE* in, long p, long q, long p1, long q1, long p2,
+                        long d, sqrat* coefficients, std::vector<bool>& seen)
+{
+    unsigned char buf[ROW_HEADER_LEN];
+    if (fread(buf, 1, ROW_HEADER_LEN, in) != ROW_HEADER_LEN)
+        return false;
+
+    const unsigned char* pos = buf;
+    const unsigned char* end = buf + ROW_HEADER_LEN;
+    unsigned long long n, k, payload_len, checksum;
+    if (! (isf_io::get_u64(pos, end, n) && isf_io::get_u64(pos, end, k)
+        && isf_io::get_u64(pos, end, payload_len)
+        && isf_io::get_u64(pos, end, checksum)))
+        return false;
+
+    size_t row_size = (q+1) * (p1+1) * (q1+1) * (p2+1);
+    if ((n >= (unsigned long long)d) || (k < (unsigned long long)q)
+        || (k > (unsigned long long)(p+q)) || seen[n * (p+1) + k-q]
+        || (payload_len < row_size)) // Each coefficient takes at least one byte
+        return false;
+
+    std::vector<unsigned char> payload(payload_len);
+    if ((fread(payload.data(), 1, payload_len, in) != payload_len)
+        || (checksum != checksum64(payload.data(), payload_len)))
+        return false;
+
+    pos = payload.data();
+    end = pos + payload_len;
+    sqrat* row = coefficients + (n * (p+1) + k-q) * row_size;
+    size_t i;
+    for (i = 0; i < row_size; ++i)
+        if (! isf_io::get_sqrat(pos, end, row[i]))
+            return false;
+
+    seen[n * (p+1) + k-q] = true;
+    return pos == end;
+}
+
+isoarray* read_isoscalar_stream(FILE* in)
+{
+    unsigned char buf[HEADER_LEN];
+    if ((fread(buf, 1, HEADER_LEN, in) != HEADER_LEN)
+        || memcmp(buf, MAGIC, MAGIC_LEN))
+        return NULL;
+
+    const unsigned char* pos = buf + MAGIC_LEN;
+    const unsigned char* end = buf + HEADER_LEN;
+    unsigned long long version, p, q, p1, q1, p2, q2, d;
+    if (! (isf_io::get_u64(pos, end, version) && (version == FORMAT_VERSION)
+        && isf_io::get_u64(pos, end, p)  && isf_io::get_u64(pos, end, q)
+        && isf_io::get_u64(pos, end, p1) && isf_io::get_u64(pos, end, q1)
+        && isf_io::get_u64(pos, end, p2) && isf_io::get_u64(pos, end, q2)
+        && isf_io::get_u64(pos, end, d)))
+        return NULL;
+
+    size_t size;
+    if (! isf_io::check_coupling(p, q, p1, q1, p2, q2, d, size))
+        return NULL;
+
+    sqrat* coefficients = new sqrat[size];
+    std::vector<bool> seen(d * (p+1));
+
+    /* Every row must appear exactly once, and nothing else */
+    size_t i;
+    for (i = 0; i < seen.size(); ++i)
+        if (! read_row(in, p, q, p1, q1, p2, d, coefficients, seen))
+        {
+            delete[] coefficients;
+            return NULL;
+        }
+
+    if (fgetc(in) != EOF)
+    {
+        delete[] coefficients;
+        return NULL;
+    }
+
+    return new isoarray(p, q, p1, q1, p2, q2, d, coefficients);
+}
@@ -0,0 +1,144 @@
+/* libSU3: Bookkeeping for the symmetry relations between couplings.
+
+    The three exchange relations act on a coupling r1 x r2 -> R by
+    permuting the three reps (r1, r2, Rbar):
+    * exch_12    swaps r1 and r2
+    * exch_13bar swaps r1 and Rbar
+    * exch_23bar swaps r2 and Rbar
+    Conjugation (conj) maps it to r1bar x r2bar -> Rbar, and commutes with
+    each of these. So the orbit of a coupling contains at most 12 couplings,
+    one for each permutation with or without conjugation, and any two of
+    them are related by at most three steps.
+*/
+
+#include "SU3_internal.h"
+
+bool operator<(const coupling& a, const coupling& b)
+{
+    if (a.p  != b.p ) return a.p  < b.p;
+    if (a.q  != b.q ) return a.q  < b.q;
+    if (a.p1 != b.p1) return a.p1 < b.p1;
+    if (a.q1 != b.q1) return a.q1 < b.q1;
+    if (a.p2 != b.p2) return a.p2 < b.p2;
+    return a.q2 < b.q2;
+}
+
+bool operator==(const coupling& a, const coupling& b)
+{
+    return (a.p  == b.p ) && (a.q  == b.q )
+        && (a.p1 == b.p1) && (a.q1 == b.q1)
+        && (a.p2 == b.p2) && (a.q2 == b.q2);
+}
+
+/* The coupling which the given symmetry relation maps 'c' to */
+coupling apply_symmetry(symmetry_op op, const coupling& c)
+{
+    coupling res = c;
+
+    switch (op)
+    {
+    case SYM_EXCH_12:
+        res.p1 = c.p2; res.q1 = c.q2;
+        res.p2 = c.p1; res.q2 = c.q1;
+        break;
+
+    case SYM_EXCH_13BAR:
+        res.p  = c.q1; res.q  = c.p1;
+        res.p1 = c.q;  res.q1 = c.p;
+        break;
+
+    case SYM_EXCH_23BAR:
+        res.p  = c.q2; res.q  = c.p2;
+        res.p2 = c.q;  res.q2 = c.p;
+        break;
+
+    case SYM_CONJ:
+        res.p  = c.q;  res.q  = c.p;
+        res.p1 = c.q1; res.q1 = c.p1;
+        res.p2 = c.q2; res.q2 = c.p2;
+        break;
+    }
+
+    return res;
+}
+
+/* Map a coupling to a canonical representative of its orbit under the
+    symmetry relations. We pick the smallest coupling in the orbit (as
+    ordered by operator< above), and record how to get back to 'c' from it.
+*/
+coupling canonical_coupling(const coupling& c, std::vector<symmetry_op>& path)
+{
+    /* One sequence of operations reaching each element of the orbit */
+    static const int nseqs = 12;
+    static const int seq_len[nseqs] = {0, 1, 1, 1, 2, 2, 1, 2, 2, 2, 3, 3};
+    static const symmetry_op seqs[nseqs][3] =
+    {
+        {SYM_EXCH_12,    SYM_EXCH_12,    SYM_EXCH_12},  // (unused)
+        {SYM_EXCH_12,    SYM_EXCH_12,    SYM_EXCH_12},
+        {SYM_EXCH_13BAR, SYM_EXCH_13BAR, SYM_EXCH_13BAR},
+        {SYM_EXCH_23BAR, SYM_EXCH_23BAR, SYM_EXCH_23BAR},
+        {SYM_EXCH_12,    SYM_EXCH_13BAR, SYM_EXCH_13BAR},
+        {SYM_EXCH_13BAR, SYM_EXCH_12,    SYM_EXCH_12},
+        {SYM_CONJ,       SYM_CONJ,       SYM_CONJ},
+        {SYM_EXCH_12,    SYM_CONJ,       SYM_CONJ},
+        {SYM_EXCH_13BAR, SYM_CONJ,       SYM_CONJ},
+        {SYM_EXCH_23BAR, SYM_CONJ,       SYM_CONJ},
+        {SYM_EXCH_12,    SYM_EXCH_13BAR, SYM_CONJ},
+        {SYM_EXCH_13BAR, SYM_EXCH_12,    SYM_CONJ},
+    };
+
+    coupling best = c;
+    int best_seq = 0;
+    int i, j;
+
+    for (i = 1; i < nseqs; ++i)
+    {
+        coupling candidate = c;
+        for (j = 0; j < seq_len[i]; ++j)
+            candidate = apply_symmetry(seqs[i][j], candidate);
+
+        if (candidate < best)
+        {
+            best = candidate;
+            best_seq = i;
+        }
+    }
+
+    /* Each operation is its own inverse, so we get back to 'c' by undoing
+        the sequence in reverse order */
+    path.clear();
+    for (j = seq_len[best_seq] - 1; j >= 0; --j)
+        path.push_back(seqs[best_seq][j]);
+
+    return best;
+}
+
+/* Apply a sequence of symmetry relations to a set of ISFs.
+    Always returns a newly-allocated object, even if 'path' is empty. */
+isoarray* apply_symmetries(isoarray* isf, const std::vector<symmetry_op>& path)
+{
+    if (path.empty())
+        return isf->copy();
+
+    isoarray* result = NULL;
+    isoarray* current = isf;
+    size_t i;
+
+    for (i = 0; i < path.size(); ++i)
+    {
+        isoarray* next = NULL;
+        switch (path[i])
+        {
+        case SYM_EXCH_12:    next = current->exch_12();    break;
+        case SYM_EXCH_13BAR: next = current->exch_13bar(); break;
+        case SYM_EXCH_23BAR: next = current->exch_23bar(); break;
+        case SYM_CONJ:       next = current->conj();       break;
+        }
+
+        /* Only delete intermediate results, not the array passed in */
+        delete result;
+        result = current = next;
+    }
+
+    return result;
+}
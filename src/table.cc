@@ -0,0 +1,130 @@
+/* libSU3: Exporting tables of Clebsch-Gordan coefficients as doubles.
+    See include/SU3_table.h for the file format and for the reader.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "SU3_internal.h"
+#include "SU3_table.h"
+
+/* Helper: Index of a rep within the table directory */
+static long table_rep_index(long p, long q)
+{
+    return (p+q)*(p+q+1)/2 + q;
+}
+
+/* Helper: Number of doubles stored for one coupling */
+static uint64_t table_entry_size(const coupling& c, long d)
+{
+    return (uint64_t)d * (c.p+1) * (c.q+1) * (c.p+c.q+1)
+            * (c.p1+1) * (c.q1+1) * (c.p1+c.q1+1) * (c.p2+1);
+}
+
+/* Helper: Write the CGCs for one coupling, in the order expected by
+    cgc_table_view. Entries which do not correspond to a valid set of states
+    are written as 0. */
+static bool write_entry(FILE* f, const coupling& c, isoarray* isf)
+{
+    long p = c.p, q = c.q, p1 = c.p1, q1 = c.q1, p2 = c.p2, q2 = c.q2;
+    long d = isf->d;
+    cgarray cg(isf);
+    cgc_table_view layout(NULL, p, q, p1, q1, p2, q2, d);
+
+    std::vector<double> values(table_entry_size(c, d), 0.0);
+    long n, k, l, m, k1, l1, m1, k2, l2, m2;
+
+    for (n = 0; n < d; ++n)
+        FOREACH_CGC(p, q, p1, q1, p2, q2, k, l, m, k1, l1, m1, k2, l2, m2)
+            values[layout.offset(n, k, l, m, k1, l1, m1, k2)]
+                = (double)cg(n, k, l, m, k1, l1, m1, k2, l2, m2);
+
+    return fwrite(values.data(), sizeof(double), values.size(), f) == values.size();
+}
+
+bool export_cgc_table(const char* path, long max_pq, long nthreads)
+{
+    if (max_pq < 0) return false;
+
+    uint64_t nreps = (max_pq+1)*(max_pq+2)/2;
+
+    /* List every coupling in the table, in directory order */
+    std::vector<coupling> couplings(nreps * nreps * nreps);
+    long p, q, p1, q1, p2, q2;
+
+    for (p = 0; p <= max_pq; ++p)
+        for (q = 0; p + q <= max_pq; ++q)
+            for (p1 = 0; p1 <= max_pq; ++p1)
+                for (q1 = 0; p1 + q1 <= max_pq; ++q1)
+                    for (p2 = 0; p2 <= max_pq; ++p2)
+                        for (q2 = 0; p2 + q2 <= max_pq; ++q2)
+                        {
+                            uint64_t entry = (table_rep_index(p, q)*nreps
+                                                + table_rep_index(p1, q1))*nreps
+                                                + table_rep_index(p2, q2);
+                            coupling c = {p, q, p1, q1, p2, q2};
+                            couplings[entry] = c;
+                        }
+
+    /* Build the header and directory */
+    uint64_t header[CGC_TABLE_HDR_WORDS];
+    std::vector<uint64_t> directory(2 * couplings.size());
+    uint64_t data_offset = 0;
+    size_t i;
+
+    for (i = 0; i < couplings.size(); ++i)
+    {
+        const coupling& c = couplings[i];
+        long d = degeneracy(c.p, c.q, c.p1, c.q1, c.p2, c.q2);
+        directory[2*i] = d;
+        directory[2*i + 1] = data_offset;
+        data_offset += d ? table_entry_size(c, d) : 0;
+    }
+
+    double bom = 1.0;
+    memcpy(&header[0], CGC_TABLE_MAGIC, 8);
+    header[CGC_TABLE_HDR_VERSION] = CGC_TABLE_VERSION;
+    header[CGC_TABLE_HDR_BOUND] = max_pq;
+    header[CGC_TABLE_HDR_NREPS] = nreps;
+    header[CGC_TABLE_HDR_DIRECTORY] = sizeof(header);
+    header[CGC_TABLE_HDR_DATA] = sizeof(header) + directory.size() * sizeof(uint64_t);
+    memcpy(&header[CGC_TABLE_HDR_BOM], &bom, sizeof(bom));
+
+    /* Write to a temporary file, so that readers never see a partial table */
+    std::string tmp_path = std::string(path) + ".tmp";
+    FILE* f = fopen(tmp_path.c_str(), "wb");
+    if (! f) return false;
+
+    bool ok = (fwrite(header, sizeof(header), 1, f) == 1)
+        && (fwrite(directory.data(), sizeof(uint64_t), directory.size(), f)
+            == directory.size());
+
+    /* Calculate the ISFs one target rep at a time, to bound memory use */
+    size_t per_target = nreps * nreps;
+    size_t start;
+    for (start = 0; ok && (start < couplings.size()); start += per_target)
+    {
+        isoarray** isfs = isoscalars_batch(&couplings[start], per_target, nthreads);
+
+        for (i = 0; i < per_target; ++i)
+        {
+            /* write_entry() takes ownership of the ISFs */
+            if (ok && isfs[i])
+                ok = write_entry(f, couplings[start + i], isfs[i]);
+            else
+                delete isfs[i];
+        }
+
+        delete[] isfs;
+    }
+
+    if ((fclose(f) != 0) || ! ok || (rename(tmp_path.c_str(), path) != 0))
+    {
+        remove(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
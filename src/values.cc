@@ -0,0 +1,126 @@
+/* libSU3: Operations on the types of value which the recursions are run with.
+    See isoscalar_context in SU3_internal.h. */
+
+#include <math.h>
+#include <float.h>
+
+#include <atomic>
+
+#include "SU3_internal.h"
+
+template<>
+sqrat signed_sqrt<sqrat>(long num, long den)
+{
+    return sqrat(num, den);
+}
+
+template<>
+double signed_sqrt<double>(long num, long den)
+{
+    double v = sqrt(fabs((double)num / (double)den));
+    return ((num < 0) != (den < 0)) ? -v : v;
+}
+
+template<>
+long double signed_sqrt<long double>(long num, long den)
+{
+    long double v = sqrtl(fabsl((long double)num / (long double)den));
+    return ((num < 0) != (den < 0)) ? -v : v;
+}
+
+template<>
+sqrat signed_sqrt_mpz<sqrat>(const mpz_class& num, const mpz_class& den)
+{
+    return sqrat(num, den);
+}
+
+/* Helper: Split x into its top 64 bits (as a long double) and a power of 2 */
+static long double mpz_mantissa(const mpz_class& x, long& exponent)
+{
+    exponent = (long)mpz_sizeinbase(x.get_mpz_t(), 2) - 64;
+    if (exponent < 0) exponent = 0;
+
+    mpz_class top = abs(x) >> exponent;
+    long double v = (long double)mpz_get_ui(top.get_mpz_t());
+    return (sgn(x) < 0) ? -v : v;
+}
+
+/* The exponents are kept separate, so that this can't overflow even if
+    num or den alone would */
+template<>
+long double signed_sqrt_mpz<long double>(const mpz_class& num, const mpz_class& den)
+{
+    long e_num, e_den;
+    long double ratio = mpz_mantissa(num, e_num) / mpz_mantissa(den, e_den);
+    long e = e_num - e_den;
+
+    if (e % 2)
+    {
+        ratio *= 2;
+        e -= 1;
+    }
+
+    long double v = ldexpl(sqrtl(fabsl(ratio)), e/2);
+    return (ratio < 0) ? -v : v;
+}
+
+template<>
+double signed_sqrt_mpz<double>(const mpz_class& num, const mpz_class& den)
+{
+    return (double)signed_sqrt_mpz<long double>(num, den);
+}
+
+mpz_class int128_to_mpz(__int128 v)
+{
+    unsigned __int128 mag = (v < 0) ? -(unsigned __int128)v : (unsigned __int128)v;
+    mpz_class result = (unsigned long)(mag >> 64);
+    result <<= 64;
+    result += (unsigned long)(mag & ~0UL);
+    return (v < 0) ? mpz_class(-result) : result;
+}
+
+static std::atomic<int> min_width(COEFFICIENT_LONG);
+
+void set_min_coefficient_width(coefficient_width width)
+{
+    min_width = width;
+}
+
+/* Every factor in the coefficients is bounded by 2 * (the sum of p+q over
+    the three reps) + 8, and there are at most five factors times a constant
+    of at most 4 */
+coefficient_width choose_coefficient_width(long p, long q, long p1, long q1,
+                                            long p2, long q2)
+{
+    long double bound = 2.0L * (p + q + p1 + q1 + p2 + q2) + 8;
+    long double largest = 4 * bound * bound * bound * bound * bound;
+
+    coefficient_width width = COEFFICIENT_MPZ;
+    if (largest < ldexpl(1, 62))
+        width = COEFFICIENT_LONG;
+    else if (largest < ldexpl(1, 126))
+        width = COEFFICIENT_INT128;
+
+    return (coefficient_width)max((long)width, (long)min_width.load());
+}
+
+bool negligible(const sqrat& x, const sqrat& scale)
+{
+    (void)scale;
+    return x == 0;
+}
+
+/* For floating-point values, anything within about sqrt(epsilon) of zero
+    (relative to the scale) is treated as zero. Values which are exactly zero
+    usually come out at around epsilon, but nonzero ISFs are never anywhere
+    near this small for the sizes of reps which can be calculated in floating
+    point. */
+bool negligible(double x, double scale)
+{
+    return fabs(x) <= fabs(scale) * sqrt(DBL_EPSILON);
+}
+
+bool negligible(long double x, long double scale)
+{
+    return fabsl(x) <= fabsl(scale) * sqrtl(LDBL_EPSILON);
+}
@@ -0,0 +1,68 @@
+/* libSU3: Tests for batched isoscalar factor calculations */
+
+#include "SU3.h"
+#include "test.h"
+
+/* Helper: Check that two sets of ISFs are identical */
+static int isfs_equal(isoarray* isf1, isoarray* isf2)
+{
+    long p = isf1->p, q = isf1->q, p1 = isf1->p1, q1 = isf1->q1,
+        p2 = isf1->p2, q2 = isf1->q2, d = isf1->d;
+
+    if ((isf2->p != p) || (isf2->q != q) || (isf2->p1 != p1) || (isf2->q1 != q1)
+        || (isf2->p2 != p2) || (isf2->q2 != q2) || (isf2->d != d))
+        return 0;
+
+    long n, k, l, k1, l1, k2, l2;
+    for (n = 0; n < d; ++n)
+        FOREACH_ISF(p, q, p1, q1, p2, q2, k, l, k1, l1, k2, l2)
+            if ((*isf1)(n, k, l, k1, l1, k2, l2) != (*isf2)(n, k, l, k1, l1, k2, l2))
+                return 0;
+
+    return 1;
+}
+
+TEST(batch)
+{
+    /* Include whole orbits, duplicates and couplings of zero degeneracy */
+    const coupling couplings[] =
+    {
+        //p q  p1 q1 p2 q2
+        {1, 1, 1, 1, 1, 1},
+        {1, 1, 1, 1, 1, 1},
+        {2, 1, 1, 0, 1, 1},
+        {2, 1, 1, 1, 1, 0},
+        {0, 1, 1, 2, 1, 1},
+        {1, 1, 1, 2, 0, 1},
+        {0, 1, 1, 1, 1, 2},
+        {1, 1, 0, 1, 1, 2},
+        {3, 0, 1, 1, 0, 0},
+        {2, 2, 2, 2, 2, 2},
+        {2, 2, 2, 1, 1, 2},
+        {1, 2, 2, 2, 2, 2},
+    };
+    long count = sizeof(couplings) / sizeof(couplings[0]);
+
+    isoarray** isfs = isoscalars_batch(couplings, count, 2);
+
+    long i;
+    for (i = 0; i < count; ++i)
+    {
+        const coupling& c = couplings[i];
+        isoarray* expected = isoscalars(c.p, c.q, c.p1, c.q1, c.p2, c.q2);
+
+        if (! expected)
+            DO_TEST(isfs[i] == NULL,
+                    "Expected no ISFs for (%ld,%ld)x(%ld,%ld)->(%ld,%ld)",
+                    c.p1, c.q1, c.p2, c.q2, c.p, c.q);
+        else
+            DO_TEST(isfs[i] && isfs_equal(isfs[i], expected),
+                    "Batched ISFs differ for (%ld,%ld)x(%ld,%ld)->(%ld,%ld)",
+                    c.p1, c.q1, c.p2, c.q2, c.p, c.q);
+
+        delete expected;
+        delete isfs[i];
+    }
+
+    delete[] isfs;
+}
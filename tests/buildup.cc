@@ -0,0 +1,41 @@
+/* libSU3: Tests for the build-up ISF engine */
+
+#include "SU3.h"
+#include "compare.h"
+#include "test.h"
+
+/* Helper: The ISFs for one coupling from the build-up engine */
+static isoarray* buildup_isoscalars(long p, long q, long p1, long q1, long p2,
+                                    long q2)
+{
+    isf_settings_guard settings;
+    set_isf_engine(ISF_ENGINE_BUILDUP);
+    return isoscalars(p, q, p1, q1, p2, q2);
+}
+
+TEST(isoscalars_buildup)
+{
+    /* The build-up engine should give exactly the same results as the
+        recursion. The built-in tables and closed forms are disabled so that
+        both engines are actually used, and the cache is emptied so that the
+        smaller couplings are built up too. */
+    set_isf_cache_size(0);
+    set_isf_cache_size(64L << 20);
+
+    long count = 0;
+    long mismatches = count_recursion_mismatches(buildup_isoscalars, 4, 4, 1, count);
+    DO_TEST(mismatches == 0, "%ld ISFs differ from the recursion (over %ld couplings)",
+            mismatches, count);
+
+    /* A larger coupling, built up through a chain of smaller ones */
+    isf_settings_guard settings;
+    set_builtin_isf_tables(false);
+    set_closed_form_isfs(false);
+    isoarray* expected = recursion_isoscalars(10, 10, 5, 5, 5, 5);
+    isoarray* built = buildup_isoscalars(10, 10, 5, 5, 5, 5);
+    mismatches = count_isf_mismatches(*built, *expected);
+    DO_TEST(mismatches == 0, "%ld ISFs for (5,5) x (5,5) -> (10,10) differ from "
+            "the recursion", mismatches);
+    delete built;
+    delete expected;
+}
@@ -0,0 +1,26 @@
+/* libSU3: Tests for the ISF tables compiled into the library */
+
+#include "SU3.h"
+#include "compare.h"
+#include "test.h"
+
+/* Helper: The ISFs for one coupling, from the built-in tables if they
+    have it */
+static isoarray* builtin_isoscalars(long p, long q, long p1, long q1, long p2,
+                                    long q2)
+{
+    isf_settings_guard settings;
+    set_builtin_isf_tables(true);
+    return isoscalars(p, q, p1, q1, p2, q2);
+}
+
+TEST(builtin_tables)
+{
+    /* Products of reps with p+q <= BUILTIN_MAX_PQ come from the tables, and
+        larger ones fall back to the recursion. Either way, they should match
+        the recursion. */
+    long count = 0;
+    long mismatches = count_recursion_mismatches(builtin_isoscalars, 4, 4, 1, count);
+    DO_TEST(mismatches == 0, "%ld ISFs differ from the recursion (over %ld "
+            "couplings)", mismatches, count);
+}
@@ -0,0 +1,182 @@
+/* libSU3: Tests for the in-process ISF cache */
+
+#include <thread>
+#include <vector>
+
+#include "SU3.h"
+#include "test.h"
+
+TEST(cache_counters)
+{
+    isf_cache cache(1L << 30, 4);
+
+    isoarray_handle isf1 = cache.isoscalars(1, 1, 1, 1, 1, 1);
+    isoarray_handle isf2 = cache.isoscalars(1, 1, 1, 1, 1, 1);
+    isoarray_handle none = cache.isoscalars(3, 0, 1, 1, 0, 0);
+
+    DO_TEST(isf1 && (isf1 == isf2),
+            "Expected the same handle for repeated lookups");
+    DO_TEST(! none, "Expected an empty handle for a coupling of zero degeneracy");
+
+    /* The cached values should match a fresh calculation */
+    isoarray* expected = isoscalars(1, 1, 1, 1, 1, 1);
+    long n, k, l, k1, l1, k2, l2;
+    int equal = 1;
+    for (n = 0; n < expected->d; ++n)
+        FOREACH_ISF(1, 1, 1, 1, 1, 1, k, l, k1, l1, k2, l2)
+            if ((*isf1)(n, k, l, k1, l1, k2, l2) != (*expected)(n, k, l, k1, l1, k2, l2))
+                equal = 0;
+    DO_TEST(equal, "Cached ISFs differ from isoscalars()");
+    delete expected;
+
+    /* CGCs should be built on the cached ISFs */
+    cgarray_handle cg = cache.clebsch_gordans(1, 1, 1, 1, 1, 1);
+    cgarray* expected_cg = clebsch_gordans(1, 1, 1, 1, 1, 1);
+    long m, m1, m2;
+    equal = 1;
+    for (n = 0; n < 2; ++n)
+        FOREACH_CGC(1, 1, 1, 1, 1, 1, k, l, m, k1, l1, m1, k2, l2, m2)
+            if ((*cg)(n, k, l, m, k1, l1, m1, k2, l2, m2)
+                != (*expected_cg)(n, k, l, m, k1, l1, m1, k2, l2, m2))
+                equal = 0;
+    DO_TEST(equal, "Cached CGCs differ from clebsch_gordans()");
+    delete expected_cg;
+
+    isf_cache_stats stats = cache.stats();
+    DO_TEST(stats.misses == 1, "Expected 1 miss, got %lu", stats.misses);
+    DO_TEST(stats.hits == 2, "Expected 2 hits, got %lu", stats.hits);
+    DO_TEST(stats.entries == 1, "Expected 1 entry, got %lu", (unsigned long)stats.entries);
+    DO_TEST(stats.bytes == isf1->memory_usage(),
+            "Expected %lu bytes in cache, got %lu",
+            (unsigned long)isf1->memory_usage(), (unsigned long)stats.bytes);
+
+    cache.clear();
+    DO_TEST(cache.stats().entries == 0, "Expected cache to be empty after clear()");
+
+    /* Handles remain valid after their entries leave the cache */
+    DO_TEST((*isf1)(0, 2, 0, 2, 0, 1, 0) == (*isf2)(0, 2, 0, 2, 0, 1, 0),
+            "Handle no longer valid after clear()");
+}
+
+TEST(cache_eviction)
+{
+    /* Size the cache (a single shard) to hold about two and a half of these */
+    isoarray* isf = isoscalars(2, 2, 2, 2, 2, 2);
+    size_t size = isf->memory_usage();
+    delete isf;
+
+    isf_cache cache(2*size + size/2, 1);
+    cache.isoscalars(2, 2, 2, 2, 2, 2);
+    cache.isoscalars(2, 2, 2, 2, 2, 2);
+
+    /* These are smaller, so all fit alongside the (2,2) coupling */
+    cache.isoscalars(1, 1, 2, 2, 2, 2);
+    cache.isoscalars(2, 2, 1, 1, 2, 2);
+    DO_TEST(cache.stats().evictions == 0, "Expected no evictions yet");
+
+    /* Use the (2,2) coupling again, so that it is the most recently used */
+    cache.isoscalars(2, 2, 2, 2, 2, 2);
+
+    /* Now overfill the cache: the least recently used entries go first */
+    cache.isoscalars(3, 3, 2, 2, 2, 2);
+
+    isf_cache_stats stats = cache.stats();
+    DO_TEST(stats.evictions > 0, "Expected some evictions");
+    DO_TEST(stats.bytes <= 2*size + size/2,
+            "Cache holds %lu bytes, over its limit of %lu",
+            (unsigned long)stats.bytes, (unsigned long)(2*size + size/2));
+
+    unsigned long misses = stats.misses;
+    cache.isoscalars(2, 2, 2, 2, 2, 2);
+    DO_TEST(cache.stats().misses == misses,
+            "Most recently used entry was evicted");
+}
+
+TEST(cache_large_entry)
+{
+    /* The limit covers the whole cache, so a coupling which needs more than
+        an equal share of it, across 16 shards, is still cached */
+    isoarray* isf = isoscalars(3, 3, 3, 3, 3, 3);
+    size_t size = isf->memory_usage();
+    delete isf;
+
+    isf_cache cache(size + size/2, 16);
+    cache.isoscalars(1, 1, 1, 1, 1, 1);
+    cache.isoscalars(3, 3, 3, 3, 3, 3);
+    cache.isoscalars(3, 3, 3, 3, 3, 3);
+
+    isf_cache_stats stats = cache.stats();
+    DO_TEST(stats.hits == 1, "Expected a large coupling to be cached, got %lu hits",
+            stats.hits);
+    DO_TEST(stats.bytes <= size + size/2,
+            "Cache holds %lu bytes, over its limit of %lu",
+            (unsigned long)stats.bytes, (unsigned long)(size + size/2));
+
+    /* Filling the rest of the cache evicts the older, smaller entry first */
+    cache.isoscalars(2, 2, 3, 3, 3, 3);
+    cache.isoscalars(3, 3, 3, 3, 3, 3);
+    stats = cache.stats();
+    DO_TEST(stats.bytes <= size + size/2,
+            "Cache holds %lu bytes, over its limit of %lu",
+            (unsigned long)stats.bytes, (unsigned long)(size + size/2));
+    DO_TEST(stats.hits == 2, "Most recently used entry was evicted");
+
+    /* Shrinking the limit evicts across every shard */
+    cache.set_max_bytes(0);
+    DO_TEST((cache.stats().entries == 0) && (cache.stats().bytes == 0),
+            "Expected cache to be empty with a limit of 0");
+}
+
+TEST(cache_threads)
+{
+    isf_cache cache(1L << 30, 4);
+    std::vector<std::thread> threads;
+    int failures[4] = {0, 0, 0, 0};
+
+    int t;
+    for (t = 0; t < 4; ++t)
+        threads.push_back(std::thread([&cache, &failures, t]()
+            {
+                long i;
+                for (i = 0; i < 200; ++i)
+                {
+                    /* Of these, only 1, 8 and 27 appear in 8 x 8 */
+                    long p = (i + t) % 3, q = i % 3;
+                    isoarray_handle isf = cache.isoscalars(p, q, 1, 1, 1, 1);
+                    if ((degeneracy(p, q, 1, 1, 1, 1) != 0) != (bool)isf)
+                        ++failures[t];
+                }
+            }));
+
+    for (t = 0; t < 4; ++t)
+        threads[t].join();
+
+    DO_TEST(failures[0] + failures[1] + failures[2] + failures[3] == 0,
+            "Concurrent lookups returned wrong results");
+
+    isf_cache_stats stats = cache.stats();
+    DO_TEST(stats.hits + stats.misses > 0, "Expected cache to be used");
+    DO_TEST(stats.entries == 3, "Expected 3 entries, got %lu", (unsigned long)stats.entries);
+}
+
+TEST(cache_conjugates)
+{
+    /* (2,1) x (1,2) -> (4,1) is derived from its conjugate once that has
+        been cached */
+    isf_cache cache(1L << 30, 4);
+    isoarray_handle isf = cache.isoscalars(1, 4, 1, 2, 2, 1);
+    isoarray_handle conj = cache.isoscalars(4, 1, 2, 1, 1, 2);
+
+    isoarray* expected = isoscalars(4, 1, 2, 1, 1, 2);
+    long n, k, l, k1, l1, k2, l2;
+    int equal = (conj != NULL);
+    for (n = 0; equal && (n < expected->d); ++n)
+        FOREACH_ISF(4, 1, 2, 1, 1, 2, k, l, k1, l1, k2, l2)
+            if ((*conj)(n, k, l, k1, l1, k2, l2) != (*expected)(n, k, l, k1, l1, k2, l2))
+                equal = 0;
+    DO_TEST(equal, "ISFs derived from the conjugate coupling differ from isoscalars()");
+    delete expected;
+
+    isf_cache_stats stats = cache.stats();
+    DO_TEST(stats.entries == 2, "Expected 2 entries, got %lu", (unsigned long)stats.entries);
+}
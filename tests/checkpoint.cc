@@ -0,0 +1,149 @@
+/* libSU3: Tests for checkpointing long calculations */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <string>
+
+#include "SU3.h"
+#include "test.h"
+
+/* Helper: Start a checkpointed calculation in a child process, which is
+    killed (by SIGXFSZ) once the checkpoint file reaches 'limit' bytes.
+    This may happen in the middle of writing a checkpoint. */
+static bool interrupted_run(long p, long q, long p1, long q1, long p2, long q2,
+                            const char* path, rlim_t limit)
+{
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0)
+    {
+        struct rlimit rl = {limit, limit};
+        setrlimit(RLIMIT_FSIZE, &rl);
+        signal(SIGXFSZ, SIG_DFL);
+        delete isoscalars_checkpointed(p, q, p1, q1, p2, q2, path, 0);
+        _exit(0);
+    }
+
+    int status;
+    return (waitpid(pid, &status, 0) == pid)
+        && WIFSIGNALED(status) && (WTERMSIG(status) == SIGXFSZ);
+}
+
+TEST(isoscalars_checkpointed)
+{
+    char dir[] = "/tmp/libSU3-test-XXXXXX";
+    if (! mkdtemp(dir))
+    {
+        DO_TEST(0, "Couldn't create temporary directory");
+        return;
+    }
+    std::string path = std::string(dir) + "/checkpoint";
+
+    /* Interrupt the calculation at various points: while calculating the
+        couplings to the state of highest weight, and while filling out rows */
+    isoarray* expected = isoscalars(4, 4, 4, 4, 4, 4);
+    rlim_t limits[] = {2000, 50000, 150000};
+    long i, n, k, l, k1, l1, k2, l2;
+    for (i = 0; i < 3; ++i)
+    {
+        bool interrupted = interrupted_run(4, 4, 4, 4, 4, 4, path.c_str(), limits[i]);
+        DO_TEST(interrupted, "Calculation wasn't interrupted at %ld bytes",
+                (long)limits[i]);
+
+        isoarray* resumed = isoscalars_resume(path.c_str(), 0);
+        long mismatches = 0;
+        if (resumed)
+            for (n = 0; n < expected->d; ++n)
+                FOREACH_ISF(4, 4, 4, 4, 4, 4, k, l, k1, l1, k2, l2)
+                    if ((*resumed)(n, k, l, k1, l1, k2, l2) != (*expected)(n, k, l, k1, l1, k2, l2))
+                        ++mismatches;
+
+        DO_TEST(resumed && (mismatches == 0),
+                "Resumed calculation (interrupted at %ld bytes) gives wrong ISFs",
+                (long)limits[i]);
+        DO_TEST(access(path.c_str(), F_OK) != 0,
+                "Checkpoint file wasn't removed after resuming");
+        delete resumed;
+    }
+    delete expected;
+
+    DO_TEST(! isoscalars_resume(path.c_str()), "Resumed without a checkpoint file");
+
+    rmdir(dir);
+}
+
+/* Helper: The size of a file, or -1 if it doesn't exist */
+static long file_size(const char* path)
+{
+    struct stat st;
+    return (stat(path, &st) == 0) ? (long)st.st_size : -1;
+}
+
+/* Helper: Write 'contents' to a new file */
+static void write_file(const char* path, const char* contents)
+{
+    FILE* f = fopen(path, "w");
+    if (! f) return;
+    fputs(contents, f);
+    fclose(f);
+}
+
+TEST(checkpoint_overwrite)
+{
+    char dir[] = "/tmp/libSU3-test-XXXXXX";
+    if (! mkdtemp(dir))
+    {
+        DO_TEST(0, "Couldn't create temporary directory");
+        return;
+    }
+    std::string path = std::string(dir) + "/checkpoint";
+
+    /* The checkpoint for one coupling isn't replaced by another's */
+    bool interrupted = interrupted_run(4, 4, 4, 4, 4, 4, path.c_str(), 50000);
+    long size = file_size(path.c_str());
+    isoarray* other = isoscalars_checkpointed(5, 5, 4, 4, 4, 4, path.c_str(), 0);
+    DO_TEST(interrupted && ! other && (file_size(path.c_str()) == size),
+            "Checkpoint for another coupling was overwritten");
+
+    isoarray* resumed = isoscalars_resume(path.c_str(), 0);
+    DO_TEST(resumed != NULL, "Couldn't resume after refusing to overwrite");
+    delete resumed;
+
+    /* ...unless asked to */
+    interrupted = interrupted_run(4, 4, 4, 4, 4, 4, path.c_str(), 50000);
+    other = isoscalars_checkpointed(5, 5, 4, 4, 4, 4, path.c_str(), 0, true);
+    DO_TEST(interrupted && other && (file_size(path.c_str()) < 0),
+            "Checkpoint for another coupling wasn't overwritten when asked");
+    delete other;
+
+    /* Nor is a file which isn't a checkpoint at all */
+    write_file(path.c_str(), "Not a checkpoint\n");
+    other = isoscalars_checkpointed(4, 4, 4, 4, 4, 4, path.c_str(), 0);
+    DO_TEST(! other && (file_size(path.c_str()) == 17),
+            "File which isn't a checkpoint was overwritten");
+    unlink(path.c_str());
+
+    /* An empty file, or part of a header, holds nothing to lose */
+    const char* unfinished[2] = {"", "libSU"};
+    int i;
+    for (i = 0; i < 2; ++i)
+    {
+        write_file(path.c_str(), unfinished[i]);
+        other = isoscalars_checkpointed(4, 4, 4, 4, 4, 4, path.c_str(), 0);
+        DO_TEST(other && (file_size(path.c_str()) < 0),
+                "Couldn't start a checkpoint in place of \"%s\"", unfinished[i]);
+        delete other;
+    }
+
+    unlink(path.c_str());
+    rmdir(dir);
+}
@@ -0,0 +1,67 @@
+/* libSU3: Tests for the closed forms for couplings to (1,0), (0,1) and (1,1) */
+
+#include "SU3.h"
+#include "test.h"
+
+/* Helper: Count the ISFs which differ between the closed forms and the
+    recursion, for one coupling */
+static long count_mismatches(long p, long q, long p1, long q1, long p2, long q2)
+{
+    long d = degeneracy(p, q, p1, q1, p2, q2);
+    if (! d) return 0;
+
+    isf_settings_guard settings;
+    set_closed_form_isfs(true);
+    isoarray* closed = isoscalars(p, q, p1, q1, p2, q2);
+    set_closed_form_isfs(false);
+    isoarray* expected = isoscalars(p, q, p1, q1, p2, q2);
+
+    long n, k, l, k1, l1, k2, l2;
+    long mismatches = 0;
+    for (n = 0; n < d; ++n)
+        FOREACH_ISF(p, q, p1, q1, p2, q2, k, l, k1, l1, k2, l2)
+            if ((*closed)(n, k, l, k1, l1, k2, l2) != (*expected)(n, k, l, k1, l1, k2, l2))
+                ++mismatches;
+
+    delete closed;
+    delete expected;
+    return mismatches;
+}
+
+TEST(closed_form_isfs)
+{
+    /* Every target of each family, with the special rep as either factor.
+        The built-in tables are disabled so that the recursion really runs. */
+    long special[3][2] = {{1, 0}, {0, 1}, {1, 1}};
+    long i, p, q, p1, q1;
+    long mismatches = 0, count = 0;
+
+    isf_settings_guard settings;
+    set_builtin_isf_tables(false);
+
+    for (i = 0; i < 3; ++i)
+        for (p1 = 0; p1 <= 5; ++p1)
+            for (q1 = 0; p1 + q1 <= 5; ++q1)
+                for (p = 0; p <= p1 + q1 + 2; ++p)
+                    for (q = 0; q <= p1 + q1 + 2; ++q)
+                    {
+                        long p2 = special[i][0], q2 = special[i][1];
+                        if (! degeneracy(p, q, p1, q1, p2, q2)) continue;
+
+                        mismatches += count_mismatches(p, q, p1, q1, p2, q2);
+                        mismatches += count_mismatches(p, q, p2, q2, p1, q1);
+                        count += 2;
+                    }
+
+    DO_TEST(mismatches == 0, "%ld closed-form ISFs differ from the recursion "
+            "(over %ld couplings)", mismatches, count);
+
+    /* Some larger reps, including a target of degeneracy 2, which is left
+        to the recursion */
+    mismatches = count_mismatches(9, 7, 8, 8, 1, 0)
+                + count_mismatches(7, 9, 8, 8, 0, 1)
+                + count_mismatches(10, 6, 8, 8, 1, 1)
+                + count_mismatches(7, 7, 8, 8, 1, 1);
+    DO_TEST(mismatches == 0, "%ld closed-form ISFs for (8,8) differ from the recursion",
+            mismatches);
+}
@@ -0,0 +1,95 @@
+/* libSU3: Tests for the integer types used for the recursion coefficients */
+
+#include <math.h>
+
+#include "SU3.h"
+#include "SU3_internal.h"
+#include "test.h"
+
+TEST(coefficient_sqrt)
+{
+    /* Values which only fit in a long once they are reduced */
+    __int128 big = (__int128)1 << 64;
+    DO_TEST(coefficient_sqrt<sqrat>(9 * big, 4 * big) == sqrat(9, 4),
+            "Reducible __int128 values give the wrong result");
+    DO_TEST(coefficient_sqrt<sqrat>(-((__int128)1 << 63), (__int128)1 << 63) == sqrat(-1),
+            "Values at the bottom of the range of a long give the wrong result");
+
+    /* Values just past the range of a long, which stay that way */
+    __int128 num = (__int128)LONG_MAX * 3;
+    DO_TEST(coefficient_sqrt<sqrat>(num, (__int128)7)
+                == sqrat(mpz_class(LONG_MAX) * 3, mpz_class(7)),
+            "Irreducible __int128 values give the wrong result");
+    DO_TEST(coefficient_sqrt<sqrat>(-num, (__int128)7)
+                == -sqrat(mpz_class(LONG_MAX) * 3, mpz_class(7)),
+            "Negative __int128 values give the wrong result");
+
+    /* Near the top of the range of an __int128 */
+    __int128 top = ~((unsigned __int128)1 << 127);
+    double v = coefficient_sqrt<double>(top, (__int128)2);
+    DO_TEST(fabs(v / ldexp(1, 63) - 1) < 1e-15,
+            "Expected sqrt((2^127-1)/2) = 2^63, got %.17g", v);
+    v = coefficient_sqrt<double>(-top, top);
+    DO_TEST(v == -1, "Expected -1 for -(2^127-1)/(2^127-1), got %g", v);
+
+    /* And for mpz, both reducible and not */
+    mpz_class huge = mpz_class(1) << 200;
+    DO_TEST(coefficient_sqrt<sqrat>(mpz_class(9 * huge), mpz_class(4 * huge))
+                == sqrat(9, 4),
+            "Reducible mpz values give the wrong result");
+    DO_TEST(coefficient_sqrt<sqrat>(mpz_class(huge + 1), mpz_class(3))
+                == sqrat(mpz_class(huge + 1), mpz_class(3)),
+            "Irreducible mpz values give the wrong result");
+    v = coefficient_sqrt<double>(mpz_class(-huge), mpz_class(1));
+    DO_TEST(v == -ldexp(1, 100), "Expected -2^100, got %g", v);
+}
+
+TEST(coefficient_width)
+{
+    /* Forcing the wider types should give exactly the same results. These
+        couplings include ones which need the symmetry relations. */
+    coupling couplings[] = {{2, 2, 2, 2, 2, 2}, {1, 1, 1, 1, 1, 1},
+                            {2, 2, 2, 3, 3, 2}, {0, 3, 2, 1, 1, 2}};
+    coefficient_width widths[2] = {COEFFICIENT_INT128, COEFFICIENT_MPZ};
+    const char* names[2] = {"__int128", "mpz"};
+    long i, w, n, k, l, k1, l1, k2, l2;
+
+    isf_settings_guard settings;
+    set_builtin_isf_tables(false);
+    set_closed_form_isfs(false);
+
+    for (i = 0; i < 4; ++i)
+    {
+        coupling& c = couplings[i];
+        isoarray* expected = isoscalars(c.p, c.q, c.p1, c.q1, c.p2, c.q2);
+        isoarray_double* expected_double = isoscalars_double(c.p, c.q, c.p1, c.q1,
+                                                                c.p2, c.q2);
+
+        for (w = 0; w < 2; ++w)
+        {
+            set_min_coefficient_width(widths[w]);
+            isoarray* isf = isoscalars(c.p, c.q, c.p1, c.q1, c.p2, c.q2);
+            isoarray_double* isf_double = isoscalars_double(c.p, c.q, c.p1, c.q1,
+                                                            c.p2, c.q2);
+            set_min_coefficient_width(COEFFICIENT_LONG);
+
+            long mismatches = 0;
+            for (n = 0; n < expected->d; ++n)
+                FOREACH_ISF(c.p, c.q, c.p1, c.q1, c.p2, c.q2, k, l, k1, l1, k2, l2)
+                    if (((*isf)(n, k, l, k1, l1, k2, l2) != (*expected)(n, k, l, k1, l1, k2, l2))
+                        || ((*isf_double)(n, k, l, k1, l1, k2, l2)
+                            != (*expected_double)(n, k, l, k1, l1, k2, l2)))
+                        ++mismatches;
+
+            DO_TEST(mismatches == 0, "%ld ISFs for (%ld,%ld) x (%ld,%ld) -> (%ld,%ld) "
+                    "differ with %s coefficients", mismatches, c.p1, c.q1, c.p2,
+                    c.q2, c.p, c.q, names[w]);
+
+            delete isf;
+            delete isf_double;
+        }
+
+        delete expected;
+        delete expected_double;
+    }
+}
@@ -0,0 +1,65 @@
+/* libSU3: Helpers for tests which compare ISFs with the recursion */
+
+#include "compare.h"
+#include "test.h"
+
+long count_isf_mismatches(const isoarray& isf, const isoarray& expected)
+{
+    long p = expected.p, q = expected.q, p1 = expected.p1, q1 = expected.q1,
+        p2 = expected.p2, q2 = expected.q2;
+    long n, k, l, k1, l1, k2, l2;
+    long mismatches = 0;
+
+    for (n = 0; n < expected.d; ++n)
+        FOREACH_ISF(p, q, p1, q1, p2, q2, k, l, k1, l1, k2, l2)
+            if (isf(n, k, l, k1, l1, k2, l2) != expected(n, k, l, k1, l1, k2, l2))
+                ++mismatches;
+
+    return mismatches;
+}
+
+isoarray* recursion_isoscalars(long p, long q, long p1, long q1, long p2, long q2)
+{
+    isf_settings_guard settings;
+    set_isf_engine(ISF_ENGINE_SQRAT);
+    set_builtin_isf_tables(false);
+    set_closed_form_isfs(false);
+    return isoscalars(p, q, p1, q1, p2, q2);
+}
+
+long count_recursion_mismatches(const isf_calculation& calculate,
+                                long max_factor, long max_target, long min_d,
+                                long& count)
+{
+    long p, q, p1, q1, p2, q2;
+    long mismatches = 0;
+
+    isf_settings_guard settings;
+    set_builtin_isf_tables(false);
+    set_closed_form_isfs(false);
+
+    for (p1 = 0; p1 <= max_factor; ++p1)
+    for (q1 = 0; p1 + q1 <= max_factor; ++q1)
+    for (p2 = 0; p2 <= max_factor; ++p2)
+    for (q2 = 0; p2 + q2 <= max_factor; ++q2)
+    for (p = 0; p <= max_target; ++p)
+    for (q = 0; p + q <= max_target; ++q)
+    {
+        long d = degeneracy(p, q, p1, q1, p2, q2);
+        if (! d || (d < min_d)) continue;
+
+        isoarray* expected = recursion_isoscalars(p, q, p1, q1, p2, q2);
+        isoarray* isf = calculate(p, q, p1, q1, p2, q2);
+        ++count;
+
+        if (isf)
+            mismatches += count_isf_mismatches(*isf, *expected);
+        else
+            ++mismatches;
+
+        delete isf;
+        delete expected;
+    }
+
+    return mismatches;
+}
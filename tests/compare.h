@@ -0,0 +1,32 @@
+/* libSU3: Helpers for tests which compare ISFs with the recursion */
+
+#ifndef __SU3_COMPARE_H__
+#define __SU3_COMPARE_H__
+
+#include <functional>
+
+#include "SU3.h"
+
+/* Calculates the ISFs for one coupling in the way being tested */
+typedef std::function<isoarray*(long p, long q, long p1, long q1, long p2,
+                                long q2)> isf_calculation;
+
+/* Count the ISFs which differ between two isoarrays for the same coupling */
+long count_isf_mismatches(const isoarray& isf, const isoarray& expected);
+
+/* The ISFs from the recursion alone: the sqrat engine, without the built-in
+    tables or closed forms. The previous settings are restored afterwards. */
+isoarray* recursion_isoscalars(long p, long q, long p1, long q1, long p2, long q2);
+
+/* Compare 'calculate' with recursion_isoscalars() for every coupling
+    (p1,q1) x (p2,q2) -> (p,q) with p1+q1, p2+q2 <= max_factor and
+    p+q <= max_target, of degeneracy at least min_d. Returns the number of
+    ISFs which differ, where a coupling which 'calculate' returns NULL for
+    counts as one, and adds the number of couplings to 'count'. 'calculate'
+    is called with the caller's engine and layout, and with the built-in
+    tables and closed forms disabled; the settings are restored afterwards. */
+long count_recursion_mismatches(const isf_calculation& calculate,
+                                long max_factor, long max_target, long min_d,
+                                long& count);
+
+#endif
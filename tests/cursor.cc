@@ -0,0 +1,100 @@
+/* libSU3: Tests for walking through isoarrays with isf_cursor */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "SU3.h"
+#include "test.h"
+
+/* Helper: Walk through every row of an isoarray, checking each value
+    against operator(), including those where l2 is out of range */
+static long count_mismatches(const isoarray* isf)
+{
+    long p = isf->p, q = isf->q, p1 = isf->p1, q1 = isf->q1,
+        p2 = isf->p2, q2 = isf->q2, d = isf->d;
+    long n, k, l, k1, l1, k2;
+    long mismatches = 0;
+
+    isf_cursor row(*isf);
+    for (n = 0; n < d; ++n)
+        for (k = q; k <= p+q; ++k)
+            for (l = 0; l <= q; ++l)
+                for (k1 = q1; k1 <= p1+q1; ++k1)
+                {
+                    if ((row.n() != n) || (row.k() != k) || (row.l() != l)
+                        || (row.k1() != k1))
+                        ++mismatches;
+
+                    for (l1 = 0; l1 <= q1; ++l1)
+                        for (k2 = q2; k2 <= p2+q2; ++k2)
+                            if (row(l1, k2) != (*isf)(n, k, l, k1, l1, k2,
+                                                      row.l2(l1, k2)))
+                                ++mismatches;
+
+                    /* The last row should be the end */
+                    if (row.next() != ((n < d-1) || (k < p+q) || (l < q)
+                                        || (k1 < p1+q1)))
+                        ++mismatches;
+                }
+
+    return mismatches;
+}
+
+TEST(isf_cursor)
+{
+    /* An array held in memory, with several degenerate reps */
+    isoarray* isf = isoscalars(3, 3, 3, 3, 3, 3);
+    DO_TEST(count_mismatches(isf) == 0, "Cursor over ISFs in memory is wrong");
+
+    /* Seeking checks the position once, and then reads the same values */
+    isf_cursor row(*isf);
+    DO_TEST(row.seek(2, 4, 1, 5) && (row.k1() == 5)
+            && (row(2, 4) == (*isf)(2, 4, 1, 5, 2, 4, row.l2(2, 4))),
+            "Seeking to a row gives the wrong values");
+    DO_TEST(! row.seek(isf->d, 4, 1, 5) && ! row.seek(0, 2, 0, 3) && ! row.seek(0, 3, 4, 3)
+            && ! row.seek(0, 3, 0, 7) && (row.n() == 2) && (row.k1() == 5),
+            "Seeking out of bounds moved the cursor");
+    DO_TEST(row.size() == 4 * 4, "Rows have the wrong size");
+
+    /* Arrays which aren't held in memory are copied a row at a time */
+    isoarray* lazy;
+    {
+        isf_settings_guard settings;
+        set_builtin_isf_tables(false);
+        lazy = isoscalars_lazy(3, 3, 3, 3, 3, 3);
+        DO_TEST(count_mismatches(lazy) == 0, "Cursor over lazily-calculated ISFs is wrong");
+    }
+
+    char dir[] = "/tmp/libSU3-test-XXXXXX";
+    if (mkdtemp(dir))
+    {
+        std::string path = std::string(dir) + "/isf";
+        isoarray* mapped = isoscalars_mapped(4, 3, 2, 3, 3, 1, path.c_str());
+        DO_TEST(mapped && (count_mismatches(mapped) == 0),
+                "Cursor over mapped ISFs is wrong");
+        delete mapped;
+        unlink(path.c_str());
+        rmdir(dir);
+    }
+    else
+        DO_TEST(0, "Couldn't create temporary directory");
+
+    /* An array read back from a stream of rows */
+    FILE* f = tmpfile();
+    isoarray* streamed = NULL;
+    if (f && isoscalars_stream(3, 3, 3, 3, 3, 3, f))
+    {
+        rewind(f);
+        streamed = read_isoscalar_stream(f);
+    }
+    DO_TEST(streamed && (count_mismatches(streamed) == 0),
+            "Cursor over ISFs read from a stream is wrong");
+    delete streamed;
+    if (f) fclose(f);
+
+    delete lazy;
+    delete isf;
+}
@@ -0,0 +1,57 @@
+/* libSU3: Tests for the full Clebsch-Gordan decomposition */
+
+#include "SU3.h"
+#include "test.h"
+
+/* Helper: Check that decompose() finds every irrep in the series, and
+    that it gives the same values as calculating each one separately */
+static void check_decomposition(long p1, long q1, long p2, long q2, long nthreads)
+{
+    decomposition* decomp = decompose(p1, q1, p2, q2, nthreads);
+    const decomposition& series = *decomp;
+
+    /* The dimensions of the summands should add up to that of the product */
+    long size = 0, i;
+    for (i = 0; i < series.size(); ++i)
+    {
+        isoarray* isf = series[i];
+        size += isf->d * dimension(isf->p, isf->q);
+    }
+
+    DO_TEST(size == dimension(p1, q1) * dimension(p2, q2),
+        "Decomposing (%ld,%ld) x (%ld,%ld) on %ld threads; "
+        "expected total size %ld, got %ld",
+        p1, q1, p2, q2, nthreads, dimension(p1, q1) * dimension(p2, q2), size);
+
+    /* Compare each irrep against a direct calculation */
+    for (i = 0; i < series.size(); ++i)
+    {
+        isoarray* isf1 = series[i];
+        long p = isf1->p, q = isf1->q, d = isf1->d;
+        isoarray* isf2 = isoscalars(p, q, p1, q1, p2, q2);
+
+        int equal = (isf2->d == d);
+        long n, k, l, k1, l1, k2, l2;
+        for (n = 0; n < d; ++n)
+            FOREACH_ISF(p, q, p1, q1, p2, q2, k, l, k1, l1, k2, l2)
+                if ((*isf1)(n, k, l, k1, l1, k2, l2) != (*isf2)(n, k, l, k1, l1, k2, l2))
+                    equal = 0;
+
+        DO_TEST(equal, "Decomposing (%ld,%ld) x (%ld,%ld) on %ld threads; "
+                "ISFs for (%ld,%ld) differ from isoscalars()",
+                p1, q1, p2, q2, nthreads, p, q);
+
+        delete isf2;
+    }
+
+    delete decomp;
+}
+
+TEST(decompose)
+{
+    check_decomposition(1, 0, 0, 1, 1);
+    check_decomposition(1, 1, 1, 1, 1);
+    check_decomposition(1, 1, 1, 1, 4);
+    check_decomposition(2, 1, 1, 2, 0);
+    check_decomposition(2, 2, 2, 2, 3);
+}
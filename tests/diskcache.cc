@@ -0,0 +1,129 @@
+/* libSU3: Tests for the on-disk ISF cache */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include <string>
+#include <vector>
+
+#include "SU3.h"
+#include "test.h"
+
+/* Helper: List the cache files in a directory */
+static std::vector<std::string> cache_files(const char* dir)
+{
+    std::vector<std::string> files;
+    DIR* dp = opendir(dir);
+    struct dirent* entry;
+
+    while (dp && (entry = readdir(dp)))
+    {
+        size_t len = strlen(entry->d_name);
+        if ((len > 4) && ! strcmp(entry->d_name + len - 4, ".isf"))
+            files.push_back(std::string(dir) + "/" + entry->d_name);
+    }
+
+    if (dp) closedir(dp);
+    return files;
+}
+
+static int isfs_equal(isoarray* isf1, isoarray* isf2)
+{
+    long p = isf1->p, q = isf1->q, p1 = isf1->p1, q1 = isf1->q1,
+        p2 = isf1->p2, q2 = isf1->q2, d = isf1->d;
+    long n, k, l, k1, l1, k2, l2;
+
+    for (n = 0; n < d; ++n)
+        FOREACH_ISF(p, q, p1, q1, p2, q2, k, l, k1, l1, k2, l2)
+            if ((*isf1)(n, k, l, k1, l1, k2, l2) != (*isf2)(n, k, l, k1, l1, k2, l2))
+                return 0;
+
+    return 1;
+}
+
+TEST(diskcache)
+{
+    char dir[] = "/tmp/libSU3-test-XXXXXX";
+    if (! mkdtemp(dir))
+    {
+        DO_TEST(0, "Couldn't create temporary directory");
+        return;
+    }
+
+    /* These couplings are small enough to be in the built-in tables, and
+        have closed forms, both of which are used before the disk cache */
+    isf_settings_guard settings;
+    set_builtin_isf_tables(false);
+    set_closed_form_isfs(false);
+
+    /* Reference values, calculated without the cache */
+    isoarray* expected = isoscalars(3, 0, 1, 1, 1, 1);
+    isoarray* expected_partner = isoscalars(1, 1, 0, 3, 1, 1);
+
+    set_isf_disk_cache(dir, 1L << 30);
+
+    /* A cold cache: the result should be stored */
+    isoarray* isf = isoscalars(3, 0, 1, 1, 1, 1);
+    DO_TEST(isfs_equal(isf, expected), "ISFs differ with a cold cache");
+    DO_TEST(cache_files(dir).size() == 1, "Expected 1 file in the cache, got %lu",
+            (unsigned long)cache_files(dir).size());
+    delete isf;
+
+    /* A warm cache, including a coupling related by symmetry */
+    isf = isoscalars(3, 0, 1, 1, 1, 1);
+    DO_TEST(isfs_equal(isf, expected), "ISFs differ with a warm cache");
+    delete isf;
+
+    isf = isoscalars(1, 1, 0, 3, 1, 1);
+    DO_TEST(isfs_equal(isf, expected_partner), "ISFs differ for a related coupling");
+    DO_TEST(cache_files(dir).size() == 1,
+            "Related couplings should share a cache file");
+    delete isf;
+
+    /* Corrupt the file; it should be ignored and replaced */
+    std::string path = cache_files(dir)[0];
+    FILE* f = fopen(path.c_str(), "r+b");
+    fseek(f, -1, SEEK_END);
+    int c = fgetc(f);
+    fseek(f, -1, SEEK_END);
+    fputc(c ^ 0xff, f);
+    fclose(f);
+
+    isf = isoscalars(3, 0, 1, 1, 1, 1);
+    DO_TEST(isfs_equal(isf, expected), "ISFs differ after corrupting the cache");
+    delete isf;
+
+    isf = isoscalars(3, 0, 1, 1, 1, 1);
+    DO_TEST(isfs_equal(isf, expected), "ISFs differ after replacing a corrupt file");
+    delete isf;
+
+    /* With a tiny size limit, storing another coupling evicts the first */
+    FILE* size_f = fopen(path.c_str(), "rb");
+    fseek(size_f, 0, SEEK_END);
+    long size = ftell(size_f);
+    fclose(size_f);
+
+    set_isf_disk_cache(dir, size + size/2);
+    isf = isoscalars(0, 0, 1, 1, 1, 1);
+    delete isf;
+
+    std::vector<std::string> files = cache_files(dir);
+    DO_TEST(files.size() == 1, "Expected 1 file after eviction, got %lu",
+            (unsigned long)files.size());
+    DO_TEST((files.size() == 1) && (files[0] != path),
+            "Expected the older file to be evicted");
+
+    /* Clean up */
+    set_isf_disk_cache(NULL, 0);
+    files = cache_files(dir);
+    size_t i;
+    for (i = 0; i < files.size(); ++i)
+        unlink(files[i].c_str());
+    rmdir(dir);
+
+    delete expected;
+    delete expected_partner;
+}
@@ -0,0 +1,79 @@
+/* libSU3: Tests for the compile-time functions and fixed-coupling CGCs */
+
+#include "SU3.h"
+#include "SU3_constexpr.h"
+#include "SU3_fixed.h"
+#include "test.h"
+
+/* These should all be evaluated at compile time */
+static_assert(ct_dimension(1, 1) == 8, "Wrong dimension for the octet");
+static_assert(ct_degeneracy(1, 1, 1, 1, 1, 1) == 2, "Wrong degeneracy for 8 in 8 x 8");
+static_assert(ct_degeneracy(3, 0, 1, 0, 1, 0) == 0, "10 should not appear in 3 x 3");
+
+TEST(constexpr_reps)
+{
+    long p, q, p1, q1, p2, q2;
+    long mismatches = 0;
+
+    for (p = 0; p <= 4; ++p)
+    for (q = 0; q <= 4; ++q)
+    {
+        if (ct_dimension(p, q) != dimension(p, q)) ++mismatches;
+
+        for (p1 = 0; p1 <= 3; ++p1)
+        for (q1 = 0; q1 <= 3; ++q1)
+        for (p2 = 0; p2 <= 3; ++p2)
+        for (q2 = 0; q2 <= 3; ++q2)
+        {
+            if (ct_degeneracy(p, q, p1, q1, p2, q2) != degeneracy(p, q, p1, q1, p2, q2))
+                ++mismatches;
+            if (ct_phase_exch_12(p, q, p1, q1, p2, q2) != phase_exch_12(p, q, p1, q1, p2, q2))
+                ++mismatches;
+            if (ct_phase_conj(p, q, p1, q1, p2, q2) != phase_conj(p, q, p1, q1, p2, q2))
+                ++mismatches;
+        }
+    }
+
+    DO_TEST(mismatches == 0, "%ld values differ from the runtime functions", mismatches);
+}
+
+TEST(fixed_cgarray)
+{
+    fixed_cgarray<1, 1, 1, 1, 1, 1> fixed;
+    cgarray* cg = clebsch_gordans(1, 1, 1, 1, 1, 1);
+
+    /* for_each() should visit exactly the states visited by FOREACH_CGC,
+        with the same values */
+    long visited = 0, mismatches = 0;
+    fixed.for_each([&](long n, long k, long l, long m, long k1, long l1, long m1,
+                        long k2, long l2, long m2, double v)
+        {
+            ++visited;
+            if (v != (double)(*cg)(n, k, l, m, k1, l1, m1, k2, l2, m2))
+                ++mismatches;
+        });
+
+    long expected = 0;
+    long n, k, l, m, k1, l1, m1, k2, l2, m2;
+    for (n = 0; n < 2; ++n)
+        FOREACH_CGC(1, 1, 1, 1, 1, 1, k, l, m, k1, l1, m1, k2, l2, m2)
+        {
+            ++expected;
+            if (fixed(n, k, l, m, k1, l1, m1, k2, l2, m2)
+                != (double)(*cg)(n, k, l, m, k1, l1, m1, k2, l2, m2))
+                ++mismatches;
+        }
+
+    DO_TEST(visited == expected, "for_each() visited %ld states, expected %ld",
+            visited, expected);
+    DO_TEST(mismatches == 0, "%ld CGCs differ from clebsch_gordans()", mismatches);
+
+    /* Compile-time lookup */
+    double v = fixed.get<0, 2, 0, 1, 2, 0, 1, 2, 0, 1>();
+    DO_TEST(v == (double)(*cg)(0, 2, 0, 1, 2, 0, 1, 2, 0, 1),
+            "Compile-time lookup gave the wrong value");
+    DO_TEST(fixed(0, 2, 0, 1, 2, 0, 1, 2, 0, 2) == 0,
+            "Expected 0 for states violating Iz conservation");
+
+    delete cg;
+}
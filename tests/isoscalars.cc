@@ -101,8 +101,8 @@ static void check_isfs_equal(isoarray* isf1, isoarray* isf2, const char* msg)
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
-/* Test that the various symmetry relations do the right thing */
-TEST(symmetries)
+/* Helper: Test that the various symmetry relations do the right thing */
+static void check_symmetries()
 {
     isoarray* isf1, * isf2, * isf3, * isf_tmp, * isf_tmp2;
 
@@ -143,6 +143,12 @@ TEST(symmetries)
         delete isf_tmp;
         delete isf2;
 
+        isf_tmp = isf1->conj();
+        isf2 = isf_tmp->conj();
+        check_isfs_equal(isf1, isf2, "Testing conjugation self-inverse");
+        delete isf_tmp;
+        delete isf2;
+
         /* Test also that exch_23bar() is equivalent to the sequence
             exch_12(), exch_13bar(), exch_12()
         */
@@ -175,6 +181,24 @@ TEST(symmetries)
         delete isf2;
         delete isf3;
 
+        isf2 = isoscalars(q, p, q1, p1, q2, p2);
+        isf3 = isf1->conj();
+        check_isfs_equal(isf2, isf3, "Testing conjugation correctness");
+        delete isf2;
+        delete isf3;
+
         delete isf1;
     }
 }
+
+TEST(symmetries)
+{
+    /* Both from the built-in tables and closed forms, and from the recursion
+        alone */
+    check_symmetries();
+
+    isf_settings_guard settings;
+    set_builtin_isf_tables(false);
+    set_closed_form_isfs(false);
+    check_symmetries();
+}
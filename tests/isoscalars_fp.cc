@@ -0,0 +1,58 @@
+/* libSU3: Tests for the floating-point ISF engine */
+
+#include <math.h>
+
+#include "SU3.h"
+#include "test.h"
+
+/* Helper: Compare against the exact engine for every coupling with
+    p+q, p1+q1 and p2+q2 all at most max_pq. Returns the largest error. */
+static double max_error(long max_pq, bool extended, long& count)
+{
+    long p, q, p1, q1, p2, q2, n, k, l, k1, l1, k2, l2;
+    double worst = 0;
+    count = 0;
+
+    for (p1 = 0; p1 <= max_pq; ++p1)
+    for (q1 = 0; p1 + q1 <= max_pq; ++q1)
+    for (p2 = 0; p2 <= max_pq; ++p2)
+    for (q2 = 0; p2 + q2 <= max_pq; ++q2)
+    for (p = 0; p <= max_pq; ++p)
+    for (q = 0; p + q <= max_pq; ++q)
+    {
+        long d = degeneracy(p, q, p1, q1, p2, q2);
+        if (! d) continue;
+
+        isoarray* exact = isoscalars(p, q, p1, q1, p2, q2);
+        isoarray_double* approx = isoscalars_double(p, q, p1, q1, p2, q2, extended);
+        ++count;
+
+        for (n = 0; n < d; ++n)
+            FOREACH_ISF(p, q, p1, q1, p2, q2, k, l, k1, l1, k2, l2)
+            {
+                double err = fabs((double)(*exact)(n, k, l, k1, l1, k2, l2)
+                                    - (*approx)(n, k, l, k1, l1, k2, l2));
+                if (err > worst) worst = err;
+            }
+
+        delete exact;
+        delete approx;
+    }
+
+    return worst;
+}
+
+TEST(isoscalars_double)
+{
+    long count;
+    double err = max_error(6, false, count);
+    DO_TEST(err < 1e-12, "Largest error in double precision is %g (over %ld couplings)",
+            err, count);
+
+    err = max_error(6, true, count);
+    DO_TEST(err < 1e-12, "Largest error in long double precision is %g (over %ld couplings)",
+            err, count);
+
+    DO_TEST(isoscalars_double(3, 0, 1, 0, 0, 1) == NULL,
+            "Expected NULL for a coupling of zero degeneracy");
+}
@@ -0,0 +1,58 @@
+/* libSU3: Tests for the stencil layout of the working buffer */
+
+#include "SU3.h"
+#include "compare.h"
+#include "test.h"
+
+/* Helper: The ISFs for one coupling with the stencil layout */
+static isoarray* stencil_isoscalars(isf_engine engine, long p, long q, long p1,
+                                    long q1, long p2, long q2)
+{
+    isf_settings_guard settings;
+    set_isf_engine(engine);
+    set_isf_layout(ISF_LAYOUT_STENCIL);
+    return isoscalars(p, q, p1, q1, p2, q2);
+}
+
+TEST(isf_layout)
+{
+    /* The stencil layout only changes the order in which values are
+        calculated, so each engine should give exactly the same results
+        with either layout. Only degenerate reps use it, and the built-in
+        tables and closed forms are disabled so that the recursion is used. */
+    isf_engine engines[2] = {ISF_ENGINE_SQRAT, ISF_ENGINE_MODULAR};
+    long n, k, l, k1, l1, k2, l2;
+    long mismatches = 0, count = 0;
+    int e;
+
+    for (e = 0; e < 2; ++e)
+    {
+        isf_engine engine = engines[e];
+        mismatches += count_recursion_mismatches(
+            [=](long p, long q, long p1, long q1, long p2, long q2)
+            {
+                return stencil_isoscalars(engine, p, q, p1, q1, p2, q2);
+            }, 4, 8, 2, count);
+    }
+
+    DO_TEST(mismatches == 0, "%ld ISFs differ between the layouts (over %ld couplings)",
+            mismatches, count);
+
+    /* The floating-point calculation, for a coupling with several
+        degenerate reps */
+    isoarray_double* expected = isoscalars_double(4, 4, 4, 4, 4, 4);
+    isf_settings_guard settings;
+    set_isf_layout(ISF_LAYOUT_STENCIL);
+    isoarray_double* stencil = isoscalars_double(4, 4, 4, 4, 4, 4);
+
+    mismatches = 0;
+    for (n = 0; n < expected->d; ++n)
+        FOREACH_ISF(4, 4, 4, 4, 4, 4, k, l, k1, l1, k2, l2)
+            if ((*stencil)(n, k, l, k1, l1, k2, l2) != (*expected)(n, k, l, k1, l1, k2, l2))
+                ++mismatches;
+    DO_TEST(mismatches == 0, "%ld floating-point ISFs for (4,4) x (4,4) -> (4,4) "
+            "differ between the layouts", mismatches);
+
+    delete stencil;
+    delete expected;
+}
@@ -0,0 +1,53 @@
+/* libSU3: Tests for isoscalar factors calculated as they are looked up */
+
+#include "SU3.h"
+#include "test.h"
+
+TEST(isoscalars_lazy)
+{
+    /* A single lookup near the state of highest weight should only
+        calculate a few values */
+    isoarray* full = isoscalars(4, 4, 4, 4, 4, 4);
+    isoarray* lazy = isoscalars_lazy(4, 4, 4, 4, 4, 4);
+    sqrat v = (*lazy)(0, 8, 1, 8, 0, 7, 1);
+    DO_TEST((v == (*full)(0, 8, 1, 8, 0, 7, 1))
+            && (lazy->memory_usage() < full->memory_usage() / 10),
+            "Lazy lookup of one ISF is wrong, or calculated too much");
+    delete full;
+    delete lazy;
+
+    /* Every lookup, calculated from the recursion. (1,1) x (1,1) -> (1,1)
+        needs a symmetry relation; the others don't. */
+    coupling couplings[] = {{3, 3, 3, 3, 3, 3}, {4, 3, 2, 3, 3, 1}, {1, 1, 1, 1, 1, 1}};
+    long i, n, k, l, k1, l1, k2, l2;
+
+    isf_settings_guard settings;
+    set_builtin_isf_tables(false);
+    for (i = 0; i < 3; ++i)
+    {
+        coupling& c = couplings[i];
+        isoarray* expected = isoscalars(c.p, c.q, c.p1, c.q1, c.p2, c.q2);
+        isoarray* lazy = isoscalars_lazy(c.p, c.q, c.p1, c.q1, c.p2, c.q2);
+
+        /* Look up the bottom row of the last rep first, so that each value
+            has to be followed all the way back to the state of highest
+            weight, and then everything else */
+        long mismatches = 0;
+        n = expected->d - 1;
+        FOREACH_ISF(c.p, c.q, c.p1, c.q1, c.p2, c.q2, k, l, k1, l1, k2, l2)
+            if ((k == c.q) && ((*lazy)(n, k, l, k1, l1, k2, l2)
+                                != (*expected)(n, k, l, k1, l1, k2, l2)))
+                ++mismatches;
+
+        for (n = 0; n < expected->d; ++n)
+            FOREACH_ISF(c.p, c.q, c.p1, c.q1, c.p2, c.q2, k, l, k1, l1, k2, l2)
+                if ((*lazy)(n, k, l, k1, l1, k2, l2) != (*expected)(n, k, l, k1, l1, k2, l2))
+                    ++mismatches;
+
+        DO_TEST(mismatches == 0, "%ld lazily-calculated ISFs for (%ld,%ld) x (%ld,%ld) "
+                "-> (%ld,%ld) are wrong", mismatches, c.p1, c.q1, c.p2, c.q2, c.p, c.q);
+
+        delete expected;
+        delete lazy;
+    }
+}
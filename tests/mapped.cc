@@ -0,0 +1,100 @@
+/* libSU3: Tests for ISFs held in memory-mapped files */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <string>
+
+#include "SU3.h"
+#include "test.h"
+
+static long count_mismatches(const isoarray* isf1, const isoarray* isf2)
+{
+    long p = isf1->p, q = isf1->q, p1 = isf1->p1, q1 = isf1->q1,
+        p2 = isf1->p2, q2 = isf1->q2, d = isf1->d;
+    long n, k, l, k1, l1, k2, l2;
+    long mismatches = 0;
+
+    for (n = 0; n < d; ++n)
+        FOREACH_ISF(p, q, p1, q1, p2, q2, k, l, k1, l1, k2, l2)
+            if ((*isf1)(n, k, l, k1, l1, k2, l2) != (*isf2)(n, k, l, k1, l1, k2, l2))
+                ++mismatches;
+
+    return mismatches;
+}
+
+TEST(isoscalars_mapped)
+{
+    char dir[] = "/tmp/libSU3-test-XXXXXX";
+    if (! mkdtemp(dir))
+    {
+        DO_TEST(0, "Couldn't create temporary directory");
+        return;
+    }
+    std::string path = std::string(dir) + "/isf";
+
+    /* (1,1) x (1,1) -> (1,1) needs a symmetry relation; the other doesn't */
+    coupling couplings[] = {{2, 2, 2, 3, 3, 2}, {1, 1, 1, 1, 1, 1}};
+    long i;
+    for (i = 0; i < 2; ++i)
+    {
+        coupling& c = couplings[i];
+        isoarray* expected = isoscalars(c.p, c.q, c.p1, c.q1, c.p2, c.q2);
+        isoarray* mapped = isoscalars_mapped(c.p, c.q, c.p1, c.q1, c.p2, c.q2,
+                                                path.c_str());
+        DO_TEST(mapped && (count_mismatches(mapped, expected) == 0),
+                "Mapped ISFs for (%ld,%ld) x (%ld,%ld) -> (%ld,%ld) are wrong",
+                c.p1, c.q1, c.p2, c.q2, c.p, c.q);
+
+        isoarray* reopened = open_isoscalars_mapped(path.c_str());
+        DO_TEST(reopened && (count_mismatches(reopened, expected) == 0),
+                "Reopened ISFs for (%ld,%ld) x (%ld,%ld) -> (%ld,%ld) are wrong",
+                c.p1, c.q1, c.p2, c.q2, c.p, c.q);
+
+        /* Anything built on top of the lookups should work too */
+        if (reopened)
+        {
+            isoarray* exch = reopened->exch_12();
+            isoarray* expected_exch = expected->exch_12();
+            DO_TEST(count_mismatches(exch, expected_exch) == 0,
+                    "Symmetry relation applied to mapped ISFs is wrong");
+            delete exch;
+            delete expected_exch;
+        }
+
+        delete expected;
+        delete mapped;
+        delete reopened;
+    }
+
+    /* A corrupt value should be caught when it is looked up */
+    FILE* f = fopen(path.c_str(), "r+b");
+    fseek(f, -1, SEEK_END);
+    fputc(0xff, f);
+    fclose(f);
+
+    isoarray* corrupt = open_isoscalars_mapped(path.c_str());
+    bool caught = false;
+    try
+    {
+        long n, k, l, k1, l1, k2, l2;
+        for (n = 0; n < 2; ++n)
+            FOREACH_ISF(1, 1, 1, 1, 1, 1, k, l, k1, l1, k2, l2)
+                (*corrupt)(n, k, l, k1, l1, k2, l2);
+    }
+    catch (std::runtime_error&)
+    {
+        caught = true;
+    }
+    DO_TEST(caught, "Corrupt value in mapped file was not detected");
+    delete corrupt;
+
+    /* A truncated file can't be opened at all */
+    DO_TEST(truncate(path.c_str(), 100) == 0, "Failed to truncate file");
+    DO_TEST(! open_isoscalars_mapped(path.c_str()), "Truncated mapped file was accepted");
+
+    unlink(path.c_str());
+    rmdir(dir);
+}
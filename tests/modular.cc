@@ -0,0 +1,95 @@
+/* libSU3: Tests for the multi-modular ISF engine */
+
+#include <mutex>
+#include <thread>
+
+#include "SU3.h"
+#include "SU3_internal.h"
+#include "compare.h"
+#include "test.h"
+
+/* Helper: The ISFs for one coupling from the modular engine */
+static isoarray* modular_isoscalars(long p, long q, long p1, long q1, long p2,
+                                    long q2)
+{
+    isf_settings_guard settings;
+    set_isf_engine(ISF_ENGINE_MODULAR);
+    return isoscalars(p, q, p1, q1, p2, q2);
+}
+
+TEST(isoscalars_modular)
+{
+    /* The modular engine should give exactly the same results as the
+        recursion. The built-in tables and closed forms are disabled so that
+        both engines are actually used. */
+    long count = 0;
+    long mismatches = count_recursion_mismatches(modular_isoscalars, 4, 4, 1, count);
+    DO_TEST(mismatches == 0, "%ld ISFs differ from the sqrat engine (over %ld couplings)",
+            mismatches, count);
+}
+
+/* Helper: Count the ISFs for (3,3) x (3,3) -> (3,3) from the modular engine
+    which differ from the recursion */
+static long count_modular_mismatches()
+{
+    isoarray* isf = modular_isoscalars(3, 3, 3, 3, 3, 3);
+    isoarray* expected = recursion_isoscalars(3, 3, 3, 3, 3, 3);
+    long mismatches = count_isf_mismatches(*isf, *expected);
+    delete isf;
+    delete expected;
+    return mismatches;
+}
+
+TEST(modular_failed_channels)
+{
+    isf_settings_guard settings;
+    set_builtin_isf_tables(false);
+    set_closed_form_isfs(false);
+
+    /* A few unlucky channels are dropped and replaced */
+    set_modular_channel_failures(3);
+    long mismatches = count_modular_mismatches();
+    long left = set_modular_channel_failures(0);
+    DO_TEST((mismatches == 0) && (left == 0), "%ld ISFs differ after 3 failed "
+            "channels (%ld failures left)", mismatches, left);
+
+    /* If too many fail, the sqrat engine takes over */
+    set_modular_channel_failures(1000);
+    mismatches = count_modular_mismatches();
+    left = set_modular_channel_failures(0);
+    DO_TEST((mismatches == 0) && (left > 900) && (left < 1000),
+            "%ld ISFs differ when every channel fails (%ld failures left)",
+            mismatches, left);
+}
+
+TEST(nested_pools)
+{
+    /* The modular engine runs its channels on a pool of its own, which
+        should run in the calling thread when that is one of the workers of
+        another pool, as under isoscalars_batch() */
+    std::mutex lock;
+    long nested = 0, moved = 0;
+
+    work_pool outer(2);
+    int i;
+    for (i = 0; i < 2; ++i)
+        outer.add([&]()
+            {
+                std::thread::id self = std::this_thread::get_id();
+                work_pool inner(4);
+                int j;
+                for (j = 0; j < 4; ++j)
+                    inner.add([&]()
+                        {
+                            std::lock_guard<std::mutex> guard(lock);
+                            ++nested;
+                            if (std::this_thread::get_id() != self)
+                                ++moved;
+                        }, 1);
+                inner.run();
+            }, 1);
+    outer.run();
+
+    DO_TEST((nested == 8) && (moved == 0), "%ld of %ld tasks of nested pools ran "
+            "on other threads", moved, nested);
+}
@@ -0,0 +1,135 @@
+/* libSU3: Tests for the MPFR ISF engine.
+    These only do anything if libSU3 was built with MPFR (see USE_MPFR in
+    config.mk). */
+
+#include <string>
+
+#include "SU3.h"
+#ifdef SU3_USE_MPFR
+#include "SU3_mpfr.h"
+#include "SU3_internal.h"
+#include "compare.h"
+#endif
+#include "test.h"
+
+#ifdef SU3_USE_MPFR
+/* Helper: Compare ISFs from the MPFR engine with the exact values, which are
+    converted to MPFR with twice the precision. Each error should be within
+    the value's own bound, and within 2^-(precision - lost bits). Returns the
+    number of ISFs for which either of these fails. */
+static long count_mpfr_mismatches(const isoarray& exact, const isoarray_mpfr& approx)
+{
+    long p = exact.p, q = exact.q, p1 = exact.p1, q1 = exact.q1,
+        p2 = exact.p2, q2 = exact.q2;
+    long prec = approx.precision();
+    long n, k, l, k1, l1, k2, l2;
+    long mismatches = 0;
+
+    mpfr_t x, diff, tolerance;
+    mpfr_init2(x, 2*prec);
+    mpfr_init2(diff, 2*prec);
+    mpfr_init2(tolerance, 2*prec);
+    mpfr_set_si(tolerance, 1, MPFR_RNDN);
+    mpfr_mul_2si(tolerance, tolerance, approx.lost_bits() - prec, MPFR_RNDN);
+
+    for (n = 0; n < exact.d; ++n)
+        FOREACH_ISF(p, q, p1, q1, p2, q2, k, l, k1, l1, k2, l2)
+        {
+            /* The exact value is stored as sign(v) v^2 */
+            mpq_class squared = isf_io::squared(exact(n, k, l, k1, l1, k2, l2));
+            mpfr_set_q(x, squared.get_mpq_t(), MPFR_RNDN);
+            int sign = mpfr_sgn(x);
+            mpfr_abs(x, x, MPFR_RNDN);
+            mpfr_sqrt(x, x, MPFR_RNDN);
+            if (sign < 0)
+                mpfr_neg(x, x, MPFR_RNDN);
+
+            mpfr_value value = approx(n, k, l, k1, l1, k2, l2);
+            mpfr_sub(diff, value.v, x, MPFR_RNDN);
+            if ((mpfr_cmpabs(diff, value.err) > 0)
+                || (mpfr_cmpabs(diff, tolerance) > 0))
+                ++mismatches;
+        }
+
+    mpfr_clear(x);
+    mpfr_clear(diff);
+    mpfr_clear(tolerance);
+    return mismatches;
+}
+
+/* Helper: As above, for one coupling calculated with both engines */
+static long count_mpfr_mismatches(long p, long q, long p1, long q1, long p2,
+                                    long q2, long precision, long& lost)
+{
+    isoarray* exact = recursion_isoscalars(p, q, p1, q1, p2, q2);
+    isoarray_mpfr* approx = isoscalars_mpfr(p, q, p1, q1, p2, q2, precision);
+    long mismatches = count_mpfr_mismatches(*exact, *approx);
+    lost = approx->lost_bits();
+
+    delete exact;
+    delete approx;
+    return mismatches;
+}
+#endif
+
+TEST(isoscalars_mpfr)
+{
+#ifdef SU3_USE_MPFR
+    /* Every small coupling, at 128 bits */
+    long p, q, p1, q1, p2, q2, lost;
+    long mismatches = 0, worst_lost = 0;
+
+    for (p1 = 0; p1 <= 3; ++p1)
+    for (q1 = 0; p1 + q1 <= 3; ++q1)
+    for (p2 = 0; p2 <= 3; ++p2)
+    for (q2 = 0; p2 + q2 <= 3; ++q2)
+    for (p = 0; p <= 6; ++p)
+    for (q = 0; p + q <= 6; ++q)
+    {
+        if (! degeneracy(p, q, p1, q1, p2, q2)) continue;
+
+        mismatches += count_mpfr_mismatches(p, q, p1, q1, p2, q2, 128, lost);
+        if (lost > worst_lost) worst_lost = lost;
+    }
+
+    DO_TEST(mismatches == 0, "%ld ISFs outside their error bounds", mismatches);
+    DO_TEST(worst_lost < 32, "Up to %ld of 128 bits lost", worst_lost);
+
+    /* A larger coupling, with several degenerate reps */
+    mismatches = count_mpfr_mismatches(5, 5, 5, 5, 5, 5, 256, lost);
+    DO_TEST(mismatches == 0, "%ld ISFs for (5,5) x (5,5) -> (5,5) outside their "
+            "error bounds", mismatches);
+    DO_TEST(lost < 64, "%ld of 256 bits lost for (5,5) x (5,5) -> (5,5)", lost);
+
+    /* At this precision, the rounding errors are far smaller than the
+        smallest long double */
+    mismatches = count_mpfr_mismatches(2, 2, 2, 2, 2, 2, 20000, lost);
+    DO_TEST(mismatches == 0, "%ld ISFs for (2,2) x (2,2) -> (2,2) at 20000 bits "
+            "outside their error bounds", mismatches);
+    DO_TEST(lost < 32, "%ld of 20000 bits lost for (2,2) x (2,2) -> (2,2)", lost);
+
+    /* Decimal output: F(27 -> 8 x 8) for the 27-plet's highest weight is 1,
+        and the full output reads back as the same value */
+    isoarray_mpfr* isf = isoscalars_mpfr(2, 2, 1, 1, 1, 1, 100);
+    mpfr_value v = (*isf)(0, 4, 0, 2, 0, 2, 0);
+    std::string s = v.str(20);
+    DO_TEST(s == "1", "Expected 1, got %s", s.c_str());
+
+    mpfr_t back;
+    mpfr_init2(back, 100);
+    s = (*isf)(0, 4, 1, 2, 1, 2, 0).str();
+    mpfr_set_str(back, s.c_str(), 10, MPFR_RNDN);
+    DO_TEST(mpfr_equal_p(back, (*isf)(0, 4, 1, 2, 1, 2, 0).v),
+            "%s doesn't read back as the same value", s.c_str());
+    mpfr_clear(back);
+
+    DO_TEST(isf->precision() == 100, "Expected precision 100, got %ld", isf->precision());
+    delete isf;
+
+    DO_TEST(isoscalars_mpfr(3, 0, 1, 0, 0, 1, 64) == NULL,
+            "Expected NULL for a coupling of zero degeneracy");
+#else
+    fprintf(stderr, "Skipped: libSU3 was built without MPFR (see USE_MPFR in "
+            "config.mk)\n");
+#endif
+}
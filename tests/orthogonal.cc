@@ -94,12 +94,23 @@ static int check_orthogonal(long p1, long q1, long p2, long q2)
 
 TEST(orthogonal)
 {
-    DO_TEST(check_orthogonal(0, 0, 0, 1),
-            "CGCs for (0,0)x(0,1) not orthonormal");
-    DO_TEST(check_orthogonal(1, 0, 0, 1),
-            "CGCs for (1,0)x(0,1) not orthonormal");
-    DO_TEST(check_orthogonal(1, 0, 2, 0),
-            "CGCs for (1,0)x(2,0) not orthonormal");
-    DO_TEST(check_orthogonal(1, 1, 1, 1),
-            "CGCs for (1,1)x(1,1) not orthonormal");
+    /* Both from the built-in tables and closed forms, and from the recursion
+        alone */
+    isf_settings_guard settings;
+    int pass;
+    for (pass = 0; pass < 2; ++pass)
+    {
+        set_builtin_isf_tables(pass == 0);
+        set_closed_form_isfs(pass == 0);
+        const char* source = (pass == 0) ? "tables" : "recursion";
+
+        DO_TEST(check_orthogonal(0, 0, 0, 1),
+                "CGCs for (0,0)x(0,1) not orthonormal (%s)", source);
+        DO_TEST(check_orthogonal(1, 0, 0, 1),
+                "CGCs for (1,0)x(0,1) not orthonormal (%s)", source);
+        DO_TEST(check_orthogonal(1, 0, 2, 0),
+                "CGCs for (1,0)x(2,0) not orthonormal (%s)", source);
+        DO_TEST(check_orthogonal(1, 1, 1, 1),
+                "CGCs for (1,1)x(1,1) not orthonormal (%s)", source);
+    }
 }
@@ -0,0 +1,62 @@
+/* libSU3: Tests for normalising a single rep */
+
+#include <math.h>
+
+#include "SU3.h"
+#include "SU3_internal.h"
+#include "compare.h"
+#include "test.h"
+
+/* Helper: The ISFs from the recursion, normalised by the general
+    Gram-Schmidt loop even for a single rep */
+static isoarray* general_isoscalars(long p, long q, long p1, long q1, long p2,
+                                    long q2)
+{
+    set_single_rep_normalisation(false);
+    isoarray* isf = recursion_isoscalars(p, q, p1, q1, p2, q2);
+    set_single_rep_normalisation(true);
+    return isf;
+}
+
+TEST(single_rep_normalisation)
+{
+    /* For a single rep, orthonormalise() takes its norm from the sum kept by
+        set_shw(), and divides through in one pass. This should give exactly
+        the same values as the general loop. */
+    long mismatches, count = 0;
+    mismatches = count_recursion_mismatches(general_isoscalars, 3, 6, 1, count);
+    DO_TEST(mismatches == 0, "%ld ISFs differ between the single-rep and general "
+            "normalisation (over %ld couplings)", mismatches, count);
+
+    /* In floating point (which never uses the built-in tables or closed
+        forms), the squares are summed in a different order, so they may
+        differ by rounding */
+    long p, q, p1, q1, p2, q2, k, l, k1, l1, k2, l2;
+    mismatches = 0;
+    count = 0;
+    for (p1 = 0; p1 <= 4; ++p1)
+    for (q1 = 0; p1 + q1 <= 4; ++q1)
+    for (p2 = 0; p2 <= 4; ++p2)
+    for (q2 = 0; p2 + q2 <= 4; ++q2)
+    for (p = 0; p <= 8; ++p)
+    for (q = 0; p + q <= 8; ++q)
+    {
+        if (degeneracy(p, q, p1, q1, p2, q2) != 1) continue;
+
+        isoarray_double* fast = isoscalars_double(p, q, p1, q1, p2, q2);
+        set_single_rep_normalisation(false);
+        isoarray_double* general = isoscalars_double(p, q, p1, q1, p2, q2);
+        set_single_rep_normalisation(true);
+
+        FOREACH_ISF(p, q, p1, q1, p2, q2, k, l, k1, l1, k2, l2)
+            if (fabs((*fast)(0, k, l, k1, l1, k2, l2)
+                        - (*general)(0, k, l, k1, l1, k2, l2)) > 1e-14)
+                ++mismatches;
+        ++count;
+
+        delete fast;
+        delete general;
+    }
+    DO_TEST(mismatches == 0, "%ld floating-point ISFs differ between the single-rep "
+            "and general normalisation (over %ld couplings)", mismatches, count);
+}
@@ -0,0 +1,48 @@
+/* libSU3: Tests for calculating a single degenerate rep */
+
+#include "SU3.h"
+#include "test.h"
+
+/* Helper: Count the ISFs for each rep n which differ from rep n of the full
+    isoarray, for one coupling */
+static long count_mismatches(long p, long q, long p1, long q1, long p2, long q2)
+{
+    isoarray* expected = isoscalars(p, q, p1, q1, p2, q2);
+    long n, k, l, k1, l1, k2, l2;
+    long mismatches = 0;
+
+    for (n = 0; n < expected->d; ++n)
+    {
+        isoarray* isf = isoscalars_rep(p, q, p1, q1, p2, q2, n);
+        if (! isf || (isf->d != 1))
+        {
+            ++mismatches;
+            delete isf;
+            continue;
+        }
+
+        FOREACH_ISF(p, q, p1, q1, p2, q2, k, l, k1, l1, k2, l2)
+            if ((*isf)(0, k, l, k1, l1, k2, l2) != (*expected)(n, k, l, k1, l1, k2, l2))
+                ++mismatches;
+        delete isf;
+    }
+
+    delete expected;
+    return mismatches;
+}
+
+TEST(isoscalars_rep)
+{
+    /* (3,3) and (2,2) are calculated directly; (1,1) x (1,1) -> (1,1) needs
+        a symmetry relation */
+    long mismatches = count_mismatches(3, 3, 3, 3, 3, 3)
+                    + count_mismatches(2, 2, 2, 2, 2, 2)
+                    + count_mismatches(3, 3, 2, 2, 4, 1)
+                    + count_mismatches(1, 1, 1, 1, 1, 1);
+    DO_TEST(mismatches == 0, "%ld ISFs of single degenerate reps differ from "
+            "isoscalars()", mismatches);
+
+    long d = degeneracy(3, 3, 3, 3, 3, 3);
+    DO_TEST(! isoscalars_rep(3, 3, 3, 3, 3, 3, d), "Got ISFs for an out-of-range rep");
+    DO_TEST(! isoscalars_rep(5, 0, 1, 0, 1, 0, 0), "Got ISFs for a zero-degeneracy coupling");
+}
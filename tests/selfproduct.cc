@@ -0,0 +1,75 @@
+/* libSU3: Tests for products of a rep with itself, of which only half is
+    calculated by the recursions */
+
+#include "SU3.h"
+#include "SU3_internal.h"
+#include "compare.h"
+#include "test.h"
+
+/* Helper: Check that every entry of an ISF array for a product of a rep
+    with itself agrees with its mirror image, with one sign for each rep.
+    For a single rep, this sign is given by phase_exch_12(). Returns the
+    number of entries which don't. */
+static long count_mirror_mismatches(const isoarray& isf)
+{
+    long p = isf.p, q = isf.q, p1 = isf.p1, q1 = isf.q1;
+    long n, k, l, k1, l1, k2, l2;
+    long mismatches = 0;
+    for (n = 0; n < isf.d; ++n)
+    {
+        long sign = (isf.d == 1) ? phase_exch_12(p, q, p1, q1, p1, q1) : 0;
+        FOREACH_ISF(p, q, p1, q1, p1, q1, k, l, k1, l1, k2, l2)
+        {
+            sqrat v = isf(n, k, l, k1, l1, k2, l2);
+            sqrat w = isf(n, k, l, k2, l2, k1, l1);
+            if (SIGN((k-l-k1+l1-k2+l2)/2) < 0)
+                v = -v;
+
+            if (v == 0)
+                mismatches += (w != 0);
+            else if (! sign)
+                sign = (w == v) ? 1 : -1;
+
+            if ((v != 0) && (w != sign * v))
+                ++mismatches;
+        }
+    }
+
+    return mismatches;
+}
+
+TEST(self_products)
+{
+    /* The lazy recursion in lazy.cc calculates every value directly, so it
+        makes a good independent check */
+    isf_settings_guard settings;
+    set_builtin_isf_tables(false);
+    set_closed_form_isfs(false);
+
+    long reps[][2] = {{2, 0}, {1, 2}, {2, 2}, {3, 1}};
+    long i, p, q;
+    long mismatches = 0, mirror_mismatches = 0, count = 0;
+    for (i = 0; i < 4; ++i)
+    {
+        long p1 = reps[i][0], q1 = reps[i][1];
+        for (p = 0; p <= 2*(p1+q1); ++p)
+            for (q = 0; p+q <= 2*(p1+q1); ++q)
+            {
+                if (! degeneracy(p, q, p1, q1, p1, q1)) continue;
+
+                isoarray* isf = isoscalars(p, q, p1, q1, p1, q1);
+                isoarray* expected = isoscalars_lazy(p, q, p1, q1, p1, q1);
+                mismatches += count_isf_mismatches(*isf, *expected);
+                mirror_mismatches += count_mirror_mismatches(*isf);
+
+                delete isf;
+                delete expected;
+                ++count;
+            }
+    }
+
+    DO_TEST(mismatches == 0, "%ld ISFs for self-products differ from the full "
+            "recursion (over %ld couplings)", mismatches, count);
+    DO_TEST(mirror_mismatches == 0, "%ld ISFs for self-products don't match "
+            "their mirror images", mirror_mismatches);
+}
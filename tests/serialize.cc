@@ -0,0 +1,47 @@
+/* libSU3: Tests for the binary format used by the disk cache */
+
+#include <string>
+
+#include "SU3.h"
+#include "SU3_internal.h"
+#include "test.h"
+
+/* Helper: Overwrite one of the 8-byte header fields of an encoded isoarray.
+    Field 0 is the format version, followed by p, q, p1, q1, p2, q2 and d. */
+static std::string set_field(std::string data, int field, unsigned long long v)
+{
+    std::string value;
+    isf_io::put_u64(value, v);
+    data.replace(8 + 8*field, 8, value);
+    return data;
+}
+
+static bool decodes(const std::string& data)
+{
+    isoarray* isf = isf_io::decode((const unsigned char*)data.data(), data.size());
+    delete isf;
+    return isf != NULL;
+}
+
+TEST(isf_io_decode)
+{
+    isoarray* isf = isoscalars(2, 2, 2, 2, 2, 2);
+    std::string data = isf_io::encode(*isf);
+    DO_TEST(decodes(data), "Couldn't decode an encoded isoarray");
+    delete isf;
+
+    /* Labels from a corrupt file are checked before they are used */
+    DO_TEST(! decodes(set_field(data, 1, 1ULL << 40)), "Decoded a huge p");
+    DO_TEST(! decodes(set_field(data, 3, ~0ULL)), "Decoded p1 = 2^64 - 1");
+    DO_TEST(! decodes(set_field(data, 7, 0)), "Decoded d = 0");
+
+    /* The number of coefficients mustn't wrap around */
+    size_t size = 0;
+    DO_TEST(isf_io::check_coupling(2, 2, 2, 2, 2, 2, 3, size) && (size == 3*3*3*3*3*3),
+            "Rejected (2,2) x (2,2) -> (2,2)");
+    long d = degeneracy(10000, 10000, 10000, 10000, 10000, 10000);
+    DO_TEST(! isf_io::check_coupling(10000, 10000, 10000, 10000, 10000, 10000, d, size),
+            "Accepted a coupling whose size overflows");
+    DO_TEST(! isf_io::check_coupling(10001, 0, 10001, 0, 0, 0, 1, size),
+            "Accepted labels beyond the limit");
+}
@@ -0,0 +1,63 @@
+/* libSU3: Tests for calculating only the couplings to the state of highest
+    weight */
+
+#include "SU3.h"
+#include "test.h"
+
+/* Helper: Count the values which differ from the k=p+q, l=0 entries of the
+    full isoarray, for one coupling */
+static long count_mismatches(long p, long q, long p1, long q1, long p2, long q2)
+{
+    shwarray* shw = isoscalars_shw(p, q, p1, q1, p2, q2);
+    isoarray* isf = isoscalars(p, q, p1, q1, p2, q2);
+    if (! isf) return shw ? 1 : 0;
+    if (! shw) return 1;
+
+    long n, k, l, k1, l1, k2, l2;
+    long mismatches = 0;
+    for (n = 0; n < isf->d; ++n)
+        FOREACH_ISF(p, q, p1, q1, p2, q2, k, l, k1, l1, k2, l2)
+            if ((k == p+q) && (l == 0)
+                && ((*shw)(n, k1, l1, k2, l2) != (*isf)(n, k, l, k1, l1, k2, l2)))
+                ++mismatches;
+
+    if (shw->size() != (size_t)(isf->d * (p1+1) * (q1+1) * (p2+1)))
+        ++mismatches;
+
+    delete shw;
+    delete isf;
+    return mismatches;
+}
+
+TEST(isoscalars_shw)
+{
+    /* With the built-in tables and closed forms off, this covers couplings
+        calculated directly and ones which need each symmetry relation */
+    isf_settings_guard settings;
+    set_builtin_isf_tables(false);
+    set_closed_form_isfs(false);
+
+    long p, q, p1, q1, p2, q2;
+    long mismatches = 0, count = 0;
+    for (p1 = 0; p1 <= 3; ++p1)
+        for (q1 = 0; q1 <= 3; ++q1)
+            for (p2 = 0; p2 <= 2; ++p2)
+                for (q2 = 0; q2 <= 2; ++q2)
+                    for (p = 0; p <= p1+p2+q2; ++p)
+                        for (q = 0; q <= q1+q2+p1; ++q)
+                        {
+                            if (! degeneracy(p, q, p1, q1, p2, q2)) continue;
+                            mismatches += count_mismatches(p, q, p1, q1, p2, q2);
+                            ++count;
+                        }
+
+    DO_TEST(mismatches == 0, "%ld highest-weight ISFs differ from isoscalars() "
+            "(over %ld couplings)", mismatches, count);
+
+    /* And a larger coupling with several degenerate reps */
+    mismatches = count_mismatches(4, 4, 4, 4, 4, 4);
+    DO_TEST(mismatches == 0, "%ld highest-weight ISFs for (4,4) x (4,4) -> (4,4) "
+            "differ from isoscalars()", mismatches);
+
+    DO_TEST(! isoscalars_shw(5, 0, 1, 0, 1, 0), "Got ISFs for a zero-degeneracy coupling");
+}
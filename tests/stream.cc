@@ -0,0 +1,101 @@
+/* libSU3: Tests for calculating ISFs one row at a time */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "SU3.h"
+#include "test.h"
+
+TEST(isoscalars_stream)
+{
+    /* Each row should match the full calculation, and the rows should come
+        in order. The built-in tables are disabled so that the rows are
+        actually calculated; this range includes couplings which need the
+        symmetry relations. */
+    long p, q, p1, q1, p2, q2, n, k, l, k1, l1, k2, l2;
+    long mismatches = 0, bad_rows = 0, stale = 0, count = 0;
+
+    isf_settings_guard settings;
+    set_builtin_isf_tables(false);
+
+    for (p1 = 0; p1 <= 3; ++p1)
+    for (q1 = 0; p1 + q1 <= 3; ++q1)
+    for (p2 = 0; p2 <= 3; ++p2)
+    for (q2 = 0; p2 + q2 <= 3; ++q2)
+    for (p = 0; p <= 3; ++p)
+    for (q = 0; p + q <= 3; ++q)
+    {
+        long d = degeneracy(p, q, p1, q1, p2, q2);
+        if (! d) continue;
+
+        isoarray* expected = isoscalars(p, q, p1, q1, p2, q2);
+        long rows = 0;
+        isoscalars_stream(p, q, p1, q1, p2, q2, [&](const isorow& row)
+        {
+            /* Rows come in order of increasing n, then decreasing k */
+            if ((row.n != rows / (p+1)) || (row.k != p+q - rows % (p+1)))
+                ++bad_rows;
+            ++rows;
+
+            n = row.n;
+            k = row.k;
+            FOREACH_ISF(p, q, p1, q1, p2, q2, k, l, k1, l1, k2, l2)
+                if ((k == row.k) && (row(l, k1, l1, k2, l2) != (*expected)(n, k, l, k1, l1, k2, l2)))
+                    ++mismatches;
+
+            /* data() is laid out as in an isoarray, so the entries where
+                l2 is out of range should be zero */
+            const sqrat* pos = row.data();
+            for (l = 0; l <= q; ++l)
+                for (k1 = q1; k1 <= p1+q1; ++k1)
+                    for (l1 = 0; l1 <= q1; ++l1)
+                        for (k2 = q2; k2 <= p2+q2; ++k2, ++pos)
+                        {
+                            l2 = (2*p1 + 2*p2 + 4*q1 + 4*q2 - 2*p - 4*q)/3
+                                    - (k1 + l1 + k2 - row.k - l);
+                            if (((l2 < 0) || (l2 > q2)) && (*pos != 0))
+                                ++stale;
+                        }
+        });
+
+        if (rows != d * (p+1))
+            ++bad_rows;
+        ++count;
+        delete expected;
+    }
+
+    DO_TEST(mismatches == 0, "%ld streamed ISFs differ from isoscalars() (over %ld couplings)",
+            mismatches, count);
+    DO_TEST(bad_rows == 0, "%ld rows streamed out of order or missing", bad_rows);
+    DO_TEST(stale == 0, "%ld streamed entries where l2 is out of range are nonzero",
+            stale);
+    DO_TEST(! isoscalars_stream(3, 0, 1, 0, 1, 0, [](const isorow&) {}),
+            "Streaming a coupling of zero degeneracy should fail");
+
+    /* Writing rows to a file and reading them back */
+    FILE* f = tmpfile();
+    DO_TEST(isoscalars_stream(2, 2, 2, 3, 3, 2, f), "Failed to write streamed ISFs");
+    long len = ftell(f);
+
+    rewind(f);
+    isoarray* isf = read_isoscalar_stream(f);
+    isoarray* expected = isoscalars(2, 2, 2, 3, 3, 2);
+    mismatches = 0;
+    if (isf)
+        for (n = 0; n < 3; ++n)
+            FOREACH_ISF(2, 2, 2, 3, 3, 2, k, l, k1, l1, k2, l2)
+                if ((*isf)(n, k, l, k1, l1, k2, l2) != (*expected)(n, k, l, k1, l1, k2, l2))
+                    ++mismatches;
+
+    DO_TEST(isf && (mismatches == 0), "Streamed file doesn't match isoscalars()");
+    delete isf;
+    delete expected;
+
+    /* A truncated file should be rejected */
+    rewind(f);
+    DO_TEST(ftruncate(fileno(f), len - 1) == 0, "Failed to truncate file");
+    isf = read_isoscalar_stream(f);
+    DO_TEST(! isf, "Truncated stream file was accepted");
+    delete isf;
+    fclose(f);
+}
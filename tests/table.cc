@@ -0,0 +1,127 @@
+/* libSU3: Tests for the table of CGCs as doubles */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "SU3.h"
+#include "SU3_table.h"
+#include "test.h"
+
+TEST(table)
+{
+    char path[] = "/tmp/libSU3-table-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        DO_TEST(0, "Couldn't create temporary file");
+        return;
+    }
+    close(fd);
+
+    long max_pq = 2;
+    DO_TEST(export_cgc_table(path, max_pq), "Couldn't write table");
+
+    cgc_table table;
+    DO_TEST(table.open(path), "Couldn't open table");
+    DO_TEST(table.max_pq() == max_pq, "Expected bound %ld, got %ld",
+            max_pq, table.max_pq());
+
+    /* Every coupling in the table should match clebsch_gordans() */
+    long p, q, p1, q1, p2, q2, n, k, l, m, k1, l1, m1, k2, l2, m2;
+    long mismatches = 0, bad_degeneracies = 0;
+
+    for (p = 0; p <= max_pq; ++p)
+    for (q = 0; p + q <= max_pq; ++q)
+    for (p1 = 0; p1 <= max_pq; ++p1)
+    for (q1 = 0; p1 + q1 <= max_pq; ++q1)
+    for (p2 = 0; p2 <= max_pq; ++p2)
+    for (q2 = 0; p2 + q2 <= max_pq; ++q2)
+    {
+        long d = degeneracy(p, q, p1, q1, p2, q2);
+        cgc_table_view view = table.lookup(p, q, p1, q1, p2, q2);
+        if (view.degeneracy() != d) ++bad_degeneracies;
+        if (d == 0) continue;
+
+        cgarray* cg = clebsch_gordans(p, q, p1, q1, p2, q2);
+        for (n = 0; n < d; ++n)
+            FOREACH_CGC(p, q, p1, q1, p2, q2, k, l, m, k1, l1, m1, k2, l2, m2)
+                if (view(n, k, l, m, k1, l1, m1, k2, l2, m2)
+                    != (double)(*cg)(n, k, l, m, k1, l1, m1, k2, l2, m2))
+                    ++mismatches;
+        delete cg;
+    }
+
+    DO_TEST(bad_degeneracies == 0, "%ld couplings have the wrong degeneracy",
+            bad_degeneracies);
+    DO_TEST(mismatches == 0, "%ld CGCs differ from clebsch_gordans()", mismatches);
+
+    /* States which can't couple, and couplings outside the table */
+    DO_TEST(table.cgc(1, 1, 1, 0, 0, 1, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0) == 0,
+            "Expected 0 for states violating Iz conservation");
+    DO_TEST(table.lookup(3, 0, 1, 1, 1, 1).degeneracy() == 0,
+            "Expected no entry for a rep outside the table");
+
+    table.close();
+
+    /* Corrupt tables should be rejected when they are opened, rather than
+        giving reads outside the file in lookup() */
+    FILE* f = fopen(path, "r+b");
+    DO_TEST(f != NULL, "Couldn't reopen table");
+    if (f)
+    {
+        uint64_t header[CGC_TABLE_HDR_WORDS];
+        DO_TEST(fread(header, sizeof(uint64_t), CGC_TABLE_HDR_WORDS, f)
+                == CGC_TABLE_HDR_WORDS, "Couldn't read table header");
+
+        /* The entry for (1,1) x (1,1) -> (1,1), which is rep 4 in the
+            table, points past the end of the data */
+        long nreps = header[CGC_TABLE_HDR_NREPS];
+        long entry = (4*nreps + 4)*nreps + 4;
+        uint64_t dir_entry[2], bad_offset = 1L << 40;
+        long dir_pos = header[CGC_TABLE_HDR_DIRECTORY] + 2 * entry * sizeof(uint64_t);
+        fseek(f, dir_pos, SEEK_SET);
+        DO_TEST(fread(dir_entry, sizeof(uint64_t), 2, f) == 2,
+                "Couldn't read directory entry");
+        DO_TEST(dir_entry[0] != 0, "Expected (1,1) x (1,1) -> (1,1) to be in the table");
+        fseek(f, dir_pos + sizeof(uint64_t), SEEK_SET);
+        fwrite(&bad_offset, sizeof(uint64_t), 1, f);
+        fflush(f);
+        DO_TEST(! table.open(path), "Opened a table with an entry past the end");
+
+        /* A huge degeneracy, whose extent overflows */
+        uint64_t bad_d = ~0ULL;
+        fseek(f, dir_pos, SEEK_SET);
+        fwrite(&bad_d, sizeof(uint64_t), 1, f);
+        fwrite(&dir_entry[1], sizeof(uint64_t), 1, f);
+        fflush(f);
+        DO_TEST(! table.open(path), "Opened a table with an overflowing entry");
+
+        /* Put the entry back, and then cut off the end of the data */
+        fseek(f, dir_pos, SEEK_SET);
+        fwrite(dir_entry, sizeof(uint64_t), 2, f);
+        fflush(f);
+        DO_TEST(table.open(path), "Couldn't open the repaired table");
+        table.close();
+
+        fseek(f, 0, SEEK_END);
+        long len = ftell(f);
+        DO_TEST(ftruncate(fileno(f), len - sizeof(double)) == 0,
+                "Failed to truncate table");
+        DO_TEST(! table.open(path), "Opened a truncated table");
+
+        /* A bound for which the size of the directory overflows */
+        header[CGC_TABLE_HDR_BOUND] = 1L << 22;
+        header[CGC_TABLE_HDR_NREPS] = ((1L << 22) + 1) * ((1L << 22) + 2) / 2;
+        fseek(f, 0, SEEK_SET);
+        fwrite(header, sizeof(uint64_t), CGC_TABLE_HDR_WORDS, f);
+        fflush(f);
+        DO_TEST(! table.open(path), "Opened a table with a huge bound");
+        fclose(f);
+    }
+
+    unlink(path);
+
+    /* Files which aren't tables should be rejected */
+    DO_TEST(! table.open(path), "Opened a nonexistent table");
+}
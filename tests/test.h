@@ -6,6 +6,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "SU3.h"
+
 extern int tests_run;
 extern int tests_passed;
 
@@ -31,6 +33,36 @@ extern int tests_passed;
             ++tests_passed; \
     } while (0)
 
+/* Saves the process-wide settings for calculating ISFs (the engine, layout,
+    built-in tables and closed forms), and restores them when it goes out of
+    scope. Every test or helper which changes them holds one, so that the
+    settings a test starts with don't depend on which tests ran before it,
+    even if one returns early. */
+class isf_settings_guard
+{
+private:
+    isf_engine engine;
+    isf_layout layout;
+    bool builtin_tables, closed_forms;
+
+    isf_settings_guard(const isf_settings_guard&);
+    isf_settings_guard& operator=(const isf_settings_guard&);
+
+public:
+    isf_settings_guard() : engine(get_isf_engine()), layout(get_isf_layout()),
+        builtin_tables(get_builtin_isf_tables()),
+        closed_forms(get_closed_form_isfs())
+    {}
+
+    ~isf_settings_guard()
+    {
+        set_isf_engine(engine);
+        set_isf_layout(layout);
+        set_builtin_isf_tables(builtin_tables);
+        set_closed_form_isfs(closed_forms);
+    }
+};
+
 /* Helper for tests involving the sqrat type
     (tests if a == sqrat(p,q)). "thing" is what the calculation
     is supposed to represent */